@@ -12,24 +12,19 @@
 // Shader code
 //--------------------------------------------------------------------------------------
 
-// This post-processing vertex shader expects that the C++ side will have already done all the matrix transformations for a four
-// point polygon and passed the resultant four points via a constant buffer (rather than via the usual vertex buffer).
-// A more flexible polygon post-procssing system would have vertex and index buffers etc. However for one-off effects (e.g. a frosted window), this is sufficient.
+// This post-processing vertex shader expects that the C++ side will have already done all the matrix transformations for a
+// polygon and passed the resultant points and their area UVs via a constant buffer (rather than via the usual vertex buffer).
+// The polygon is drawn as a triangle list from an index buffer, so the vertex ID is the index of the polygon point. This
+// supports concave polygons and any number of points up to MAX_POLYGON_POINTS (see PostProcessPolygon.h on the C++ side)
 PostProcessingInput main(uint vertexId : SV_VertexID)
 {
 	PostProcessingInput output; // Defined in Common.hlsi
 
-	// The four points of the polygon come from the C++ side. The shader gives the polygon fixed UVs
-	const float2 polygonUVs[4] = { float2(0.0, 0.0),   // Top-left
-					               float2(0.0, 1.0),   // Bottom-left
-						           float2(1.0, 0.0),   // Top-right
-						           float2(1.0, 1.0) }; // Bottom-left
-
-	// The post-processing shaders expect the points of the polygon (came from C++), the UVs for the area to affect (in the array above)...
+	// The post-processing shaders expect the points of the polygon (came from C++), the UVs for the area to affect (also from C++)...
 	// ... and the UVs of which part of the scene texture is getting affected. We don't have that yet but it can be caclulated from the...
 	// ... x and y coordinates of the polygon points
 	output.projectedPosition = gPolygon2DPoints[vertexId];
-	output.areaUV = polygonUVs[vertexId];
+	output.areaUV = gPolygonAreaUVs[vertexId].xy;
 	output.sceneUV = (output.projectedPosition.xy / output.projectedPosition.w + 1.0f) * 0.5f;
 	output.sceneUV.y = 1.0f - output.sceneUV.y;
 
@@ -0,0 +1,172 @@
+//--------------------------------------------------------------------------------------
+// Bloom for CPU images
+//--------------------------------------------------------------------------------------
+// Differences from the GPU chain:
+//   - The bright pass keeps the colour of pixels above the threshold, scaled by the same smoothstep
+//     of luminance as Bloom_pp.hlsl (the shader subtracts 0.9997 afterwards, which leaves at most
+//     0.0003 of bloom)
+//   - The blur is the dual filter at half size rather than a full-size Gaussian
+//   - The Reinhard tone-map and gamma powers of MergeTextures_pp.hlsl use lookup tables
+
+#include "Bloom.h"
+#include "DualFilter.h"
+#include "MathHelpers.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+	const float Gamma = 2.2f;
+
+
+	// Lookup tables for the merge. Each channel of each input goes through pow(x / (x + 1), 1 / gamma), the two results are
+	// added and the sum raised to the power gamma. x / (x + 1) is in the range 0->1 but pow(t, 1 / gamma) is very steep near
+	// zero, so the first table is indexed by sqrt(t) and holds pow(u, 2 / gamma), which is nearly a straight line. The sum is
+	// in the range 0->2 and pow(s, gamma) is smooth so the second table is indexed by the sum directly
+	struct MergeTables
+	{
+		static const int Size = 1024;
+
+		float toneMap[Size + 2]; // Extra entries so interpolation at the top of the range can read one past the end
+		float output [Size + 2];
+
+		MergeTables()
+		{
+			for (int i = 0; i < Size + 2; ++i)
+			{
+				float u = static_cast<float>(i) / Size;
+				toneMap[i] = std::pow(u, 2.0f / Gamma);
+				output[i]  = std::pow(u * 2.0f, Gamma);
+			}
+		}
+
+		// Linear interpolation in a table, x is the table position (0->Size)
+		static inline float Lookup(const float* table, float x)
+		{
+			int   i = static_cast<int>(x);
+			float f = x - i;
+			return table[i] + (table[i + 1] - table[i]) * f;
+		}
+
+		// pow(x / (x + 1), 1 / gamma) for x >= 0
+		inline float ToneMap(float x) const
+		{
+			x = std::max(x, 0.0f);
+			return Lookup(toneMap, std::sqrt(x / (x + 1.0f)) * Size);
+		}
+
+		// pow(s, gamma) for s in the range 0->2
+		inline float Output(float s) const
+		{
+			return Lookup(output, std::min(s, 2.0f) * (Size * 0.5f));
+		}
+
+		// Full calculation from the untouched inputs
+		inline float Merge(float scene, float bloom) const
+		{
+			return Output(ToneMap(scene) + ToneMap(bloom));
+		}
+	};
+	const MergeTables Tables;
+
+
+	// Bloom strength of a colour from its luminance, same as the shader without the final subtraction
+	inline float BrightPassWeight(const ColourRGBA& c, float thresholdLow, float thresholdHigh)
+	{
+		float luma = c.r * 0.299f + c.g * 0.587f + c.b * 0.114f;
+		return SmoothStep(thresholdLow, thresholdHigh, luma);
+	}
+
+
+	// Extract the bright pixels of the scene into an image half the size, averaging each 2x2 block (edge pixels repeated for
+	// odd sizes). The threshold is applied to each full-size pixel before averaging so small highlights are not lost
+	void BrightPass(ThreadPool& threadPool, const Image& scene, Image& target, float thresholdLow, float thresholdHigh)
+	{
+		ForEachRow(threadPool, target.Height(), [&](int y)
+		{
+			const ColourRGBA* row0 = scene.Row(std::min(y * 2,     scene.Height() - 1));
+			const ColourRGBA* row1 = scene.Row(std::min(y * 2 + 1, scene.Height() - 1));
+			ColourRGBA* out = target.Row(y);
+			for (int x = 0; x < target.Width(); ++x)
+			{
+				int x0 = std::min(x * 2,     scene.Width() - 1);
+				int x1 = std::min(x * 2 + 1, scene.Width() - 1);
+				ColourRGBA sum = row0[x0] * BrightPassWeight(row0[x0], thresholdLow, thresholdHigh) +
+				                 row0[x1] * BrightPassWeight(row0[x1], thresholdLow, thresholdHigh) +
+				                 row1[x0] * BrightPassWeight(row1[x0], thresholdLow, thresholdHigh) +
+				                 row1[x1] * BrightPassWeight(row1[x1], thresholdLow, thresholdHigh);
+				out[x] = sum * 0.25f;
+			}
+		});
+	}
+}
+
+
+// Add bloom to the scene image, result in the target (same size)
+void Bloom(ThreadPool& threadPool, const Image& scene, Image& target, std::vector<Image>& halfSize, std::vector<Image>& blurLevels,
+           const BloomSettings& settings)
+{
+	int width  = std::max((scene.Width()  + 1) / 2, 1);
+	int height = std::max((scene.Height() + 1) / 2, 1);
+	halfSize.resize(2);
+	for (auto& image : halfSize)
+	{
+		if (image.Width() != width || image.Height() != height)  image.Resize(width, height);
+	}
+
+	BrightPass(threadPool, scene, halfSize[0], settings.thresholdLow, settings.thresholdHigh);
+	DualFilterBlur(threadPool, halfSize[0], halfSize[1], blurLevels, settings.blurLevels);
+	Image& bloom = halfSize[1];
+
+	// Tone-map the bloom while it is small. The bloom is smooth after blurring so upsampling the tone-mapped values
+	// is very close to tone-mapping the upsampled values, at a quarter of the cost
+	ForEachRow(threadPool, height, [&](int y)
+	{
+		ColourRGBA* row = bloom.Row(y);
+		for (int x = 0; x < width; ++x)
+		{
+			row[x] = { Tables.ToneMap(row[x].r), Tables.ToneMap(row[x].g), Tables.ToneMap(row[x].b), 1.0f };
+		}
+	});
+
+	// Upsample the bloom and merge with the scene in one pass. Full-size pixels map 2:1 onto the half-size texels
+	float invWidth  = 0.5f / width;
+	float invHeight = 0.5f / height;
+	ForEachRow(threadPool, target.Height(), [&](int y)
+	{
+		const ColourRGBA* sceneRow = scene.Row(y);
+		ColourRGBA* out = target.Row(y);
+		CVector2 uv;
+		uv.y = (y + 0.5f) * invHeight;
+		for (int x = 0; x < target.Width(); ++x)
+		{
+			uv.x = (x + 0.5f) * invWidth;
+			ColourRGBA b = bloom.SampleBilinearClamp(uv);
+			out[x] = { Tables.Output(Tables.ToneMap(sceneRow[x].r) + b.r),
+			           Tables.Output(Tables.ToneMap(sceneRow[x].g) + b.g),
+			           Tables.Output(Tables.ToneMap(sceneRow[x].b) + b.b), 1.0f };
+		}
+	});
+}
+
+
+// Largest error of the tone-map/merge lookup tables against the exact pow() calculation in MergeTextures_pp.hlsl
+float BloomMergeMaxError()
+{
+	const int Steps = 4096;
+	const float MaxInput = 64.0f;
+	float maxError = 0.0f;
+	for (int i = 0; i <= Steps; ++i)
+	{
+		// Inputs are spaced more closely near zero, where the tone-map changes fastest
+		float t = static_cast<float>(i) / Steps;
+		float scene = t * t * MaxInput;
+		float bloom = (1.0f - t) * (1.0f - t);
+		float exact = std::pow(std::pow(scene / (scene + 1.0f), 1.0f / Gamma) + std::pow(bloom / (bloom + 1.0f), 1.0f / Gamma), Gamma);
+		maxError = std::max(maxError, std::abs(Tables.Merge(scene, bloom) - exact));
+	}
+	return maxError;
+}
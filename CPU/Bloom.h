@@ -0,0 +1,36 @@
+//--------------------------------------------------------------------------------------
+// Bloom for CPU images
+//--------------------------------------------------------------------------------------
+// The Bloom -> blur -> MergeTextures chain in one call. Bright pixels are extracted straight into a
+// half-size image, blurred there with the dual filter, then tone-mapped and merged with the scene in
+// a single pass. The scene is read directly, it is not held for a later merge pass as on the GPU.
+// Code in .cpp file
+
+#ifndef _BLOOM_H_INCLUDED_
+#define _BLOOM_H_INCLUDED_
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+struct BloomSettings
+{
+	float thresholdLow  = 0.56f; // Pixels with a luminance below this do not bloom, from Bloom_pp.hlsl
+	float thresholdHigh = 0.63f; // Pixels with a luminance above this bloom fully, also from the shader
+	int   blurLevels    = 3;     // Dual filter levels used to blur the half-size bright pixels, each extra level doubles the spread
+};
+
+
+// Add bloom to the scene image, result in the target (same size). The half-size vector holds the bright pixel images and
+// blurLevels the dual filter levels, both are resized as needed and can be kept between calls to avoid reallocating
+void Bloom(ThreadPool& threadPool, const Image& scene, Image& target, std::vector<Image>& halfSize, std::vector<Image>& blurLevels,
+           const BloomSettings& settings);
+
+// Largest error of the tone-map/merge lookup tables against the exact pow() calculation in MergeTextures_pp.hlsl, found by
+// testing a range of inputs. For reporting (about 1.5e-4 over inputs 0 to 64)
+float BloomMergeMaxError();
+
+
+#endif //_BLOOM_H_INCLUDED_
@@ -0,0 +1,134 @@
+//--------------------------------------------------------------------------------------
+// 3D colour lookup table for CPU images
+//--------------------------------------------------------------------------------------
+// Each grid cell is split into six tetrahedra along its main diagonal. The fractional position in
+// the cell decides which tetrahedron the colour is in, and the result is a weighted sum of its four
+// corners. The weights of the sum are worked out in scalar code, the sum itself in one SSE register
+
+#include "ColourLut.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define COLOUR_LUT_SSE
+#endif
+
+
+namespace
+{
+	// Cell containing a grid position and the fraction within it. The fraction is left outside 0->1 for positions off the
+	// edges of the grid so the edge cell is extrapolated
+	inline int Cell(float position, int size, float& fraction)
+	{
+		int cell = std::min(std::max(static_cast<int>(std::floor(position)), 0), size - 2);
+		fraction = position - cell;
+		return cell;
+	}
+}
+
+
+// Evaluate the colour function at every point of a size x size x size grid
+void ColourLut::Bake(int size, const ColourFunction& colourFunction)
+{
+	mSize = std::max(size, 2);
+	mTable.resize(static_cast<size_t>(mSize) * mSize * mSize);
+	float scale = 1.0f / (mSize - 1);
+	ColourRGBA* entry = mTable.data();
+	for (int b = 0; b < mSize; ++b)
+	{
+		for (int g = 0; g < mSize; ++g)
+		{
+			for (int r = 0; r < mSize; ++r)
+			{
+				*entry = colourFunction({ r * scale, g * scale, b * scale, 1.0f });
+				entry->a = 1.0f;
+				++entry;
+			}
+		}
+	}
+}
+
+
+// Interpolated value of the baked function for a colour
+ColourRGBA ColourLut::Lookup(const ColourRGBA& colour) const
+{
+	float scale = static_cast<float>(mSize - 1);
+	float fr, fg, fb;
+	int r = Cell(colour.r * scale, mSize, fr);
+	int g = Cell(colour.g * scale, mSize, fg);
+	int b = Cell(colour.b * scale, mSize, fb);
+
+	// Offsets to the neighbouring entries in each direction
+	const int stepR = 1;
+	const int stepG = mSize;
+	const int stepB = mSize * mSize;
+	const ColourRGBA* c000 = mTable.data() + r * stepR + g * stepG + b * stepB;
+
+	// The tetrahedron is given by the order of the fractions. It runs from c000 to c111 along one edge in each direction,
+	// largest fraction first. The weights are the differences between consecutive fractions
+	int step1, step2;
+	float f1, f2, f3;
+	if (fr > fg)
+	{
+		if      (fg > fb) { step1 = stepR; step2 = stepG; f1 = fr; f2 = fg; f3 = fb; }
+		else if (fr > fb) { step1 = stepR; step2 = stepB; f1 = fr; f2 = fb; f3 = fg; }
+		else              { step1 = stepB; step2 = stepR; f1 = fb; f2 = fr; f3 = fg; }
+	}
+	else
+	{
+		if      (fb > fg) { step1 = stepB; step2 = stepG; f1 = fb; f2 = fg; f3 = fr; }
+		else if (fb > fr) { step1 = stepG; step2 = stepB; f1 = fg; f2 = fb; f3 = fr; }
+		else              { step1 = stepG; step2 = stepR; f1 = fg; f2 = fr; f3 = fb; }
+	}
+	const ColourRGBA* c1 = c000 + step1;
+	const ColourRGBA* c2 = c1 + step2;
+	const ColourRGBA* c3 = c000 + stepR + stepG + stepB;
+	float w0 = 1.0f - f1;
+	float w1 = f1 - f2;
+	float w2 = f2 - f3;
+	float w3 = f3;
+
+#ifdef COLOUR_LUT_SSE
+	__m128 sum = _mm_mul_ps(_mm_set1_ps(w0), _mm_loadu_ps(&c000->r));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w1), _mm_loadu_ps(&c1->r)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w2), _mm_loadu_ps(&c2->r)));
+	sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(w3), _mm_loadu_ps(&c3->r)));
+	ColourRGBA result;
+	_mm_storeu_ps(&result.r, sum);
+	result.a = 1.0f;
+	return result;
+#else
+	// Platforms without SSE
+	ColourRGBA result = *c000 * w0 + *c1 * w1 + *c2 * w2 + *c3 * w3;
+	result.a = 1.0f;
+	return result;
+#endif
+}
+
+
+// Largest difference in any channel between Lookup and the colour function over a grid of test colours
+float ColourLut::MaxError(const ColourFunction& colourFunction, float maxInput) const
+{
+	// Test points are at the centres of the cells of a grid offset from the table's, which avoids the table entries
+	// themselves where the error is zero
+	const int TestSize = 24;
+	float maxError = 0.0f;
+	for (int b = 0; b < TestSize; ++b)
+	{
+		for (int g = 0; g < TestSize; ++g)
+		{
+			for (int r = 0; r < TestSize; ++r)
+			{
+				ColourRGBA colour = { (r + 0.5f) / TestSize * maxInput, (g + 0.5f) / TestSize * maxInput,
+				                      (b + 0.5f) / TestSize * maxInput, 1.0f };
+				ColourRGBA exact  = colourFunction(colour);
+				ColourRGBA lookup = Lookup(colour);
+				maxError = std::max({ maxError, std::abs(lookup.r - exact.r), std::abs(lookup.g - exact.g),
+				                      std::abs(lookup.b - exact.b) });
+			}
+		}
+	}
+	return maxError;
+}
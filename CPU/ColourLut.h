@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// 3D colour lookup table for CPU images
+//--------------------------------------------------------------------------------------
+// A colour function baked into a grid of colours over the range 0->1 in red, green and blue (33 or
+// 65 entries each way are usual). Colours are looked up with tetrahedral interpolation, which reads
+// four table entries rather than the eight of trilinear and reproduces affine functions exactly.
+// Colours outside 0->1 (HDR) are extrapolated from the nearest cell rather than clamped. Lookups use
+// SSE where available. Code in .cpp file
+
+#ifndef _COLOUR_LUT_H_INCLUDED_
+#define _COLOUR_LUT_H_INCLUDED_
+
+#include "ColourRGBA.h"
+
+#include <functional>
+#include <vector>
+
+
+// Colour function that can be baked, alpha of the input is 1 and alpha of the result is ignored
+using ColourFunction = std::function<ColourRGBA(const ColourRGBA& colour)>;
+
+
+class ColourLut
+{
+public:
+	// Evaluate the colour function at every point of a size x size x size grid (size >= 2)
+	void Bake(int size, const ColourFunction& colourFunction);
+
+	int Size() const  { return mSize; }
+
+	// Interpolated value of the baked function for a colour, alpha of the result is 1
+	ColourRGBA Lookup(const ColourRGBA& colour) const;
+
+	// Largest difference in any channel between Lookup and the colour function over a grid of test colours in the range
+	// 0->maxInput, placed between the table entries where interpolation error is greatest. Use to check a table size
+	float MaxError(const ColourFunction& colourFunction, float maxInput) const;
+
+private:
+	int mSize = 0;
+	std::vector<ColourRGBA> mTable; // Red changes fastest, then green, then blue
+};
+
+
+#endif //_COLOUR_LUT_H_INCLUDED_
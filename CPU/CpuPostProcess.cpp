@@ -0,0 +1,591 @@
+//--------------------------------------------------------------------------------------
+// CPU post-processing pipeline
+//--------------------------------------------------------------------------------------
+// Follows the structure of the GPU post-processing in Scene.cpp: each entry in the stack is one pass
+// that reads one ping-pong image and writes the other. Area and polygon passes first copy the whole
+// scene across then process their region over the copy, polygons only shade the spans they cover.
+// Groups of polygon passes are instead drawn together in one sweep (see RegionComposite.h)
+
+#include "CpuPostProcess.h"
+#include "DualFilter.h"
+#include "GaussianBlur.h"
+#include "LightStreak.h"
+#include "PixelFormat.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+	// Size of the tiles that passes are split into for multithreading. Small enough to spread the work evenly
+	// over the threads and keep each tile's rows in cache, large enough to keep the per-tile overhead low
+	const int TileSize = 64;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+// The thread pool is used for all the work and must outlive this object
+CpuPostProcessor::CpuPostProcessor(ThreadPool& threadPool, int width, int height)
+	: mThreadPool(threadPool), mHasPreviousViewProjection(false), mCacheBytes(LastLevelCacheBytes())
+{
+	Resize(width, height);
+}
+
+
+// Change the size of the images, content is lost
+void CpuPostProcessor::Resize(int width, int height)
+{
+	mSceneImages.resize(1);
+	mSceneImages[0].Resize(width, height);
+	mVelocity.Resize(width, height);
+	mFusedImages.clear();
+
+	mSceneImages[0].Clear({ 0, 0, 0, 1 });
+}
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Run every pass in the post-process stack over the scene image and return the final result
+const Image& CpuPostProcessor::Execute(const PostProcessStack& stack, PostProcessingConstants& constants, const PostProcessTextures& textures,
+                                       float frameTime, const PostProcessRegionFunction& regionFunction /*= nullptr*/)
+{
+	// Stacks that don't need floats run in fixed point when the output is LDR
+	mUsedFixedPoint = mSettings.ldrOutput && CanRunFixedPoint(stack);
+	if (mUsedFixedPoint)  return ExecuteFixedPoint(stack, constants, frameTime);
+
+	PostProcessInputs inputs;
+	inputs.velocityTexture = &mVelocity;
+	inputs.depthTexture    = textures.depthTexture;
+	inputs.noiseMap        = textures.noiseMap;
+	inputs.burnMap         = textures.burnMap;
+	inputs.distortMap      = textures.distortMap;
+	inputs.constants       = &constants;
+	inputs.viewportWidth   = static_cast<float>(Width());
+	inputs.viewportHeight  = static_cast<float>(Height());
+
+	// The velocity buffer is made when the first MotionBlur pass needs it
+	bool velocityReady = false;
+	const CMatrix4x4& previousViewProjection = mHasPreviousViewProjection ? mPreviousViewProjection : mSettings.viewProjectionMatrix;
+
+	// Chains of colour-only passes are run as one pass (see PointOpFusion.h). Each step below is either a chain or a single
+	// pass, a chain is represented by its first pass
+	mFusedPasses = 0;
+	PostProcessStack steps;
+	std::vector<int>  stepPasses; // Number of passes in each step
+	std::vector<bool> isChain;    // Whether each step is a chain
+	for (int i = 0; i < static_cast<int>(stack.size()); i += stepPasses.back())
+	{
+		steps.push_back(stack[i]);
+		int chainLength = mSettings.fusePointOps ? PointOpChainLength(stack, i) : 0;
+		stepPasses.push_back(std::max(chainLength, 1));
+		isChain.push_back(chainLength > 0);
+		mFusedPasses += stepPasses.back() - 1;
+	}
+
+	// Consecutive full-screen steps that only read nearby pixels are run together tile by tile (see TileFusion.h). Each group
+	// below is either a tile-fused group of steps or a single step, a group is represented by its first pass, which is enough
+	// for planning as none of the steps in a fused group use history
+	auto canTileFuse = [&](int step)
+	{
+		return steps[step].second == PostProcessMode::Fullscreen && (isChain[step] || CanTileFuse(steps[step].first));
+	};
+	// Consecutive polygon steps are also grouped, and drawn in a single sweep (see RegionComposite.h)
+	auto canComposite = [&](int step)
+	{
+		return steps[step].second == PostProcessMode::Polygon && CanCompositeRegion(steps[step].first);
+	};
+	PostProcessStack groups;
+	std::vector<int>  groupSteps;  // Number of steps in each group
+	std::vector<bool> isComposite; // Whether each group is a group of polygon steps
+	for (int step = 0; step < static_cast<int>(steps.size()); step += groupSteps.back())
+	{
+		int length = 1;
+		if (mSettings.tileFusion && canTileFuse(step))
+		{
+			while (step + length < static_cast<int>(steps.size()) && canTileFuse(step + length))  ++length;
+		}
+		else if (mSettings.compositeRegions && canComposite(step))
+		{
+			while (step + length < static_cast<int>(steps.size()) && canComposite(step + length) && length < MaxCompositeRegions)  ++length;
+		}
+		groups.push_back(steps[step]);
+		groupSteps.push_back(length);
+		isComposite.push_back(length > 1 && steps[step].second == PostProcessMode::Polygon);
+	}
+
+	// Work out which scene image each group reads and writes. The scene before Bloom or DepthOfField is held (not copied)
+	// until the last group that needs it, images that are not needed at the same time share memory
+	PostProcessBufferPlan plan = PlanPostProcessBuffers(groups, false);
+	while (static_cast<int>(mSceneImages.size()) < plan.numBuffers)  mSceneImages.emplace_back(Width(), Height());
+	mSceneImages.resize(std::max(plan.numBuffers, 1));
+
+	// Tile-fused groups keep the output of each step but the last in an image of its own. Polygon groups draw straight into
+	// their target and need none
+	int largestGroup = 0;
+	for (int group = 0; group < static_cast<int>(groups.size()); ++group)
+	{
+		if (!isComposite[group])  largestGroup = std::max(largestGroup, groupSteps[group]);
+	}
+	while (static_cast<int>(mFusedImages.size()) < largestGroup - 1)  mFusedImages.emplace_back(Width(), Height());
+	mFusedImages.resize(std::max(largestGroup - 1, 0));
+
+	mTileFusionStats = TileFusionStats();
+	mTileFusionStats.passByPassBytes = steps.size() * 2 * ImageBytes();
+	mTileFusionStats.fusedBytes      = mTileFusionStats.passByPassBytes;
+
+	// One chain object for each chain in the stack, made before any are used as fused groups hold on to them
+	int numChains = static_cast<int>(std::count(isChain.begin(), isChain.end(), true));
+	if (static_cast<int>(mPointOpChains.size()) < numChains)  mPointOpChains.resize(numChains);
+	mUsedPointOpChains = 0;
+
+	mCompositedPasses = 0;
+	mCompositedPixels = 0;
+
+	// Format of the latest result, which images are rounded to in the same way as the GPU's scene buffers
+	SceneBufferFormat currentFormat = std::max(SCENE_RENDER_FORMAT, mSettings.minBufferFormat);
+	if (!groups.empty())  QuantiseImage(mThreadPool, mSceneImages[0], currentFormat);
+
+	int current = 0; // Image with the latest result, the scene image to start with
+	int processIndex = 0;
+	int step = 0;
+	for (int group = 0; group < static_cast<int>(groups.size()); ++group)
+	{
+		PostProcess     postProcess = groups[group].first;
+		PostProcessMode mode        = groups[group].second;
+		int firstProcess = processIndex;
+
+		int next = plan.imageBuffer[group + 1];
+		int preEffect = plan.preEffect[group];
+
+		const Image& source = mSceneImages[current];
+		Image&       target = mSceneImages[next];
+		inputs.sceneTexture = &source;
+
+		// With no earlier Bloom or DepthOfField the pass's own input stands in for the scene before the effect
+		inputs.sharpTexture = &mSceneImages[preEffect >= 0 ? plan.imageBuffer[preEffect] : current];
+
+		if (postProcess == PostProcess::MotionBlur && !velocityReady)
+		{
+			VelocityBuffer(mThreadPool, textures.depthTexture, mVelocity, mSettings.viewProjectionMatrix, previousViewProjection,
+			               mSettings.motionBlurMaxLength);
+			velocityReady = true;
+		}
+
+		if (isComposite[group])
+		{
+			processIndex = CompositeRegionGroup(stack, processIndex, groupSteps[group], inputs, constants, frameTime, regionFunction,
+			                                    target);
+		}
+		else if (groupSteps[group] > 1)
+		{
+			processIndex = TileFusedGroup(stack, processIndex, stepPasses, isChain, step, groupSteps[group], inputs, constants,
+			                              frameTime, target);
+		}
+		else if (isChain[step])
+		{
+			BuildPointOpChain(stack, processIndex, stepPasses[step], constants, frameTime).Run(mThreadPool, inputs, target,
+			                                                                                   mSettings.colourLutSize);
+			processIndex += stepPasses[step];
+		}
+		else if (mode == PostProcessMode::Fullscreen)
+		{
+			UpdatePostProcessConstants(postProcess, constants, frameTime, Width(), Height());
+			constants.area2DTopLeft = { 0, 0 };
+			constants.area2DSize    = { 1, 1 };
+			constants.area2DDepth   = 0;
+			FullScreenPass(postProcess, inputs, target);
+			++processIndex;
+		}
+		else
+		{
+			// Copy the whole scene first, the region is processed over the top of it
+			CopyImage(source, target);
+
+			UpdatePostProcessConstants(postProcess, constants, frameTime, Width(), Height());
+			if (regionFunction && regionFunction(mode, processIndex, constants))
+			{
+				if (mode == PostProcessMode::Area)  AreaPass   (postProcess, inputs, target);
+				else                                PolygonPass(postProcess, inputs, target);
+			}
+			++processIndex;
+		}
+
+		for (int i = firstProcess; i < processIndex; ++i)
+		{
+			currentFormat = std::max(PostProcessOutputFormat(stack[i].first, stack[i].second, currentFormat), mSettings.minBufferFormat);
+		}
+		QuantiseImage(mThreadPool, target, currentFormat);
+
+		current = next;
+		step += groupSteps[group];
+	}
+
+	mPreviousViewProjection = mSettings.viewProjectionMatrix;
+	mHasPreviousViewProjection = true;
+
+	return mSceneImages[current];
+}
+
+
+// Run every pass in a stack with the fixed-point kernels
+const Image& CpuPostProcessor::ExecuteFixedPoint(const PostProcessStack& stack, PostProcessingConstants& constants, float frameTime)
+{
+	PostProcessInputs inputs;
+	inputs.constants      = &constants;
+	inputs.viewportWidth  = static_cast<float>(Width());
+	inputs.viewportHeight = static_cast<float>(Height());
+
+	ImageToFixed(mThreadPool, mSceneImages[0], mFixedImages[0]);
+	mFixedImages[1].Resize(Width(), Height());
+
+	int current = 0;
+	for (const auto& pass : stack)
+	{
+		UpdatePostProcessConstants(pass.first, constants, frameTime, Width(), Height());
+		constants.area2DTopLeft = { 0, 0 };
+		constants.area2DSize    = { 1, 1 };
+		constants.area2DDepth   = 0;
+		FixedPointPass(mThreadPool, pass.first, inputs, mFixedImages[current], mFixedImages[1 - current]);
+		current = 1 - current;
+	}
+
+	// None of the float pipeline's work is done
+	mFusedPasses = 0;
+	mUsedPointOpChains = 0;
+	mTileFusionStats = TileFusionStats();
+	mCompositedPasses = 0;
+	mCompositedPixels = 0;
+
+	mPreviousViewProjection = mSettings.viewProjectionMatrix;
+	mHasPreviousViewProjection = true;
+
+	// The result is returned in the second scene image, as it would be by the float pipeline
+	if (mSceneImages.size() < 2)  mSceneImages.emplace_back(Width(), Height());
+	FixedToImage(mThreadPool, mFixedImages[current], mSceneImages[1]);
+	return mSceneImages[1];
+}
+
+
+// Run a group of polygon passes in a single sweep
+int CpuPostProcessor::CompositeRegionGroup(const PostProcessStack& stack, int processIndex, int numPasses, const PostProcessInputs& inputs,
+                                           PostProcessingConstants& constants, float frameTime,
+                                           const PostProcessRegionFunction& regionFunction, Image& target)
+{
+	// The constants are updated and the polygon found for every pass in the same order as running them separately, each
+	// polygon keeps a copy of the constants as they would be when it runs
+	mRegionCompositor.Begin(Width(), Height());
+	for (int i = 0; i < numPasses; ++i)
+	{
+		PostProcess postProcess = stack[processIndex].first;
+		UpdatePostProcessConstants(postProcess, constants, frameTime, Width(), Height());
+		if (regionFunction && regionFunction(PostProcessMode::Polygon, processIndex, constants))
+		{
+			mRegionCompositor.AddPolygon(postProcess, constants);
+		}
+		++processIndex;
+	}
+
+	mRegionCompositor.Run(mThreadPool, inputs, target);
+	mCompositedPasses += numPasses;
+	mCompositedPixels += mRegionCompositor.CoveredPixels();
+	return processIndex;
+}
+
+
+// Largest error of the colour lookup tables used by the last call to Execute
+float CpuPostProcessor::ColourLutMaxError(float maxInput) const
+{
+	float maxError = 0.0f;
+	for (int chain = 0; chain < mUsedPointOpChains; ++chain)
+	{
+		maxError = std::max(maxError, mPointOpChains[chain].LutMaxError(maxInput));
+	}
+	return maxError;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Passes
+//--------------------------------------------------------------------------------------
+
+void CpuPostProcessor::FullScreenPass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target)
+{
+	if (WholeImagePass(postProcess, inputs, target))  return;
+
+	FullScreenRows(postProcess, inputs, target, 0, target.Height());
+}
+
+
+// Run a full-screen post-process that shades each pixel separately over the given rows of the target image
+void CpuPostProcessor::FullScreenRows(PostProcess postProcess, const PostProcessInputs& inputs, Image& target, int top, int bottom)
+{
+	PixelRect rows = { 0, top, target.Width(), bottom };
+	if (GaussianBlurPass(postProcess, inputs, target, rows))  return;
+
+	FullScreenShaderFunction shader = GetFullScreenShader(postProcess);
+	ForEachTile(rows, [&](const PixelRect& tile)
+	{
+		shader(inputs, target, tile);
+	});
+}
+
+
+// Process the rectangle given by area2DTopLeft/area2DSize, alpha blending the result over the target like gAlphaBlendingState.
+// There is no depth test against the scene
+void CpuPostProcessor::AreaPass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	float width  = inputs.viewportWidth;
+	float height = inputs.viewportHeight;
+
+	// Pixels are covered when their centre is inside the area (same rule as the GPU rasterizer)
+	PixelRect rect;
+	rect.left   = std::max(static_cast<int>(std::ceil(c.area2DTopLeft.x * width  - 0.5f)), 0);
+	rect.top    = std::max(static_cast<int>(std::ceil(c.area2DTopLeft.y * height - 0.5f)), 0);
+	rect.right  = std::min(static_cast<int>(std::ceil((c.area2DTopLeft.x + c.area2DSize.x) * width  - 0.5f)), target.Width());
+	rect.bottom = std::min(static_cast<int>(std::ceil((c.area2DTopLeft.y + c.area2DSize.y) * height - 0.5f)), target.Height());
+	if (rect.IsEmpty() || c.area2DSize.x <= 0 || c.area2DSize.y <= 0)  return;
+
+	// Blurs are opaque so blending is not needed
+	if (GaussianBlurPass(postProcess, inputs, target, rect))  return;
+
+	PixelShaderFunction shader = GetPixelShader(postProcess);
+	ForEachTile(rect, [&](const PixelRect& tile)
+	{
+		for (int y = tile.top; y < tile.bottom; ++y)
+		{
+			ColourRGBA* row = target.Row(y);
+			CVector2 sceneUV, areaUV;
+			sceneUV.y = (y + 0.5f) / height;
+			areaUV.y  = (sceneUV.y - c.area2DTopLeft.y) / c.area2DSize.y;
+			for (int x = tile.left; x < tile.right; ++x)
+			{
+				sceneUV.x = (x + 0.5f) / width;
+				areaUV.x  = (sceneUV.x - c.area2DTopLeft.x) / c.area2DSize.x;
+				ColourRGBA colour = shader(inputs, sceneUV, areaUV);
+
+				// Blend colour by source alpha, alpha channel is replaced
+				float alpha = colour.a;
+				row[x] = { row[x].r + (colour.r - row[x].r) * alpha,
+				           row[x].g + (colour.g - row[x].g) * alpha,
+				           row[x].b + (colour.b - row[x].b) * alpha, alpha };
+			}
+		}
+	});
+}
+
+
+// Process the polygon in the constants (see PostProcessPolygon.h), shading only the spans of pixels it covers. Scene UVs are
+// screen positions, area UVs are interpolated with perspective correction. There is no alpha blending, like the GPU version
+void CpuPostProcessor::PolygonPass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target)
+{
+	const PostProcessingConstants& c = *inputs.constants;
+	float width  = inputs.viewportWidth;
+	float height = inputs.viewportHeight;
+
+	std::vector<CVector2> points = PolygonPixelPoints(c, width, height);
+	PolygonSpans(points, target.Width(), target.Height(), mPolygonSpans);
+	if (mPolygonSpans.empty())  return;
+
+	PolygonUVMapping areaUVs;
+	if (!areaUVs.Set(c, points))  return;
+
+	PixelShaderFunction shader = GetPixelShader(postProcess);
+	const int spansPerJob = 16;
+	int numJobs = (static_cast<int>(mPolygonSpans.size()) + spansPerJob - 1) / spansPerJob;
+	mThreadPool.ParallelFor(numJobs, [&](int job)
+	{
+		size_t first = static_cast<size_t>(job) * spansPerJob;
+		size_t last  = std::min(first + spansPerJob, mPolygonSpans.size());
+		for (size_t i = first; i < last; ++i)
+		{
+			const PolygonSpan& span = mPolygonSpans[i];
+			ColourRGBA* row = target.Row(span.y);
+			float cy = span.y + 0.5f;
+			for (int x = span.left; x < span.right; ++x)
+			{
+				float cx = x + 0.5f;
+				CVector2 sceneUV = { cx / width, cy / height };
+				row[x] = shader(inputs, sceneUV, areaUVs.At(cx, cy));
+			}
+		}
+	});
+}
+
+
+// Build the next chain of colour-only passes from count passes in the stack starting at first. The constants are updated for
+// each pass in the chain as if they were run separately
+PointOpChain& CpuPostProcessor::BuildPointOpChain(const PostProcessStack& stack, int first, int count,
+                                                  PostProcessingConstants& constants, float frameTime)
+{
+	PointOpChain& chain = mPointOpChains[mUsedPointOpChains++];
+	for (int i = 0; i < count; ++i)
+	{
+		PostProcess postProcess = stack[first + i].first;
+		UpdatePostProcessConstants(postProcess, constants, frameTime, Width(), Height());
+		constants.area2DTopLeft = { 0, 0 };
+		constants.area2DSize    = { 1, 1 };
+		constants.area2DDepth   = 0;
+		if (i == 0)  chain.Begin(postProcess, constants);
+		else         chain.Add  (postProcess, constants);
+	}
+	return chain;
+}
+
+
+// Run a group of full-screen steps tile by tile, from the input in the inputs to the target. The group starts at the given
+// position in the stack and step. Returns the position in the stack after the group
+int CpuPostProcessor::TileFusedGroup(const PostProcessStack& stack, int processIndex, const std::vector<int>& stepPasses,
+                                     const std::vector<bool>& isChain, int firstStep, int numSteps, const PostProcessInputs& inputs,
+                                     PostProcessingConstants& constants, float frameTime, Image& target)
+{
+	// The constants are updated for every pass before any are run, in the same order as running them separately. Each step
+	// keeps a copy of the constants as they would be when it runs
+	mFusedConstants.resize(numSteps);
+	std::vector<TileFusionStage> stages(numSteps);
+	for (int i = 0; i < numSteps; ++i)
+	{
+		int step = firstStep + i;
+		PostProcess postProcess = stack[processIndex].first;
+
+		// Each step reads the output of the one before, the steps between the first and last write to the fused images
+		PostProcessInputs stageInputs = inputs;
+		stageInputs.sceneTexture = (i == 0) ? inputs.sceneTexture : &mFusedImages[i - 1];
+		stageInputs.sharpTexture = stageInputs.sceneTexture;
+		Image* stageTarget = (i == numSteps - 1) ? &target : &mFusedImages[i];
+
+		if (isChain[step])
+		{
+			PointOpChain* chain = &BuildPointOpChain(stack, processIndex, stepPasses[step], constants, frameTime);
+			chain->Prepare(mSettings.colourLutSize);
+			stages[i].run = [this, chain, stageInputs, stageTarget](int top, int bottom)
+			{
+				chain->RunRows(mThreadPool, stageInputs, *stageTarget, top, bottom);
+			};
+		}
+		else
+		{
+			UpdatePostProcessConstants(postProcess, constants, frameTime, Width(), Height());
+			constants.area2DTopLeft = { 0, 0 };
+			constants.area2DSize    = { 1, 1 };
+			constants.area2DDepth   = 0;
+			stageInputs.constants = &mFusedConstants[i];
+			stages[i].run = [this, postProcess, stageInputs, stageTarget](int top, int bottom)
+			{
+				FullScreenRows(postProcess, stageInputs, *stageTarget, top, bottom);
+			};
+		}
+
+		// A chain only reads nearby pixels in its first pass
+		mFusedConstants[i] = constants;
+		stages[i].footprintRows = SampleFootprintRows(postProcess, mFusedConstants[i], Width(), Height());
+
+		processIndex += stepPasses[step];
+		mTileFusionStats.fusedPasses += stepPasses[step];
+	}
+
+	size_t cacheBytes = (mSettings.tileFusionCacheBytes != 0) ? mSettings.tileFusionCacheBytes : mCacheBytes;
+	int tileRows = TileFusionRows(cacheBytes, Width(), Height(), numSteps);
+	RunTileFused(Height(), tileRows, stages);
+
+	// Each image between the steps is read from cache rather than memory
+	++mTileFusionStats.fusedGroups;
+	mTileFusionStats.tileRows = tileRows;
+	mTileFusionStats.fusedBytes -= (numSteps - 1) * ImageBytes();
+
+	return processIndex;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Helpers
+//--------------------------------------------------------------------------------------
+
+// The Gaussian blur post-processes are run with the separable blur in GaussianBlur.h rather than the shader ports. The blur
+// amount is converted to a sigma that spreads colour as far as the shaders' kernel, but with no gaps between the samples.
+// Returns false if the post-process is not a Gaussian blur
+bool CpuPostProcessor::GaussianBlurPass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target, const PixelRect& rect)
+{
+	if (postProcess != PostProcess::GaussianBlurHorizontal && postProcess != PostProcess::GaussianBlurVertical)  return false;
+
+	std::vector<float> weights = GaussianBlurWeights(inputs.constants->blurAmount * GaussianSigmaPerBlurAmount);
+	if (postProcess == PostProcess::GaussianBlurHorizontal)
+	{
+		GaussianBlurHorizontal(mThreadPool, *inputs.sceneTexture, target, rect, weights);
+	}
+	else
+	{
+		GaussianBlurVertical(mThreadPool, *inputs.sceneTexture, target, rect, weights);
+	}
+	return true;
+}
+
+
+// Run a post-process that works on the whole image rather than pixel by pixel (the CPU-only post-processes, depth of field
+// and motion blur). Returns false for other post-processes. In area and polygon modes these post-processes fall back to their
+// pixel shader (the copy shader for CPU-only post-processes)
+bool CpuPostProcessor::WholeImagePass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target)
+{
+	if (postProcess == PostProcess::DepthOfField)
+	{
+		mDepthOfFieldStats = DepthOfField(mThreadPool, *inputs.sharpTexture, inputs.depthTexture, target, mCircleOfConfusion,
+		                                  mSettings.nearClip, mSettings.farClip, inputs.constants->distanceToFocusedObject);
+		return true;
+	}
+	if (postProcess == PostProcess::MotionBlur)
+	{
+		mMotionBlurStats = MotionBlur(mThreadPool, *inputs.sceneTexture, *inputs.velocityTexture, target, mTileVelocity, MotionBlurAmount);
+		return true;
+	}
+	if (postProcess == PostProcess::DualFilterPyramid)
+	{
+		DualFilterBlur(mThreadPool, *inputs.sceneTexture, target, mDualFilterLevels, mSettings.dualFilterLevels);
+		return true;
+	}
+	if (postProcess == PostProcess::LightStreaks)
+	{
+		KawaseLightStreaks(mThreadPool, *inputs.sceneTexture, *inputs.sharpTexture, target, mLightStreakLevels, mSettings.lightStreakIterations);
+		return true;
+	}
+	if (postProcess == PostProcess::BloomMerge)
+	{
+		// Reads the scene directly, no copy is needed
+		Bloom(mThreadPool, *inputs.sceneTexture, target, mBloomImages, mBloomLevels, mSettings.bloom);
+		return true;
+	}
+	return false;
+}
+
+
+// Copy all of one image to another, in parallel
+void CpuPostProcessor::CopyImage(const Image& source, Image& target)
+{
+	ForEachTile(target.Rect(), [&](const PixelRect& tile)
+	{
+		target.CopyRect(source, tile);
+	});
+}
+
+
+// Split a rectangle into tiles and call the given function for each tile, spread over the thread pool
+void CpuPostProcessor::ForEachTile(const PixelRect& rect, const std::function<void(const PixelRect&)>& tileFunction)
+{
+	int tilesX = (rect.Width()  + TileSize - 1) / TileSize;
+	int tilesY = (rect.Height() + TileSize - 1) / TileSize;
+	mThreadPool.ParallelFor(tilesX * tilesY, [&](int tileIndex)
+	{
+		PixelRect tile;
+		tile.left   = rect.left + (tileIndex % tilesX) * TileSize;
+		tile.top    = rect.top  + (tileIndex / tilesX) * TileSize;
+		tile.right  = std::min(tile.left + TileSize, rect.right);
+		tile.bottom = std::min(tile.top  + TileSize, rect.bottom);
+		tileFunction(tile);
+	});
+}
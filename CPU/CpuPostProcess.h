@@ -0,0 +1,257 @@
+//--------------------------------------------------------------------------------------
+// CPU post-processing pipeline
+//--------------------------------------------------------------------------------------
+// Runs the same post-process stack as the GPU (gPostProcessAndModeStack) entirely on the CPU,
+// using float RGBA images in place of the scene textures. Work is split into tiles which are
+// shaded in parallel on a thread pool. Nothing here uses DirectX, so it can run headless
+// (e.g. for testing effects or on machines without a GPU) - CMakeLists.txt builds it without DirectX along
+// with a command-line driver (Tools folder) and tests (Tests folder). Code in .cpp file
+
+#ifndef _CPU_POST_PROCESS_H_INCLUDED_
+#define _CPU_POST_PROCESS_H_INCLUDED_
+
+#include "Bloom.h"
+#include "CMatrix4x4.h"
+#include "DepthOfField.h"
+#include "FixedPoint.h"
+#include "Image.h"
+#include "MotionBlur.h"
+#include "PointOpFusion.h"
+#include "PostProcess.h"
+#include "PostProcessPolygon.h"
+#include "PostProcessShaders.h"
+#include "RegionComposite.h"
+#include "ThreadPool.h"
+#include "TileFusion.h"
+
+#include <functional>
+#include <vector>
+
+
+// Extra textures used by some post-processes. Any not provided are sampled as black
+struct PostProcessTextures
+{
+	const Image* depthTexture = nullptr; // Depth buffer values (0->1) in the red channel, used by DepthOfField and MotionBlur
+	const Image* noiseMap     = nullptr; // Used by GreyNoise
+	const Image* burnMap      = nullptr; // Used by Burn
+	const Image* distortMap   = nullptr; // Used by Distort
+};
+
+
+// Settings for the CPU-only post-processes and the CPU versions of other post-processes. Kept separate from
+// PostProcessingConstants, which must match the shaders
+struct CpuPostProcessSettings
+{
+	// Camera clip distances, used by DepthOfField to convert depth buffer values to distances. Copy from the camera
+	// each frame (Camera::NearClip/FarClip), defaults are the camera defaults
+	float nearClip = 0.1f;
+	float farClip  = 10000.0f;
+
+	// The camera's ViewProjectionMatrix, copy each frame. MotionBlur compares it with the matrix from the previous
+	// call to Execute to find how far each pixel has moved on screen
+	CMatrix4x4 viewProjectionMatrix = MatrixIdentity();
+	float motionBlurMaxLength = 32.0f; // Longest motion blur in pixels
+
+	int dualFilterLevels = 4; // Number of half-size levels used by DualFilterPyramid, each extra level roughly doubles the blur
+
+	// Streaking iterations in LightStreaks (before the final combining iteration), each one makes the streaks four times longer.
+	// LightStreaks replaces the chain of KawaseLightStreak entries and, like them, should follow a Bloom entry
+	int lightStreakIterations = 4;
+
+	// Threshold and blur used by BloomMerge, which replaces the Bloom, Gaussian blur and MergeTextures chain
+	BloomSettings bloom;
+
+	// Run chains of full-screen colour-only passes (Sepia, Inverted, Tint, the vertical gradients, optionally starting with
+	// NightVision or GameBoy) as a single pass. Results differ from separate passes only by float rounding
+	bool fusePointOps = true;
+
+	// Size of the 3D lookup table used for the part of each chain that is the same in every row (usually 33 or 65), 0 to
+	// use the chain's colour transform directly. See ColourLutMaxError for the accuracy of a table
+	int colourLutSize = 0;
+
+	// Run groups of consecutive full-screen passes that only read nearby pixels (including chains of colour-only passes) tile
+	// by tile, so intermediate results are read back from cache (see TileFusion.h). Results are identical either way
+	bool tileFusion = true;
+
+	// Cache size used to choose the tile height for tile fusion, 0 to use the size of this machine's last level cache
+	size_t tileFusionCacheBytes = 0;
+
+	// Draw groups of consecutive polygon passes (e.g. the windows) in a single sweep over the image using an effect ID mask,
+	// instead of copying the whole image for each polygon (see RegionComposite.h). Results differ from separate passes where
+	// a post-process reads pixels of another polygon in the group, or where polygons overlap
+	bool compositeRegions = true;
+
+	// Least precise format images are rounded to after each pass, to match the GPU's scene buffers when they are allowed to
+	// use less precise formats (see PostProcessOutputFormat). Images are still held as floats, RGBA32F does no rounding.
+	// Intermediate results inside tile-fused groups and point-op chains are not rounded
+	SceneBufferFormat minBufferFormat = SceneBufferFormat::RGBA32F;
+
+	// The final image is LDR. Stacks of full-screen passes that don't need HDR (see CanRunFixedPoint) are then run with 16-bit
+	// fixed-point kernels, with colours clamped to 0->1 after every pass. See FixedPoint.h for the precision against float
+	bool ldrOutput = false;
+};
+
+
+// Called before each area or polygon pass to fill in the area (area2DTopLeft, area2DSize, area2DDepth) or
+// polygon (with SetPolygonConstants) in the constants, as AreaPostProcess and PolygonPostProcess do on the GPU.
+// processIndex is the position of the pass in the stack. Return false to skip the pass (e.g. area behind the camera)
+using PostProcessRegionFunction = std::function<bool(PostProcessMode mode, int processIndex, PostProcessingConstants& constants)>;
+
+
+class CpuPostProcessor
+{
+public:
+	//-------------------------------------
+	// Construction
+	//-------------------------------------
+
+	// The thread pool is used for all the work and must outlive this object
+	CpuPostProcessor(ThreadPool& threadPool, int width, int height);
+
+	// Change the size of the images, content is lost
+	void Resize(int width, int height);
+
+	int Width()  const  { return mSceneImages[0].Width();  }
+	int Height() const  { return mSceneImages[0].Height(); }
+
+
+	//-------------------------------------
+	// Usage
+	//-------------------------------------
+
+	// The image to render (or copy) the scene into before calling Execute. The CPU equivalent of the first scene buffer rendered each frame
+	Image& SceneImage()  { return mSceneImages[0]; }
+
+	// Settings for the CPU-only post-processes, can be changed between calls to Execute
+	CpuPostProcessSettings& Settings()  { return mSettings; }
+
+	// Tile classification from the last full-screen DepthOfField pass
+	const DepthOfFieldStats& LastDepthOfFieldStats() const  { return mDepthOfFieldStats; }
+
+	// Static and blurred tiles from the last full-screen MotionBlur pass
+	const MotionBlurStats& LastMotionBlurStats() const  { return mMotionBlurStats; }
+
+	// Passes saved in the last call to Execute by running chains of colour-only passes as one pass
+	int LastFusedPasses() const  { return mFusedPasses; }
+
+	// Largest error of the colour lookup tables used by the chains of colour-only passes in the last call to Execute against
+	// evaluating the chains directly, for colours in the range 0->maxInput. 0 if no table was used
+	float ColourLutMaxError(float maxInput) const;
+
+	// Groups of passes run tile by tile in the last call to Execute, and the estimated memory traffic saved
+	const TileFusionStats& LastTileFusionStats() const  { return mTileFusionStats; }
+
+	// Polygon passes drawn by the region compositor in the last call to Execute, and the pixels they covered
+	int    LastCompositedPasses() const  { return mCompositedPasses; }
+	size_t LastCompositedPixels() const  { return mCompositedPixels; }
+
+	// Whether the last call to Execute used the fixed-point kernels (see CpuPostProcessSettings::ldrOutput)
+	bool LastUsedFixedPoint() const  { return mUsedFixedPoint; }
+
+	// Memory used by the scene images in the last call to Execute. This is the peak memory of the stack's intermediate
+	// images, as images that are not needed at the same time share memory, plus the intermediate images of tile-fused groups
+	size_t SceneImageBytes() const  { return (mSceneImages.size() + mFusedImages.size()) * ImageBytes(); }
+
+	// Run every pass in the post-process stack over the scene image and return the final result (which is one
+	// of the scene images, valid until the next call). The constants are updated as each pass runs, in
+	// the same way as on the GPU. Settings that depend on the scene (such as distanceToFocusedObject for
+	// DepthOfField) should be set before the call. Area and polygon passes are skipped if no region function is given.
+	// Call once per frame, MotionBlur measures motion since the last call
+	const Image& Execute(const PostProcessStack& stack, PostProcessingConstants& constants, const PostProcessTextures& textures,
+	                     float frameTime, const PostProcessRegionFunction& regionFunction = nullptr);
+
+
+//-------------------------------------
+// Private members
+//-------------------------------------
+private:
+	// Run one post-process over the source image into the target image
+	void FullScreenPass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target);
+	void AreaPass      (PostProcess postProcess, const PostProcessInputs& inputs, Image& target);
+	void PolygonPass   (PostProcess postProcess, const PostProcessInputs& inputs, Image& target);
+
+	// Run a full-screen post-process that shades each pixel separately over rows top->bottom-1 of the target image
+	void FullScreenRows(PostProcess postProcess, const PostProcessInputs& inputs, Image& target, int top, int bottom);
+
+	// Build the next chain of colour-only passes from count passes in the stack starting at first, updating the constants for each
+	PointOpChain& BuildPointOpChain(const PostProcessStack& stack, int first, int count, PostProcessingConstants& constants, float frameTime);
+
+	// Run a group of full-screen steps tile by tile (see TileFusion.h), updating the constants for each pass. The group starts at
+	// processIndex in the stack and at firstStep in stepPasses/isChain. Returns the position in the stack after the group
+	int TileFusedGroup(const PostProcessStack& stack, int processIndex, const std::vector<int>& stepPasses, const std::vector<bool>& isChain,
+	                   int firstStep, int numSteps, const PostProcessInputs& inputs, PostProcessingConstants& constants, float frameTime,
+	                   Image& target);
+
+	// Run a group of numPasses polygon passes starting at processIndex in the stack in a single sweep (see RegionComposite.h),
+	// updating the constants and calling the region function for each pass. Returns the position in the stack after the group
+	int CompositeRegionGroup(const PostProcessStack& stack, int processIndex, int numPasses, const PostProcessInputs& inputs,
+	                         PostProcessingConstants& constants, float frameTime, const PostProcessRegionFunction& regionFunction,
+	                         Image& target);
+
+	// Run every pass in a stack with the fixed-point kernels, returning the final image. See CanRunFixedPoint for the stacks
+	// this can be used for
+	const Image& ExecuteFixedPoint(const PostProcessStack& stack, PostProcessingConstants& constants, float frameTime);
+
+	// Run a Gaussian blur post-process over a rectangle using the separable blur. Returns false for other post-processes
+	bool GaussianBlurPass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target, const PixelRect& rect);
+
+	// Run a post-process that works on the whole image rather than pixel by pixel (the CPU-only post-processes, depth of field
+	// and motion blur). Returns false for other post-processes
+	bool WholeImagePass(PostProcess postProcess, const PostProcessInputs& inputs, Image& target);
+
+	// Size in bytes of one image
+	size_t ImageBytes() const  { return static_cast<size_t>(Width()) * Height() * sizeof(ColourRGBA); }
+
+	// Copy all of one image to another, in parallel
+	void CopyImage(const Image& source, Image& target);
+
+	// Split a rectangle into tiles and call the given function for each tile, spread over the thread pool
+	void ForEachTile(const PixelRect& rect, const std::function<void(const PixelRect&)>& tileFunction);
+
+
+	ThreadPool& mThreadPool;
+	CpuPostProcessSettings mSettings;
+
+	// Pass inputs and outputs, the CPU equivalent of gSceneBuffers. There are as many as the stack's plan needs (at least
+	// one, the scene image). There is no previous frame slot, MotionBlur uses velocities instead
+	std::vector<Image> mSceneImages;
+	Image mVelocity; // Screen motion of each pixel since last frame, used by MotionBlur
+
+	CMatrix4x4 mPreviousViewProjection;    // View-projection matrix from the last call to Execute
+	bool       mHasPreviousViewProjection; // False until Execute has been called, there is no motion in the first frame
+
+	std::vector<Image> mDualFilterLevels;  // Half-size images used by DualFilterPyramid
+	std::vector<Image> mLightStreakLevels; // Half-size images used by LightStreaks
+	std::vector<Image> mBloomImages;       // Half-size bright pixels used by BloomMerge, before and after blurring
+	std::vector<Image> mBloomLevels;       // Dual filter levels used by BloomMerge
+
+	std::vector<float> mCircleOfConfusion; // Blur radius of each pixel, used by DepthOfField
+	DepthOfFieldStats  mDepthOfFieldStats;
+
+	std::vector<CVector2> mTileVelocity; // Fastest motion in each tile, used by MotionBlur
+	MotionBlurStats       mMotionBlurStats;
+
+	std::vector<PolygonSpan> mPolygonSpans; // Pixels covered by the polygon of the current polygon pass
+
+	// Chains of colour-only passes run as one pass, one for each chain in the stack. Kept between calls so lookup tables are
+	// only rebaked when they change
+	std::vector<PointOpChain> mPointOpChains;
+	int                       mUsedPointOpChains = 0; // Chains used by the last call to Execute
+	int                       mFusedPasses = 0;
+
+	// Outputs of every pass but the last in a tile-fused group, and the constants of each pass in the group as it would run
+	std::vector<Image>                   mFusedImages;
+	std::vector<PostProcessingConstants> mFusedConstants;
+	TileFusionStats                      mTileFusionStats;
+	size_t                               mCacheBytes; // Last level cache size, found at construction
+
+	RegionCompositor mRegionCompositor;
+	int              mCompositedPasses = 0;
+	size_t           mCompositedPixels = 0;
+
+	FixedImage mFixedImages[2]; // Ping-pong images for the fixed-point kernels
+	bool       mUsedFixedPoint = false;
+};
+
+
+#endif //_CPU_POST_PROCESS_H_INCLUDED_
@@ -0,0 +1,263 @@
+//--------------------------------------------------------------------------------------
+// Tile-classified depth of field for CPU images
+//--------------------------------------------------------------------------------------
+// The blur response to distance and the gather pattern follow DepthOfField_pp.hlsl. Differences:
+//   - Depth is converted to distance with the Direct3D projection used by Camera (the shader uses
+//     an OpenGL style formula with near/far fixed at 1/20000)
+//   - The gather is divided by the number of samples (the shader divides by 81 for 97 samples,
+//     brightening the image by about 20%)
+
+#include "DepthOfField.h"
+#include "MathHelpers.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+
+namespace
+{
+	// Settings from the shader
+	const int   Directions = 24;
+	const int   Rings = 4;
+	const float MaxRadius = 10.0f; // Largest blur radius in pixels
+
+	const int NumTaps = Directions * Rings;
+
+	// Tile classification
+	const int   TileSize = 16;
+	const float InFocusRadius = 0.5f;      // Tiles with all radii below this (in pixels) are copied - every tap would land on the centre pixel
+	const float UniformTolerance = 0.75f;  // Tiles with radii all within this range (in pixels) use one radius for the whole tile
+
+
+	// Offsets of the gather taps for a radius of 1 pixel, ring by ring within each direction
+	struct TapTable
+	{
+		float x[NumTaps];
+		float y[NumTaps];
+
+		TapTable()
+		{
+			for (int d = 0; d < Directions; ++d)
+			{
+				float angle = d * 2 * PI / Directions;
+				for (int ring = 0; ring < Rings; ++ring)
+				{
+					float scale = (ring + 1.0f) / Rings;
+					x[d * Rings + ring] = std::cos(angle) * scale;
+					y[d * Rings + ring] = std::sin(angle) * scale;
+				}
+			}
+		}
+	};
+	const TapTable Taps;
+
+
+	// Blur radius in pixels for a depth buffer value, same response as the shader
+	inline float CircleOfConfusion(float depth, float nearClip, float farClip, float focusDistance)
+	{
+		// Inverse of the depth calculation in the projection matrix (see Camera::UpdateMatrices)
+		float distance = nearClip * farClip / (farClip - depth * (farClip - nearClip));
+		float x = Saturate(std::abs(distance - focusDistance) / focusDistance);
+		x = 1.0f - std::pow(1.0f - x, 1.0f / 10.0f);
+		return MaxRadius * x;
+	}
+
+
+	// Gather around one pixel with the given integer tap offsets, clamping to the edge of the image
+	inline ColourRGBA GatherClamped(const Image& sharp, int x, int y, const int* offsetX, const int* offsetY)
+	{
+		ColourRGBA sum = sharp.Pixel(x, y);
+		for (int t = 0; t < NumTaps; ++t)
+		{
+			int sx = std::min(std::max(x + offsetX[t], 0), sharp.Width()  - 1);
+			int sy = std::min(std::max(y + offsetY[t], 0), sharp.Height() - 1);
+			sum += sharp.Pixel(sx, sy);
+		}
+		return sum;
+	}
+
+	// Gather around one pixel with a kernel of distinct offsets, each weighted by the number of taps that land on it. Offsets
+	// must be in range of the image (no clamping)
+	inline ColourRGBA GatherKernelUnclamped(const Image& sharp, int x, int y, const int* offsetX, const int* offsetY,
+	                                        const float* weight, int numOffsets)
+	{
+		ColourRGBA sum = { 0, 0, 0, 0 };
+		for (int t = 0; t < numOffsets; ++t)
+		{
+			const ColourRGBA& c = sharp.Pixel(x + offsetX[t], y + offsetY[t]);
+			sum.r += c.r * weight[t];
+			sum.g += c.g * weight[t];
+			sum.b += c.b * weight[t];
+		}
+		return sum;
+	}
+
+	// As above, clamping to the edge of the image
+	inline ColourRGBA GatherKernelClamped(const Image& sharp, int x, int y, const int* offsetX, const int* offsetY,
+	                                      const float* weight, int numOffsets)
+	{
+		ColourRGBA sum = { 0, 0, 0, 0 };
+		for (int t = 0; t < numOffsets; ++t)
+		{
+			int sx = std::min(std::max(x + offsetX[t], 0), sharp.Width()  - 1);
+			int sy = std::min(std::max(y + offsetY[t], 0), sharp.Height() - 1);
+			const ColourRGBA& c = sharp.Pixel(sx, sy);
+			sum.r += c.r * weight[t];
+			sum.g += c.g * weight[t];
+			sum.b += c.b * weight[t];
+		}
+		return sum;
+	}
+
+	// Integer pixel offsets of the taps for a given radius. Point sampling at the pixel centre plus an offset reads
+	// pixel floor(0.5 + offset) away, the same for every pixel
+	inline void TapOffsets(float radius, int* offsetX, int* offsetY)
+	{
+		for (int t = 0; t < NumTaps; ++t)
+		{
+			offsetX[t] = static_cast<int>(std::floor(0.5f + Taps.x[t] * radius));
+			offsetY[t] = static_cast<int>(std::floor(0.5f + Taps.y[t] * radius));
+		}
+	}
+
+	// The gather for a given radius as a kernel: the distinct pixel offsets the centre and taps read and the fraction of the
+	// samples that land on each. Near the centre many taps round to the same pixel (all of them below a radius of 0.5), so
+	// the kernel is much smaller than the gather for small radii. Returns the number of offsets
+	int GatherKernel(float radius, int* offsetX, int* offsetY, float* weight)
+	{
+		int tapX[NumTaps], tapY[NumTaps];
+		TapOffsets(radius, tapX, tapY);
+
+		offsetX[0] = 0;
+		offsetY[0] = 0;
+		weight[0] = 1;
+		int numOffsets = 1;
+		for (int t = 0; t < NumTaps; ++t)
+		{
+			int i = 0;
+			while (i < numOffsets && (offsetX[i] != tapX[t] || offsetY[i] != tapY[t]))  ++i;
+			if (i == numOffsets)
+			{
+				offsetX[numOffsets] = tapX[t];
+				offsetY[numOffsets] = tapY[t];
+				weight[numOffsets] = 0;
+				++numOffsets;
+			}
+			++weight[i];
+		}
+
+		const float scale = 1.0f / (NumTaps + 1);
+		for (int i = 0; i < numOffsets; ++i)  weight[i] *= scale;
+		return numOffsets;
+	}
+}
+
+
+// Blur the sharp image into the target (same size) with depth of field
+DepthOfFieldStats DepthOfField(ThreadPool& threadPool, const Image& sharp, const Image* depth, Image& target, std::vector<float>& cocBuffer,
+                               float nearClip, float farClip, float focusDistance)
+{
+	int width  = sharp.Width();
+	int height = sharp.Height();
+	focusDistance = std::max(focusDistance, nearClip);
+	cocBuffer.resize(static_cast<size_t>(width) * height);
+
+	// Circle of confusion pass
+	ForEachRow(threadPool, height, [&](int y)
+	{
+		float* cocRow = &cocBuffer[static_cast<size_t>(y) * width];
+		CVector2 uv;
+		uv.y = (y + 0.5f) / height;
+		for (int x = 0; x < width; ++x)
+		{
+			uv.x = (x + 0.5f) / width;
+			float depthValue = depth ? depth->SamplePoint(uv).r : 0.0f;
+			cocRow[x] = CircleOfConfusion(depthValue, nearClip, farClip, focusDistance);
+		}
+	});
+
+	// Classify and process tiles
+	int tilesX = (width  + TileSize - 1) / TileSize;
+	int tilesY = (height + TileSize - 1) / TileSize;
+	std::atomic<int> inFocusTiles(0), nearUniformTiles(0), mixedTiles(0);
+	threadPool.ParallelFor(tilesX * tilesY, [&](int tileIndex)
+	{
+		int left   = (tileIndex % tilesX) * TileSize;
+		int top    = (tileIndex / tilesX) * TileSize;
+		int right  = std::min(left + TileSize, width);
+		int bottom = std::min(top  + TileSize, height);
+
+		float minCoc = MaxRadius;
+		float maxCoc = 0.0f;
+		for (int y = top; y < bottom; ++y)
+		{
+			const float* cocRow = &cocBuffer[static_cast<size_t>(y) * width];
+			for (int x = left; x < right; ++x)
+			{
+				minCoc = std::min(minCoc, cocRow[x]);
+				maxCoc = std::max(maxCoc, cocRow[x]);
+			}
+		}
+
+		// In focus - copy
+		if (maxCoc < InFocusRadius)
+		{
+			for (int y = top; y < bottom; ++y)
+			{
+				const ColourRGBA* in = sharp.Row(y);
+				ColourRGBA* out = target.Row(y);
+				for (int x = left; x < right; ++x)  out[x] = { in[x].r, in[x].g, in[x].b, 1.0f };
+			}
+			++inFocusTiles;
+			return;
+		}
+
+		const float scale = 1.0f / (NumTaps + 1);
+		int offsetX[NumTaps], offsetY[NumTaps];
+
+		// Near uniform - one radius for the tile, so the gather is a fixed blur kernel worked out once. Taps that read the same
+		// pixel are combined, no clamping unless the tile is near the edge of the image
+		if (maxCoc - minCoc < UniformTolerance)
+		{
+			int kernelX[NumTaps + 1], kernelY[NumTaps + 1];
+			float kernelWeight[NumTaps + 1];
+			int kernelSize = GatherKernel((minCoc + maxCoc) * 0.5f, kernelX, kernelY, kernelWeight);
+			int reach = static_cast<int>(std::ceil(maxCoc)) + 1;
+			bool inside = left - reach >= 0 && top - reach >= 0 && right + reach <= width && bottom + reach <= height;
+			for (int y = top; y < bottom; ++y)
+			{
+				ColourRGBA* out = target.Row(y);
+				for (int x = left; x < right; ++x)
+				{
+					ColourRGBA sum = inside ? GatherKernelUnclamped(sharp, x, y, kernelX, kernelY, kernelWeight, kernelSize)
+					                        : GatherKernelClamped  (sharp, x, y, kernelX, kernelY, kernelWeight, kernelSize);
+					out[x] = { sum.r, sum.g, sum.b, 1.0f };
+				}
+			}
+			++nearUniformTiles;
+			return;
+		}
+
+		// Mixed - per-pixel radius
+		for (int y = top; y < bottom; ++y)
+		{
+			const float* cocRow = &cocBuffer[static_cast<size_t>(y) * width];
+			ColourRGBA* out = target.Row(y);
+			for (int x = left; x < right; ++x)
+			{
+				TapOffsets(cocRow[x], offsetX, offsetY);
+				ColourRGBA sum = GatherClamped(sharp, x, y, offsetX, offsetY);
+				out[x] = { sum.r * scale, sum.g * scale, sum.b * scale, 1.0f };
+			}
+		}
+		++mixedTiles;
+	});
+
+	DepthOfFieldStats stats;
+	stats.inFocusTiles     = inFocusTiles;
+	stats.nearUniformTiles = nearUniformTiles;
+	stats.mixedTiles       = mixedTiles;
+	return stats;
+}
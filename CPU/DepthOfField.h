@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// Tile-classified depth of field for CPU images
+//--------------------------------------------------------------------------------------
+// Same blur as DepthOfField_pp.hlsl (24 directions x 4 rings gathered around each pixel, radius
+// growing with distance from the focus), but only where it is needed. A first pass works out the
+// circle of confusion (blur radius) of every pixel from the depth buffer, using the camera's real
+// clip distances. Screen tiles are then classified:
+//   - In focus:     no pixel is blurred by half a pixel or more, the tile is copied
+//   - Near uniform: all pixels have about the same radius, the gather is worked out once for the tile as a
+//                   blur kernel with taps that read the same pixel combined
+//   - Mixed:        full per-pixel gather
+// Code in .cpp file
+
+#ifndef _DEPTH_OF_FIELD_H_INCLUDED_
+#define _DEPTH_OF_FIELD_H_INCLUDED_
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+// Number of tiles of each type in the last frame, to see how much work was saved
+struct DepthOfFieldStats
+{
+	int inFocusTiles     = 0;
+	int nearUniformTiles = 0;
+	int mixedTiles       = 0;
+};
+
+
+// Blur the sharp image into the target (same size) with depth of field. The depth image holds depth buffer values (0->1) in
+// its red channel and is sampled by UV so can be any size, if it is missing every pixel is treated as being at the near clip.
+// nearClip and farClip are the camera's clip distances used to convert depth buffer values to distances, focusDistance the
+// distance that is in focus. The circle of confusion buffer is resized as needed and can be kept between calls
+DepthOfFieldStats DepthOfField(ThreadPool& threadPool, const Image& sharp, const Image* depth, Image& target, std::vector<float>& cocBuffer,
+                               float nearClip, float farClip, float focusDistance);
+
+
+#endif //_DEPTH_OF_FIELD_H_INCLUDED_
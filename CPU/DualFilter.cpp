@@ -0,0 +1,114 @@
+//--------------------------------------------------------------------------------------
+// Dual filter (dual Kawase) blur for CPU images
+//--------------------------------------------------------------------------------------
+// Filters are the same as Downsample/Upsample in DualFiltering_pp.hlsl, but sample with bilinear
+// filtering and use offsets measured in texels of the image being read (so they scale with each level)
+
+#include "DualFilter.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	// Run a filter for every pixel of the target, spread over the thread pool. The filter is given the UV in the source image
+	// of the target pixel centre. Levels are exactly twice or half the size of each other in texels (an odd sized image has
+	// an extra half texel on its smaller level), so this is not the same as the target UV. Mapping by UV would drift off the
+	// texel grid on odd sizes and put some texels exactly under the filter's samples and others between them
+	template <typename Filter>
+	void FilterImage(ThreadPool& threadPool, const Image& source, Image& target, float scale, Filter filter)
+	{
+		float invWidth  = scale / source.Width();
+		float invHeight = scale / source.Height();
+		ForEachRow(threadPool, target.Height(), [&](int y)
+		{
+			ColourRGBA* row = target.Row(y);
+			CVector2 uv;
+			uv.y = (y + 0.5f) * invHeight;
+			for (int x = 0; x < target.Width(); ++x)
+			{
+				uv.x = (x + 0.5f) * invWidth;
+				row[x] = filter(uv);
+			}
+		});
+	}
+
+
+	// Halve the size of an image: centre sample weighted 4 plus four diagonal samples one texel away, divided by 8.
+	// The samples land on texel corners so each one averages four texels
+	void Downsample(ThreadPool& threadPool, const Image& source, Image& target)
+	{
+		float texelX = 1.0f / source.Width();
+		float texelY = 1.0f / source.Height();
+		FilterImage(threadPool, source, target, 2.0f, [&](CVector2 uv)
+		{
+			ColourRGBA sum = source.SampleBilinearClamp(uv) * 4.0f;
+			sum += source.SampleBilinearClamp({ uv.x - texelX, uv.y - texelY });
+			sum += source.SampleBilinearClamp({ uv.x + texelX, uv.y + texelY });
+			sum += source.SampleBilinearClamp({ uv.x + texelX, uv.y - texelY });
+			sum += source.SampleBilinearClamp({ uv.x - texelX, uv.y + texelY });
+			return sum / 8.0f;
+		});
+	}
+
+
+	// Double the size of an image: four samples one texel away along the axes plus four diagonal samples half a texel
+	// away weighted 2, divided by 12
+	void Upsample(ThreadPool& threadPool, const Image& source, Image& target)
+	{
+		float halfX = 0.5f / source.Width();
+		float halfY = 0.5f / source.Height();
+		FilterImage(threadPool, source, target, 0.5f, [&](CVector2 uv)
+		{
+			ColourRGBA sum = source.SampleBilinearClamp({ uv.x - halfX * 2, uv.y });
+			sum += source.SampleBilinearClamp({ uv.x - halfX, uv.y + halfY }) * 2.0f;
+			sum += source.SampleBilinearClamp({ uv.x, uv.y + halfY * 2 });
+			sum += source.SampleBilinearClamp({ uv.x + halfX, uv.y + halfY }) * 2.0f;
+			sum += source.SampleBilinearClamp({ uv.x + halfX * 2, uv.y });
+			sum += source.SampleBilinearClamp({ uv.x + halfX, uv.y - halfY }) * 2.0f;
+			sum += source.SampleBilinearClamp({ uv.x, uv.y - halfY * 2 });
+			sum += source.SampleBilinearClamp({ uv.x - halfX, uv.y - halfY }) * 2.0f;
+			return sum / 12.0f;
+		});
+	}
+}
+
+
+// Blur the source image into the target image (same size) using numLevels half-size levels
+void DualFilterBlur(ThreadPool& threadPool, const Image& source, Image& target, std::vector<Image>& levels, int numLevels)
+{
+	// Size each level, stopping early if the image can't be halved again
+	int width  = source.Width();
+	int height = source.Height();
+	int usedLevels = 0;
+	while (usedLevels < numLevels && (width > 1 || height > 1))
+	{
+		width  = std::max((width  + 1) / 2, 1);
+		height = std::max((height + 1) / 2, 1);
+		if (static_cast<int>(levels.size()) <= usedLevels)  levels.emplace_back();
+		if (levels[usedLevels].Width() != width || levels[usedLevels].Height() != height)
+		{
+			levels[usedLevels].Resize(width, height);
+		}
+		++usedLevels;
+	}
+
+	if (usedLevels == 0)
+	{
+		target.CopyRect(source, source.Rect());
+		return;
+	}
+
+	// Down the pyramid then back up, the last upsample writes the full size result
+	Downsample(threadPool, source, levels[0]);
+	for (int i = 1; i < usedLevels; ++i)
+	{
+		Downsample(threadPool, levels[i - 1], levels[i]);
+	}
+	for (int i = usedLevels - 1; i > 0; --i)
+	{
+		Upsample(threadPool, levels[i], levels[i - 1]);
+	}
+	Upsample(threadPool, levels[0], target);
+}
@@ -0,0 +1,24 @@
+//--------------------------------------------------------------------------------------
+// Dual filter (dual Kawase) blur for CPU images
+//--------------------------------------------------------------------------------------
+// A wide, cheap blur made by repeatedly halving the image with a 5-tap downsample filter, then
+// doubling it back up with an 8-tap upsample filter. Unlike the DualFiltering shader, which runs
+// every iteration at full size, each level here really is half the size of the one above, so the
+// whole blur costs roughly 1.33 full-size passes whatever the number of levels. Code in .cpp file
+
+#ifndef _DUAL_FILTER_H_INCLUDED_
+#define _DUAL_FILTER_H_INCLUDED_
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+// Blur the source image into the target image (same size) using numLevels half-size levels. Each extra level roughly
+// doubles the blur radius. The levels vector holds the smaller images, it is resized as needed and can be kept between
+// calls to avoid reallocating. The number of levels is reduced if the image is too small to halve that many times
+void DualFilterBlur(ThreadPool& threadPool, const Image& source, Image& target, std::vector<Image>& levels, int numLevels);
+
+
+#endif //_DUAL_FILTER_H_INCLUDED_
@@ -0,0 +1,580 @@
+//--------------------------------------------------------------------------------------
+// 16-bit fixed-point post-processing for LDR output
+//--------------------------------------------------------------------------------------
+// Every kernel samples the source at a fixed set of taps. The sample positions of each tap depend
+// only on x for the column and only on y for the row, so they are worked out once per pass as a
+// table of source columns and a table of source rows, using the float shaders' arithmetic. A
+// kernel is then a function of its taps, written with the Lanes operations below, which are SSE
+// instructions or (on platforms without SSE) plain loops over the eight channels
+
+#include "FixedPoint.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSSE3__) || defined(__AVX__)
+	#include <tmmintrin.h>
+	#define FIXED_POINT_SSSE3
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define FIXED_POINT_SSE
+#endif
+
+
+namespace
+{
+	// Most taps read by a kernel
+	const int MaxTaps = 9;
+
+
+	// Channel value for a float from 0->1, or a weight for MulQ15 from -1->1
+	inline int16_t ToFixed(float value)  { return static_cast<int16_t>(std::lrint(value * FixedOne)); }
+	inline int16_t ToWeight(float value) { return static_cast<int16_t>(std::lrint(value * 32768.0f)); }
+
+	// Channel value that a value must be greater than to be greater than a float threshold
+	inline int16_t ToThreshold(float value) { return static_cast<int16_t>(std::floor(value * FixedOne)); }
+
+
+	//--------------------------------------------------------------------------------------
+	// Lanes - two pixels of four 16-bit channels
+	//--------------------------------------------------------------------------------------
+#if defined(FIXED_POINT_SSE)
+
+	using Lanes = __m128i;
+
+	inline Lanes LoadPair(const FixedPixel* first, const FixedPixel* second)
+	{
+		return _mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(first)),
+		                          _mm_loadl_epi64(reinterpret_cast<const __m128i*>(second)));
+	}
+	inline void StorePair(FixedPixel* out, Lanes v)  { _mm_storeu_si128(reinterpret_cast<__m128i*>(out), v); }
+
+	// The same channels in both pixels, and one value in all four channels of each pixel
+	inline Lanes Set(int r, int g, int b, int a)  { return _mm_set_epi16(a, b, g, r, a, b, g, r); }
+	inline Lanes SetPair(int first, int second)
+	{
+		return _mm_set_epi16(second, second, second, second, first, first, first, first);
+	}
+
+	inline Lanes Add(Lanes a, Lanes b)    { return _mm_adds_epi16(a, b); } // Saturating
+	inline Lanes Sub(Lanes a, Lanes b)    { return _mm_subs_epi16(a, b); } // Saturating
+	inline Lanes Max(Lanes a, Lanes b)    { return _mm_max_epi16(a, b); }
+	inline Lanes Greater(Lanes a, Lanes b) { return _mm_cmpgt_epi16(a, b); }
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b) { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); }
+
+	// a * b / 32768, rounded to nearest
+	inline Lanes MulQ15(Lanes a, Lanes b)
+	{
+	#if defined(FIXED_POINT_SSSE3)
+		return _mm_mulhrs_epi16(a, b);
+	#else
+		__m128i low  = _mm_mullo_epi16(a, b);
+		__m128i high = _mm_mulhi_epi16(a, b);
+		const __m128i round = _mm_set1_epi32(1 << 14);
+		__m128i first  = _mm_srai_epi32(_mm_add_epi32(_mm_unpacklo_epi16(low, high), round), 15);
+		__m128i second = _mm_srai_epi32(_mm_add_epi32(_mm_unpackhi_epi16(low, high), round), 15);
+		return _mm_packs_epi32(first, second);
+	#endif
+	}
+
+	// One channel of each pixel copied to all four of its channels
+	template <int Channel>
+	inline Lanes Broadcast(Lanes v)
+	{
+		v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(Channel, Channel, Channel, Channel));
+		return _mm_shufflehi_epi16(v, _MM_SHUFFLE(Channel, Channel, Channel, Channel));
+	}
+
+	// Red channel of the first and second pixel
+	inline int FirstRed(Lanes v)   { return static_cast<int16_t>(_mm_extract_epi16(v, 0)); }
+	inline int SecondRed(Lanes v)  { return static_cast<int16_t>(_mm_extract_epi16(v, 4)); }
+
+#else
+
+	struct Lanes
+	{
+		int16_t v[8];
+	};
+
+	inline int16_t Saturate16(int value)  { return static_cast<int16_t>(std::min(std::max(value, -32768), 32767)); }
+
+	inline Lanes LoadPair(const FixedPixel* first, const FixedPixel* second)
+	{
+		return { { first->r, first->g, first->b, first->a, second->r, second->g, second->b, second->a } };
+	}
+	inline void StorePair(FixedPixel* out, Lanes v)
+	{
+		out[0] = { v.v[0], v.v[1], v.v[2], v.v[3] };
+		out[1] = { v.v[4], v.v[5], v.v[6], v.v[7] };
+	}
+
+	inline Lanes Set(int r, int g, int b, int a)
+	{
+		Lanes out = { { static_cast<int16_t>(r), static_cast<int16_t>(g), static_cast<int16_t>(b), static_cast<int16_t>(a) } };
+		for (int i = 0; i < 4; ++i)  out.v[i + 4] = out.v[i];
+		return out;
+	}
+	inline Lanes SetPair(int first, int second)
+	{
+		Lanes out;
+		for (int i = 0; i < 4; ++i)  { out.v[i] = static_cast<int16_t>(first);  out.v[i + 4] = static_cast<int16_t>(second); }
+		return out;
+	}
+
+	template <class Function>
+	inline Lanes PerLane(Lanes a, Lanes b, Function function)
+	{
+		Lanes out;
+		for (int i = 0; i < 8; ++i)  out.v[i] = static_cast<int16_t>(function(a.v[i], b.v[i]));
+		return out;
+	}
+
+	inline Lanes Add(Lanes a, Lanes b)     { return PerLane(a, b, [](int x, int y) { return Saturate16(x + y); }); }
+	inline Lanes Sub(Lanes a, Lanes b)     { return PerLane(a, b, [](int x, int y) { return Saturate16(x - y); }); }
+	inline Lanes Max(Lanes a, Lanes b)     { return PerLane(a, b, [](int x, int y) { return std::max(x, y); }); }
+	inline Lanes Greater(Lanes a, Lanes b) { return PerLane(a, b, [](int x, int y) { return x > y ? -1 : 0; }); }
+	inline Lanes MulQ15(Lanes a, Lanes b)  { return PerLane(a, b, [](int x, int y) { return Saturate16((x * y + (1 << 14)) >> 15); }); }
+
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b)
+	{
+		Lanes out;
+		for (int i = 0; i < 8; ++i)  out.v[i] = mask.v[i] ? a.v[i] : b.v[i];
+		return out;
+	}
+
+	template <int Channel>
+	inline Lanes Broadcast(Lanes v)
+	{
+		return SetPair(v.v[Channel], v.v[Channel + 4]);
+	}
+
+	inline int FirstRed(Lanes v)   { return v.v[0]; }
+	inline int SecondRed(Lanes v)  { return v.v[4]; }
+
+#endif
+
+	// Average of the red, green and blue channels of each pixel, in all four of its channels. Each channel is multiplied by the
+	// given weight, 1/3 for the plain average
+	inline Lanes Grey(Lanes v, Lanes weight)
+	{
+		return Add(Add(MulQ15(Broadcast<0>(v), weight), MulQ15(Broadcast<1>(v), weight)), MulQ15(Broadcast<2>(v), weight));
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Taps
+	//--------------------------------------------------------------------------------------
+
+	// The source column (for each x, padded to the image stride) and row (for each y) read by each tap of a kernel
+	struct TapTables
+	{
+		int numTaps = 0;
+		std::vector<int> columns[MaxTaps];
+		std::vector<int> rows[MaxTaps];
+	};
+
+	// Build the tables from a function giving the sample UV of a tap for the UV of an output pixel, as in the float shaders
+	template <class TapUVFunction>
+	void BuildTapTables(int numTaps, int width, int height, int stride, TapUVFunction tapUV, TapTables& tables)
+	{
+		// Same UVs as ShadeFullScreenRect and the same rounding as Image::SamplePoint
+		float invWidth  = 1.0f / width;
+		float invHeight = 1.0f / height;
+		tables.numTaps = numTaps;
+		for (int tap = 0; tap < numTaps; ++tap)
+		{
+			tables.columns[tap].resize(stride);
+			for (int x = 0; x < stride; ++x)
+			{
+				CVector2 uv = tapUV(tap, CVector2{ (std::min(x, width - 1) + 0.5f) * invWidth, 0.5f });
+				tables.columns[tap][x] = std::min(std::max(static_cast<int>(std::floor(uv.x * width)), 0), width - 1);
+			}
+			tables.rows[tap].resize(height);
+			for (int y = 0; y < height; ++y)
+			{
+				CVector2 uv = tapUV(tap, CVector2{ 0.5f, (y + 0.5f) * invHeight });
+				tables.rows[tap][y] = std::min(std::max(static_cast<int>(std::floor(uv.y * height)), 0), height - 1);
+			}
+		}
+	}
+
+	// Run a kernel over the whole target. Kernels return two shaded pixels from their taps, alpha is set to 1 and channels
+	// below 0 clamped here
+	template <class Kernel>
+	void RunKernel(ThreadPool& threadPool, const Kernel& kernel, const TapTables& tables, const FixedImage& source, FixedImage& target)
+	{
+		const Lanes alphaMask = Set(0, 0, 0, -1);
+		const Lanes one       = Set(FixedOne, FixedOne, FixedOne, FixedOne);
+		const Lanes zero      = Set(0, 0, 0, 0);
+
+		int height = target.Height();
+		int stride = target.Stride();
+		ForEachRow(threadPool, height, [&](int y)
+		{
+			const FixedPixel* rows[MaxTaps];
+			for (int tap = 0; tap < tables.numTaps; ++tap)  rows[tap] = source.Row(tables.rows[tap][y]);
+
+			FixedPixel* out = target.Row(y);
+			for (int x = 0; x < stride; x += 2)
+			{
+				Lanes taps[MaxTaps];
+				for (int tap = 0; tap < tables.numTaps; ++tap)
+				{
+					taps[tap] = LoadPair(rows[tap] + tables.columns[tap][x], rows[tap] + tables.columns[tap][x + 1]);
+				}
+				StorePair(out + x, Max(Select(alphaMask, one, kernel(taps)), zero));
+			}
+		});
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Kernels
+	//--------------------------------------------------------------------------------------
+	// These must match the float shaders in PostProcessShaders.cpp
+
+	struct CopyKernel
+	{
+		Lanes operator()(const Lanes* taps) const  { return taps[0]; }
+	};
+
+	struct TintKernel
+	{
+		Lanes redMask = Set(-1, 0, 0, 0);
+		Lanes operator()(const Lanes* taps) const  { return Select(redMask, taps[0], Set(0, 0, 0, 0)); }
+	};
+
+	struct InvertedKernel
+	{
+		Lanes one = Set(FixedOne, FixedOne, FixedOne, FixedOne);
+		Lanes operator()(const Lanes* taps) const  { return Sub(one, taps[0]); }
+	};
+
+	// The weights are less than 1, so every product is in range and only the sums saturate
+	struct SepiaKernel
+	{
+		Lanes fromRed   = Set(ToWeight(0.393f), ToWeight(0.349f), ToWeight(0.272f), 0);
+		Lanes fromGreen = Set(ToWeight(0.769f), ToWeight(0.686f), ToWeight(0.534f), 0);
+		Lanes fromBlue  = Set(ToWeight(0.189f), ToWeight(0.168f), ToWeight(0.131f), 0);
+		Lanes operator()(const Lanes* taps) const
+		{
+			Lanes c = taps[0];
+			return Add(Add(MulQ15(Broadcast<0>(c), fromRed), MulQ15(Broadcast<1>(c), fromGreen)), MulQ15(Broadcast<2>(c), fromBlue));
+		}
+	};
+
+	struct GameBoyKernel
+	{
+		Lanes third = Set(ToWeight(1 / 3.0f), ToWeight(1 / 3.0f), ToWeight(1 / 3.0f), ToWeight(1 / 3.0f));
+		Lanes high   = Set(ToThreshold(0.45f),  ToThreshold(0.45f),  ToThreshold(0.45f),  ToThreshold(0.45f));
+		Lanes middle = Set(ToThreshold(0.3f),   ToThreshold(0.3f),   ToThreshold(0.3f),   ToThreshold(0.3f));
+		Lanes low    = Set(ToThreshold(0.15f),  ToThreshold(0.15f),  ToThreshold(0.15f),  ToThreshold(0.15f));
+		Lanes colours[4] = { Set(ToFixed(0.070f), ToFixed(0.090f), ToFixed(0.086f), FixedOne),
+		                     Set(ToFixed(0.152f), ToFixed(0.172f), ToFixed(0.145f), FixedOne),
+		                     Set(ToFixed(0.294f), ToFixed(0.313f), ToFixed(0.247f), FixedOne),
+		                     Set(ToFixed(0.505f), ToFixed(0.529f), ToFixed(0.407f), FixedOne) };
+		Lanes operator()(const Lanes* taps) const
+		{
+			Lanes grey = Grey(taps[0], third);
+			return Select(Greater(grey, high), colours[3], Select(Greater(grey, middle), colours[2],
+			              Select(Greater(grey, low), colours[1], colours[0])));
+		}
+	};
+
+	// The float shader sums four samples and divides by 4 if their average is below 0.9. Here the samples are quartered first
+	// so the sum stays in range, and the test becomes an average below 0.225
+	struct NightVisionKernel
+	{
+		Lanes quarter   = Set(ToWeight(0.25f), ToWeight(0.25f), ToWeight(0.25f), ToWeight(0.25f));
+		Lanes third     = Set(ToWeight(1 / 3.0f), ToWeight(1 / 3.0f), ToWeight(1 / 3.0f), ToWeight(1 / 3.0f));
+		Lanes dark      = Set(ToThreshold(0.225f), ToThreshold(0.225f), ToThreshold(0.225f), ToThreshold(0.225f));
+		Lanes greenMask = Set(0, -1, 0, 0);
+		Lanes operator()(const Lanes* taps) const
+		{
+			Lanes sum = Add(Add(MulQ15(taps[0], quarter), MulQ15(taps[1], quarter)), Add(MulQ15(taps[2], quarter), MulQ15(taps[3], quarter)));
+			Lanes grey = Grey(sum, third);
+			Lanes bright = Add(Add(grey, grey), Add(grey, grey));
+			return Select(greenMask, Select(Greater(grey, dark), bright, grey), Set(0, 0, 0, 0));
+		}
+	};
+
+	// Taps are in the order of the float shader's loops, x offset -1->1 outside and y offset inside. The Sobel sums are taken of
+	// quarter greys so they stay in range. The magnitude needs a square root so is found in float for each pixel
+	struct ContourKernel
+	{
+		Lanes twelfth = Set(ToWeight(1 / 12.0f), ToWeight(1 / 12.0f), ToWeight(1 / 12.0f), ToWeight(1 / 12.0f));
+		Lanes operator()(const Lanes* taps) const
+		{
+			const int sobelX[9] = { -1, 0, 1, -2, 0, 2, -1, 0, 1 };
+			const int sobelY[9] = { -1, -2, -1, 0, 0, 0, 1, 2, 1 };
+			Lanes zero = Set(0, 0, 0, 0);
+			Lanes gx = zero;
+			Lanes gy = zero;
+			for (int tap = 0; tap < 9; ++tap)
+			{
+				Lanes grey = Grey(taps[tap], twelfth);
+				Lanes grey2 = Add(grey, grey);
+				gx = (sobelX[tap] > 0) ? Add(gx, sobelX[tap] == 2 ? grey2 : grey) : (sobelX[tap] < 0) ? Sub(gx, sobelX[tap] == -2 ? grey2 : grey) : gx;
+				gy = (sobelY[tap] > 0) ? Add(gy, sobelY[tap] == 2 ? grey2 : grey) : (sobelY[tap] < 0) ? Sub(gy, sobelY[tap] == -2 ? grey2 : grey) : gy;
+			}
+			return SetPair(Magnitude(FirstRed(gx), FirstRed(gy)), Magnitude(SecondRed(gx), SecondRed(gy)));
+		}
+
+		// Same as the float shader, from Sobel sums of quarter greys
+		static int Magnitude(int quarterGx, int quarterGy)
+		{
+			float gx = quarterGx * (4.0f / FixedOne);
+			float gy = quarterGy * (4.0f / FixedOne);
+			float gxMag = 3 * gx * gx;
+			float gyMag = 3 * gy * gy;
+			float gradientMag = std::sqrt(gxMag * gxMag + gyMag * gyMag);
+			return ToFixed(std::min(gradientMag, 1.0f));
+		}
+	};
+
+	// Taps are the centre then +x, -x, +y, -y. The extrapolation away from the centre saturates, but only where the float
+	// result is outside 0->1 anyway
+	struct DilationKernel
+	{
+		Lanes luminance = Set(ToWeight(0.2126f), ToWeight(0.7152f), ToWeight(0.0722f), 0);
+		Lanes threshold = Set(ToThreshold(0.5f), ToThreshold(0.5f), ToThreshold(0.5f), ToThreshold(0.5f));
+		Lanes operator()(const Lanes* taps) const
+		{
+			Lanes colour = taps[0];
+			Lanes weighted = MulQ15(colour, luminance);
+			Lanes brightness = Add(Add(Broadcast<0>(weighted), Broadcast<1>(weighted)), Broadcast<2>(weighted));
+			Lanes dilated = Max(Max(taps[1], taps[2]), Max(taps[3], taps[4]));
+			Lanes difference = Sub(dilated, colour);
+			return Add(colour, Select(Greater(brightness, threshold), difference, Add(difference, difference)));
+		}
+	};
+
+	// Taps are the centre then pairs at +offset and -offset. The weights are rounded to sum to just under 1
+	struct GaussianBlurKernel
+	{
+		Lanes weights[5] = { Set(7439, 7439, 7439, 7439), Set(6377, 6377, 6377, 6377), Set(3985, 3985, 3985, 3985),
+		                     Set(1771, 1771, 1771, 1771), Set(531, 531, 531, 531) };
+		Lanes operator()(const Lanes* taps) const
+		{
+			Lanes sum = MulQ15(taps[0], weights[0]);
+			for (int i = 1; i < 5; ++i)
+			{
+				sum = Add(sum, Add(MulQ15(taps[2 * i - 1], weights[i]), MulQ15(taps[2 * i], weights[i])));
+			}
+			return sum;
+		}
+	};
+}
+
+
+//--------------------------------------------------------------------------------------
+// FixedImage
+//--------------------------------------------------------------------------------------
+
+// Change the size of the image
+void FixedImage::Resize(int width, int height)
+{
+	mWidth  = width;
+	mHeight = height;
+	mStride = (width + 1) & ~1;
+	mPixels.resize(static_cast<size_t>(mStride) * height);
+}
+
+
+//--------------------------------------------------------------------------------------
+// Fixed-point post-processing
+//--------------------------------------------------------------------------------------
+
+// Whether a post-process has a fixed-point kernel
+bool HasFixedPointKernel(PostProcess postProcess)
+{
+	switch (postProcess)
+	{
+		case PostProcess::None:
+		case PostProcess::Copy:
+		case PostProcess::Tint:
+		case PostProcess::Sepia:
+		case PostProcess::Inverted:
+		case PostProcess::GameBoy:
+		case PostProcess::NightVision:
+		case PostProcess::Contour:
+		case PostProcess::Dilation:
+		case PostProcess::GaussianBlurHorizontal:
+		case PostProcess::GaussianBlurVertical:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+// Whether a whole stack can run in fixed point
+bool CanRunFixedPoint(const PostProcessStack& stack)
+{
+	if (stack.empty())  return false;
+	for (const auto& pass : stack)
+	{
+		if (pass.second != PostProcessMode::Fullscreen || !HasFixedPointKernel(pass.first))  return false;
+	}
+	return true;
+}
+
+
+// Convert a float image to fixed point, clamping to 0->1
+void ImageToFixed(ThreadPool& threadPool, const Image& source, FixedImage& target)
+{
+	int width  = source.Width();
+	int height = source.Height();
+	target.Resize(width, height);
+
+	ForEachRow(threadPool, height, [&](int y)
+	{
+		const float* in  = &source.Row(y)[0].r;
+		int16_t*     out = &target.Row(y)[0].r;
+		int i = 0;
+
+#if defined(FIXED_POINT_SSE)
+		// Two pixels at a time, rounded to nearest as lrint does
+		const __m128 scale = _mm_set1_ps(static_cast<float>(FixedOne));
+		const __m128 one   = _mm_set1_ps(1.0f);
+		for (; i + 8 <= width * 4; i += 8)
+		{
+			__m128 first  = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i),     _mm_setzero_ps()), one);
+			__m128 second = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), _mm_setzero_ps()), one);
+			__m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(_mm_mul_ps(first, scale)), _mm_cvtps_epi32(_mm_mul_ps(second, scale)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), packed);
+		}
+#endif
+
+		for (; i < width * 4; ++i)
+		{
+			float value = in[i];
+			value = (value > 0) ? value : 0; // Also NaN
+			value = (value < 1) ? value : 1;
+			out[i] = ToFixed(value);
+		}
+
+		// Padding pixel repeats the last one
+		if (target.Stride() > width)  target.Row(y)[width] = target.Row(y)[width - 1];
+	});
+}
+
+
+// Convert a fixed-point image to float
+void FixedToImage(ThreadPool& threadPool, const FixedImage& source, Image& target)
+{
+	int width  = source.Width();
+	int height = source.Height();
+
+	ForEachRow(threadPool, height, [&](int y)
+	{
+		const int16_t* in  = &source.Row(y)[0].r;
+		float*         out = &target.Row(y)[0].r;
+		int i = 0;
+
+#if defined(FIXED_POINT_SSE)
+		const __m128 scale = _mm_set1_ps(1.0f / FixedOne);
+		for (; i + 8 <= width * 4; i += 8)
+		{
+			__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+			__m128i first  = _mm_srai_epi32(_mm_unpacklo_epi16(value, value), 16);
+			__m128i second = _mm_srai_epi32(_mm_unpackhi_epi16(value, value), 16);
+			_mm_storeu_ps(out + i,     _mm_mul_ps(_mm_cvtepi32_ps(first),  scale));
+			_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(second), scale));
+		}
+#endif
+
+		for (; i < width * 4; ++i)  out[i] = in[i] * (1.0f / FixedOne);
+	});
+}
+
+
+// Run a full-screen post-process with a fixed-point kernel
+void FixedPointPass(ThreadPool& threadPool, PostProcess postProcess, const PostProcessInputs& inputs,
+                    const FixedImage& source, FixedImage& target)
+{
+	int width  = source.Width();
+	int height = source.Height();
+	float texelWidth  = 1.0f / inputs.viewportWidth;
+	float texelHeight = 1.0f / inputs.viewportHeight;
+	auto offset = [](CVector2 uv, float x, float y) { return CVector2{ uv.x + x, uv.y + y }; };
+
+	TapTables tables;
+	auto build = [&](int numTaps, auto tapUV)
+	{
+		BuildTapTables(numTaps, width, height, target.Stride(), tapUV, tables);
+	};
+
+	switch (postProcess)
+	{
+		case PostProcess::Tint:
+		case PostProcess::Sepia:
+		case PostProcess::Inverted:
+		case PostProcess::None:
+		case PostProcess::Copy:
+		default:
+			build(1, [](int, CVector2 uv) { return uv; });
+			break;
+
+		case PostProcess::GameBoy:
+		{
+			const float newTexelWidth  = 7 * (1.0f / inputs.viewportWidth);
+			const float newTexelHeight = 4 * (1.0f / inputs.viewportHeight);
+			build(1, [&](int, CVector2 uv)
+			{
+				return CVector2{ std::floor(uv.x / newTexelWidth  + 0.5f) * newTexelWidth,
+				                 std::floor(uv.y / newTexelHeight + 0.5f) * newTexelHeight };
+			});
+			break;
+		}
+
+		case PostProcess::NightVision:
+		{
+			const float offsets[4] = { 0, 0.001f, 0.002f, 0.003f };
+			build(4, [&](int tap, CVector2 uv) { return offset(uv, offsets[tap], offsets[tap]); });
+			break;
+		}
+
+		case PostProcess::Contour:
+			build(9, [&](int tap, CVector2 uv) { return offset(uv, (tap / 3 - 1) * texelWidth, (tap % 3 - 1) * texelHeight); });
+			break;
+
+		case PostProcess::Dilation:
+		{
+			const CVector2 offsets[5] = { { 0, 0 }, { texelWidth, 0 }, { -texelWidth, 0 }, { 0, texelHeight }, { 0, -texelHeight } };
+			build(5, [&](int tap, CVector2 uv) { return offset(uv, offsets[tap].x, offsets[tap].y); });
+			break;
+		}
+
+		case PostProcess::GaussianBlurHorizontal:
+		case PostProcess::GaussianBlurVertical:
+		{
+			bool horizontal = (postProcess == PostProcess::GaussianBlurHorizontal);
+			float step = inputs.constants->blurAmount / (horizontal ? inputs.viewportWidth : inputs.viewportHeight);
+			build(9, [&](int tap, CVector2 uv)
+			{
+				float tapOffset = ((tap + 1) / 2) * step;
+				CVector2 normalizedOffset = horizontal ? CVector2{ tapOffset, 0.0f } : CVector2{ 0.0f, tapOffset };
+				return (tap % 2 == 1) ? uv + normalizedOffset : uv - normalizedOffset;
+			});
+			break;
+		}
+	}
+
+	switch (postProcess)
+	{
+		case PostProcess::Tint:                   RunKernel(threadPool, TintKernel(),         tables, source, target); break;
+		case PostProcess::Sepia:                  RunKernel(threadPool, SepiaKernel(),        tables, source, target); break;
+		case PostProcess::Inverted:               RunKernel(threadPool, InvertedKernel(),     tables, source, target); break;
+		case PostProcess::GameBoy:                RunKernel(threadPool, GameBoyKernel(),      tables, source, target); break;
+		case PostProcess::NightVision:            RunKernel(threadPool, NightVisionKernel(),  tables, source, target); break;
+		case PostProcess::Contour:                RunKernel(threadPool, ContourKernel(),      tables, source, target); break;
+		case PostProcess::Dilation:               RunKernel(threadPool, DilationKernel(),     tables, source, target); break;
+		case PostProcess::GaussianBlurHorizontal:
+		case PostProcess::GaussianBlurVertical:   RunKernel(threadPool, GaussianBlurKernel(), tables, source, target); break;
+		default:                                  RunKernel(threadPool, CopyKernel(),         tables, source, target); break;
+	}
+}
@@ -0,0 +1,95 @@
+//--------------------------------------------------------------------------------------
+// 16-bit fixed-point post-processing for LDR output
+//--------------------------------------------------------------------------------------
+// When the final image is LDR, post-processes that only need colours in the range 0->1 can work
+// on 16-bit integer channels instead of floats. Images hold 0->1 as 0->32767 (FixedImage, 8 bytes
+// per pixel rather than 16) and the kernels process two pixels (eight channels) per SSE register,
+// multiplying with pmulhrsw (rounded Q15 multiply, emulated on SSE2 without SSSE3) and adding with
+// saturation, which clamps to 1 as an UNORM render target would. Results below 0 are clamped too.
+// Supported post-processes are Copy, Tint, Sepia, Inverted, GameBoy, NightVision, Contour,
+// Dilation and the Gaussian blurs. Sample positions are the same as the float shaders'.
+//
+// Precision against the float shaders with their output saturated to 0->1, in steps of 1/32767
+// (an 8-bit step is 128 of these), measured on noise and on smooth gradients:
+//   Copy, Tint, Inverted   exact
+//   GameBoy                0.5 (rounding of the palette colours)
+//   Sepia                  2
+//   Gaussian blurs         4.2
+//   NightVision            10
+//   Contour                10 on smooth images, 77 on noise (the square root is taken in float from
+//                          the 16-bit Sobel sums, the error is in the grey values they are made from)
+// GameBoy, Dilation and NightVision choose between results by comparing a brightness with a
+// threshold. Where the float brightness is within 2 steps of the threshold the other result may be
+// chosen, otherwise the bounds above hold. Code in .cpp file
+
+#ifndef _FIXED_POINT_H_INCLUDED_
+#define _FIXED_POINT_H_INCLUDED_
+
+#include "Image.h"
+#include "PostProcess.h"
+#include "PostProcessShaders.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// A pixel of a FixedImage, channels from 0 to FixedOne
+struct FixedPixel
+{
+	int16_t r;
+	int16_t g;
+	int16_t b;
+	int16_t a;
+};
+
+// Channel value of 1.0
+const int FixedOne = 32767;
+
+
+// An image of 16-bit fixed-point pixels. Rows are padded to an even number of pixels so kernels can work in pairs
+class FixedImage
+{
+public:
+	// Create an empty image, use Resize before use
+	FixedImage() : mWidth(0), mHeight(0), mStride(0) {}
+
+	// Change the size of the image. Pixel content is uninitialised after a resize
+	void Resize(int width, int height);
+
+	int Width()  const  { return mWidth;  }
+	int Height() const  { return mHeight; }
+	int Stride() const  { return mStride; } // Pixels per row including padding
+
+	FixedPixel*       Row(int y)        { return mPixels.data() + static_cast<size_t>(y) * mStride; }
+	const FixedPixel* Row(int y) const  { return mPixels.data() + static_cast<size_t>(y) * mStride; }
+
+private:
+	int mWidth;
+	int mHeight;
+	int mStride;
+
+	std::vector<FixedPixel> mPixels;
+};
+
+
+// Whether a post-process has a fixed-point kernel. PostProcess::None runs as a copy
+bool HasFixedPointKernel(PostProcess postProcess);
+
+// Whether a whole stack can run in fixed point: every pass is full-screen and has a fixed-point kernel. Stacks with passes that
+// need HDR (e.g. Bloom and MergeTextures) or that read history cannot
+bool CanRunFixedPoint(const PostProcessStack& stack);
+
+// Convert a float image to fixed point, clamping to 0->1. The target is resized to match
+void ImageToFixed(ThreadPool& threadPool, const Image& source, FixedImage& target);
+
+// Convert a fixed-point image to float. The target must be the same size
+void FixedToImage(ThreadPool& threadPool, const FixedImage& source, Image& target);
+
+// Run a full-screen post-process with a fixed-point kernel from the source to the target image, which must be the same size
+// and different images. The constants and viewport size are taken from the inputs, textures are not used
+void FixedPointPass(ThreadPool& threadPool, PostProcess postProcess, const PostProcessInputs& inputs,
+                    const FixedImage& source, FixedImage& target);
+
+
+#endif //_FIXED_POINT_H_INCLUDED_
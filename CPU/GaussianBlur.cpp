@@ -0,0 +1,160 @@
+//--------------------------------------------------------------------------------------
+// Separable Gaussian blur for CPU images
+//--------------------------------------------------------------------------------------
+// Both directions use the same inner loop: a weighted sum of a centre span of floats and pairs of
+// spans at equal distances either side of it. For the horizontal pass the spans are shifted views
+// of one (edge padded) row, for the vertical pass they are different rows of the image
+
+#include "GaussianBlur.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define GAUSSIAN_BLUR_SSE
+#endif
+
+
+namespace
+{
+	// Vertical pass work is split into strips this many pixels wide, 1KB per row. The rows of the kernel for a strip
+	// stay in cache as the pass moves down the strip
+	const int StripWidth = 64;
+
+	// Rows per job in both passes
+	const int RowsPerJob = 32;
+
+
+	// For numFloats floats: out = weights[0] * centre + sum over k of weights[k] * (before[k] + after[k]), k from 1 to radius.
+	// The arrays of span pointers are indexed by k (element 0 unused). If opaque every fourth float (alpha) is written as 1
+	void WeightedSum(const float* centre, const float* const* before, const float* const* after,
+	                 const float* weights, int radius, float* out, int numFloats, bool opaque)
+	{
+		int i = 0;
+
+#ifdef GAUSSIAN_BLUR_SSE
+		// One pixel at a time
+		const __m128 rgbMask  = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+		const __m128 alphaOne = _mm_set_ps(1, 0, 0, 0);
+		for (; i + 4 <= numFloats; i += 4)
+		{
+			__m128 sum = _mm_mul_ps(_mm_set1_ps(weights[0]), _mm_loadu_ps(centre + i));
+			for (int k = 1; k <= radius; ++k)
+			{
+				__m128 pair = _mm_add_ps(_mm_loadu_ps(before[k] + i), _mm_loadu_ps(after[k] + i));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), pair));
+			}
+			if (opaque)  sum = _mm_or_ps(_mm_and_ps(sum, rgbMask), alphaOne);
+			_mm_storeu_ps(out + i, sum);
+		}
+#endif
+
+		// Platforms without SSE
+		for (; i < numFloats; ++i)
+		{
+			float sum = weights[0] * centre[i];
+			for (int k = 1; k <= radius; ++k)
+			{
+				sum += weights[k] * (before[k][i] + after[k][i]);
+			}
+			out[i] = (opaque && (i & 3) == 3) ? 1.0f : sum;
+		}
+	}
+
+
+	int Clamp(int x, int low, int high)  { return std::min(std::max(x, low), high); }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Kernel
+//--------------------------------------------------------------------------------------
+
+// Return the weights of a Gaussian kernel with the given standard deviation in pixels. Only half the kernel is returned
+// since it is symmetric: element 0 is the centre weight, element i the weight for offsets of +i and -i pixels
+std::vector<float> GaussianBlurWeights(float sigma)
+{
+	if (sigma <= 0)  return { 1.0f };
+
+	int radius = static_cast<int>(std::ceil(3 * sigma));
+	std::vector<float> weights(radius + 1);
+	float total = 0;
+	for (int i = 0; i <= radius; ++i)
+	{
+		weights[i] = std::exp(-(i * i) / (2 * sigma * sigma));
+		total += (i == 0) ? weights[i] : 2 * weights[i]; // Off-centre weights are used twice
+	}
+	for (auto& weight : weights)  weight /= total;
+	return weights;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Blur passes
+//--------------------------------------------------------------------------------------
+
+// Blur the given rectangle of the source image horizontally into the same rectangle of the target image
+void GaussianBlurHorizontal(ThreadPool& threadPool, const Image& source, Image& target, const PixelRect& rect,
+                            const std::vector<float>& weights, bool opaque /*= true*/)
+{
+	if (rect.IsEmpty())  return;
+	int radius = static_cast<int>(weights.size()) - 1;
+	int numJobs = (rect.Height() + RowsPerJob - 1) / RowsPerJob;
+
+	threadPool.ParallelFor(numJobs, [&](int job)
+	{
+		// Each source row is copied into a buffer with the edge pixels repeated either side, so the inner loop needs no clamping
+		std::vector<ColourRGBA> padded(rect.Width() + 2 * radius);
+		const float* centre = &padded[radius].r;
+		std::vector<const float*> before(radius + 1), after(radius + 1);
+		for (int k = 1; k <= radius; ++k)
+		{
+			before[k] = centre - 4 * k;
+			after[k]  = centre + 4 * k;
+		}
+
+		int top    = rect.top + job * RowsPerJob;
+		int bottom = std::min(top + RowsPerJob, rect.bottom);
+		for (int y = top; y < bottom; ++y)
+		{
+			const ColourRGBA* sourceRow = source.Row(y);
+			for (int i = 0; i < static_cast<int>(padded.size()); ++i)
+			{
+				padded[i] = sourceRow[Clamp(rect.left - radius + i, 0, source.Width() - 1)];
+			}
+			WeightedSum(centre, before.data(), after.data(), weights.data(), radius, &target.Row(y)[rect.left].r, rect.Width() * 4, opaque);
+		}
+	});
+}
+
+
+// Blur the given rectangle of the source image vertically into the same rectangle of the target image
+void GaussianBlurVertical(ThreadPool& threadPool, const Image& source, Image& target, const PixelRect& rect,
+                          const std::vector<float>& weights, bool opaque /*= true*/)
+{
+	if (rect.IsEmpty())  return;
+	int radius = static_cast<int>(weights.size()) - 1;
+	int numStrips = (rect.Width()  + StripWidth - 1) / StripWidth;
+	int numBands  = (rect.Height() + RowsPerJob - 1) / RowsPerJob;
+
+	// Jobs are ordered down each strip so neighbouring jobs share source rows in cache
+	threadPool.ParallelFor(numStrips * numBands, [&](int job)
+	{
+		int left   = rect.left + (job / numBands) * StripWidth;
+		int right  = std::min(left + StripWidth, rect.right);
+		int top    = rect.top + (job % numBands) * RowsPerJob;
+		int bottom = std::min(top + RowsPerJob, rect.bottom);
+
+		std::vector<const float*> before(radius + 1), after(radius + 1);
+		for (int y = top; y < bottom; ++y)
+		{
+			for (int k = 1; k <= radius; ++k)
+			{
+				before[k] = &source.Row(Clamp(y - k, 0, source.Height() - 1))[left].r;
+				after[k]  = &source.Row(Clamp(y + k, 0, source.Height() - 1))[left].r;
+			}
+			WeightedSum(&source.Row(y)[left].r, before.data(), after.data(), weights.data(), radius, &target.Row(y)[left].r, (right - left) * 4, opaque);
+		}
+	});
+}
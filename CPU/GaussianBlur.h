@@ -0,0 +1,39 @@
+//--------------------------------------------------------------------------------------
+// Separable Gaussian blur for CPU images
+//--------------------------------------------------------------------------------------
+// Blurs with a true Gaussian kernel of any size, or any other symmetric kernel, one direction at
+// a time. Every pixel within the kernel radius is weighted (the GPU shaders instead point sample
+// 9 fixed taps spread further apart as the blur amount increases, leaving gaps at large amounts).
+// Rows and columns are processed with SSE, the vertical pass in narrow column strips so the rows
+// it reads stay in cache. Code in .cpp file
+
+#ifndef _GAUSSIAN_BLUR_H_INCLUDED_
+#define _GAUSSIAN_BLUR_H_INCLUDED_
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+// Standard deviation in pixels of the Gaussian used for each unit of the post-processing blur amount (gBlurAmount). The
+// shaders' 9 taps, blurAmount pixels apart, spread colour by about this much, so the CPU blur matches them in size
+const float GaussianSigmaPerBlurAmount = 1.69f;
+
+// Return the weights of a Gaussian kernel with the given standard deviation in pixels, normalised to sum to 1. Only half the
+// kernel is returned since it is symmetric: element 0 is the centre weight, element i the weight for offsets of +i and -i
+// pixels. The kernel extends to 3 sigma. A sigma of 0 or less gives the single weight 1, a copy
+std::vector<float> GaussianBlurWeights(float sigma);
+
+// Blur the given rectangle of the source image horizontally into the same rectangle of the target image. Pixels outside
+// the source image are clamped to the edge, like gPointSampler. Source and target must be the same size and different images.
+// If opaque is true the output alpha is set to 1 (as the blur shaders do), otherwise alpha is blurred like the colour
+void GaussianBlurHorizontal(ThreadPool& threadPool, const Image& source, Image& target, const PixelRect& rect,
+                            const std::vector<float>& weights, bool opaque = true);
+
+// Blur the given rectangle of the source image vertically into the same rectangle of the target image. Same rules as above
+void GaussianBlurVertical(ThreadPool& threadPool, const Image& source, Image& target, const PixelRect& rect,
+                          const std::vector<float>& weights, bool opaque = true);
+
+
+#endif //_GAUSSIAN_BLUR_H_INCLUDED_
@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------
+// Image class - a 2D buffer of float RGBA pixels held in CPU memory
+//--------------------------------------------------------------------------------------
+
+#include "Image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+// Create an image of the given size. Pixel content is uninitialised
+Image::Image(int width, int height)
+	: mWidth(0), mHeight(0)
+{
+	Resize(width, height);
+}
+
+
+// Change the size of the image. Pixel content is uninitialised after a resize
+void Image::Resize(int width, int height)
+{
+	mWidth  = width;
+	mHeight = height;
+	mPixels.resize(static_cast<size_t>(width) * height); // ColourRGBA default constructor leaves values uninitialised so this is cheap
+}
+
+
+//--------------------------------------------------------------------------------------
+// Data access
+//--------------------------------------------------------------------------------------
+
+// Fill the whole image with one colour
+void Image::Clear(const ColourRGBA& colour)
+{
+	std::fill(mPixels.begin(), mPixels.end(), colour);
+}
+
+
+// Copy the given rectangle of pixels from another image of the same size
+void Image::CopyRect(const Image& source, const PixelRect& rect)
+{
+	size_t rowBytes = static_cast<size_t>(rect.Width()) * sizeof(ColourRGBA);
+	for (int y = rect.top; y < rect.bottom; ++y)
+	{
+		std::memcpy(Row(y) + rect.left, source.Row(y) + rect.left, rowBytes);
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Sampling
+//--------------------------------------------------------------------------------------
+
+// Nearest pixel to the given UV, coordinates outside 0->1 are clamped to the edge. Same as gPointSampler
+ColourRGBA Image::SamplePoint(CVector2 uv) const
+{
+	int x = static_cast<int>(std::floor(uv.x * mWidth));
+	int y = static_cast<int>(std::floor(uv.y * mHeight));
+	x = std::min(std::max(x, 0), mWidth  - 1);
+	y = std::min(std::max(y, 0), mHeight - 1);
+	return Pixel(x, y);
+}
+
+
+// Bilinear filtered sample with coordinates outside 0->1 wrapped around. Same as gTrilinearSampler
+// when the image is not minified (no mip-maps on the CPU)
+ColourRGBA Image::SampleBilinearWrap(CVector2 uv) const
+{
+	// Pixel centres are at half-pixel positions, so shift by half a pixel to find the four surrounding centres
+	float x = uv.x * mWidth  - 0.5f;
+	float y = uv.y * mHeight - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fracX = x - floorX;
+	float fracY = y - floorY;
+
+	// Wrap the integer coordinates into the image (handling negative values)
+	int x0 = static_cast<int>(floorX) % mWidth;   if (x0 < 0)  x0 += mWidth;
+	int y0 = static_cast<int>(floorY) % mHeight;  if (y0 < 0)  y0 += mHeight;
+	int x1 = x0 + 1 == mWidth  ? 0 : x0 + 1;
+	int y1 = y0 + 1 == mHeight ? 0 : y0 + 1;
+
+	ColourRGBA top    = Pixel(x0, y0) * (1.0f - fracX) + Pixel(x1, y0) * fracX;
+	ColourRGBA bottom = Pixel(x0, y1) * (1.0f - fracX) + Pixel(x1, y1) * fracX;
+	return top * (1.0f - fracY) + bottom * fracY;
+}
+
+
+// Bilinear filtered sample with coordinates outside 0->1 clamped to the edge. Used when resampling between image sizes
+ColourRGBA Image::SampleBilinearClamp(CVector2 uv) const
+{
+	float x = uv.x * mWidth  - 0.5f;
+	float y = uv.y * mHeight - 0.5f;
+	float floorX = std::floor(x);
+	float floorY = std::floor(y);
+	float fracX = x - floorX;
+	float fracY = y - floorY;
+
+	int x0 = std::min(std::max(static_cast<int>(floorX),     0), mWidth  - 1);
+	int y0 = std::min(std::max(static_cast<int>(floorY),     0), mHeight - 1);
+	int x1 = std::min(std::max(static_cast<int>(floorX) + 1, 0), mWidth  - 1);
+	int y1 = std::min(std::max(static_cast<int>(floorY) + 1, 0), mHeight - 1);
+
+	ColourRGBA top    = Pixel(x0, y0) * (1.0f - fracX) + Pixel(x1, y0) * fracX;
+	ColourRGBA bottom = Pixel(x0, y1) * (1.0f - fracX) + Pixel(x1, y1) * fracX;
+	return top * (1.0f - fracY) + bottom * fracY;
+}
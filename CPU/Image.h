@@ -0,0 +1,96 @@
+//--------------------------------------------------------------------------------------
+// Image class - a 2D buffer of float RGBA pixels held in CPU memory
+//--------------------------------------------------------------------------------------
+// The CPU equivalent of a R32G32B32A32_FLOAT texture. Used by the CPU post-processing
+// pipeline in place of the scene textures / render targets. Code in .cpp file
+
+#ifndef _IMAGE_H_INCLUDED_
+#define _IMAGE_H_INCLUDED_
+
+#include "ColourRGBA.h"
+#include "CVector2.h"
+
+#include <vector>
+
+
+// A rectangle of pixels. Right and bottom are exclusive, so the width is right - left
+struct PixelRect
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+
+	int  Width()   const  { return right - left; }
+	int  Height()  const  { return bottom - top; }
+	bool IsEmpty() const  { return right <= left || bottom <= top; }
+};
+
+
+class Image
+{
+public:
+	//-------------------------------------
+	// Construction
+	//-------------------------------------
+
+	// Create an empty image, use Resize before use
+	Image() : mWidth(0), mHeight(0) {}
+
+	// Create an image of the given size. Pixel content is uninitialised
+	Image(int width, int height);
+
+	// Change the size of the image. Pixel content is uninitialised after a resize
+	void Resize(int width, int height);
+
+
+	//-------------------------------------
+	// Data access
+	//-------------------------------------
+
+	int Width()  const  { return mWidth;  }
+	int Height() const  { return mHeight; }
+	PixelRect Rect() const  { return { 0, 0, mWidth, mHeight }; }
+
+	// Pointer to the first pixel of a given row. Rows are stored top to bottom with no padding between them
+	ColourRGBA*       Row(int y)        { return mPixels.data() + static_cast<size_t>(y) * mWidth; }
+	const ColourRGBA* Row(int y) const  { return mPixels.data() + static_cast<size_t>(y) * mWidth; }
+
+	ColourRGBA&       Pixel(int x, int y)        { return Row(y)[x]; }
+	const ColourRGBA& Pixel(int x, int y) const  { return Row(y)[x]; }
+
+	// Fill the whole image with one colour
+	void Clear(const ColourRGBA& colour);
+
+	// Copy the given rectangle of pixels from another image of the same size
+	void CopyRect(const Image& source, const PixelRect& rect);
+
+
+	//-------------------------------------
+	// Sampling
+	//-------------------------------------
+	// UVs are texture coordinates in the range 0->1 across the image, as used in the shaders
+
+	// Nearest pixel to the given UV, coordinates outside 0->1 are clamped to the edge. Same as gPointSampler
+	ColourRGBA SamplePoint(CVector2 uv) const;
+
+	// Bilinear filtered sample with coordinates outside 0->1 wrapped around. Same as gTrilinearSampler
+	// when the image is not minified (no mip-maps on the CPU)
+	ColourRGBA SampleBilinearWrap(CVector2 uv) const;
+
+	// Bilinear filtered sample with coordinates outside 0->1 clamped to the edge. Used when resampling between image sizes
+	ColourRGBA SampleBilinearClamp(CVector2 uv) const;
+
+
+//-------------------------------------
+// Private members
+//-------------------------------------
+private:
+	int mWidth;
+	int mHeight;
+
+	std::vector<ColourRGBA> mPixels;
+};
+
+
+#endif //_IMAGE_H_INCLUDED_
@@ -0,0 +1,158 @@
+//--------------------------------------------------------------------------------------
+// Kawase light streaks for CPU images
+//--------------------------------------------------------------------------------------
+// Follows KawaseLightStreak_pp.hlsl. Each iteration the shader streaks four directions, keeping
+// each direction in its own channel (horizontal in red, vertical in green, diagonals in blue and
+// alpha) so the next iteration continues the same streak. The shader steps 2 full-size pixels per
+// sample, which is exactly 1 pixel at half size, so here every sample is a whole pixel fetch and
+// the samples for the four directions at each step share one weight and one vector add
+
+#include "LightStreak.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+	// Samples each side of the centre per direction, and fall-off of the sample weights along the streak
+	const int   StreakSamples = 4;
+	const float Attenuation = 0.98f;
+
+
+	inline ColourRGBA Saturate(const ColourRGBA& c)
+	{
+		return { std::min(std::max(c.r, 0.0f), 1.0f), std::min(std::max(c.g, 0.0f), 1.0f),
+		         std::min(std::max(c.b, 0.0f), 1.0f), std::min(std::max(c.a, 0.0f), 1.0f) };
+	}
+
+
+	// Halve the size of the bright pass with a 2x2 box filter (edge pixels repeated for odd sizes)
+	void Downsample(ThreadPool& threadPool, const Image& source, Image& target)
+	{
+		ForEachRow(threadPool, target.Height(), [&](int y)
+		{
+			const ColourRGBA* row0 = source.Row(std::min(y * 2,     source.Height() - 1));
+			const ColourRGBA* row1 = source.Row(std::min(y * 2 + 1, source.Height() - 1));
+			ColourRGBA* out = target.Row(y);
+			for (int x = 0; x < target.Width(); ++x)
+			{
+				int x0 = std::min(x * 2,     source.Width() - 1);
+				int x1 = std::min(x * 2 + 1, source.Width() - 1);
+				out[x] = (row0[x0] + row0[x1] + row1[x0] + row1[x1]) * 0.25f;
+			}
+		});
+	}
+
+
+	// One streaking iteration. Red is streaked horizontally, green vertically, blue along (1,1) and alpha along (-1,1),
+	// with samples spaced 4^iteration pixels apart. If combine is true the four saturated streaks are added together and
+	// the total stored in every channel (the shader's final iteration), otherwise each streak is stored in its channel
+	void Streak(ThreadPool& threadPool, const Image& source, Image& target, int iteration, bool combine)
+	{
+		int width  = source.Width();
+		int height = source.Height();
+		int step = static_cast<int>(std::pow(static_cast<float>(StreakSamples), static_cast<float>(iteration)));
+
+		float weights[StreakSamples];
+		for (int s = 0; s < StreakSamples; ++s)
+		{
+			weights[s] = std::min(std::max(std::pow(Attenuation, static_cast<float>(step * s)), 0.0f), 1.0f);
+		}
+		int reach = step * (StreakSamples - 1);
+
+		ForEachRow(threadPool, height, [&](int y)
+		{
+			ColourRGBA* out = target.Row(y);
+			bool rowInside = (y - reach >= 0 && y + reach < height);
+			for (int x = 0; x < width; ++x)
+			{
+				// The centre sample is taken twice by the shader (forward and backward offsets are both zero)
+				ColourRGBA sum = source.Pixel(x, y) * (2 * weights[0]);
+
+				if (rowInside && x - reach >= 0 && x + reach < width)
+				{
+					// Fast path, no clamping needed
+					for (int s = 1; s < StreakSamples; ++s)
+					{
+						int o = step * s;
+						const ColourRGBA* above = source.Row(y - o);
+						const ColourRGBA* centre = source.Row(y);
+						const ColourRGBA* below = source.Row(y + o);
+						ColourRGBA forward  = { centre[x + o].r, below[x].g, below[x + o].b, below[x - o].a };
+						ColourRGBA backward = { centre[x - o].r, above[x].g, above[x - o].b, above[x + o].a };
+						sum += (forward + backward) * weights[s];
+					}
+				}
+				else
+				{
+					// Clamp to the edge of the image, as the point sampler does
+					auto pixel = [&](int px, int py) -> const ColourRGBA&
+					{
+						return source.Pixel(std::min(std::max(px, 0), width - 1), std::min(std::max(py, 0), height - 1));
+					};
+					for (int s = 1; s < StreakSamples; ++s)
+					{
+						int o = step * s;
+						ColourRGBA forward  = { pixel(x + o, y).r, pixel(x, y + o).g, pixel(x + o, y + o).b, pixel(x - o, y + o).a };
+						ColourRGBA backward = { pixel(x - o, y).r, pixel(x, y - o).g, pixel(x - o, y - o).b, pixel(x + o, y - o).a };
+						sum += (forward + backward) * weights[s];
+					}
+				}
+
+				sum = Saturate(sum);
+				if (combine)
+				{
+					float total = sum.r + sum.g + sum.b + sum.a;
+					sum = { total, total, total, total };
+				}
+				out[x] = sum;
+			}
+		});
+	}
+}
+
+
+// Streak the bright pass image and screen-blend the result over the sharp image into the target
+void KawaseLightStreaks(ThreadPool& threadPool, const Image& brightPass, const Image& sharp, Image& target,
+                        std::vector<Image>& levels, int numIterations)
+{
+	int width  = std::max((brightPass.Width()  + 1) / 2, 1);
+	int height = std::max((brightPass.Height() + 1) / 2, 1);
+	levels.resize(2);
+	for (auto& level : levels)
+	{
+		if (level.Width() != width || level.Height() != height)  level.Resize(width, height);
+	}
+
+	// Streak iterations ping-pong between the two half-size images, then a final iteration combines the four streaks
+	Downsample(threadPool, brightPass, levels[0]);
+	int current = 0;
+	for (int iteration = 0; iteration < numIterations; ++iteration)
+	{
+		Streak(threadPool, levels[current], levels[1 - current], iteration, false);
+		current = 1 - current;
+	}
+	Streak(threadPool, levels[current], levels[1 - current], numIterations, true);
+	const Image& streaks = levels[1 - current];
+
+	// Upsample the combined streaks and screen-blend over the sharp image. Full-size pixels map 2:1 onto the half-size texels
+	float invWidth  = 0.5f / width;
+	float invHeight = 0.5f / height;
+	ForEachRow(threadPool, target.Height(), [&](int y)
+	{
+		const ColourRGBA* sharpRow = sharp.Row(y);
+		ColourRGBA* out = target.Row(y);
+		CVector2 uv;
+		uv.y = (y + 0.5f) * invHeight;
+		for (int x = 0; x < target.Width(); ++x)
+		{
+			uv.x = (x + 0.5f) * invWidth;
+			float streak = streaks.SampleBilinearClamp(uv).r;
+			out[x] = { 1.0f - (1.0f - sharpRow[x].r) * (1.0f - streak),
+			           1.0f - (1.0f - sharpRow[x].g) * (1.0f - streak),
+			           1.0f - (1.0f - sharpRow[x].b) * (1.0f - streak), 1.0f };
+		}
+	});
+}
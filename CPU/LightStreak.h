@@ -0,0 +1,26 @@
+//--------------------------------------------------------------------------------------
+// Kawase light streaks for CPU images
+//--------------------------------------------------------------------------------------
+// Does the work of the chain of KawaseLightStreak passes in one call. The bright parts of an image
+// are streaked horizontally, vertically and along both diagonals, with the streak length growing
+// four times each iteration, then the streaks are screen-blended over the sharp scene. Runs at half
+// resolution and calculates all four directions in a single sweep over the image. Code in .cpp file
+
+#ifndef _LIGHT_STREAK_H_INCLUDED_
+#define _LIGHT_STREAK_H_INCLUDED_
+
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+// Streak the bright pass image (the output of the Bloom post-process) and screen-blend the result over the sharp image
+// into the target. All three images are the same size. numIterations streaking passes are done before the final combining
+// pass, 4 matches the shader chain. The levels vector holds the half-size images, it is resized as needed and can be kept
+// between calls to avoid reallocating
+void KawaseLightStreaks(ThreadPool& threadPool, const Image& brightPass, const Image& sharp, Image& target,
+                        std::vector<Image>& levels, int numIterations);
+
+
+#endif //_LIGHT_STREAK_H_INCLUDED_
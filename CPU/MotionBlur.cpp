@@ -0,0 +1,194 @@
+//--------------------------------------------------------------------------------------
+// Camera motion blur for CPU images
+//--------------------------------------------------------------------------------------
+// Velocities are worked out by taking each pixel back to the world with the inverse of this frame's
+// view-projection matrix, then forward to the screen with last frame's. Both steps combine into one
+// matrix, and the part that depends on y is worked out once per row. The blur is centred on the
+// pixel, half the motion each way, with the number of samples set by the fastest motion in the tile
+
+#include "MotionBlur.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+
+namespace
+{
+	const int TileSize = 16;
+	const float StaticLength = 0.5f; // Blurs shorter than this (in pixels) are not visible, the pixel is copied
+	const int MaxSamples = 32;
+
+
+	inline float LengthSquared(const ColourRGBA& velocity)  { return velocity.r * velocity.r + velocity.g * velocity.g; }
+
+
+	// Samples needed to blur over the given length in pixels without gaps
+	inline int NumSamples(float length)
+	{
+		return std::min(std::max(static_cast<int>(std::ceil(length)) + 1, 3), MaxSamples);
+	}
+
+
+	// Average numSamples bilinear samples of the scene along the motion (in pixels) centred on the given position (in pixels)
+	inline ColourRGBA Gather(const Image& scene, float x, float y, float motionX, float motionY, int numSamples)
+	{
+		float invWidth  = 1.0f / scene.Width();
+		float invHeight = 1.0f / scene.Height();
+		float step = 1.0f / (numSamples - 1);
+		ColourRGBA sum = { 0, 0, 0, 0 };
+		for (int s = 0; s < numSamples; ++s)
+		{
+			float t = s * step - 0.5f;
+			sum += scene.SampleBilinearClamp({ (x + motionX * t) * invWidth, (y + motionY * t) * invHeight });
+		}
+		return sum * (1.0f / numSamples);
+	}
+}
+
+
+// Write the screen motion in pixels since the last frame of every pixel of the velocity image into its red and green channels
+void VelocityBuffer(ThreadPool& threadPool, const Image* depth, Image& velocity, const CMatrix4x4& viewProjection,
+                    const CMatrix4x4& previousViewProjection, float maxLength)
+{
+	int width  = velocity.Width();
+	int height = velocity.Height();
+
+	// Clip space this frame to clip space last frame. Row vectors, so a point (x, y, z, 1) becomes
+	// x * row 0 + y * row 1 + z * row 2 + row 3 of the matrix
+	const CMatrix4x4 m = Inverse(viewProjection) * previousViewProjection;
+
+	ForEachRow(threadPool, height, [&](int y)
+	{
+		ColourRGBA* out = velocity.Row(y);
+		float v = (y + 0.5f) / height;
+		float ndcY = 1.0f - 2.0f * v;
+
+		// Part of the result that is the same along the row
+		CVector4 rowBase = { ndcY * m.e10 + m.e30, ndcY * m.e11 + m.e31, ndcY * m.e12 + m.e32, ndcY * m.e13 + m.e33 };
+		for (int x = 0; x < width; ++x)
+		{
+			float u = (x + 0.5f) / width;
+			float ndcX = 2.0f * u - 1.0f;
+			float z = depth ? depth->SamplePoint({ u, v }).r : 1.0f;
+			CVector4 previous = { rowBase.x + ndcX * m.e00 + z * m.e20, rowBase.y + ndcX * m.e01 + z * m.e21,
+			                      rowBase.z + ndcX * m.e02 + z * m.e22, rowBase.w + ndcX * m.e03 + z * m.e23 };
+
+			// Points that were behind the camera last frame have no sensible motion
+			if (previous.w <= 0)
+			{
+				out[x] = { 0, 0, 0, 0 };
+				continue;
+			}
+			float previousX = (previous.x / previous.w + 1.0f) * 0.5f * width;
+			float previousY = (1.0f - previous.y / previous.w) * 0.5f * height;
+			float motionX = (x + 0.5f) - previousX;
+			float motionY = (y + 0.5f) - previousY;
+
+			float length = std::sqrt(motionX * motionX + motionY * motionY);
+			if (length > maxLength)
+			{
+				motionX *= maxLength / length;
+				motionY *= maxLength / length;
+			}
+			out[x] = { motionX, motionY, 0, 0 };
+		}
+	});
+}
+
+
+// Blur the scene image into the target along the velocities in the velocity image
+MotionBlurStats MotionBlur(ThreadPool& threadPool, const Image& scene, const Image& velocity, Image& target,
+                           std::vector<CVector2>& tileVelocity, float blurScale)
+{
+	int width  = scene.Width();
+	int height = scene.Height();
+	int tilesX = (width  + TileSize - 1) / TileSize;
+	int tilesY = (height + TileSize - 1) / TileSize;
+	tileVelocity.resize(static_cast<size_t>(tilesX) * tilesY);
+
+	// Tile-max prepass, the fastest velocity in each tile
+	threadPool.ParallelFor(tilesY, [&](int tileY)
+	{
+		int top    = tileY * TileSize;
+		int bottom = std::min(top + TileSize, height);
+		for (int tileX = 0; tileX < tilesX; ++tileX)
+		{
+			int left  = tileX * TileSize;
+			int right = std::min(left + TileSize, width);
+			ColourRGBA fastest = { 0, 0, 0, 0 };
+			for (int y = top; y < bottom; ++y)
+			{
+				const ColourRGBA* row = velocity.Row(y);
+				for (int x = left; x < right; ++x)
+				{
+					if (LengthSquared(row[x]) > LengthSquared(fastest))  fastest = row[x];
+				}
+			}
+			tileVelocity[tileY * tilesX + tileX] = { fastest.r, fastest.g };
+		}
+	});
+
+	// Blur tiles that move, copy the others
+	std::atomic<int> staticTiles(0), blurredTiles(0);
+	threadPool.ParallelFor(tilesX * tilesY, [&](int tileIndex)
+	{
+		int left   = (tileIndex % tilesX) * TileSize;
+		int top    = (tileIndex / tilesX) * TileSize;
+		int right  = std::min(left + TileSize, width);
+		int bottom = std::min(top  + TileSize, height);
+
+		const CVector2& fastest = tileVelocity[tileIndex];
+		float maxLength = std::sqrt(fastest.x * fastest.x + fastest.y * fastest.y) * blurScale;
+		if (maxLength < StaticLength)
+		{
+			for (int y = top; y < bottom; ++y)
+			{
+				std::copy(scene.Row(y) + left, scene.Row(y) + right, target.Row(y) + left);
+			}
+			++staticTiles;
+			return;
+		}
+
+		int numSamples = NumSamples(maxLength);
+		for (int y = top; y < bottom; ++y)
+		{
+			const ColourRGBA* sceneRow = scene.Row(y);
+			const ColourRGBA* velocityRow = velocity.Row(y);
+			ColourRGBA* out = target.Row(y);
+			for (int x = left; x < right; ++x)
+			{
+				float motionX = velocityRow[x].r * blurScale;
+				float motionY = velocityRow[x].g * blurScale;
+				if (motionX * motionX + motionY * motionY < StaticLength * StaticLength)
+				{
+					out[x] = sceneRow[x];
+				}
+				else
+				{
+					out[x] = Gather(scene, x + 0.5f, y + 0.5f, motionX, motionY, numSamples);
+				}
+			}
+		}
+		++blurredTiles;
+	});
+
+	MotionBlurStats stats;
+	stats.staticTiles  = staticTiles;
+	stats.blurredTiles = blurredTiles;
+	return stats;
+}
+
+
+// The motion blur of a single pixel, for area and polygon passes that are not processed in tiles
+ColourRGBA MotionBlurPixel(const Image& scene, const Image& velocity, CVector2 uv, float blurScale)
+{
+	ColourRGBA pixelVelocity = velocity.SamplePoint(uv);
+	float motionX = pixelVelocity.r * blurScale;
+	float motionY = pixelVelocity.g * blurScale;
+	float length = std::sqrt(motionX * motionX + motionY * motionY);
+	if (length < StaticLength)  return scene.SamplePoint(uv);
+
+	return Gather(scene, uv.x * scene.Width(), uv.y * scene.Height(), motionX, motionY, NumSamples(length));
+}
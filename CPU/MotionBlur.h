@@ -0,0 +1,52 @@
+//--------------------------------------------------------------------------------------
+// Camera motion blur for CPU images
+//--------------------------------------------------------------------------------------
+// Replaces the colour difference "motion vector" of MotionBlur_pp.hlsl with real motion. A velocity
+// buffer is made by reprojecting each pixel's depth with the current and previous view-projection
+// matrices, giving how far (in pixels) the point under each pixel moved on screen since last frame.
+// The blur then averages samples along that vector. A prepass finds the fastest velocity in each
+// screen tile, tiles where nothing moves by half a pixel or more are copied without blurring.
+// Only camera motion is captured, models that move by themselves are blurred as if they were static.
+// Code in .cpp file
+
+#ifndef _MOTION_BLUR_H_INCLUDED_
+#define _MOTION_BLUR_H_INCLUDED_
+
+#include "CMatrix4x4.h"
+#include "CVector2.h"
+#include "Image.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+// Fraction of each frame's motion that is blurred (like a camera's exposure time), AmountOfBlur in the shader
+const float MotionBlurAmount = 0.5f;
+
+
+// Number of tiles of each type in the last frame, to see how much work was saved
+struct MotionBlurStats
+{
+	int staticTiles  = 0;
+	int blurredTiles = 0;
+};
+
+
+// Write the screen motion in pixels since the last frame of every pixel of the velocity image into its red (x) and green (y)
+// channels. The depth image holds depth buffer values (0->1) in its red channel and is sampled by UV so can be any size, if it
+// is missing every pixel is treated as being at the far clip (only camera rotation gives motion). The matrices are the camera's
+// ViewProjectionMatrix this frame and last frame. Velocities are limited to maxLength pixels
+void VelocityBuffer(ThreadPool& threadPool, const Image* depth, Image& velocity, const CMatrix4x4& viewProjection,
+                    const CMatrix4x4& previousViewProjection, float maxLength);
+
+// Blur the scene image into the target (same size) along the velocities in the velocity image (same size, from VelocityBuffer).
+// blurScale is the fraction of each frame's motion that is blurred (the exposure time). The tile velocity vector holds the
+// fastest velocity in each tile, it is resized as needed and can be kept between calls
+MotionBlurStats MotionBlur(ThreadPool& threadPool, const Image& scene, const Image& velocity, Image& target,
+                           std::vector<CVector2>& tileVelocity, float blurScale);
+
+// The motion blur of a single pixel, for area and polygon passes that are not processed in tiles
+ColourRGBA MotionBlurPixel(const Image& scene, const Image& velocity, CVector2 uv, float blurScale);
+
+
+#endif //_MOTION_BLUR_H_INCLUDED_
@@ -0,0 +1,351 @@
+//--------------------------------------------------------------------------------------
+// Scene buffer storage formats for CPU images
+//--------------------------------------------------------------------------------------
+// Float to small float conversion multiplies by 2^-112, which moves the float exponent bias (127)
+// to the small float bias (15) and turns values too small for a normal small float into float
+// denormals with the matching bit pattern. The float's bits are then rounded (to nearest even) and
+// shifted down to the small float's mantissa width. Small floats to floats do the reverse
+
+#include "PixelFormat.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+	#include <immintrin.h>
+	#define PIXEL_FORMAT_F16C
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define PIXEL_FORMAT_SSE
+#endif
+
+
+namespace
+{
+	const float ToSmallFloatScale   = 1.925929944e-34f; // 2^-112
+	const float FromSmallFloatScale = 5.192296859e+33f; // 2^112
+
+	// Largest values of the small floats, with 5 exponent bits and 6 (R11G11B10F red and green) or 5 (blue) mantissa bits. Half
+	// floats (10 mantissa bits) are clamped to 2^16 instead, which converts to infinity like values that overflow on the GPU
+	const float MaxFloat11  = 65024.0f;
+	const float MaxFloat10  = 64512.0f;
+	const float HalfOverflow = 65536.0f;
+
+	inline uint32_t FloatBits(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		return bits;
+	}
+
+	inline float BitsFloat(uint32_t bits)
+	{
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+
+	//-------------------------------------
+	// Scalar conversions
+	//-------------------------------------
+
+	// Positive float (negatives and NaN give 0) to a small float with the given number of mantissa bits
+	inline uint32_t ToSmallFloat(float value, int mantissaBits, float maxValue)
+	{
+		value = (value > 0) ? value : 0;
+		value = (value < maxValue) ? value : maxValue;
+		uint32_t bits = FloatBits(value * ToSmallFloatScale);
+		int shift = 23 - mantissaBits;
+		return (bits + (1u << (shift - 1)) - 1 + ((bits >> shift) & 1)) >> shift;
+	}
+
+	inline float FromSmallFloat(uint32_t smallFloat, int mantissaBits)
+	{
+		return BitsFloat(smallFloat << (23 - mantissaBits)) * FromSmallFloatScale;
+	}
+
+	inline uint16_t ToHalf(float value)
+	{
+		uint32_t sign = (FloatBits(value) >> 16) & 0x8000;
+		float magnitude = std::abs(value);
+		if (!(magnitude < HalfOverflow))  magnitude = HalfOverflow; // Also NaN
+		return static_cast<uint16_t>(sign | ToSmallFloat(magnitude, 10, HalfOverflow));
+	}
+
+	// Half floats with all exponent bits set are infinities, NaNs are not produced by ToHalf
+	inline float FromHalf(uint16_t half)
+	{
+		float magnitude = FromSmallFloat(half & 0x7fff, 10);
+		if (magnitude >= HalfOverflow)  magnitude = std::numeric_limits<float>::infinity();
+		return (half & 0x8000) ? -magnitude : magnitude;
+	}
+
+	inline uint32_t ToFloat11Float11Float10(const ColourRGBA& colour)
+	{
+		return ToSmallFloat(colour.r, 6, MaxFloat11) | (ToSmallFloat(colour.g, 6, MaxFloat11) << 11) |
+		       (ToSmallFloat(colour.b, 5, MaxFloat10) << 22);
+	}
+
+	inline ColourRGBA FromFloat11Float11Float10(uint32_t packed)
+	{
+		return { FromSmallFloat(packed & 0x7ff, 6), FromSmallFloat((packed >> 11) & 0x7ff, 6), FromSmallFloat(packed >> 22, 5), 1.0f };
+	}
+
+
+	//-------------------------------------
+	// sRGB
+	//-------------------------------------
+
+	inline float SrgbToLinear(float value)
+	{
+		return (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+	}
+
+	// Decoded value of each 8-bit sRGB step, and the linear value halfway between each step and the next. A linear value is
+	// encoded as the number of halfway points below it, which is the same as rounding its sRGB encoding
+	struct SrgbTables
+	{
+		float decode[256];
+		float halfway[255];
+
+		SrgbTables()
+		{
+			for (int i = 0; i < 256; ++i)  decode[i]  = SrgbToLinear(i / 255.0f);
+			for (int i = 0; i < 255; ++i)  halfway[i] = SrgbToLinear((i + 0.5f) / 255.0f);
+		}
+	};
+
+	const SrgbTables& GetSrgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	inline uint32_t ToSrgb8(float value, const SrgbTables& tables)
+	{
+		if (!(value > 0))  return 0; // Also NaN
+		return static_cast<uint32_t>(std::upper_bound(tables.halfway, tables.halfway + 255, value) - tables.halfway);
+	}
+
+	inline uint32_t ToUnorm8(float value)
+	{
+		value = (value > 0) ? value : 0;
+		value = (value < 1) ? value : 1;
+		return static_cast<uint32_t>(value * 255.0f + 0.5f);
+	}
+
+
+	//-------------------------------------
+	// Rows
+	//-------------------------------------
+
+	void PackRGBA16F(const ColourRGBA* pixels, int count, uint16_t* packed)
+	{
+		const float* in = &pixels[0].r;
+		int i = 0;
+
+#if defined(PIXEL_FORMAT_F16C)
+		for (; i < count; ++i)
+		{
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(packed + i * 4), _mm_cvtps_ph(_mm_loadu_ps(in + i * 4), _MM_FROUND_TO_NEAREST_INT));
+		}
+#elif defined(PIXEL_FORMAT_SSE)
+		// The scalar conversion for all four channels at once. Packing to 16 bits saturates signed values, so values are moved
+		// into the signed range first and back after
+		const __m128  signMask  = _mm_castsi128_ps(_mm_set1_epi32(static_cast<int>(0x80000000)));
+		const __m128  overflow  = _mm_set1_ps(HalfOverflow);
+		const __m128  scale     = _mm_set1_ps(ToSmallFloatScale);
+		const __m128i roundBias = _mm_set1_epi32((1 << 12) - 1);
+		const __m128i one       = _mm_set1_epi32(1);
+		const __m128i bias32    = _mm_set1_epi32(0x8000);
+		const __m128i bias16    = _mm_set1_epi16(static_cast<short>(0x8000));
+		for (; i < count; ++i)
+		{
+			__m128 value     = _mm_loadu_ps(in + i * 4);
+			__m128 sign      = _mm_and_ps(value, signMask);
+			__m128 magnitude = _mm_min_ps(_mm_andnot_ps(signMask, value), overflow); // NaN gives overflow
+			__m128i bits     = _mm_castps_si128(_mm_mul_ps(magnitude, scale));
+			__m128i lowBit   = _mm_and_si128(_mm_srli_epi32(bits, 13), one);
+			__m128i half     = _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, roundBias), lowBit), 13);
+			half = _mm_or_si128(half, _mm_srli_epi32(_mm_castps_si128(sign), 16));
+			__m128i packed16 = _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(half, bias32), _mm_setzero_si128()), bias16);
+			_mm_storel_epi64(reinterpret_cast<__m128i*>(packed + i * 4), packed16);
+		}
+#endif
+
+		for (int channel = i * 4; channel < count * 4; ++channel)  packed[channel] = ToHalf(in[channel]);
+	}
+
+	void UnpackRGBA16F(const uint16_t* packed, int count, ColourRGBA* pixels)
+	{
+		float* out = &pixels[0].r;
+		int i = 0;
+
+#if defined(PIXEL_FORMAT_F16C)
+		for (; i < count; ++i)
+		{
+			_mm_storeu_ps(out + i * 4, _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(packed + i * 4))));
+		}
+#elif defined(PIXEL_FORMAT_SSE)
+		const __m128  scale     = _mm_set1_ps(FromSmallFloatScale);
+		const __m128  overflow  = _mm_set1_ps(HalfOverflow);
+		const __m128  infinity  = _mm_set1_ps(std::numeric_limits<float>::infinity());
+		const __m128i magnitude = _mm_set1_epi32(0x7fff);
+		const __m128i sign      = _mm_set1_epi32(0x8000);
+		for (; i < count; ++i)
+		{
+			__m128i half  = _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(packed + i * 4)), _mm_setzero_si128());
+			__m128i bits  = _mm_slli_epi32(_mm_and_si128(half, magnitude), 13);
+			__m128  value = _mm_mul_ps(_mm_castsi128_ps(bits), scale);
+			value = _mm_or_ps(value, _mm_and_ps(_mm_cmpge_ps(value, overflow), infinity)); // 2^16 has no mantissa bits set
+			value = _mm_or_ps(value, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(half, sign), 16)));
+			_mm_storeu_ps(out + i * 4, value);
+		}
+#endif
+
+		for (int channel = i * 4; channel < count * 4; ++channel)  out[channel] = FromHalf(packed[channel]);
+	}
+
+
+#if defined(PIXEL_FORMAT_SSE)
+	// Positive floats to small floats, as ToSmallFloat, for four values
+	template <int MantissaBits>
+	inline __m128i ToSmallFloat4(__m128 value, __m128 maxValue)
+	{
+		const int shift = 23 - MantissaBits;
+		value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), maxValue); // max gives 0 for NaN
+		__m128i bits   = _mm_castps_si128(_mm_mul_ps(value, _mm_set1_ps(ToSmallFloatScale)));
+		__m128i lowBit = _mm_and_si128(_mm_srli_epi32(bits, shift), _mm_set1_epi32(1));
+		return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(bits, _mm_set1_epi32((1 << (shift - 1)) - 1)), lowBit), shift);
+	}
+
+	template <int MantissaBits>
+	inline __m128 FromSmallFloat4(__m128i smallFloat)
+	{
+		return _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(smallFloat, 23 - MantissaBits)), _mm_set1_ps(FromSmallFloatScale));
+	}
+#endif
+
+	// Four pixels at a time, transposed so each register holds one channel of four pixels
+	void PackR11G11B10F(const ColourRGBA* pixels, int count, uint32_t* packed)
+	{
+		int i = 0;
+
+#if defined(PIXEL_FORMAT_SSE)
+		const __m128 max11 = _mm_set1_ps(MaxFloat11);
+		const __m128 max10 = _mm_set1_ps(MaxFloat10);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 r = _mm_loadu_ps(&pixels[i].r);
+			__m128 g = _mm_loadu_ps(&pixels[i + 1].r);
+			__m128 b = _mm_loadu_ps(&pixels[i + 2].r);
+			__m128 a = _mm_loadu_ps(&pixels[i + 3].r);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			__m128i result = _mm_or_si128(_mm_or_si128(ToSmallFloat4<6>(r, max11), _mm_slli_epi32(ToSmallFloat4<6>(g, max11), 11)),
+			                              _mm_slli_epi32(ToSmallFloat4<5>(b, max10), 22));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(packed + i), result);
+		}
+#endif
+
+		for (; i < count; ++i)  packed[i] = ToFloat11Float11Float10(pixels[i]);
+	}
+
+	void UnpackR11G11B10F(const uint32_t* packed, int count, ColourRGBA* pixels)
+	{
+		int i = 0;
+
+#if defined(PIXEL_FORMAT_SSE)
+		const __m128i mask11 = _mm_set1_epi32(0x7ff);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(packed + i));
+			__m128 r = FromSmallFloat4<6>(_mm_and_si128(value, mask11));
+			__m128 g = FromSmallFloat4<6>(_mm_and_si128(_mm_srli_epi32(value, 11), mask11));
+			__m128 b = FromSmallFloat4<5>(_mm_srli_epi32(value, 22));
+			__m128 a = _mm_set1_ps(1.0f);
+			_MM_TRANSPOSE4_PS(r, g, b, a);
+			_mm_storeu_ps(&pixels[i].r,     r);
+			_mm_storeu_ps(&pixels[i + 1].r, g);
+			_mm_storeu_ps(&pixels[i + 2].r, b);
+			_mm_storeu_ps(&pixels[i + 3].r, a);
+		}
+#endif
+
+		for (; i < count; ++i)  pixels[i] = FromFloat11Float11Float10(packed[i]);
+	}
+
+	void PackRGBA8(const ColourRGBA* pixels, int count, uint32_t* packed)
+	{
+		const SrgbTables& tables = GetSrgbTables();
+		for (int i = 0; i < count; ++i)
+		{
+			const ColourRGBA& colour = pixels[i];
+			packed[i] = ToSrgb8(colour.r, tables) | (ToSrgb8(colour.g, tables) << 8) | (ToSrgb8(colour.b, tables) << 16) |
+			            (ToUnorm8(colour.a) << 24);
+		}
+	}
+
+	void UnpackRGBA8(const uint32_t* packed, int count, ColourRGBA* pixels)
+	{
+		const SrgbTables& tables = GetSrgbTables();
+		for (int i = 0; i < count; ++i)
+		{
+			uint32_t value = packed[i];
+			pixels[i] = { tables.decode[value & 0xff], tables.decode[(value >> 8) & 0xff], tables.decode[(value >> 16) & 0xff],
+			              (value >> 24) / 255.0f };
+		}
+	}
+}
+
+
+// Pack count pixels into a format
+void PackPixels(SceneBufferFormat format, const ColourRGBA* pixels, int count, void* packed)
+{
+	switch (format)
+	{
+		case SceneBufferFormat::RGBA8:      PackRGBA8       (pixels, count, static_cast<uint32_t*>(packed)); break;
+		case SceneBufferFormat::R11G11B10F: PackR11G11B10F  (pixels, count, static_cast<uint32_t*>(packed)); break;
+		case SceneBufferFormat::RGBA16F:    PackRGBA16F     (pixels, count, static_cast<uint16_t*>(packed)); break;
+		default:                            std::memcpy(packed, pixels, count * sizeof(ColourRGBA));         break;
+	}
+}
+
+
+// Unpack count pixels from a format
+void UnpackPixels(SceneBufferFormat format, const void* packed, int count, ColourRGBA* pixels)
+{
+	switch (format)
+	{
+		case SceneBufferFormat::RGBA8:      UnpackRGBA8     (static_cast<const uint32_t*>(packed), count, pixels); break;
+		case SceneBufferFormat::R11G11B10F: UnpackR11G11B10F(static_cast<const uint32_t*>(packed), count, pixels); break;
+		case SceneBufferFormat::RGBA16F:    UnpackRGBA16F   (static_cast<const uint16_t*>(packed), count, pixels); break;
+		default:                            std::memcpy(pixels, packed, count * sizeof(ColourRGBA));               break;
+	}
+}
+
+
+// Round every pixel of an image to the precision of a format
+void QuantiseImage(ThreadPool& threadPool, Image& image, SceneBufferFormat format)
+{
+	if (format == SceneBufferFormat::RGBA32F)  return;
+
+	int width  = image.Width();
+	int height = image.Height();
+	ForEachRowBand(threadPool, height, [&](int top, int bottom)
+	{
+		// One row at a time through a packed row, which stays in cache
+		std::vector<uint8_t> packed(static_cast<size_t>(width) * SceneBufferFormatBytes(format));
+		for (int y = top; y < bottom; ++y)
+		{
+			PackPixels  (format, image.Row(y), width, packed.data());
+			UnpackPixels(format, packed.data(), width, image.Row(y));
+		}
+	});
+}
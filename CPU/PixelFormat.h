@@ -0,0 +1,33 @@
+//--------------------------------------------------------------------------------------
+// Scene buffer storage formats for CPU images
+//--------------------------------------------------------------------------------------
+// Packs rows of float RGBA pixels into the formats of SceneBufferFormat (see PostProcess.h) and
+// unpacks them again, with the same rounding as the GPU: round to nearest for the float formats,
+// sRGB encoding rounded to the nearest 8-bit step for RGBA8. Half floats use the F16C instructions
+// when the build enables them (as /arch:AVX2 does), small floats are converted four pixels at a time
+// with SSE2, and sRGB uses tables. The CPU pipeline uses these to give its images the precision
+// they would have in the GPU's scene buffers. Code in .cpp file
+
+#ifndef _PIXEL_FORMAT_H_INCLUDED_
+#define _PIXEL_FORMAT_H_INCLUDED_
+
+#include "ColourRGBA.h"
+#include "Image.h"
+#include "PostProcess.h"
+#include "ThreadPool.h"
+
+#include <cstddef>
+
+
+// Pack count pixels into a format, SceneBufferFormatBytes(format) * count bytes are written. RGBA32F is a plain copy
+void PackPixels(SceneBufferFormat format, const ColourRGBA* pixels, int count, void* packed);
+
+// Unpack count pixels from a format. Alpha is 1 for R11G11B10F, which has no alpha channel
+void UnpackPixels(SceneBufferFormat format, const void* packed, int count, ColourRGBA* pixels);
+
+// Round every pixel of an image to the precision of a format, as if it had been written to a scene buffer of that format
+// and read back. Does nothing for RGBA32F
+void QuantiseImage(ThreadPool& threadPool, Image& image, SceneBufferFormat format);
+
+
+#endif //_PIXEL_FORMAT_H_INCLUDED_
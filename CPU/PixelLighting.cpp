@@ -0,0 +1,300 @@
+//--------------------------------------------------------------------------------------
+// Per-pixel lighting for the software rasterizer, a batched port of PixelLighting_ps
+//--------------------------------------------------------------------------------------
+// The shader is written once with the Lanes operations below, which are SSE instructions on four
+// fragments or (on platforms without SSE) plain loops over four floats. pow(x, p) is worked out
+// as exp2(p * log2(x)): log2 splits x into exponent and mantissa and uses the atanh series on the
+// mantissa, exp2 splits into integer and fraction and uses a Taylor series centred on the middle
+// of the fraction's range, then builds the power of two in the exponent bits
+
+#include "PixelLighting.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define PIXEL_LIGHTING_SSE
+#endif
+
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	// Lanes - four floats
+	//--------------------------------------------------------------------------------------
+	const int NUM_LANES = 4;
+
+#if defined(PIXEL_LIGHTING_SSE)
+
+	using Lanes = __m128;
+	using IntLanes = __m128i;
+
+	inline Lanes Load(const float* values)  { return _mm_loadu_ps(values); }
+	inline void  Store(float* out, Lanes v)  { _mm_storeu_ps(out, v); }
+	inline Lanes Broadcast(float value)      { return _mm_set1_ps(value); }
+
+	inline Lanes Add(Lanes a, Lanes b)  { return _mm_add_ps(a, b); }
+	inline Lanes Sub(Lanes a, Lanes b)  { return _mm_sub_ps(a, b); }
+	inline Lanes Mul(Lanes a, Lanes b)  { return _mm_mul_ps(a, b); }
+	inline Lanes Div(Lanes a, Lanes b)  { return _mm_div_ps(a, b); }
+	inline Lanes Max(Lanes a, Lanes b)  { return _mm_max_ps(a, b); }
+	inline Lanes Min(Lanes a, Lanes b)  { return _mm_min_ps(a, b); }
+
+	// 1 / sqrt(x), the estimate refined with one Newton-Raphson step
+	inline Lanes Rsqrt(Lanes x)
+	{
+		Lanes estimate = _mm_rsqrt_ps(x);
+		Lanes halfX = _mm_mul_ps(x, _mm_set1_ps(0.5f));
+		return _mm_mul_ps(estimate, _mm_sub_ps(_mm_set1_ps(1.5f), _mm_mul_ps(halfX, _mm_mul_ps(estimate, estimate))));
+	}
+
+	// Select a where mask is set, else b
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b)  { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	inline Lanes Greater(Lanes a, Lanes b)  { return _mm_cmpgt_ps(a, b); }
+	inline Lanes Less(Lanes a, Lanes b)     { return _mm_cmplt_ps(a, b); }
+
+	// Bits of the floats, and floats from bits
+	inline IntLanes AsInt(Lanes v)      { return _mm_castps_si128(v); }
+	inline Lanes    AsFloat(IntLanes v) { return _mm_castsi128_ps(v); }
+
+	// Exponent of each float (unbiased) and its mantissa as a float from 1 to 2
+	inline Lanes Exponent(Lanes x)
+	{
+		IntLanes exponent = _mm_sub_epi32(_mm_srli_epi32(_mm_and_si128(AsInt(x), _mm_set1_epi32(0x7f800000)), 23), _mm_set1_epi32(127));
+		return _mm_cvtepi32_ps(exponent);
+	}
+	inline Lanes Mantissa(Lanes x)
+	{
+		return AsFloat(_mm_or_si128(_mm_and_si128(AsInt(x), _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+	}
+
+	// Largest whole number no greater than x, as a float
+	inline Lanes Floor(Lanes x)
+	{
+		Lanes truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+		return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmpgt_ps(truncated, x), _mm_set1_ps(1.0f)));
+	}
+
+	// 2^n for whole numbers n from -126 to 127
+	inline Lanes PowerOfTwo(Lanes n)
+	{
+		return AsFloat(_mm_slli_epi32(_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23));
+	}
+
+#else
+
+	struct Lanes
+	{
+		float v[NUM_LANES];
+	};
+
+	template <typename Op>
+	inline Lanes Map(Lanes a, Lanes b, Op op)
+	{
+		Lanes result;
+		for (int i = 0; i < NUM_LANES; ++i)  result.v[i] = op(a.v[i], b.v[i]);
+		return result;
+	}
+	template <typename Op>
+	inline Lanes Map(Lanes a, Op op)
+	{
+		Lanes result;
+		for (int i = 0; i < NUM_LANES; ++i)  result.v[i] = op(a.v[i]);
+		return result;
+	}
+
+	inline Lanes Load(const float* values)  { Lanes result; std::memcpy(result.v, values, sizeof(result.v)); return result; }
+	inline void  Store(float* out, Lanes v)  { std::memcpy(out, v.v, sizeof(v.v)); }
+	inline Lanes Broadcast(float value)      { Lanes result; std::fill(result.v, result.v + NUM_LANES, value); return result; }
+
+	inline Lanes Add(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x + y; }); }
+	inline Lanes Sub(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x - y; }); }
+	inline Lanes Mul(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x * y; }); }
+	inline Lanes Div(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x / y; }); }
+	inline Lanes Max(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x > y ? x : y; }); }
+	inline Lanes Min(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x < y ? x : y; }); }
+
+	inline Lanes Rsqrt(Lanes x)  { return Map(x, [](float value) { return 1.0f / std::sqrt(value); }); }
+
+	// Masks are 1 or 0 in this version
+	inline Lanes Select(Lanes mask, Lanes a, Lanes b)  { Lanes result; for (int i = 0; i < NUM_LANES; ++i)  result.v[i] = mask.v[i] != 0 ? a.v[i] : b.v[i]; return result; }
+	inline Lanes Greater(Lanes a, Lanes b)  { return Map(a, b, [](float x, float y) { return x > y ? 1.0f : 0.0f; }); }
+	inline Lanes Less(Lanes a, Lanes b)     { return Map(a, b, [](float x, float y) { return x < y ? 1.0f : 0.0f; }); }
+
+	inline Lanes Exponent(Lanes x)
+	{
+		return Map(x, [](float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, 4);
+			return static_cast<float>(static_cast<int>((bits >> 23) & 0xff) - 127);
+		});
+	}
+	inline Lanes Mantissa(Lanes x)
+	{
+		return Map(x, [](float value)
+		{
+			uint32_t bits;
+			std::memcpy(&bits, &value, 4);
+			bits = (bits & 0x007fffff) | 0x3f800000;
+			std::memcpy(&value, &bits, 4);
+			return value;
+		});
+	}
+
+	inline Lanes Floor(Lanes x)  { return Map(x, [](float value) { return std::floor(value); }); }
+
+	inline Lanes PowerOfTwo(Lanes n)
+	{
+		return Map(n, [](float value)
+		{
+			uint32_t bits = static_cast<uint32_t>(static_cast<int>(value) + 127) << 23;
+			float result;
+			std::memcpy(&result, &bits, 4);
+			return result;
+		});
+	}
+
+#endif
+
+	inline Lanes MulAdd(Lanes a, Lanes b, Lanes c)  { return Add(Mul(a, b), c); }
+
+
+	//--------------------------------------------------------------------------------------
+	// Fast pow
+	//--------------------------------------------------------------------------------------
+
+	// log2(x) for x > 0. x = m * 2^e with m from sqrt(0.5) to sqrt(2), then log2(m) = 2/ln2 * atanh(s) with s = (m-1)/(m+1).
+	// |s| is at most 0.172 so four terms of the series are accurate to float precision. x = 0 gives -127
+	inline Lanes Log2(Lanes x)
+	{
+		Lanes exponent = Exponent(x);
+		Lanes mantissa = Mantissa(x);
+		Lanes high = Greater(mantissa, Broadcast(1.41421356f));
+		mantissa = Select(high, Mul(mantissa, Broadcast(0.5f)), mantissa);
+		exponent = Select(high, Add(exponent, Broadcast(1.0f)), exponent);
+
+		Lanes s  = Div(Sub(mantissa, Broadcast(1.0f)), Add(mantissa, Broadcast(1.0f)));
+		Lanes s2 = Mul(s, s);
+		Lanes series = MulAdd(s2, Broadcast(2.0f / (7.0f * 0.69314718f)), Broadcast(2.0f / (5.0f * 0.69314718f)));
+		series = MulAdd(s2, series, Broadcast(2.0f / (3.0f * 0.69314718f)));
+		series = MulAdd(s2, series, Broadcast(2.0f / 0.69314718f));
+		return MulAdd(s, series, exponent);
+	}
+
+	// 2^y. y = n + f with n whole and f from 0 to 1, then 2^f = sqrt(2) * e^((f - 0.5) * ln2) by a degree 6 Taylor series.
+	// Results below 2^-126 are 0
+	inline Lanes Exp2(Lanes y)
+	{
+		y = Min(y, Broadcast(127.0f));
+		Lanes underflow = Less(y, Broadcast(-126.0f));
+		y = Max(y, Broadcast(-126.0f));
+
+		Lanes whole = Floor(y);
+		Lanes u = Mul(Sub(Sub(y, whole), Broadcast(0.5f)), Broadcast(0.69314718f));
+		Lanes series = MulAdd(u, Broadcast(1.0f / 720.0f), Broadcast(1.0f / 120.0f));
+		series = MulAdd(u, series, Broadcast(1.0f / 24.0f));
+		series = MulAdd(u, series, Broadcast(1.0f / 6.0f));
+		series = MulAdd(u, series, Broadcast(0.5f));
+		series = MulAdd(u, series, Broadcast(1.0f));
+		series = MulAdd(u, series, Broadcast(1.0f));
+		Lanes result = Mul(Mul(series, Broadcast(1.41421356f)), PowerOfTwo(whole));
+		return Select(underflow, Broadcast(0.0f), result);
+	}
+
+	// x^power for x >= 0
+	inline Lanes Pow(Lanes x, Lanes power)  { return Exp2(Mul(power, Log2(x))); }
+
+
+	//--------------------------------------------------------------------------------------
+	// Shading
+	//--------------------------------------------------------------------------------------
+
+	// PixelLighting_ps for four fragments starting at first, colour channels written to the output arrays
+	void ShadeLanes(const LightingConstants& constants, const LightingFragments& fragments, int first,
+	                float* outR, float* outG, float* outB)
+	{
+		Lanes positionX = Load(fragments.positionX + first);
+		Lanes positionY = Load(fragments.positionY + first);
+		Lanes positionZ = Load(fragments.positionZ + first);
+
+		// Normal might have been scaled by model scaling or interpolation so renormalise
+		Lanes normalX = Load(fragments.normalX + first);
+		Lanes normalY = Load(fragments.normalY + first);
+		Lanes normalZ = Load(fragments.normalZ + first);
+		Lanes invLength = Rsqrt(MulAdd(normalX, normalX, MulAdd(normalY, normalY, Mul(normalZ, normalZ))));
+		normalX = Mul(normalX, invLength);
+		normalY = Mul(normalY, invLength);
+		normalZ = Mul(normalZ, invLength);
+
+		// Direction from pixel to camera
+		Lanes cameraX = Sub(Broadcast(constants.cameraPosition.x), positionX);
+		Lanes cameraY = Sub(Broadcast(constants.cameraPosition.y), positionY);
+		Lanes cameraZ = Sub(Broadcast(constants.cameraPosition.z), positionZ);
+		invLength = Rsqrt(MulAdd(cameraX, cameraX, MulAdd(cameraY, cameraY, Mul(cameraZ, cameraZ))));
+		cameraX = Mul(cameraX, invLength);
+		cameraY = Mul(cameraY, invLength);
+		cameraZ = Mul(cameraZ, invLength);
+
+		// Ambient is added once, then each light's diffuse and specular
+		Lanes diffuseR = Broadcast(constants.ambientColour.x);
+		Lanes diffuseG = Broadcast(constants.ambientColour.y);
+		Lanes diffuseB = Broadcast(constants.ambientColour.z);
+		Lanes specularR = Broadcast(0.0f);
+		Lanes specularG = Broadcast(0.0f);
+		Lanes specularB = Broadcast(0.0f);
+		Lanes power = Broadcast(constants.specularPower);
+
+		for (auto& light : constants.lights)
+		{
+			// Direction and distance from pixel to light. Dividing by the distance is a multiply by the same reciprocal
+			Lanes lightX = Sub(Broadcast(light.position.x), positionX);
+			Lanes lightY = Sub(Broadcast(light.position.y), positionY);
+			Lanes lightZ = Sub(Broadcast(light.position.z), positionZ);
+			Lanes invDistance = Rsqrt(MulAdd(lightX, lightX, MulAdd(lightY, lightY, Mul(lightZ, lightZ))));
+			lightX = Mul(lightX, invDistance);
+			lightY = Mul(lightY, invDistance);
+			lightZ = Mul(lightZ, invDistance);
+
+			Lanes diffuseLevel = Mul(Max(MulAdd(normalX, lightX, MulAdd(normalY, lightY, Mul(normalZ, lightZ))), Broadcast(0.0f)), invDistance);
+			Lanes lightR = Mul(Broadcast(light.colour.x), diffuseLevel);
+			Lanes lightG = Mul(Broadcast(light.colour.y), diffuseLevel);
+			Lanes lightB = Mul(Broadcast(light.colour.z), diffuseLevel);
+
+			Lanes halfwayX = Add(lightX, cameraX);
+			Lanes halfwayY = Add(lightY, cameraY);
+			Lanes halfwayZ = Add(lightZ, cameraZ);
+			invLength = Rsqrt(MulAdd(halfwayX, halfwayX, MulAdd(halfwayY, halfwayY, Mul(halfwayZ, halfwayZ))));
+			Lanes halfwayDot = Mul(MulAdd(normalX, halfwayX, MulAdd(normalY, halfwayY, Mul(normalZ, halfwayZ))), invLength);
+			Lanes specularLevel = Pow(Max(halfwayDot, Broadcast(0.0f)), power);
+
+			diffuseR = Add(diffuseR, lightR);
+			diffuseG = Add(diffuseG, lightG);
+			diffuseB = Add(diffuseB, lightB);
+			specularR = MulAdd(lightR, specularLevel, specularR); // Specular is the diffuse light times the specular level
+			specularG = MulAdd(lightG, specularLevel, specularG);
+			specularB = MulAdd(lightB, specularLevel, specularB);
+		}
+
+		// Combine lighting with texture colours
+		Lanes specularMaterial = Load(fragments.specular + first);
+		Store(outR, MulAdd(diffuseR, Load(fragments.diffuseR + first), Mul(specularR, specularMaterial)));
+		Store(outG, MulAdd(diffuseG, Load(fragments.diffuseG + first), Mul(specularG, specularMaterial)));
+		Store(outB, MulAdd(diffuseB, Load(fragments.diffuseB + first), Mul(specularB, specularMaterial)));
+	}
+}
+
+
+// Light the first count fragments of a batch and write their colours (alpha 1)
+void ShadePixelLighting(const LightingConstants& constants, const LightingFragments& fragments, int count, ColourRGBA* colours)
+{
+	float r[LIGHTING_BATCH], g[LIGHTING_BATCH], b[LIGHTING_BATCH];
+	for (int first = 0; first < count; first += NUM_LANES)
+	{
+		ShadeLanes(constants, fragments, first, r + first, g + first, b + first);
+	}
+	for (int i = 0; i < count; ++i)  colours[i] = { r[i], g[i], b[i], 1.0f };
+}
@@ -0,0 +1,217 @@
+//--------------------------------------------------------------------------------------
+// Fusion of colour-only post-processes for CPU images
+//--------------------------------------------------------------------------------------
+// The transforms of the chain are interpolated for each row and multiplied together, so each pixel
+// costs one 3x4 matrix multiply however long the chain is. With a lookup table each pixel costs a
+// table lookup for the row-invariant part plus a matrix multiply for the rest, if there is any
+
+#include "PointOpFusion.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+
+
+namespace
+{
+	// Post-processes that can start a chain, they read the scene in their own way then only work on colour
+	inline bool IsChainHead(PostProcess postProcess)
+	{
+		return postProcess == PostProcess::NightVision || postProcess == PostProcess::GameBoy;
+	}
+
+	ColourTransform Lerp(const ColourTransform& a, const ColourTransform& b, float t)
+	{
+		ColourTransform result;
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int col = 0; col < 4; ++col)  result.m[row][col] = a.m[row][col] + (b.m[row][col] - a.m[row][col]) * t;
+		}
+		return result;
+	}
+
+	bool SameTransform(const ColourTransform& a, const ColourTransform& b)
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int col = 0; col < 4; ++col)
+			{
+				if (a.m[row][col] != b.m[row][col])  return false;
+			}
+		}
+		return true;
+	}
+
+	const ColourTransform Identity = { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 } } };
+
+	inline ColourRGBA Apply(const ColourTransform& t, const ColourRGBA& c)
+	{
+		return { t.m[0][0] * c.r + t.m[0][1] * c.g + t.m[0][2] * c.b + t.m[0][3],
+		         t.m[1][0] * c.r + t.m[1][1] * c.g + t.m[1][2] * c.b + t.m[1][3],
+		         t.m[2][0] * c.r + t.m[2][1] * c.g + t.m[2][2] * c.b + t.m[2][3], 1.0f };
+	}
+}
+
+
+// Number of passes from the given one that can run as one chain, 0 if the pass should run by itself
+int PointOpChainLength(const PostProcessStack& stack, int first)
+{
+	if (stack[first].second != PostProcessMode::Fullscreen)  return 0;
+	if (!IsChainHead(stack[first].first) && !IsColourTransform(stack[first].first))  return 0;
+
+	int last = first + 1;
+	while (last < static_cast<int>(stack.size()) && stack[last].second == PostProcessMode::Fullscreen &&
+	       IsColourTransform(stack[last].first))
+	{
+		++last;
+	}
+
+	// NightVision or GameBoy by themselves gain nothing
+	if (last == first + 1 && IsChainHead(stack[first].first))  return 0;
+	return last - first;
+}
+
+
+//--------------------------------------------------------------------------------------
+// PointOpChain
+//--------------------------------------------------------------------------------------
+
+// Start a new chain with the given post-process
+void PointOpChain::Begin(PostProcess postProcess, const PostProcessingConstants& constants)
+{
+	mTop.clear();
+	mBottom.clear();
+	if (IsChainHead(postProcess))
+	{
+		mHead = postProcess;
+		mHeadConstants = constants;
+	}
+	else
+	{
+		mHead = PostProcess::None;
+		Add(postProcess, constants);
+	}
+}
+
+
+// Add a colour transform post-process to the end of the chain
+void PointOpChain::Add(PostProcess postProcess, const PostProcessingConstants& constants)
+{
+	ColourTransform top, bottom;
+	GetColourTransform(postProcess, constants, true,  top);
+	GetColourTransform(postProcess, constants, false, bottom);
+	mTop.push_back(top);
+	mBottom.push_back(bottom);
+}
+
+
+// Number of transforms at the start of the chain that are the same for every row
+int PointOpChain::RowInvariantTransforms() const
+{
+	int count = 0;
+	while (count < static_cast<int>(mTop.size()) && SameTransform(mTop[count], mBottom[count]))  ++count;
+	return count;
+}
+
+
+// Combined transform of the given transforms, at the given height (0 = top, 1 = bottom)
+ColourTransform PointOpChain::Combined(int first, int count, float v) const
+{
+	ColourTransform transform = Identity;
+	for (int i = first; i < first + count; ++i)  transform = CombineColourTransforms(transform, Lerp(mTop[i], mBottom[i], v));
+	return transform;
+}
+
+
+// Bake the lookup table if needed, call before RunRows
+void PointOpChain::Prepare(int lutSize)
+{
+	// Bake the row-invariant part of the chain if it has changed since the table was last baked
+	int numInvariant = RowInvariantTransforms();
+	mUsedLut = lutSize != 0 && numInvariant > 0;
+	if (mUsedLut)
+	{
+		std::vector<ColourTransform> invariant(mTop.begin(), mTop.begin() + numInvariant);
+		if (mLut.Size() != lutSize || invariant.size() != mLutTransforms.size() ||
+		    !std::equal(invariant.begin(), invariant.end(), mLutTransforms.begin(), SameTransform))
+		{
+			ColourTransform transform = Combined(0, numInvariant, 0);
+			mLut.Bake(lutSize, [&](const ColourRGBA& colour) { return Apply(transform, colour); });
+			mLutTransforms = invariant;
+		}
+	}
+}
+
+
+// Run the chain over the scene texture of the inputs into the target
+void PointOpChain::Run(ThreadPool& threadPool, const PostProcessInputs& inputs, Image& target, int lutSize)
+{
+	Prepare(lutSize);
+	RunRows(threadPool, inputs, target, 0, target.Height());
+}
+
+
+// Run the chain over the given rows
+void PointOpChain::RunRows(ThreadPool& threadPool, const PostProcessInputs& inputs, Image& target, int top, int bottom)
+{
+	const Image& scene = *inputs.sceneTexture;
+	int width = target.Width();
+
+	// UVs are worked out exactly as ShadeFullScreenRect does for the separate passes, so the head shader's choices that depend
+	// on position (e.g. GameBoy's blocks) are the same
+	float invWidth  = 1.0f / target.Width();
+	float invHeight = 1.0f / target.Height();
+
+	PostProcessInputs headInputs = inputs;
+	headInputs.constants = &mHeadConstants;
+	PixelShaderFunction headShader = GetPixelShader(mHead);
+
+	int firstPerRow = mUsedLut ? static_cast<int>(mLutTransforms.size()) : 0;
+	int numPerRow   = static_cast<int>(mTop.size()) - firstPerRow;
+
+	// Fewer rows per job when there are only a few rows, so they are still spread over the threads
+	int numThreads = static_cast<int>(threadPool.NumThreads());
+	int rowsPerJob = std::max(std::min(RowsPerJob, (bottom - top) / numThreads), 1);
+	int numJobs = (bottom - top + rowsPerJob - 1) / rowsPerJob;
+	threadPool.ParallelFor(numJobs, [&](int job)
+	{
+		int jobTop    = top + job * rowsPerJob;
+		int jobBottom = std::min(jobTop + rowsPerJob, bottom);
+		for (int y = jobTop; y < jobBottom; ++y)
+		{
+			CVector2 uv;
+			uv.y = (y + 0.5f) * invHeight;
+
+			// The chain (or the part not in the table) as one transform for this row
+			ColourTransform transform = Combined(firstPerRow, numPerRow, uv.y);
+
+			const ColourRGBA* in = scene.Row(y);
+			ColourRGBA* out = target.Row(y);
+			for (int x = 0; x < width; ++x)
+			{
+				ColourRGBA colour;
+				if (mHead == PostProcess::None)
+				{
+					colour = in[x];
+				}
+				else
+				{
+					uv.x = (x + 0.5f) * invWidth;
+					colour = headShader(headInputs, uv, uv);
+				}
+				if (mUsedLut)        colour = mLut.Lookup(colour);
+				if (numPerRow != 0)  colour = Apply(transform, colour);
+				out[x] = colour;
+				out[x].a = 1.0f;
+			}
+		}
+	});
+}
+
+
+// Largest error of the lookup table against the transforms it replaces
+float PointOpChain::LutMaxError(float maxInput) const
+{
+	if (!mUsedLut)  return 0.0f;
+	ColourTransform transform = Combined(0, static_cast<int>(mLutTransforms.size()), 0);
+	return mLut.MaxError([&](const ColourRGBA& colour) { return Apply(transform, colour); }, maxInput);
+}
@@ -0,0 +1,76 @@
+//--------------------------------------------------------------------------------------
+// Fusion of colour-only post-processes for CPU images
+//--------------------------------------------------------------------------------------
+// Sepia, Inverted, Tint and the vertical colour gradients only change the colour of each pixel,
+// using nothing but the pixel's colour and its row. Each one is an affine colour transform (see
+// GetColourTransform), so a chain of them combines into one transform per row and the chain runs
+// as a single pass that reads and writes each pixel once. The chain may start with NightVision or
+// GameBoy, which read a few nearby pixels but otherwise only work on colour.
+// The part of the chain before the first vertical gradient is the same for every row and can
+// instead be baked into a 3D lookup table, rebaked only when it changes. The table gives the same
+// results as the transform for these post-processes (they are all affine), so it is off by default
+// and kept for colour functions that are not. Code in .cpp file
+
+#ifndef _POINT_OP_FUSION_H_INCLUDED_
+#define _POINT_OP_FUSION_H_INCLUDED_
+
+#include "ColourLut.h"
+#include "Image.h"
+#include "PostProcess.h"
+#include "PostProcessShaders.h"
+#include "ThreadPool.h"
+
+#include <vector>
+
+
+// Number of passes from the given one that can run as one chain, 0 if the pass should run by itself. A colour transform
+// on its own is a chain of one, which avoids repeating work in every pixel that only depends on the constants (such as
+// the HSL conversions of HueVerticalColourGradient)
+int PointOpChainLength(const PostProcessStack& stack, int first);
+
+
+// A chain of full-screen passes compiled into a single pass
+class PointOpChain
+{
+public:
+	// Start a new chain with the given post-process, using the constants as they are when it would run
+	void Begin(PostProcess postProcess, const PostProcessingConstants& constants);
+
+	// Add a colour transform post-process to the end of the chain, using the constants as they are when it would run
+	void Add(PostProcess postProcess, const PostProcessingConstants& constants);
+
+	// Run the chain over the scene texture of the inputs into the target (same size, must be a different image). If lutSize
+	// is not 0 the part of the chain that is the same for every row is looked up in a table of that size
+	void Run(ThreadPool& threadPool, const PostProcessInputs& inputs, Image& target, int lutSize);
+
+	// Run the chain over part of the image in two steps, as used when the chain is part of a tile-fused group (see TileFusion.h).
+	// Call Prepare once after the chain is built (lutSize as for Run), then RunRows for rows top->bottom-1 as often as needed
+	void Prepare(int lutSize);
+	void RunRows(ThreadPool& threadPool, const PostProcessInputs& inputs, Image& target, int top, int bottom);
+
+	// Largest error of the lookup table against the transforms it replaces for colours 0->maxInput, 0 if the last run
+	// did not use a table
+	float LutMaxError(float maxInput) const;
+
+private:
+	// Number of transforms at the start of the chain that are the same for every row
+	int RowInvariantTransforms() const;
+
+	// Combined transform of the first count transforms, at the given height (0 = top, 1 = bottom)
+	ColourTransform Combined(int first, int count, float v) const;
+
+	PostProcess             mHead = PostProcess::None; // Post-process that reads the scene (NightVision or GameBoy), None to read pixels directly
+	PostProcessingConstants mHeadConstants;
+
+	// Colour transforms in the order they are applied, at the top and bottom of the screen
+	std::vector<ColourTransform> mTop;
+	std::vector<ColourTransform> mBottom;
+
+	// Table for the row-invariant part of the chain, and the transforms it was baked from
+	ColourLut                    mLut;
+	std::vector<ColourTransform> mLutTransforms;
+	bool                         mUsedLut = false;
+};
+
+
+#endif //_POINT_OP_FUSION_H_INCLUDED_
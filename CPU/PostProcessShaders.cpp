@@ -0,0 +1,716 @@
+//--------------------------------------------------------------------------------------
+// CPU versions of the post-processing pixel shaders (the *_pp.hlsl files)
+//--------------------------------------------------------------------------------------
+// Each post-process is ported line-for-line from its shader so the CPU pipeline gives the same
+// results as the GPU. Oddities in the shaders are kept deliberately (commented where they occur).
+// MotionBlur is the exception, it uses the velocity buffer in place of the previous frame
+
+#include "PostProcessShaders.h"
+#include "MathHelpers.h"
+#include "MotionBlur.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+//--------------------------------------------------------------------------------------
+// Shader helpers
+//--------------------------------------------------------------------------------------
+namespace
+{
+	// Equivalent of texture.Sample(PointSample, uv). A missing texture returns black like an unbound texture does on the GPU
+	inline ColourRGBA SamplePoint(const Image* texture, CVector2 uv)
+	{
+		if (texture == nullptr)  return { 0, 0, 0, 0 };
+		return texture->SamplePoint(uv);
+	}
+
+	// Equivalent of texture.Sample(TrilinearWrap, uv)
+	inline ColourRGBA SampleWrap(const Image* texture, CVector2 uv)
+	{
+		if (texture == nullptr)  return { 0, 0, 0, 0 };
+		return texture->SampleBilinearWrap(uv);
+	}
+
+	inline CVector2 Offset(CVector2 uv, float x, float y)  { return { uv.x + x, uv.y + y }; }
+
+	// Soft-edged circular alpha used by the area effects (GreyNoise, Spiral, HeatHaze)
+	inline float CircleAlpha(CVector2 areaUV, float softEdge)
+	{
+		float cx = areaUV.x - 0.5f;
+		float cy = areaUV.y - 0.5f;
+		float centreLengthSq = cx * cx + cy * cy;
+		return 1.0f - Saturate((centreLengthSq - 0.25f + softEdge) / softEdge);
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Pixel shaders
+	//--------------------------------------------------------------------------------------
+
+	ColourRGBA CopyShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		colour.a = 1.0f;
+		return colour;
+	}
+
+
+	ColourRGBA TintShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		return { colour.r, 0.0f, 0.0f, 1.0f };
+	}
+
+
+	ColourRGBA NightVisionShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		// Scalar added to a float2 UV in the shader, so both u and v are offset
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		colour += SamplePoint(in.sceneTexture, Offset(sceneUV, 0.001f, 0.001f));
+		colour += SamplePoint(in.sceneTexture, Offset(sceneUV, 0.002f, 0.002f));
+		colour += SamplePoint(in.sceneTexture, Offset(sceneUV, 0.003f, 0.003f));
+		if ((colour.r + colour.g + colour.b) / 3 < 0.9f)
+		{
+			colour = colour / 4;
+		}
+		return { 0.0f, (colour.r + colour.g + colour.b) / 3, 0.0f, 1.0f };
+	}
+
+
+	ColourRGBA VerticalColourGradientShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const PostProcessingConstants& c = *in.constants;
+		float t = sceneUV.y;
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		return { colour.r * Lerp(c.topColour.x, c.bottomColour.x, t),
+		         colour.g * Lerp(c.topColour.y, c.bottomColour.y, t),
+		         colour.b * Lerp(c.topColour.z, c.bottomColour.z, t), 1.0f };
+	}
+
+
+	// Gaussian blur, 9 taps in one direction. The horizontal shader scales its offsets by the blur amount and divides by
+	// the viewport width, the vertical shader the same with the height
+	const float GaussianWeights[5] = { 0.2270270270f, 0.1945945946f, 0.1216216216f, 0.0540540541f, 0.0162162162f };
+
+	template <bool Horizontal>
+	ColourRGBA GaussianBlurShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		float step = in.constants->blurAmount / (Horizontal ? in.viewportWidth : in.viewportHeight);
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV) * GaussianWeights[0];
+		for (int i = 1; i < 5; ++i)
+		{
+			float offset = i * step;
+			CVector2 normalizedOffset = Horizontal ? CVector2{ offset, 0.0f } : CVector2{ 0.0f, offset };
+			colour += SamplePoint(in.sceneTexture, sceneUV + normalizedOffset) * GaussianWeights[i] +
+			          SamplePoint(in.sceneTexture, sceneUV - normalizedOffset) * GaussianWeights[i];
+		}
+		colour.a = 1.0f;
+		return colour;
+	}
+
+
+	ColourRGBA UnderWaterShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2 areaUV)
+	{
+		const float effectStrength = 0.01f;
+		float timer = in.constants->underWaterTimer;
+		float sinX = std::sin(areaUV.x * 2 * PI + timer * 3.0f);
+		float sinY = std::sin(areaUV.y * 2 * PI + timer * 3.7f);
+		ColourRGBA colour = SamplePoint(in.sceneTexture, Offset(sceneUV, sinY * effectStrength, sinX * effectStrength));
+		return { 0.0f, colour.g * 0.6f, colour.b * 0.8f, 1.0f };
+	}
+
+
+	// HSL conversions from HueVerticalColourGradient_pp.hlsl
+	const float HueEpsilon = 1e-10f;
+
+	CVector3 RGBtoHCV(CVector3 rgb)
+	{
+		float px, py, pz, pw;
+		if (rgb.y < rgb.z) { px = rgb.z; py = rgb.y; pz = -1.0f; pw = 2.0f / 3.0f; }
+		else               { px = rgb.y; py = rgb.z; pz =  0.0f; pw = -1.0f / 3.0f; }
+		float qx, qy, qz, qw;
+		if (rgb.x < px) { qx = px;    qy = py; qz = pw; qw = rgb.x; }
+		else            { qx = rgb.x; qy = py; qz = pz; qw = px; }
+		float c = qx - std::min(qw, qy);
+		float h = std::abs((qw - qy) / (6 * c + HueEpsilon) + qz);
+		return { h, c, qx };
+	}
+
+	CVector3 RGBtoHSL(CVector3 rgb)
+	{
+		CVector3 hcv = RGBtoHCV(rgb);
+		float l = hcv.z - hcv.y * 0.5f;
+		float s = hcv.y / (1 - std::abs(l * 2 - 1) + HueEpsilon);
+		return { hcv.x, s, l };
+	}
+
+	CVector3 HSLtoRGB(CVector3 hsl)
+	{
+		float r = Saturate(std::abs(hsl.x * 6 - 3) - 1);
+		float g = Saturate(2 - std::abs(hsl.x * 6 - 2));
+		float b = Saturate(2 - std::abs(hsl.x * 6 - 4));
+		float c = (1 - std::abs(2 * hsl.z - 1)) * hsl.y;
+		return { (r - 0.5f) * c + hsl.z, (g - 0.5f) * c + hsl.z, (b - 0.5f) * c + hsl.z };
+	}
+
+	CVector3 ShiftHue(CVector3 startingColour, float elapsedTime, float period)
+	{
+		CVector3 hsl = RGBtoHSL(startingColour);
+		float t = elapsedTime + hsl.x * period;
+		hsl.x = (t - std::floor(t / period) * period) / period;
+		return HSLtoRGB(hsl);
+	}
+
+	ColourRGBA HueVerticalColourGradientShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		// The shader recalculates the shifted colours for every pixel although they only depend on the constants
+		const PostProcessingConstants& c = *in.constants;
+		CVector3 top    = ShiftHue(c.topColour,    c.elapsedTime, c.period);
+		CVector3 bottom = ShiftHue(c.bottomColour, c.elapsedTime, c.period);
+		float t = sceneUV.y;
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		return { colour.r * Lerp(top.x, bottom.x, t), colour.g * Lerp(top.y, bottom.y, t), colour.b * Lerp(top.z, bottom.z, t), 1.0f };
+	}
+
+
+	ColourRGBA SepiaShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		ColourRGBA c = SamplePoint(in.sceneTexture, sceneUV);
+		return { c.r * 0.393f + c.g * 0.769f + c.b * 0.189f,
+		         c.r * 0.349f + c.g * 0.686f + c.b * 0.168f,
+		         c.r * 0.272f + c.g * 0.534f + c.b * 0.131f, 1.0f };
+	}
+
+
+	ColourRGBA InvertedShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		ColourRGBA c = SamplePoint(in.sceneTexture, sceneUV);
+		return { 1.0f - c.r, 1.0f - c.g, 1.0f - c.b, 1.0f };
+	}
+
+
+	ColourRGBA ContourShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const float sobelX[3][3] = { { -1, 0, 1 }, { -2, 0, 2 }, { -1, 0, 1 } };
+		const float sobelY[3][3] = { { -1, -2, -1 }, { 0, 0, 0 }, { 1, 2, 1 } };
+		float texelWidth  = 1.0f / in.viewportWidth;
+		float texelHeight = 1.0f / in.viewportHeight;
+
+		float gx = 0;
+		float gy = 0;
+		for (int i = -1; i <= 1; ++i)
+		{
+			for (int j = -1; j <= 1; ++j)
+			{
+				ColourRGBA colour = SamplePoint(in.sceneTexture, Offset(sceneUV, i * texelWidth, j * texelHeight));
+				float gray = (colour.r + colour.g + colour.b) / 3.0f;
+				gx += sobelX[i + 1][j + 1] * gray;
+				gy += sobelY[i + 1][j + 1] * gray;
+			}
+		}
+
+		// The shader holds the gray values in a float3, so dot(gx, gx) is three times the squared value
+		float gxMag = 3 * gx * gx;
+		float gyMag = 3 * gy * gy;
+		float gradientMag = std::sqrt(gxMag * gxMag + gyMag * gyMag);
+		return { gradientMag, gradientMag, gradientMag, 1.0f };
+	}
+
+
+	ColourRGBA GameBoyShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const float offset = 0.3f;
+		const float newTexelWidth  = 7 * (1.0f / in.viewportWidth);
+		const float newTexelHeight = 4 * (1.0f / in.viewportHeight);
+		CVector2 newCoord = { std::floor(sceneUV.x / newTexelWidth  + 0.5f) * newTexelWidth,
+		                      std::floor(sceneUV.y / newTexelHeight + 0.5f) * newTexelHeight };
+		ColourRGBA colour = SamplePoint(in.sceneTexture, newCoord);
+		float gray = (colour.r + colour.g + colour.b) / 3.0f;
+
+		if (gray > offset * 1.5f)  return { 0.505f, 0.529f, 0.407f, 1.0f };
+		if (gray > offset)         return { 0.294f, 0.313f, 0.247f, 1.0f };
+		if (gray > offset * 0.5f)  return { 0.152f, 0.172f, 0.145f, 1.0f };
+		return { 0.070f, 0.090f, 0.086f, 1.0f };
+	}
+
+
+	// Bright pass. The shader also calculates a "soft" levels adjustment that is never used, so it is left out here
+	ColourRGBA BloomShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		ColourRGBA t = SamplePoint(in.sceneTexture, sceneUV);
+		float l = t.r * 0.299f + t.g * 0.587f + t.b * 0.114f;
+		float v = Saturate(SmoothStep(0.56f, 0.63f, l) - 0.9997f);
+		return { v, v, v, v };
+	}
+
+
+	ColourRGBA MergeTexturesShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const float gamma = 2.2f;
+		ColourRGBA hdrColour   = SamplePoint(in.sceneTexture, sceneUV);
+		ColourRGBA bloomColour = SamplePoint(in.sharpTexture, sceneUV);
+
+		auto merge = [gamma](float hdr, float bloom)
+		{
+			hdr   = std::pow(hdr   / (hdr   + 1.0f), 1.0f / gamma);
+			bloom = std::pow(bloom / (bloom + 1.0f), 1.0f / gamma);
+			return std::pow(hdr + bloom, gamma);
+		};
+		return { merge(hdrColour.r, bloomColour.r), merge(hdrColour.g, bloomColour.g), merge(hdrColour.b, bloomColour.b), 1.0f };
+	}
+
+
+	ColourRGBA DilationShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const float brightnessThreshold = 0.5f;
+		float texelWidth  = 1.0f / in.viewportWidth;
+		float texelHeight = 1.0f / in.viewportHeight;
+
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		float centreBrightness = colour.r * 0.2126f + colour.g * 0.7152f + colour.b * 0.0722f;
+		float dilationFactor = (centreBrightness > brightnessThreshold) ? 1.0f : 2.0f;
+
+		ColourRGBA dilated = SamplePoint(in.sceneTexture, Offset(sceneUV, texelWidth, 0));
+		for (CVector2 uv : { Offset(sceneUV, -texelWidth, 0), Offset(sceneUV, 0, texelHeight), Offset(sceneUV, 0, -texelHeight) })
+		{
+			ColourRGBA neighbour = SamplePoint(in.sceneTexture, uv);
+			dilated.r = std::max(dilated.r, neighbour.r);
+			dilated.g = std::max(dilated.g, neighbour.g);
+			dilated.b = std::max(dilated.b, neighbour.b);
+		}
+
+		return { colour.r + dilationFactor * (dilated.r - colour.r),
+		         colour.g + dilationFactor * (dilated.g - colour.g),
+		         colour.b + dilationFactor * (dilated.b - colour.b), 1.0f };
+	}
+
+
+	// Dual filtering down/up sample. The shader builds the half-pixel offset from (height, width) rather than
+	// (width, height), kept here for identical results. Alpha is filtered too
+	ColourRGBA DualFilteringShader(const PostProcessInputs& in, CVector2 uv, CVector2)
+	{
+		const Image* scene = in.sceneTexture;
+		if (in.constants->dualFilterIteration < 4)
+		{
+			float hx = 0.5f / (in.viewportHeight / 2.0f);
+			float hy = 0.5f / (in.viewportWidth  / 2.0f);
+			ColourRGBA sum = SamplePoint(scene, uv) * 4.0f;
+			sum += SamplePoint(scene, Offset(uv, -hx, -hy));
+			sum += SamplePoint(scene, Offset(uv,  hx,  hy));
+			sum += SamplePoint(scene, Offset(uv,  hx, -hy));
+			sum += SamplePoint(scene, Offset(uv, -hx,  hy));
+			return sum / 8.0f;
+		}
+		else
+		{
+			float hx = 0.5f / (in.viewportHeight * 2.0f);
+			float hy = 0.5f / (in.viewportWidth  * 2.0f);
+			ColourRGBA sum = SamplePoint(scene, Offset(uv, -hx * 2, 0));
+			sum += SamplePoint(scene, Offset(uv, -hx,  hy)) * 2.0f;
+			sum += SamplePoint(scene, Offset(uv,   0,  hy * 2));
+			sum += SamplePoint(scene, Offset(uv,  hx,  hy)) * 2.0f;
+			sum += SamplePoint(scene, Offset(uv,  hx * 2, 0));
+			sum += SamplePoint(scene, Offset(uv,  hx, -hy)) * 2.0f;
+			sum += SamplePoint(scene, Offset(uv,   0, -hy * 2));
+			sum += SamplePoint(scene, Offset(uv, -hx, -hy)) * 2.0f;
+			return sum / 12.0f;
+		}
+	}
+
+
+	// Depth of field. The near/far clip distances are hard-coded in the shader (not the camera's values)
+	ColourRGBA DepthOfFieldShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const float piTimes2 = 6.28318530718f;
+		const float directions = 24.0f;
+		const float quality = 4.0f;
+		const float size = 10.0f;
+		const float nearClip = 1.0f;
+		const float farClip = 20000.0f;
+
+		ColourRGBA unblurred = SamplePoint(in.sharpTexture, sceneUV);
+		float depth = SamplePoint(in.depthTexture, sceneUV).r;
+		float distanceToPixel = (2.0f * nearClip * farClip) / (farClip + nearClip - depth * (farClip - nearClip));
+
+		float focus = in.constants->distanceToFocusedObject;
+		float x = Saturate(std::abs(distanceToPixel - focus) / focus);
+		x = std::max(1.0f - x, 0.0f);
+		x = 1.0f - std::pow(x, 1.0f / 10.0f);
+		float radiusX = size / in.viewportWidth  * x;
+		float radiusY = size / in.viewportHeight * x;
+
+		// Loops step with floats exactly as the shader does so the number of taps matches. Divided by 81 rather than the tap count, as in the shader
+		ColourRGBA blurred = unblurred;
+		for (float d = 0.0f; d < piTimes2; d += piTimes2 / directions)
+		{
+			float dirX = std::cos(d) * radiusX;
+			float dirY = std::sin(d) * radiusY;
+			for (float i = 1.0f / quality; i <= 1.0f; i += 1.0f / quality)
+			{
+				blurred += SamplePoint(in.sharpTexture, Offset(sceneUV, dirX * i, dirY * i));
+			}
+		}
+		blurred = blurred / (quality * directions - 15.0f);
+		blurred.a = 1.0f;
+		return blurred;
+	}
+
+
+	// One direction of the Kawase light streak, only the channel selected by the channel mask in the shader is calculated
+	inline float KawaseStreak(const Image* source, CVector2 uv, float pixelWidth, float pixelHeight, float dirX, float dirY,
+	                          int channel, int iteration)
+	{
+		const float attenuation = 0.98f;
+		const int samples = 4;
+		float b = std::pow(static_cast<float>(samples), static_cast<float>(iteration));
+		float out = 0;
+		for (int s = 0; s < samples; ++s)
+		{
+			float weight = Saturate(std::pow(attenuation, b * s));
+			float offsetX = dirX * b * s * pixelWidth;
+			float offsetY = dirY * b * s * pixelHeight;
+			ColourRGBA forward  = SamplePoint(source, Offset(uv,  offsetX,  offsetY));
+			ColourRGBA backward = SamplePoint(source, Offset(uv, -offsetX, -offsetY));
+			out += weight * ((&forward.r)[channel] + (&backward.r)[channel]);
+		}
+		return Saturate(out);
+	}
+
+	// Each iteration streaks the four directions into the four channels. The final iteration adds the four
+	// streaks together and screen-blends them over the sharp image (unused colouring code in the shader is left out)
+	ColourRGBA KawaseLightStreakShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		int iteration = in.constants->kawaseIter;
+		float pixelWidth  = 2.0f / in.viewportWidth;
+		float pixelHeight = 2.0f / in.viewportHeight;
+		float strH  = KawaseStreak(in.sceneTexture, sceneUV, pixelWidth, pixelHeight,  1.0f, 0.0f, 0, iteration);
+		float strV  = KawaseStreak(in.sceneTexture, sceneUV, pixelWidth, pixelHeight,  0.0f, 1.0f, 1, iteration);
+		float strD1 = KawaseStreak(in.sceneTexture, sceneUV, pixelWidth, pixelHeight,  1.0f, 1.0f, 2, iteration);
+		float strD2 = KawaseStreak(in.sceneTexture, sceneUV, pixelWidth, pixelHeight, -1.0f, 1.0f, 3, iteration);
+
+		if (iteration == 4)
+		{
+			float strC = strH + strV + strD1 + strD2;
+			ColourRGBA sharp = SamplePoint(in.sharpTexture, sceneUV);
+			return { 1.0f - (1.0f - sharp.r) * (1.0f - strC),
+			         1.0f - (1.0f - sharp.g) * (1.0f - strC),
+			         1.0f - (1.0f - sharp.b) * (1.0f - strC), 1.0f };
+		}
+		return { strH, strV, strD1, strD2 };
+	}
+
+
+	// Blurs along the velocity buffer (see MotionBlur.h) rather than the shader's colour difference between frames
+	ColourRGBA MotionBlurShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		if (!in.velocityTexture)  return SamplePoint(in.sceneTexture, sceneUV);
+		return MotionBlurPixel(*in.sceneTexture, *in.velocityTexture, sceneUV, MotionBlurAmount);
+	}
+
+
+	ColourRGBA GreyNoiseShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2 areaUV)
+	{
+		const float noiseStrength = 0.5f;
+		const PostProcessingConstants& c = *in.constants;
+		ColourRGBA sceneColour = SamplePoint(in.sceneTexture, sceneUV);
+		float grey = (sceneColour.r + sceneColour.g + sceneColour.b) / 3.0f;
+		CVector2 noiseUV = { sceneUV.x * c.noiseScale.x + c.noiseOffset.x, sceneUV.y * c.noiseScale.y + c.noiseOffset.y };
+		grey += noiseStrength * (SampleWrap(in.noiseMap, noiseUV).r - 0.5f);
+		return { grey, grey, grey, CircleAlpha(areaUV, 0.20f) };
+	}
+
+
+	ColourRGBA BurnShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2 areaUV)
+	{
+		const ColourRGBA burnColour = { 0.8f, 0.4f, 0.0f, 1.0f };
+		const ColourRGBA glowColour = { 1.0f, 0.8f, 0.0f, 1.0f };
+		const float glowAmount = 0.25f;
+		const float crinkle = 0.15f;
+
+		float burnHeight = in.constants->burnHeight;
+		ColourRGBA burnTexture = SampleWrap(in.burnMap, areaUV);
+		if (burnTexture.r <= burnHeight)
+		{
+			return { 0.0f, 0.0f, 0.0f, 1.0f };
+		}
+		if (burnTexture.r >= burnHeight + glowAmount)
+		{
+			ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+			colour.a = 1.0f;
+			return colour;
+		}
+
+		float glowLevel = 1.0f - (burnTexture.r - burnHeight) / glowAmount;
+		float crinkleX = burnTexture.g - 0.5f;
+		float crinkleY = burnTexture.b - 0.5f;
+		ColourRGBA texColour = SamplePoint(in.sceneTexture, Offset(sceneUV, -glowLevel * crinkle * crinkleX, -glowLevel * crinkle * crinkleY));
+		texColour.a = 1.0f;
+		glowLevel *= 2.0f;
+		if (glowLevel < 1.0f)
+		{
+			return texColour + (burnColour * texColour - texColour) * glowLevel;
+		}
+		return burnColour * texColour + (glowColour - burnColour * texColour) * (glowLevel - 1.0f);
+	}
+
+
+	ColourRGBA DistortShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2 areaUV)
+	{
+		const float lightStrength = 0.015f;
+		const float glassDarken = 0.8f;
+		const float distortLevel = 0.03f;
+
+		ColourRGBA distortTexture = SampleWrap(in.distortMap, areaUV);
+		float distortX = distortTexture.g - 0.5f;
+		float distortY = distortTexture.b - 0.5f;
+
+		// normalize() of a zero vector is undefined in the shader, treat it as no lighting
+		float length = std::sqrt(distortX * distortX + distortY * distortY);
+		float light = length > 0 ? (distortX + distortY) / length * 0.707f * lightStrength : 0.0f;
+
+		ColourRGBA colour = SamplePoint(in.sceneTexture, Offset(sceneUV, distortLevel * distortX, distortLevel * distortY));
+		return { light + colour.r * glassDarken, light + colour.g * glassDarken, light + colour.b * glassDarken, 1.0f };
+	}
+
+
+	// The shader measures from the area centre in scene UVs but offsets from it in area UVs, so the spiral is only
+	// centred for areas at the top-left of the screen. Kept for identical results
+	ColourRGBA SpiralShader(const PostProcessInputs& in, CVector2, CVector2 areaUV)
+	{
+		const PostProcessingConstants& c = *in.constants;
+		CVector2 centreUV = { c.area2DTopLeft.x + c.area2DSize.x * 0.5f, c.area2DTopLeft.y + c.area2DSize.y * 0.5f };
+		float offsetX = areaUV.x - centreUV.x;
+		float offsetY = areaUV.y - centreUV.y;
+		float centreDistance = std::sqrt(offsetX * offsetX + offsetY * offsetY);
+		float s = std::sin(centreDistance * c.spiralLevel * c.spiralLevel);
+		float co = std::cos(centreDistance * c.spiralLevel * c.spiralLevel);
+
+		// Row vector multiplied by the matrix { c, s, -s, c }
+		CVector2 rotatedUV = { centreUV.x + offsetX * co - offsetY * s, centreUV.y + offsetX * s + offsetY * co };
+		ColourRGBA colour = SamplePoint(in.sceneTexture, rotatedUV);
+		colour.a = CircleAlpha(areaUV, 0.10f);
+		return colour;
+	}
+
+
+	ColourRGBA HeatHazeShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2 areaUV)
+	{
+		const float effectStrength = 0.01f;
+		const PostProcessingConstants& c = *in.constants;
+		float alpha = CircleAlpha(areaUV, 0.15f);
+		float sinX = std::sin(areaUV.x * 8 * PI + c.heatHazeTimer * 3.0f);
+		float sinY = std::sin(areaUV.y * 20 * PI + c.heatHazeTimer * 3.7f);
+		CVector2 hazeOffset = { sinY * effectStrength * alpha * c.area2DSize.x, sinX * effectStrength * alpha * c.area2DSize.y };
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV + hazeOffset);
+		colour.a = alpha * Saturate(sinX * sinY * 0.33f + 0.66f);
+		return colour;
+	}
+
+
+	ColourRGBA ColourMatrixShader(const PostProcessInputs& in, CVector2 sceneUV, CVector2)
+	{
+		const PostProcessingConstants& c = *in.constants;
+		ColourRGBA colour = SamplePoint(in.sceneTexture, sceneUV);
+		for (int i = 0; i < c.numColourTransforms; ++i)
+		{
+			// Each row of the transform is interpolated from the top to the bottom of the screen
+			float result[3];
+			for (int row = 0; row < 3; ++row)
+			{
+				const CVector4& top    = c.colourTransformTop   [i * 3 + row];
+				const CVector4& bottom = c.colourTransformBottom[i * 3 + row];
+				result[row] = (top.x + (bottom.x - top.x) * sceneUV.y) * colour.r + (top.y + (bottom.y - top.y) * sceneUV.y) * colour.g +
+				              (top.z + (bottom.z - top.z) * sceneUV.y) * colour.b + (top.w + (bottom.w - top.w) * sceneUV.y);
+			}
+			colour.r = result[0];
+			colour.g = result[1];
+			colour.b = result[2];
+		}
+		colour.a = 1.0f;
+		return colour;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Full screen shading
+	//--------------------------------------------------------------------------------------
+
+	// Run a pixel shader over a rectangle of the target. The shader is a template parameter so it is inlined into the loop
+	template <PixelShaderFunction Shader>
+	void ShadeFullScreenRect(const PostProcessInputs& inputs, Image& target, const PixelRect& rect)
+	{
+		float invWidth  = 1.0f / target.Width();
+		float invHeight = 1.0f / target.Height();
+		for (int y = rect.top; y < rect.bottom; ++y)
+		{
+			ColourRGBA* row = target.Row(y);
+			CVector2 uv;
+			uv.y = (y + 0.5f) * invHeight;
+			for (int x = rect.left; x < rect.right; ++x)
+			{
+				uv.x = (x + 0.5f) * invWidth;
+				row[x] = Shader(inputs, uv, uv);
+			}
+		}
+	}
+
+
+	struct ShaderEntry
+	{
+		PixelShaderFunction      pixelShader;
+		FullScreenShaderFunction fullScreenShader;
+	};
+
+	template <PixelShaderFunction Shader>
+	constexpr ShaderEntry MakeShaderEntry()  { return { Shader, &ShadeFullScreenRect<Shader> }; }
+
+	ShaderEntry GetShaderEntry(PostProcess postProcess)
+	{
+		switch (postProcess)
+		{
+			case PostProcess::NightVision:               return MakeShaderEntry<NightVisionShader>();
+			case PostProcess::VerticalColourGradient:    return MakeShaderEntry<VerticalColourGradientShader>();
+			case PostProcess::GaussianBlurHorizontal:    return MakeShaderEntry<GaussianBlurShader<true>>();
+			case PostProcess::GaussianBlurVertical:      return MakeShaderEntry<GaussianBlurShader<false>>();
+			case PostProcess::UnderWater:                return MakeShaderEntry<UnderWaterShader>();
+			case PostProcess::HueVerticalColourGradient: return MakeShaderEntry<HueVerticalColourGradientShader>();
+			case PostProcess::Sepia:                     return MakeShaderEntry<SepiaShader>();
+			case PostProcess::Inverted:                  return MakeShaderEntry<InvertedShader>();
+			case PostProcess::Contour:                   return MakeShaderEntry<ContourShader>();
+			case PostProcess::GameBoy:                   return MakeShaderEntry<GameBoyShader>();
+			case PostProcess::Bloom:                     return MakeShaderEntry<BloomShader>();
+			case PostProcess::MergeTextures:             return MakeShaderEntry<MergeTexturesShader>();
+			case PostProcess::Dilation:                  return MakeShaderEntry<DilationShader>();
+			case PostProcess::DualFiltering:             return MakeShaderEntry<DualFilteringShader>();
+			case PostProcess::DepthOfField:              return MakeShaderEntry<DepthOfFieldShader>();
+			case PostProcess::KawaseLightStreak:         return MakeShaderEntry<KawaseLightStreakShader>();
+			case PostProcess::MotionBlur:                return MakeShaderEntry<MotionBlurShader>();
+			case PostProcess::Tint:                      return MakeShaderEntry<TintShader>();
+			case PostProcess::GreyNoise:                 return MakeShaderEntry<GreyNoiseShader>();
+			case PostProcess::Burn:                      return MakeShaderEntry<BurnShader>();
+			case PostProcess::Distort:                   return MakeShaderEntry<DistortShader>();
+			case PostProcess::Spiral:                    return MakeShaderEntry<SpiralShader>();
+			case PostProcess::HeatHaze:                  return MakeShaderEntry<HeatHazeShader>();
+			case PostProcess::ColourMatrix:              return MakeShaderEntry<ColourMatrixShader>();
+			default:                                     return MakeShaderEntry<CopyShader>();
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shader lookup
+//--------------------------------------------------------------------------------------
+
+// Return the CPU pixel shader for a post-process. PostProcess::None uses the copy shader
+PixelShaderFunction GetPixelShader(PostProcess postProcess)
+{
+	return GetShaderEntry(postProcess).pixelShader;
+}
+
+// Return the CPU full-screen shader for a post-process. PostProcess::None uses the copy shader
+FullScreenShaderFunction GetFullScreenShader(PostProcess postProcess)
+{
+	return GetShaderEntry(postProcess).fullScreenShader;
+}
+
+
+// Get the colour transform of a post-process that only changes the colour of each pixel at the top or bottom of the screen.
+// These must match the shaders above
+bool GetColourTransform(PostProcess postProcess, const PostProcessingConstants& constants, bool top, ColourTransform& transform)
+{
+	// Colour multiplied by a gradient, as in the vertical colour gradient shaders
+	auto gradient = [&](CVector3 colour)
+	{
+		transform = { { { colour.x, 0, 0, 0 }, { 0, colour.y, 0, 0 }, { 0, 0, colour.z, 0 } } };
+	};
+
+	switch (postProcess)
+	{
+		case PostProcess::Sepia:
+			transform = { { { 0.393f, 0.769f, 0.189f, 0 }, { 0.349f, 0.686f, 0.168f, 0 }, { 0.272f, 0.534f, 0.131f, 0 } } };
+			return true;
+
+		case PostProcess::Inverted:
+			transform = { { { -1, 0, 0, 1 }, { 0, -1, 0, 1 }, { 0, 0, -1, 1 } } };
+			return true;
+
+		case PostProcess::Tint:
+			transform = { { { 1, 0, 0, 0 }, { 0, 0, 0, 0 }, { 0, 0, 0, 0 } } };
+			return true;
+
+		case PostProcess::VerticalColourGradient:
+			gradient(top ? constants.topColour : constants.bottomColour);
+			return true;
+
+		case PostProcess::HueVerticalColourGradient:
+			gradient(ShiftHue(top ? constants.topColour : constants.bottomColour, constants.elapsedTime, constants.period));
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+
+// Transform that applies first then second
+ColourTransform CombineColourTransforms(const ColourTransform& first, const ColourTransform& second)
+{
+	ColourTransform result;
+	for (int row = 0; row < 3; ++row)
+	{
+		for (int col = 0; col < 4; ++col)
+		{
+			float sum = (col == 3) ? second.m[row][3] : 0.0f;
+			for (int i = 0; i < 3; ++i)  sum += second.m[row][i] * first.m[i][col];
+			result.m[row][col] = sum;
+		}
+	}
+	return result;
+}
+
+
+// Set the constants of a ColourMatrix pass standing for the given colour transforms. A gradient changes linearly down the
+// screen and multiplying it by transforms that don't change keeps it linear, so the top and bottom transforms of each
+// gradient can be combined with the constant transforms around it and still be interpolated in the shader
+void SetColourMatrixConstants(const std::vector<PostProcess>& postProcesses, PostProcessingConstants& constants, float frameTime,
+                              int viewportWidth, int viewportHeight)
+{
+	std::vector<ColourTransform> top, bottom; // Transforms to apply in order
+	bool lastRowVarying = false;              // Whether the last transform includes a gradient
+	for (PostProcess postProcess : postProcesses)
+	{
+		UpdatePostProcessConstants(postProcess, constants, frameTime, viewportWidth, viewportHeight);
+		ColourTransform transformTop, transformBottom;
+		GetColourTransform(postProcess, constants, true,  transformTop);
+		GetColourTransform(postProcess, constants, false, transformBottom);
+
+		bool rowVarying = IsRowVaryingColourTransform(postProcess);
+		if (top.empty() || (rowVarying && lastRowVarying))
+		{
+			top.push_back(transformTop);
+			bottom.push_back(transformBottom);
+			lastRowVarying = rowVarying;
+		}
+		else
+		{
+			top.back()    = CombineColourTransforms(top.back(),    transformTop);
+			bottom.back() = CombineColourTransforms(bottom.back(), transformBottom);
+			lastRowVarying = lastRowVarying || rowVarying;
+		}
+	}
+
+	// OptimisePostProcessStack keeps to the limit, anything more is left out
+	constants.numColourTransforms = std::min(static_cast<int>(top.size()), MAX_COLOUR_TRANSFORMS);
+	for (int i = 0; i < constants.numColourTransforms; ++i)
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			const float* t = top[i].m[row];
+			const float* b = bottom[i].m[row];
+			constants.colourTransformTop   [i * 3 + row] = { t[0], t[1], t[2], t[3] };
+			constants.colourTransformBottom[i * 3 + row] = { b[0], b[1], b[2], b[3] };
+		}
+	}
+}
@@ -0,0 +1,72 @@
+//--------------------------------------------------------------------------------------
+// CPU versions of the post-processing pixel shaders (the *_pp.hlsl files)
+//--------------------------------------------------------------------------------------
+// Each post-process is ported line-for-line from its shader so the CPU pipeline gives the same
+// results as the GPU. Code in .cpp file
+
+#ifndef _POST_PROCESS_SHADERS_H_INCLUDED_
+#define _POST_PROCESS_SHADERS_H_INCLUDED_
+
+#include "Image.h"
+#include "PostProcess.h"
+
+#include <vector>
+
+
+// Everything a post-process pixel shader can read. This is the CPU equivalent of the textures and
+// constant buffer that SelectPostProcessShaderAndTextures binds on the GPU. Unused textures can be
+// left as nullptr, sampling a missing texture returns black (as an unbound texture does on the GPU)
+struct PostProcessInputs
+{
+	const Image* sceneTexture    = nullptr; // t0 - output of the previous pass
+	const Image* sharpTexture    = nullptr; // The scene before Bloom/DepthOfField (the PreEffect history slot)
+	const Image* velocityTexture = nullptr; // Screen motion of each pixel since last frame in pixels (red/green), used by MotionBlur
+	const Image* depthTexture    = nullptr; // Depth buffer values (0->1) in the red channel (gShadowMap1SRV), used by DepthOfField
+	const Image* noiseMap        = nullptr; // Textures for GreyNoise, Burn and Distort
+	const Image* burnMap         = nullptr;
+	const Image* distortMap      = nullptr;
+
+	const PostProcessingConstants* constants = nullptr;
+	float viewportWidth  = 0;
+	float viewportHeight = 0;
+};
+
+
+// Shade one pixel. sceneUV is the position in the scene texture, areaUV the position in the area or polygon
+// being processed (same as sceneUV for full screen), exactly as received by the HLSL shaders
+using PixelShaderFunction = ColourRGBA(*)(const PostProcessInputs& inputs, CVector2 sceneUV, CVector2 areaUV);
+
+// Shade a rectangle of pixels of a full-screen pass into the target image. Faster than calling a PixelShaderFunction
+// for each pixel as the shader is inlined into the pixel loop
+using FullScreenShaderFunction = void(*)(const PostProcessInputs& inputs, Image& target, const PixelRect& rect);
+
+
+// An affine colour transform. Each output channel (red, green, blue) is a weighted sum of the input channels plus a constant
+struct ColourTransform
+{
+	float m[3][4]; // One row per output channel, the red, green and blue weights then the constant
+};
+
+
+// Return the CPU pixel shader for a post-process. PostProcess::None uses the copy shader
+PixelShaderFunction GetPixelShader(PostProcess postProcess);
+
+// Return the CPU full-screen shader for a post-process. PostProcess::None uses the copy shader
+FullScreenShaderFunction GetFullScreenShader(PostProcess postProcess);
+
+// Get the colour transform of a post-process that only changes the colour of each pixel (Sepia, Inverted, Tint and the
+// vertical colour gradients) at the top (top = true) or bottom of the screen. The vertical gradients change linearly from one
+// to the other, the others are the same everywhere. Returns false for post-processes that are not colour transforms
+bool GetColourTransform(PostProcess postProcess, const PostProcessingConstants& constants, bool top, ColourTransform& transform);
+
+// Transform that applies first then second
+ColourTransform CombineColourTransforms(const ColourTransform& first, const ColourTransform& second);
+
+// Set the constants of a ColourMatrix pass standing for the given colour transforms (see PostProcessExecutionPlan), updating
+// the constants for each of them as if they were run separately. Used by both the GPU and CPU pipelines. Transforms that are
+// the same everywhere are multiplied into their neighbours, each vertical gradient needs a transform of its own
+void SetColourMatrixConstants(const std::vector<PostProcess>& postProcesses, PostProcessingConstants& constants, float frameTime,
+                              int viewportWidth, int viewportHeight);
+
+
+#endif //_POST_PROCESS_SHADERS_H_INCLUDED_
@@ -0,0 +1,751 @@
+//--------------------------------------------------------------------------------------
+// Software rasterizer - renders triangle meshes into CPU images
+//--------------------------------------------------------------------------------------
+// Vertices are kept as VERTEX_FLOATS floats: the clip space position (x, y, z, w) followed by the
+// attributes (world position, world normal, uv), or just the position in depth-only frames. Clip
+// space is as D3D's: visible points have -w <= x,y <= w and 0 <= z <= w
+
+#include "Rasterizer.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+	// Size of the screen tiles triangles are binned into, in pixels. Each tile is one job for the thread pool
+	const int TileSize = 64;
+
+	// Size of the blocks in the depth hierarchy, in pixels. A tile is 8x8 blocks
+	const int BlockSize = 8;
+	const int BlocksPerTile = TileSize / BlockSize;
+
+	// Jobs when transforming vertices
+	const int VerticesPerJob = 1024;
+
+	// Screen positions are snapped to 1/256th of a pixel, the same precision as the GPU
+	const int SubPixelBits = 8;
+	const int SubPixels    = 1 << SubPixelBits;
+	const int HalfPixel    = SubPixels / 2;
+
+	// Floats per vertex, see top of file
+	const int VERTEX_FLOATS       = 4 + 8;
+	const int DEPTH_VERTEX_FLOATS = 4;
+
+	// Triangles are clipped to the near and far planes, and to a guard band at this many times the viewport size in x and y.
+	// Triangles poking out of the viewport inside the guard band are not clipped, the rasteriser skips their outside pixels,
+	// and the guard band keeps the fixed point screen positions in range for the 64-bit edge functions
+	const float GuardBand = 4.0f;
+	const int NUM_CLIP_PLANES = 6;
+
+	// Most vertices a triangle can have after clipping to all the planes, one more for each plane
+	const int MaxClipVertices = 3 + NUM_CLIP_PLANES;
+
+
+	// Signed distance of a clip space position from a clip plane, positive inside
+	float ClipDistance(int plane, const float* v)
+	{
+		switch (plane)
+		{
+			case 0:  return v[2];                    // Near, z >= 0
+			case 1:  return v[3] - v[2];             // Far, z <= w
+			case 2:  return v[0] + GuardBand * v[3]; // Left
+			case 3:  return GuardBand * v[3] - v[0]; // Right
+			case 4:  return v[1] + GuardBand * v[3]; // Bottom
+			default: return GuardBand * v[3] - v[1]; // Top
+		}
+	}
+
+	// Bit for each plane a clip space position is outside
+	unsigned int ClipOutcode(const float* v)
+	{
+		unsigned int outcode = 0;
+		for (int plane = 0; plane < NUM_CLIP_PLANES; ++plane)
+		{
+			if (ClipDistance(plane, v) < 0)  outcode |= 1u << plane;
+		}
+		return outcode;
+	}
+
+
+	// Clip a triangle to the view and call emit for each triangle that is left. Each vertex is a clip space position followed by
+	// its attributes, Floats in total
+	template <int Floats, typename Emit>
+	void ClipTriangle(const float* vertices[3], Emit emit)
+	{
+		unsigned int outcodes[3] = { ClipOutcode(vertices[0]), ClipOutcode(vertices[1]), ClipOutcode(vertices[2]) };
+		if (outcodes[0] & outcodes[1] & outcodes[2])  return; // All vertices outside the same plane
+		unsigned int clipPlanes = outcodes[0] | outcodes[1] | outcodes[2];
+		if (clipPlanes == 0)
+		{
+			emit(vertices);
+			return;
+		}
+
+		// Clip the triangle as a polygon against each plane it crosses in turn (Sutherland-Hodgman), ping-ponging between two lists
+		float polygons[2][MaxClipVertices][Floats];
+		int numVertices = 3;
+		for (int i = 0; i < 3; ++i)  std::copy(vertices[i], vertices[i] + Floats, polygons[0][i]);
+
+		int current = 0;
+		for (int plane = 0; plane < NUM_CLIP_PLANES; ++plane)
+		{
+			if (!(clipPlanes & (1u << plane)))  continue;
+
+			auto& input  = polygons[current];
+			auto& output = polygons[1 - current];
+			int numOutput = 0;
+			for (int i = 0; i < numVertices; ++i)
+			{
+				const float* a = input[i];
+				const float* b = input[(i + 1) % numVertices];
+				float distanceA = ClipDistance(plane, a);
+				float distanceB = ClipDistance(plane, b);
+
+				if (distanceA >= 0)  std::copy(a, a + Floats, output[numOutput++]);
+				if ((distanceA >= 0) != (distanceB >= 0))
+				{
+					// Edge crosses the plane, add the crossing point. Attributes are linear in clip space so interpolate them all
+					float t = distanceA / (distanceA - distanceB);
+					for (int f = 0; f < Floats; ++f)  output[numOutput][f] = a[f] + (b[f] - a[f]) * t;
+					++numOutput;
+				}
+			}
+			numVertices = numOutput;
+			current = 1 - current;
+			if (numVertices < 3)  return;
+		}
+
+		// Split the clipped polygon into a fan of triangles, keeping the winding
+		for (int i = 1; i + 1 < numVertices; ++i)
+		{
+			const float* triangle[3] = { polygons[current][0], polygons[current][i], polygons[current][i + 1] };
+			emit(triangle);
+		}
+	}
+
+
+	// Division rounding towards minus infinity, for fixed point positions that can be negative
+	int FloorDiv(int value, int divisor)
+	{
+		int quotient = value / divisor;
+		return (value % divisor != 0 && value < 0) ? quotient - 1 : quotient;
+	}
+
+
+	// Port of TintedTexture_ps. PixelLighting_ps is shaded in batches by ShadePixelLighting
+	ColourRGBA ShadeTintedTexture(const RasterState& state, const float* uv)
+	{
+		ColourRGBA textureColour = state.texture->SampleBilinearWrap({ uv[0], uv[1] });
+		return { state.objectColour.x * textureColour.r, state.objectColour.y * textureColour.g,
+		         state.objectColour.z * textureColour.b, 1.0f };
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Construction
+//--------------------------------------------------------------------------------------
+
+SoftwareRasterizer::SoftwareRasterizer(ThreadPool& threadPool)
+	: mThreadPool(threadPool)
+{
+}
+
+
+//--------------------------------------------------------------------------------------
+// Usage
+//--------------------------------------------------------------------------------------
+
+// Start a frame that renders into the given image. Clears the image to the given colour and the depth buffer to 1 (far)
+void SoftwareRasterizer::BeginFrame(Image& target, const ColourRGBA& clearColour, const RasterFrameConstants& constants)
+{
+	mTarget    = &target;
+	mConstants = constants;
+	mDepthOnly = false;
+	mLighting.lights = { { constants.light1Position, constants.light1Colour }, { constants.light2Position, constants.light2Colour } };
+	mLighting.ambientColour  = constants.ambientColour;
+	mLighting.specularPower  = constants.specularPower;
+	mLighting.cameraPosition = constants.cameraPosition;
+	StartFrame(target.Width(), target.Height());
+
+	ForEachRow(mThreadPool, mHeight, [&](int y)
+	{
+		std::fill(target.Row(y), target.Row(y) + mWidth, clearColour);
+	});
+}
+
+
+// Start a frame that only renders depth. Clears the depth buffer of the given size to 1 (far)
+void SoftwareRasterizer::BeginDepthFrame(int width, int height, const CMatrix4x4& viewProjectionMatrix)
+{
+	mTarget = nullptr;
+	mConstants.viewProjectionMatrix = viewProjectionMatrix;
+	mDepthOnly = true;
+	StartFrame(width, height);
+}
+
+
+// Set up a new frame of the given size, clearing the depth buffer and its hierarchy
+void SoftwareRasterizer::StartFrame(int width, int height)
+{
+	mWidth   = width;
+	mHeight  = height;
+	mTilesX  = (mWidth  + TileSize  - 1) / TileSize;
+	mTilesY  = (mHeight + TileSize  - 1) / TileSize;
+	mBlocksX = (mWidth  + BlockSize - 1) / BlockSize;
+	mBlocksY = (mHeight + BlockSize - 1) / BlockSize;
+
+	mDepth.resize(static_cast<size_t>(mWidth) * mHeight);
+	mBlockNearestZ .assign(mBlocksX * mBlocksY, 1.0f);
+	mBlockFurthestZ.assign(mBlocksX * mBlocksY, 1.0f);
+	mTileNearestZ  .assign(mTilesX  * mTilesY,  1.0f);
+	mTileFurthestZ .assign(mTilesX  * mTilesY,  1.0f);
+	mTileHiZRejected.assign(mTilesX * mTilesY,  0);
+
+	mTileBins.resize(mTilesX * mTilesY);
+	for (auto& bin : mTileBins)  bin.clear(); // Bins keep their memory from frame to frame
+	mTriangles.clear();
+	mDepthTriangles.clear();
+	mDrawStates.clear();
+
+	ForEachRowBand(mThreadPool, mHeight, [&](int top, int bottom)
+	{
+		std::fill(mDepth.begin() + static_cast<size_t>(top) * mWidth, mDepth.begin() + static_cast<size_t>(bottom) * mWidth, 1.0f);
+	});
+}
+
+
+// Draw a triangle list with the given world matrix and state. Triangles are transformed, clipped, culled and put in tile bins
+void SoftwareRasterizer::Draw(const std::vector<RasterVertex>& vertices, const std::vector<uint32_t>& indices,
+                              const CMatrix4x4& worldMatrix, const RasterState& state)
+{
+	int draw = static_cast<int>(mDrawStates.size());
+	mDrawStates.push_back(state);
+
+	// Vertex shader, PixelLighting_vs (BasicTransform_vs is the same without the world position and normal, which are ignored by
+	// TintedTexture)
+	CMatrix4x4 worldViewProjection = worldMatrix * mConstants.viewProjectionMatrix;
+	int numVertices = static_cast<int>(vertices.size());
+	mVertexData.resize(static_cast<size_t>(numVertices) * VERTEX_FLOATS);
+	int numJobs = (numVertices + VerticesPerJob - 1) / VerticesPerJob;
+	mThreadPool.ParallelFor(numJobs, [&](int job)
+	{
+		int first = job * VerticesPerJob;
+		int last  = std::min(first + VerticesPerJob, numVertices);
+		for (int i = first; i < last; ++i)
+		{
+			CVector4 modelPosition = { vertices[i].position, 1 };
+			CVector4 modelNormal   = { vertices[i].normal,   0 }; // Normals are vectors, 0 in w
+			CVector4 projectedPosition = modelPosition * worldViewProjection;
+			CVector4 worldPosition     = modelPosition * worldMatrix;
+			CVector4 worldNormal       = modelNormal   * worldMatrix;
+
+			float* vertex = &mVertexData[static_cast<size_t>(i) * VERTEX_FLOATS];
+			vertex[0]  = projectedPosition.x;  vertex[1]  = projectedPosition.y;  vertex[2]  = projectedPosition.z;  vertex[3] = projectedPosition.w;
+			vertex[4]  = worldPosition.x;      vertex[5]  = worldPosition.y;      vertex[6]  = worldPosition.z;
+			vertex[7]  = worldNormal.x;        vertex[8]  = worldNormal.y;        vertex[9]  = worldNormal.z;
+			vertex[10] = vertices[i].uv.x;     vertex[11] = vertices[i].uv.y;
+		}
+	});
+
+	// Triangles are set up in order on this thread so the bins are in submission order
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const float* triangle[3] = { &mVertexData[static_cast<size_t>(indices[i    ]) * VERTEX_FLOATS],
+		                             &mVertexData[static_cast<size_t>(indices[i + 1]) * VERTEX_FLOATS],
+		                             &mVertexData[static_cast<size_t>(indices[i + 2]) * VERTEX_FLOATS] };
+		AddTriangle(triangle, draw);
+	}
+}
+
+
+// Draw a triangle list into the depth buffer in a depth-only frame, positions only
+void SoftwareRasterizer::DrawDepth(const std::vector<CVector3>& positions, const std::vector<uint32_t>& indices,
+                                   const CMatrix4x4& worldMatrix, RasterCull cull)
+{
+	// Vertex shader, BasicTransform_vs without the uvs
+	CMatrix4x4 worldViewProjection = worldMatrix * mConstants.viewProjectionMatrix;
+	int numVertices = static_cast<int>(positions.size());
+	mVertexData.resize(static_cast<size_t>(numVertices) * DEPTH_VERTEX_FLOATS);
+	int numJobs = (numVertices + VerticesPerJob - 1) / VerticesPerJob;
+	mThreadPool.ParallelFor(numJobs, [&](int job)
+	{
+		int first = job * VerticesPerJob;
+		int last  = std::min(first + VerticesPerJob, numVertices);
+		for (int i = first; i < last; ++i)
+		{
+			CVector4 projectedPosition = CVector4(positions[i], 1) * worldViewProjection;
+			float* vertex = &mVertexData[static_cast<size_t>(i) * DEPTH_VERTEX_FLOATS];
+			vertex[0] = projectedPosition.x;  vertex[1] = projectedPosition.y;  vertex[2] = projectedPosition.z;  vertex[3] = projectedPosition.w;
+		}
+	});
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		const float* triangle[3] = { &mVertexData[static_cast<size_t>(indices[i    ]) * DEPTH_VERTEX_FLOATS],
+		                             &mVertexData[static_cast<size_t>(indices[i + 1]) * DEPTH_VERTEX_FLOATS],
+		                             &mVertexData[static_cast<size_t>(indices[i + 2]) * DEPTH_VERTEX_FLOATS] };
+		ClipTriangle<DEPTH_VERTEX_FLOATS>(triangle, [&](const float* clipped[3]) { SetupDepthTriangle(clipped, cull); });
+	}
+}
+
+
+// Draw all the triangles from this frame into the target image (if any) and the depth buffer, then copy the depth buffer into
+// DepthImage
+void SoftwareRasterizer::EndFrame()
+{
+	if (mDepthOnly)
+	{
+		mThreadPool.ParallelFor(mTilesX * mTilesY, [&](int tile) { DrawDepthTile(tile); });
+		mLastTriangles = static_cast<int>(mDepthTriangles.size());
+	}
+	else
+	{
+		mThreadPool.ParallelFor(mTilesX * mTilesY, [&](int tile) { DrawTile(tile); });
+		mLastTriangles = static_cast<int>(mTriangles.size());
+	}
+
+	mLastBinned = 0;
+	for (auto& bin : mTileBins)  mLastBinned += static_cast<int>(bin.size());
+	mLastHiZRejected = 0;
+	for (int rejected : mTileHiZRejected)  mLastHiZRejected += rejected;
+
+	mDepthImage.Resize(mWidth, mHeight);
+	ForEachRow(mThreadPool, mHeight, [&](int y)
+	{
+		const float* depthRow = &mDepth[static_cast<size_t>(y) * mWidth];
+		ColourRGBA*  row      = mDepthImage.Row(y);
+		for (int x = 0; x < mWidth; ++x)  row[x] = { depthRow[x], 0, 0, 1 };
+	});
+}
+
+
+//--------------------------------------------------------------------------------------
+// Data access
+//--------------------------------------------------------------------------------------
+
+// Whether everything within a rectangle of pixels no nearer than the given depth is hidden by the depth buffer of the last frame
+bool SoftwareRasterizer::IsOccluded(const PixelRect& rect, float nearestDepth) const
+{
+	int left   = std::max(rect.left, 0);
+	int top    = std::max(rect.top,  0);
+	int right  = std::min(rect.right,  mWidth);
+	int bottom = std::min(rect.bottom, mHeight);
+	if (right <= left || bottom <= top)  return true; // Off screen
+
+	// Hidden if every block covered has nothing further away than the given depth
+	for (int blockY = top / BlockSize; blockY <= (bottom - 1) / BlockSize; ++blockY)
+	{
+		for (int blockX = left / BlockSize; blockX <= (right - 1) / BlockSize; ++blockX)
+		{
+			if (mBlockFurthestZ[blockY * mBlocksX + blockX] > nearestDepth)  return false;
+		}
+	}
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Triangle setup
+//--------------------------------------------------------------------------------------
+
+// Clip a triangle to the view, each vertex is a clip space position followed by its attributes
+void SoftwareRasterizer::AddTriangle(const float* vertices[3], int draw)
+{
+	ClipTriangle<VERTEX_FLOATS>(vertices, [&](const float* clipped[3]) { SetupTriangle(clipped, draw); });
+}
+
+
+// Cull a triangle that is inside the view, set it up for rasterisation and put it in the bins of the tiles it overlaps
+void SoftwareRasterizer::SetupTriangle(const float* vertices[3], int draw)
+{
+	Triangle triangle;
+	int   order[3];
+	float invW[3];
+	if (!SetupEdges(vertices, mDrawStates[draw].cull, triangle.edges, order, triangle.z, invW))  return;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		const float* vertex = vertices[order[i]];
+		triangle.invW[i] = invW[i];
+		for (int attribute = 0; attribute < NUM_ATTRIBUTES; ++attribute)
+		{
+			triangle.attributes[i][attribute] = vertex[4 + attribute] * invW[i];
+		}
+	}
+	triangle.draw = draw;
+
+	mTriangles.push_back(triangle);
+	BinTriangle(triangle.edges, static_cast<uint32_t>(mTriangles.size() - 1));
+}
+
+
+// Cull a triangle that is inside the view, set it up for depth-only rasterisation and put it in the bins of the tiles it overlaps
+void SoftwareRasterizer::SetupDepthTriangle(const float* vertices[3], RasterCull cull)
+{
+	DepthTriangle triangle;
+	int   order[3];
+	float invW[3];
+	if (!SetupEdges(vertices, cull, triangle.edges, order, triangle.z, invW))  return;
+	triangle.nearestZ  = std::min({ triangle.z[0], triangle.z[1], triangle.z[2] });
+	triangle.furthestZ = std::max({ triangle.z[0], triangle.z[1], triangle.z[2] });
+
+	mDepthTriangles.push_back(triangle);
+	BinTriangle(triangle.edges, static_cast<uint32_t>(mDepthTriangles.size() - 1));
+}
+
+
+// Project a triangle to the screen and set up its edge functions and bounds. Returns false if it is culled or covers no pixel
+// centres. Back faces drawn without culling have their vertices reversed, order gives the vertex used for each corner
+bool SoftwareRasterizer::SetupEdges(const float* vertices[3], RasterCull cull, TriangleEdges& edges, int order[3],
+                                    float z[3], float invW[3]) const
+{
+	// Project to the screen in fixed point (viewport transform), y down
+	int   x[3], y[3];
+	float vertexZ[3], vertexInvW[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		vertexInvW[i] = 1.0f / vertices[i][3];
+		float screenX = (vertices[i][0] * vertexInvW[i] *  0.5f + 0.5f) * mWidth;
+		float screenY = (vertices[i][1] * vertexInvW[i] * -0.5f + 0.5f) * mHeight;
+		x[i] = static_cast<int>(std::floor(screenX * SubPixels + 0.5f));
+		y[i] = static_cast<int>(std::floor(screenY * SubPixels + 0.5f));
+		vertexZ[i] = vertices[i][2] * vertexInvW[i];
+	}
+
+	// Twice the signed area. Positive for triangles that are clockwise on screen, which are front faces as on the GPU
+	int64_t area = static_cast<int64_t>(x[1] - x[0]) * (y[2] - y[0]) - static_cast<int64_t>(y[1] - y[0]) * (x[2] - x[0]);
+	if (area == 0)  return false;
+	order[0] = 0;  order[1] = 1;  order[2] = 2;
+	if (area < 0)
+	{
+		if (cull == RasterCull::Back)  return false;
+		std::swap(order[1], order[2]); // Draw back faces with their vertices reversed
+		area = -area;
+	}
+
+	// Pixels whose centres lie within the bounding box, clamped to the image
+	int minX = std::min({ x[0], x[1], x[2] }), maxX = std::max({ x[0], x[1], x[2] });
+	int minY = std::min({ y[0], y[1], y[2] }), maxY = std::max({ y[0], y[1], y[2] });
+	edges.left   = std::max(FloorDiv(minX - HalfPixel + SubPixels - 1, SubPixels), 0);
+	edges.top    = std::max(FloorDiv(minY - HalfPixel + SubPixels - 1, SubPixels), 0);
+	edges.right  = std::min(FloorDiv(maxX - HalfPixel, SubPixels) + 1, mWidth);
+	edges.bottom = std::min(FloorDiv(maxY - HalfPixel, SubPixels) + 1, mHeight);
+	if (edges.right <= edges.left || edges.bottom <= edges.top)  return false;
+
+	// Edge functions, positive on the inside. Edges that are exactly horizontal with the triangle below (top edges) or that have
+	// the triangle on their right (left edges) own the pixels on them, the others have C reduced by one so those pixels fail
+	for (int edge = 0; edge < 3; ++edge)
+	{
+		int a = order[(edge + 1) % 3];
+		int b = order[(edge + 2) % 3];
+		int64_t edgeA = y[a] - y[b];
+		int64_t edgeB = x[b] - x[a];
+		bool topLeft = edgeA > 0 || (edgeA == 0 && edgeB > 0);
+		edges.edgeA[edge] = edgeA;
+		edges.edgeB[edge] = edgeB;
+		edges.edgeC[edge] = -(edgeA * x[a] + edgeB * y[a]) - (topLeft ? 0 : 1);
+	}
+	edges.invArea = 1.0f / static_cast<float>(area);
+
+	for (int i = 0; i < 3; ++i)
+	{
+		z[i]    = vertexZ[order[i]];
+		invW[i] = vertexInvW[order[i]];
+	}
+	return true;
+}
+
+
+// Put a triangle in the bins of the tiles it overlaps
+void SoftwareRasterizer::BinTriangle(const TriangleEdges& edges, uint32_t index)
+{
+	for (int tileY = edges.top / TileSize; tileY <= (edges.bottom - 1) / TileSize; ++tileY)
+	{
+		for (int tileX = edges.left / TileSize; tileX <= (edges.right - 1) / TileSize; ++tileX)
+		{
+			mTileBins[tileY * mTilesX + tileX].push_back(index);
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Rasterisation
+//--------------------------------------------------------------------------------------
+
+// Rasterise the triangles in one tile's bin
+void SoftwareRasterizer::DrawTile(int tile)
+{
+	int tileLeft   = (tile % mTilesX) * TileSize;
+	int tileTop    = (tile / mTilesX) * TileSize;
+	int tileRight  = std::min(tileLeft + TileSize, mWidth);
+	int tileBottom = std::min(tileTop  + TileSize, mHeight);
+
+	// PixelLighting pixels are gathered into batches for ShadePixelLighting. Pixels of one triangle never overlap so a batch
+	// is only shaded and written when full or at the end of the triangle
+	LightingFragments fragments;
+	ColourRGBA*       fragmentPixels[LIGHTING_BATCH];
+	int               numFragments = 0;
+	auto ShadeFragments = [&](const RasterState& state)
+	{
+		ColourRGBA colours[LIGHTING_BATCH];
+		ShadePixelLighting(mLighting, fragments, numFragments, colours);
+		for (int i = 0; i < numFragments; ++i)
+		{
+			ColourRGBA& pixel = *fragmentPixels[i];
+			if (state.blend == RasterBlend::Additive)
+			{
+				pixel = { pixel.r + colours[i].r, pixel.g + colours[i].g, pixel.b + colours[i].b, colours[i].a };
+			}
+			else
+			{
+				pixel = colours[i];
+			}
+		}
+		numFragments = 0;
+	};
+
+	for (uint32_t index : mTileBins[tile])
+	{
+		const Triangle&      triangle = mTriangles[index];
+		const TriangleEdges& edges    = triangle.edges;
+		const RasterState&   state    = mDrawStates[triangle.draw];
+
+		int left   = std::max(edges.left,   tileLeft);
+		int top    = std::max(edges.top,    tileTop);
+		int right  = std::min(edges.right,  tileRight);
+		int bottom = std::min(edges.bottom, tileBottom);
+
+		int64_t stepX[3];
+		for (int edge = 0; edge < 3; ++edge)  stepX[edge] = edges.edgeA[edge] * SubPixels;
+
+		float nearestZ  = std::min({ triangle.z[0], triangle.z[1], triangle.z[2] });
+		float furthestZ = std::max({ triangle.z[0], triangle.z[1], triangle.z[2] });
+
+		for (int y = top; y < bottom; ++y)
+		{
+			// Edge functions at the centre of the first pixel in the row
+			int64_t pixelX = static_cast<int64_t>(left) * SubPixels + HalfPixel;
+			int64_t pixelY = static_cast<int64_t>(y)    * SubPixels + HalfPixel;
+			int64_t edgeValues[3];
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				edgeValues[edge] = edges.edgeA[edge] * pixelX + edges.edgeB[edge] * pixelY + edges.edgeC[edge];
+			}
+
+			float*      depthRow  = &mDepth[static_cast<size_t>(y) * mWidth];
+			ColourRGBA* colourRow = mTarget->Row(y);
+			for (int x = left; x < right; ++x, edgeValues[0] += stepX[0], edgeValues[1] += stepX[1], edgeValues[2] += stepX[2])
+			{
+				if ((edgeValues[0] | edgeValues[1] | edgeValues[2]) < 0)  continue; // Outside if any edge function is negative
+
+				float barycentric[3] = { edgeValues[0] * edges.invArea, edgeValues[1] * edges.invArea, edgeValues[2] * edges.invArea };
+
+				// Depth is linear in screen space. Clamped to the triangle's range against rounding, as in depth-only frames
+				float depth = barycentric[0] * triangle.z[0] + barycentric[1] * triangle.z[1] + barycentric[2] * triangle.z[2];
+				depth = std::min(std::max(depth, nearestZ), furthestZ);
+				if (!(depth < depthRow[x]))  continue;
+				if (state.depthWrite)  depthRow[x] = depth;
+
+				// Attributes divided by w are linear in screen space, divide by the interpolated 1/w for perspective correction
+				float w = 1.0f / (barycentric[0] * triangle.invW[0] + barycentric[1] * triangle.invW[1] + barycentric[2] * triangle.invW[2]);
+				float attributes[NUM_ATTRIBUTES];
+				for (int attribute = 0; attribute < NUM_ATTRIBUTES; ++attribute)
+				{
+					attributes[attribute] = (barycentric[0] * triangle.attributes[0][attribute] +
+					                         barycentric[1] * triangle.attributes[1][attribute] +
+					                         barycentric[2] * triangle.attributes[2][attribute]) * w;
+				}
+
+				if (state.shader == RasterShader::PixelLighting)
+				{
+					// Diffuse material colour in texture rgb, specular material colour in alpha
+					ColourRGBA textureColour = state.texture->SampleBilinearWrap({ attributes[6], attributes[7] });
+					fragments.positionX[numFragments] = attributes[0];
+					fragments.positionY[numFragments] = attributes[1];
+					fragments.positionZ[numFragments] = attributes[2];
+					fragments.normalX[numFragments]   = attributes[3];
+					fragments.normalY[numFragments]   = attributes[4];
+					fragments.normalZ[numFragments]   = attributes[5];
+					fragments.diffuseR[numFragments]  = textureColour.r;
+					fragments.diffuseG[numFragments]  = textureColour.g;
+					fragments.diffuseB[numFragments]  = textureColour.b;
+					fragments.specular[numFragments]  = textureColour.a;
+					fragmentPixels[numFragments] = &colourRow[x];
+					if (++numFragments == LIGHTING_BATCH)  ShadeFragments(state);
+					continue;
+				}
+
+				ColourRGBA colour = ShadeTintedTexture(state, attributes + 6);
+				if (state.blend == RasterBlend::Additive)
+				{
+					colourRow[x] = { colourRow[x].r + colour.r, colourRow[x].g + colour.g, colourRow[x].b + colour.b, colour.a };
+				}
+				else
+				{
+					colourRow[x] = colour;
+				}
+			}
+		}
+		if (numFragments > 0)  ShadeFragments(state);
+	}
+
+	// Bring the depth hierarchy up to date for occlusion tests
+	int blockLeft = tileLeft / BlockSize, blockRight  = (tileRight  + BlockSize - 1) / BlockSize;
+	int blockTop  = tileTop  / BlockSize, blockBottom = (tileBottom + BlockSize - 1) / BlockSize;
+	for (int blockY = blockTop; blockY < blockBottom; ++blockY)
+	{
+		for (int blockX = blockLeft; blockX < blockRight; ++blockX)  UpdateBlockDepthRange(blockX, blockY);
+	}
+	UpdateTileDepthRange(tile);
+}
+
+
+// Rasterise the triangles in one tile's bin in a depth-only frame. Whole blocks are skipped when the depth hierarchy shows the
+// triangle is behind everything already there
+void SoftwareRasterizer::DrawDepthTile(int tile)
+{
+	int tileX = tile % mTilesX;
+	int tileY = tile / mTilesX;
+	int tileLeft   = tileX * TileSize;
+	int tileTop    = tileY * TileSize;
+	int tileRight  = std::min(tileLeft + TileSize, mWidth);
+	int tileBottom = std::min(tileTop  + TileSize, mHeight);
+
+	int rejected = 0;
+	for (uint32_t index : mTileBins[tile])
+	{
+		const DepthTriangle& triangle = mDepthTriangles[index];
+		const TriangleEdges& edges    = triangle.edges;
+
+		int left   = std::max(edges.left,   tileLeft);
+		int top    = std::max(edges.top,    tileTop);
+		int right  = std::min(edges.right,  tileRight);
+		int bottom = std::min(edges.bottom, tileBottom);
+
+		int blockLeft = left / BlockSize, blockRight  = (right  + BlockSize - 1) / BlockSize;
+		int blockTop  = top  / BlockSize, blockBottom = (bottom + BlockSize - 1) / BlockSize;
+
+		// Whole tile behind the depth already drawn
+		if (triangle.nearestZ >= mTileFurthestZ[tile])
+		{
+			rejected += (blockRight - blockLeft) * (blockBottom - blockTop);
+			continue;
+		}
+
+		int64_t stepX[3];
+		for (int edge = 0; edge < 3; ++edge)  stepX[edge] = edges.edgeA[edge] * SubPixels;
+
+		bool tileChanged = false;
+		for (int blockY = blockTop; blockY < blockBottom; ++blockY)
+		{
+			for (int blockX = blockLeft; blockX < blockRight; ++blockX)
+			{
+				int block = blockY * mBlocksX + blockX;
+				if (triangle.nearestZ >= mBlockFurthestZ[block])
+				{
+					++rejected;
+					continue;
+				}
+
+				// If the triangle is nearer than everything in the block, every pixel it covers passes the depth test
+				bool alwaysPasses = triangle.furthestZ < mBlockNearestZ[block];
+
+				int pixelLeft   = std::max(blockX * BlockSize, left);
+				int pixelTop    = std::max(blockY * BlockSize, top);
+				int pixelRight  = std::min(blockX * BlockSize + BlockSize, right);
+				int pixelBottom = std::min(blockY * BlockSize + BlockSize, bottom);
+
+				bool blockChanged = false;
+				for (int y = pixelTop; y < pixelBottom; ++y)
+				{
+					int64_t pixelX = static_cast<int64_t>(pixelLeft) * SubPixels + HalfPixel;
+					int64_t pixelY = static_cast<int64_t>(y)         * SubPixels + HalfPixel;
+					int64_t edgeValues[3];
+					for (int edge = 0; edge < 3; ++edge)
+					{
+						edgeValues[edge] = edges.edgeA[edge] * pixelX + edges.edgeB[edge] * pixelY + edges.edgeC[edge];
+					}
+
+					float* depthRow = &mDepth[static_cast<size_t>(y) * mWidth];
+					for (int x = pixelLeft; x < pixelRight; ++x, edgeValues[0] += stepX[0], edgeValues[1] += stepX[1], edgeValues[2] += stepX[2])
+					{
+						if ((edgeValues[0] | edgeValues[1] | edgeValues[2]) < 0)  continue;
+
+						// Depth only, no other attributes. Clamped as in DrawTile, which also makes the test above exact
+						float depth = (edgeValues[0] * edges.invArea) * triangle.z[0] + (edgeValues[1] * edges.invArea) * triangle.z[1] +
+						              (edgeValues[2] * edges.invArea) * triangle.z[2];
+						depth = std::min(std::max(depth, triangle.nearestZ), triangle.furthestZ);
+						if (alwaysPasses || depth < depthRow[x])
+						{
+							depthRow[x] = depth;
+							blockChanged = true;
+						}
+					}
+				}
+
+				if (blockChanged)
+				{
+					UpdateBlockDepthRange(blockX, blockY);
+					tileChanged = true;
+				}
+			}
+		}
+		if (tileChanged)  UpdateTileDepthRange(tile);
+	}
+	mTileHiZRejected[tile] = rejected;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Depth hierarchy
+//--------------------------------------------------------------------------------------
+
+// Recalculate the nearest and furthest depth of a block from the depth buffer
+void SoftwareRasterizer::UpdateBlockDepthRange(int blockX, int blockY)
+{
+	int left   = blockX * BlockSize;
+	int top    = blockY * BlockSize;
+	int right  = std::min(left + BlockSize, mWidth);
+	int bottom = std::min(top  + BlockSize, mHeight);
+
+	float nearest  = 1.0f;
+	float furthest = 0.0f;
+	for (int y = top; y < bottom; ++y)
+	{
+		const float* depthRow = &mDepth[static_cast<size_t>(y) * mWidth];
+		for (int x = left; x < right; ++x)
+		{
+			nearest  = std::min(nearest,  depthRow[x]);
+			furthest = std::max(furthest, depthRow[x]);
+		}
+	}
+	mBlockNearestZ [blockY * mBlocksX + blockX] = nearest;
+	mBlockFurthestZ[blockY * mBlocksX + blockX] = furthest;
+}
+
+
+// Recalculate the nearest and furthest depth of a tile from its blocks
+void SoftwareRasterizer::UpdateTileDepthRange(int tile)
+{
+	int blockLeft   = (tile % mTilesX) * BlocksPerTile;
+	int blockTop    = (tile / mTilesX) * BlocksPerTile;
+	int blockRight  = std::min(blockLeft + BlocksPerTile, mBlocksX);
+	int blockBottom = std::min(blockTop  + BlocksPerTile, mBlocksY);
+
+	float nearest  = 1.0f;
+	float furthest = 0.0f;
+	for (int blockY = blockTop; blockY < blockBottom; ++blockY)
+	{
+		for (int blockX = blockLeft; blockX < blockRight; ++blockX)
+		{
+			nearest  = std::min(nearest,  mBlockNearestZ [blockY * mBlocksX + blockX]);
+			furthest = std::max(furthest, mBlockFurthestZ[blockY * mBlocksX + blockX]);
+		}
+	}
+	mTileNearestZ [tile] = nearest;
+	mTileFurthestZ[tile] = furthest;
+}
@@ -0,0 +1,252 @@
+//--------------------------------------------------------------------------------------
+// Software rasterizer - renders triangle meshes into CPU images
+//--------------------------------------------------------------------------------------
+// The CPU equivalent of the GPU pipeline used by RenderSceneFromCamera, so a scene image can be made
+// without a GPU and passed straight to the CPU post-processing (see CpuPostProcessor::SceneImage).
+// Each draw transforms its vertices, clips its triangles to the view and culls them, then puts each
+// triangle in the bin of every screen tile it overlaps. EndFrame rasterises the tiles in parallel.
+// A tile's pixels are only touched by the thread drawing it, and its triangles are drawn in the order
+// they were submitted, so no locking is needed and blending gives the same result as the GPU.
+// Pixels are found with half-space edge functions in fixed point (8 bits of sub-pixel precision, as
+// on the GPU) using the top-left fill rule and pixel centre sampling, with a LESS depth test and
+// perspective correct attributes. The pixel shaders are ports of PixelLighting_ps and TintedTexture_ps.
+// PixelLighting pixels are shaded in batches of eight by ShadePixelLighting (see PixelLighting.h).
+// Textures are sampled bilinear with wrapping but no mip-maps, so distant surfaces shimmer more than
+// on the GPU's anisotropic sampler.
+//
+// Frames started with BeginDepthFrame only render depth, for a depth prepass or for DepthOfField as
+// RenderDepthBufferFromCamera does on the GPU. Draws take position-only vertices, there is no shading
+// and no attribute interpolation. The depth buffer also keeps a hierarchy of the nearest and furthest
+// depth in each 8x8 block and each tile. A triangle whose nearest point is no nearer than the furthest
+// depth of a tile or block is skipped there without visiting its pixels, and a triangle entirely nearer
+// than a block's nearest depth is written without testing. The hierarchy is kept after every frame and
+// can be used for occlusion tests with IsOccluded. Code in .cpp file
+
+#ifndef _RASTERIZER_H_INCLUDED_
+#define _RASTERIZER_H_INCLUDED_
+
+#include "Image.h"
+#include "PixelLighting.h"
+#include "ThreadPool.h"
+#include "CMatrix4x4.h"
+#include "CVector2.h"
+#include "CVector3.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// A mesh vertex as read by the scene's vertex shaders (BasicVertex in Common.hlsli)
+struct RasterVertex
+{
+	CVector3 position;
+	CVector3 normal;
+	CVector2 uv;
+};
+
+
+// Per-frame settings used by the vertex and pixel shaders, the parts of PerFrameConstants (Common.h) the scene shaders read
+struct RasterFrameConstants
+{
+	CMatrix4x4 viewProjectionMatrix;
+
+	CVector3 light1Position;
+	CVector3 light1Colour;
+	CVector3 light2Position;
+	CVector3 light2Colour;
+
+	CVector3 ambientColour;
+	float    specularPower;
+	CVector3 cameraPosition;
+};
+
+
+// Pixel shaders available to the rasterizer
+enum class RasterShader
+{
+	PixelLighting, // Per-pixel lighting from two point lights and ambient, diffuse map in rgb and specular map in alpha
+	TintedTexture, // Texture colour tinted by the object colour, no lighting
+};
+
+enum class RasterCull
+{
+	Back, // Triangles that are anti-clockwise on screen are not drawn (as gCullBackState)
+	None,
+};
+
+enum class RasterBlend
+{
+	None,
+	Additive, // Pixel colour is added to the colour already in the image (as gAdditiveBlendingState)
+};
+
+
+// Shader, texture and states for a draw - the CPU equivalent of the shaders, resources and state objects set before Render
+struct RasterState
+{
+	RasterShader shader       = RasterShader::PixelLighting;
+	const Image* texture      = nullptr;   // Must be set. Sampled bilinear with wrapping
+	CVector3     objectColour = { 1, 1, 1 }; // Tint for TintedTexture
+
+	RasterCull  cull       = RasterCull::Back;
+	RasterBlend blend      = RasterBlend::None;
+	bool        depthWrite = true; // The depth test is always LESS, set false for a read-only depth buffer (as gDepthReadOnlyState)
+};
+
+
+class SoftwareRasterizer
+{
+public:
+	//-------------------------------------
+	// Construction
+	//-------------------------------------
+
+	explicit SoftwareRasterizer(ThreadPool& threadPool);
+
+
+	//-------------------------------------
+	// Usage
+	//-------------------------------------
+
+	// Start a frame that renders into the given image. Clears the image to the given colour and the depth buffer to 1 (far). The
+	// depth buffer is resized to match the image
+	void BeginFrame(Image& target, const ColourRGBA& clearColour, const RasterFrameConstants& constants);
+
+	// Draw a triangle list with the given world matrix and state. Triangles are transformed, clipped, culled and put in tile bins,
+	// the pixels are drawn by EndFrame. The vertices and indices are not needed after the call
+	void Draw(const std::vector<RasterVertex>& vertices, const std::vector<uint32_t>& indices, const CMatrix4x4& worldMatrix,
+	          const RasterState& state);
+
+	// Start a frame that only renders depth. Clears the depth buffer of the given size to 1 (far)
+	void BeginDepthFrame(int width, int height, const CMatrix4x4& viewProjectionMatrix);
+
+	// Draw a triangle list into the depth buffer in a depth-only frame, positions only
+	void DrawDepth(const std::vector<CVector3>& positions, const std::vector<uint32_t>& indices, const CMatrix4x4& worldMatrix,
+	               RasterCull cull);
+
+	// Draw all the triangles from this frame into the target image (if any) and the depth buffer, then copy the depth buffer into
+	// DepthImage
+	void EndFrame();
+
+
+	//-------------------------------------
+	// Data access
+	//-------------------------------------
+
+	// Depth buffer values (0->1) of the last frame in the red channel, as PostProcessTextures::depthTexture expects
+	const Image& DepthImage() const  { return mDepthImage; }
+
+	// Whether everything within a rectangle of pixels no nearer than the given depth is hidden by the depth buffer of the last
+	// frame (would fail the LESS depth test). Uses the hierarchy only, so can report false for things that are hidden
+	bool IsOccluded(const PixelRect& rect, float nearestDepth) const;
+
+	// Triangles drawn in the last frame after clipping and culling, and the triangle-tile pairs rasterised
+	int LastTriangleCount() const  { return mLastTriangles; }
+	int LastBinnedCount()   const  { return mLastBinned; }
+
+	// Triangle-block pairs of the last depth-only frame skipped by the depth hierarchy without visiting their pixels
+	int LastHiZRejectedCount() const  { return mLastHiZRejected; }
+
+
+//-------------------------------------
+// Private types / members
+//-------------------------------------
+private:
+	// Attributes interpolated across a triangle: world position, world normal and uv
+	static const int NUM_ATTRIBUTES = 8;
+
+	// Coverage of a triangle on screen
+	struct TriangleEdges
+	{
+		// Edge functions E = A*x + B*y + C in 8-bit sub-pixel units. Edge i is opposite vertex i. A pixel is inside when all three
+		// are 0 or more, C is adjusted so that is only true exactly on an edge for top-left edges (the top-left fill rule)
+		int64_t edgeA[3];
+		int64_t edgeB[3];
+		int64_t edgeC[3];
+		float   invArea; // 1 / twice the triangle area, turns edge functions into barycentric coordinates
+
+		int left, top, right, bottom; // Pixels that might be covered, clamped to the image. Right and bottom are exclusive
+	};
+
+	// A triangle ready for rasterisation
+	struct Triangle
+	{
+		TriangleEdges edges;
+		float z[3];    // Depth of each vertex
+		float invW[3]; // 1 / w of each vertex
+		float attributes[3][NUM_ATTRIBUTES]; // Attributes of each vertex divided by w
+		int   draw; // Index into mDrawStates
+	};
+
+	// A triangle for a depth-only frame
+	struct DepthTriangle
+	{
+		TriangleEdges edges;
+		float z[3]; // Depth of each vertex
+		float nearestZ;
+		float furthestZ;
+	};
+
+	// Set up a new frame of the given size, clearing the depth buffer and its hierarchy
+	void StartFrame(int width, int height);
+
+	// Rasterise the triangles in one tile's bin
+	void DrawTile(int tile);
+	void DrawDepthTile(int tile);
+
+	// Clip a triangle to the view, each vertex is a clip space position followed by its attributes
+	void AddTriangle(const float* vertices[3], int draw);
+
+	// Cull a triangle that is inside the view, set it up for rasterisation and put it in the bins of the tiles it overlaps
+	void SetupTriangle(const float* vertices[3], int draw);
+	void SetupDepthTriangle(const float* vertices[3], RasterCull cull);
+
+	// Project a triangle to the screen and set up its edge functions and bounds. Returns false if it is culled or covers no pixel
+	// centres. Back faces drawn without culling have their vertices reversed, order gives the vertex used for each corner
+	bool SetupEdges(const float* vertices[3], RasterCull cull, TriangleEdges& edges, int order[3], float z[3], float invW[3]) const;
+
+	// Put a triangle in the bins of the tiles it overlaps
+	void BinTriangle(const TriangleEdges& edges, uint32_t index);
+
+	// Recalculate the depth hierarchy of a block or tile from the depth buffer / blocks
+	void UpdateBlockDepthRange(int blockX, int blockY);
+	void UpdateTileDepthRange(int tile);
+
+	ThreadPool& mThreadPool;
+
+	Image* mTarget = nullptr;
+	RasterFrameConstants mConstants;
+	LightingConstants    mLighting; // The lighting parts of mConstants for ShadePixelLighting
+
+	int mWidth  = 0;
+	int mHeight = 0;
+	int mTilesX = 0;
+	int mTilesY = 0;
+
+	std::vector<float> mDepth;      // Depth buffer, one float per pixel
+	Image              mDepthImage; // Copy of the depth buffer made by EndFrame
+
+	// Depth hierarchy: the nearest and furthest depth in each 8x8 block and each tile
+	int mBlocksX = 0;
+	int mBlocksY = 0;
+	std::vector<float> mBlockNearestZ;
+	std::vector<float> mBlockFurthestZ;
+	std::vector<float> mTileNearestZ;
+	std::vector<float> mTileFurthestZ;
+	std::vector<int>   mTileHiZRejected; // Rejections in each tile this frame
+
+	bool mDepthOnly = false; // Whether the current frame was started with BeginDepthFrame
+
+	std::vector<RasterState>           mDrawStates; // State of each draw this frame
+	std::vector<Triangle>              mTriangles;  // Triangles of this frame in submission order
+	std::vector<DepthTriangle>         mDepthTriangles; // As above in a depth-only frame
+	std::vector<std::vector<uint32_t>> mTileBins;   // Triangles overlapping each tile, in submission order
+	std::vector<float>                 mVertexData; // Transformed vertices of the current draw
+
+	int mLastTriangles = 0;
+	int mLastBinned    = 0;
+	int mLastHiZRejected = 0;
+};
+
+
+#endif //_RASTERIZER_H_INCLUDED_
@@ -0,0 +1,107 @@
+//--------------------------------------------------------------------------------------
+// Single-pass compositing of polygon post-processes for CPU images
+//--------------------------------------------------------------------------------------
+// Polygons are rasterised into the mask as they are added. The sweep clears each run of the mask
+// after drawing it, so the mask is all 0 again for the next group without a separate clear
+
+#include "RegionComposite.h"
+#include "ParallelRows.h"
+
+#include <algorithm>
+
+
+// Whether a polygon post-process can be part of a composited group
+bool CanCompositeRegion(PostProcess postProcess)
+{
+	return PostProcessHistoryRead(postProcess) == HistorySlot::None && !PostProcessSavesPreEffect(postProcess);
+}
+
+
+//--------------------------------------------------------------------------------------
+// RegionCompositor
+//--------------------------------------------------------------------------------------
+
+// Start a new group for images of the given size
+void RegionCompositor::Begin(int width, int height)
+{
+	if (width != mWidth || height != mHeight)
+	{
+		mWidth  = width;
+		mHeight = height;
+		mMask.assign(static_cast<size_t>(width) * height, 0);
+	}
+	mRegions.clear();
+	mCoveredPixels = 0;
+}
+
+
+// Add the polygon pass for the given post-process
+bool RegionCompositor::AddPolygon(PostProcess postProcess, const PostProcessingConstants& constants)
+{
+	if (static_cast<int>(mRegions.size()) >= MaxCompositeRegions)  return false;
+
+	std::vector<CVector2> points = PolygonPixelPoints(constants, static_cast<float>(mWidth), static_cast<float>(mHeight));
+	PolygonSpans(points, mWidth, mHeight, mSpans);
+
+	Region region;
+	region.shader    = GetPixelShader(postProcess);
+	region.constants = constants;
+	if (mSpans.empty() || !region.areaUVs.Set(constants, points))  return false;
+
+	mRegions.push_back(region);
+	uint8_t id = static_cast<uint8_t>(mRegions.size());
+	for (const PolygonSpan& span : mSpans)
+	{
+		uint8_t* mask = &mMask[static_cast<size_t>(span.y) * mWidth];
+		mCoveredPixels += std::count(mask + span.left, mask + span.right, static_cast<uint8_t>(0));
+		std::fill(mask + span.left, mask + span.right, id);
+	}
+	return true;
+}
+
+
+// Draw the group over the scene texture of the inputs into the target
+void RegionCompositor::Run(ThreadPool& threadPool, const PostProcessInputs& inputs, Image& target)
+{
+	const Image& scene = *inputs.sceneTexture;
+	float width  = inputs.viewportWidth;
+	float height = inputs.viewportHeight;
+
+	// Each polygon's post-process runs with its own constants
+	std::vector<PostProcessInputs> regionInputs(mRegions.size(), inputs);
+	for (size_t i = 0; i < mRegions.size(); ++i)  regionInputs[i].constants = &mRegions[i].constants;
+
+	ForEachRow(threadPool, mHeight, [&](int y)
+	{
+		uint8_t* mask = &mMask[static_cast<size_t>(y) * mWidth];
+		const ColourRGBA* in = scene.Row(y);
+		ColourRGBA* out = target.Row(y);
+		float cy = y + 0.5f;
+
+		// Split the row into runs of the same effect ID
+		for (int left = 0; left < mWidth; )
+		{
+			uint8_t id = mask[left];
+			int right = left + 1;
+			while (right < mWidth && mask[right] == id)  ++right;
+
+			if (id == 0)
+			{
+				std::copy(in + left, in + right, out + left);
+			}
+			else
+			{
+				const Region& region = mRegions[id - 1];
+				const PostProcessInputs& regionInput = regionInputs[id - 1];
+				for (int x = left; x < right; ++x)
+				{
+					float cx = x + 0.5f;
+					CVector2 sceneUV = { cx / width, cy / height };
+					out[x] = region.shader(regionInput, sceneUV, region.areaUVs.At(cx, cy));
+				}
+				std::fill(mask + left, mask + right, static_cast<uint8_t>(0));
+			}
+			left = right;
+		}
+	});
+}
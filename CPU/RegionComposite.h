@@ -0,0 +1,73 @@
+//--------------------------------------------------------------------------------------
+// Single-pass compositing of polygon post-processes for CPU images
+//--------------------------------------------------------------------------------------
+// Run one at a time, each polygon pass copies the whole image then shades its polygon, so a group
+// of windows costs a full-screen copy per window. The compositor instead rasterises every polygon
+// of a group of consecutive polygon passes into an effect ID mask (one byte per pixel, 0 for no
+// polygon), then makes one sweep over the image. Each row is split into runs of the same ID: runs
+// without a polygon are copied and the others are shaded by their polygon's post-process. The cost
+// is one pass over the image plus the area of each polygon, however many polygons there are.
+// Every polygon reads the image from before the group rather than the output of the polygons
+// before it, and where polygons overlap the last one in the group is drawn. This only differs from
+// running the passes one by one where a post-process reads pixels of another polygon (e.g. Contour
+// next to another window) or where polygons overlap. Code in .cpp file
+
+#ifndef _REGION_COMPOSITE_H_INCLUDED_
+#define _REGION_COMPOSITE_H_INCLUDED_
+
+#include "Image.h"
+#include "PostProcess.h"
+#include "PostProcessPolygon.h"
+#include "PostProcessShaders.h"
+#include "ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// Most polygons in one group, IDs must fit in the mask
+const int MaxCompositeRegions = 255;
+
+
+// Whether a polygon post-process can be part of a composited group. True for post-processes that shade each pixel separately
+// and don't use history (PostProcessHistoryRead) or keep their input for later passes (PostProcessSavesPreEffect)
+bool CanCompositeRegion(PostProcess postProcess);
+
+
+// A group of polygon passes drawn in a single sweep over the image
+class RegionCompositor
+{
+public:
+	// Start a new group for images of the given size
+	void Begin(int width, int height);
+
+	// Add the polygon pass for the given post-process, using the constants as they are when it would run (with the polygon
+	// from SetPolygonConstants). Returns false if the polygon covers no pixels, it is then left out
+	bool AddPolygon(PostProcess postProcess, const PostProcessingConstants& constants);
+
+	// Draw the group over the scene texture of the inputs into the target (same size, must be a different image)
+	void Run(ThreadPool& threadPool, const PostProcessInputs& inputs, Image& target);
+
+	// Polygons in the group and the pixels they cover (not counting pixels covered by more than one polygon twice)
+	int    NumRegions()    const  { return static_cast<int>(mRegions.size()); }
+	size_t CoveredPixels() const  { return mCoveredPixels; }
+
+private:
+	struct Region
+	{
+		PixelShaderFunction     shader;
+		PostProcessingConstants constants;
+		PolygonUVMapping        areaUVs;
+	};
+
+	int mWidth  = 0;
+	int mHeight = 0;
+
+	std::vector<Region>      mRegions;
+	std::vector<uint8_t>     mMask;  // Effect ID of each pixel, 1 + index in mRegions or 0 for no polygon. Cleared by Run
+	std::vector<PolygonSpan> mSpans; // Spans of the polygon being added
+	size_t                   mCoveredPixels = 0;
+};
+
+
+#endif //_REGION_COMPOSITE_H_INCLUDED_
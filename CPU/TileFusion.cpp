@@ -0,0 +1,189 @@
+//--------------------------------------------------------------------------------------
+// Tile-fused execution of consecutive passes for CPU images
+//--------------------------------------------------------------------------------------
+// Stages run as a wavefront down the image. For each tile the last stage's rows are known, and
+// working back up the group each stage must have shaded the rows after it plus the next stage's
+// footprint. Each stage then shades only the rows it has not shaded before
+
+#include "TileFusion.h"
+#include "GaussianBlur.h"
+#include "ColourRGBA.h"
+
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#include <Windows.h>
+#else
+	#include <unistd.h>
+#endif
+
+
+namespace
+{
+	// Used if the cache size can't be found, a common size of level 3 cache
+	const size_t DefaultCacheBytes = 8 * 1024 * 1024;
+
+	// Fewest rows in a tile. Smaller tiles would spend more time waiting for the threads than shading
+	const int MinTileRows = 8;
+
+
+	// Rows covered by an offset in UV space, plus one for the rounding of SamplePoint
+	inline int RowsForOffset(float offsetV, int height)
+	{
+		return static_cast<int>(std::ceil(offsetV * height)) + 1;
+	}
+}
+
+
+// Whether a full-screen post-process can be part of a tile-fused group
+bool CanTileFuse(PostProcess postProcess)
+{
+	switch (postProcess)
+	{
+	case PostProcess::None:
+	case PostProcess::Copy:
+	case PostProcess::Tint:
+	case PostProcess::GreyNoise:
+	case PostProcess::VerticalColourGradient:
+	case PostProcess::HueVerticalColourGradient:
+	case PostProcess::Sepia:
+	case PostProcess::Inverted:
+	case PostProcess::ColourMatrix:
+	case PostProcess::NightVision:
+	case PostProcess::GameBoy:
+	case PostProcess::Contour:
+	case PostProcess::Dilation:
+	case PostProcess::GaussianBlurHorizontal:
+	case PostProcess::GaussianBlurVertical:
+	case PostProcess::DualFiltering:
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+
+// Distance in rows above or below a pixel that a full-screen post-process reads the scene texture from
+int SampleFootprintRows(PostProcess postProcess, const PostProcessingConstants& constants, int width, int height)
+{
+	switch (postProcess)
+	{
+	// Only the pixel itself
+	case PostProcess::None:
+	case PostProcess::Copy:
+	case PostProcess::Tint:
+	case PostProcess::GreyNoise:
+	case PostProcess::VerticalColourGradient:
+	case PostProcess::HueVerticalColourGradient:
+	case PostProcess::Sepia:
+	case PostProcess::Inverted:
+	case PostProcess::ColourMatrix:
+	case PostProcess::GaussianBlurHorizontal:
+		return 0;
+
+	// 3x3 Sobel filter and the four neighbours of the dilation
+	case PostProcess::Contour:
+	case PostProcess::Dilation:
+		return 1;
+
+	// Offsets of up to 0.003 in UV
+	case PostProcess::NightVision:
+		return RowsForOffset(0.003f, height);
+
+	// Rounds to the nearest row that is a multiple of 4
+	case PostProcess::GameBoy:
+		return 3;
+
+	// The separable blur's kernel, 3 sigma each side
+	case PostProcess::GaussianBlurVertical:
+		return static_cast<int>(GaussianBlurWeights(constants.blurAmount * GaussianSigmaPerBlurAmount).size()) - 1;
+
+	// Vertical offsets of up to 1 / width in UV (the shader mixes up width and height)
+	case PostProcess::DualFiltering:
+		return RowsForOffset(1.0f / width, height);
+
+	default:
+		return -1;
+	}
+}
+
+
+// Size in bytes of the largest cache on this machine
+size_t LastLevelCacheBytes()
+{
+	size_t cacheBytes = 0;
+
+#ifdef _WIN32
+	DWORD length = 0;
+	GetLogicalProcessorInformation(nullptr, &length);
+	std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+	if (!info.empty() && GetLogicalProcessorInformation(info.data(), &length))
+	{
+		int level = 0;
+		for (const SYSTEM_LOGICAL_PROCESSOR_INFORMATION& entry : info)
+		{
+			if (entry.Relationship != RelationCache || entry.Cache.Level < level)  continue;
+			if (entry.Cache.Level > level)  cacheBytes = 0;
+			level = entry.Cache.Level;
+			cacheBytes = std::max(cacheBytes, static_cast<size_t>(entry.Cache.Size));
+		}
+	}
+#else
+	// The cache size names are a glibc extension
+	#ifdef _SC_LEVEL3_CACHE_SIZE
+		long size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+		if (size <= 0)  size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+		if (size > 0)  cacheBytes = static_cast<size_t>(size);
+	#endif
+#endif
+
+	return (cacheBytes != 0) ? cacheBytes : DefaultCacheBytes;
+}
+
+
+// Height of the tiles for a group of passes over images of the given size
+int TileFusionRows(size_t cacheBytes, int width, int height, int numStages)
+{
+	// A tile holds rows of every stage's output and of the group's input
+	size_t rowBytes = static_cast<size_t>(width) * sizeof(ColourRGBA) * (numStages + 1);
+	int rows = static_cast<int>(cacheBytes / 2 / std::max(rowBytes, static_cast<size_t>(1)));
+	return std::min(std::max(rows, MinTileRows), std::max(height, 1));
+}
+
+
+// Run a group of passes tile by tile over an image of the given height
+void RunTileFused(int height, int tileRows, const std::vector<TileFusionStage>& stages)
+{
+	if (stages.empty())  return;
+
+	int numStages = static_cast<int>(stages.size());
+	std::vector<int> shaded(numStages, 0); // Rows from the top that each stage has shaded
+	std::vector<int> needed(numStages);
+	tileRows = std::max(tileRows, 1);
+
+	for (int tileBottom = std::min(tileRows, height); ; tileBottom = std::min(tileBottom + tileRows, height))
+	{
+		// Rows each stage must have shaded for the last stage to finish this tile
+		needed[numStages - 1] = tileBottom;
+		for (int stage = numStages - 2; stage >= 0; --stage)
+		{
+			needed[stage] = std::min(needed[stage + 1] + stages[stage + 1].footprintRows, height);
+		}
+
+		for (int stage = 0; stage < numStages; ++stage)
+		{
+			if (needed[stage] > shaded[stage])
+			{
+				stages[stage].run(shaded[stage], needed[stage]);
+				shaded[stage] = needed[stage];
+			}
+		}
+
+		if (tileBottom >= height)  break;
+	}
+}
@@ -0,0 +1,71 @@
+//--------------------------------------------------------------------------------------
+// Tile-fused execution of consecutive passes for CPU images
+//--------------------------------------------------------------------------------------
+// Run pass by pass, every pass streams the whole image out of cache to memory and the next pass
+// streams it back in. Tile fusion instead runs a group of consecutive passes one tile at a time:
+// every pass in the group processes the tile before the next tile is started, so each intermediate
+// result is read back by the following pass while it is still in cache.
+// A pass may read a few pixels around the one it shades (its sample footprint), so each pass must
+// run a halo of rows ahead of the pass that reads it. Tiles are the full width of the image, which
+// needs a halo only above and below. Rows finished for an earlier tile are kept rather than shaded
+// again, so the halo is never recomputed and results are identical to running the passes one by one.
+// Tile height is chosen so the rows a tile uses from every pass fit in the last level cache. Code in
+// .cpp file
+
+#ifndef _TILE_FUSION_H_INCLUDED_
+#define _TILE_FUSION_H_INCLUDED_
+
+#include "PostProcess.h"
+
+#include <cstddef>
+#include <functional>
+#include <vector>
+
+
+// One pass of a tile-fused group
+struct TileFusionStage
+{
+	int footprintRows = 0; // Distance in rows above or below a pixel that the pass reads its input from
+
+	// Shade rows top->bottom-1 of the pass's output, reading the output of the previous stage (or the group input). May use the
+	// thread pool. Each row is shaded exactly once
+	std::function<void(int top, int bottom)> run;
+};
+
+
+// Estimated memory traffic of the last call to CpuPostProcessor::Execute. Each step (a pass, or a chain of colour-only passes
+// run as one) is counted as reading its input image and writing its output image once. In a fused group an intermediate image
+// is still written back to memory when it leaves the cache, but the read by the next step comes from cache and is not counted
+struct TileFusionStats
+{
+	int    fusedGroups     = 0; // Groups of passes run tile by tile
+	int    fusedPasses     = 0; // Passes in those groups (counting each pass in a chain)
+	int    tileRows        = 0; // Tile height used by the last group
+	size_t passByPassBytes = 0; // Traffic running every step separately
+	size_t fusedBytes      = 0; // Traffic with the groups fused
+};
+
+
+// Whether a full-screen post-process can be part of a tile-fused group. True for per-pixel post-processes that read their
+// input within a fixed distance, don't use history (PostProcessHistoryRead) and don't run on the whole image at once
+bool CanTileFuse(PostProcess postProcess);
+
+// Distance in rows above or below a pixel that a full-screen post-process reads the scene texture from, as it runs in the CPU
+// pipeline with the given constants (e.g. the Gaussian blurs use the separable blur, not the 9 shader taps). Returns -1 for a
+// post-process without a fixed footprint
+int SampleFootprintRows(PostProcess postProcess, const PostProcessingConstants& constants, int width, int height);
+
+// Size in bytes of the largest cache on this machine (usually the level 3 cache, which is shared by the cores). A typical size
+// is returned if it can't be found
+size_t LastLevelCacheBytes();
+
+// Height of the tiles for a group of passes over images of the given size, so the rows of every pass's output used by one tile
+// fill about half of a cache of the given size (leaving the rest for textures and other data)
+int TileFusionRows(size_t cacheBytes, int width, int height, int numStages);
+
+// Run a group of passes tile by tile over an image of the given height. Tiles are tileRows high and cover the full width.
+// Before each stage shades a tile, the previous stage has shaded all the rows it will read
+void RunTileFused(int height, int tileRows, const std::vector<TileFusionStage>& stages);
+
+
+#endif //_TILE_FUSION_H_INCLUDED_
@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// Colour Matrix Post-Processing Pixel Shader
+//--------------------------------------------------------------------------------------
+// Applies a run of colour-only post-processes (Sepia, Inverted, Tint and the vertical colour gradients)
+// in one pass. The C++ side combines them into a few colour transforms (see SetColourMatrixConstants)
+
+#include "Common.hlsli"
+
+
+//--------------------------------------------------------------------------------------
+// Textures (texture maps)
+//--------------------------------------------------------------------------------------
+
+// The scene has been rendered to a texture, these variables allow access to that texture
+Texture2D SceneTexture : register(t0);
+SamplerState PointSample : register(s0); // We don't usually want to filter (bilinear, trilinear etc.) the scene texture when
+                                          // post-processing so this sampler will use "point sampling" - no filtering
+
+
+//--------------------------------------------------------------------------------------
+// Shader code
+//--------------------------------------------------------------------------------------
+
+// Post-processing shader that applies each colour transform in the constant buffer in turn
+float4 main(PostProcessingInput input) : SV_Target
+{
+    float3 colour = SceneTexture.Sample(PointSample, input.sceneUV).rgb;
+
+    for (int i = 0; i < gNumColourTransforms; ++i)
+    {
+        // Each row of the transform (red, green and blue weights then a constant) changes from the top to the bottom of the screen
+        float4 red   = lerp(gColourTransformTop[i * 3 + 0], gColourTransformBottom[i * 3 + 0], input.sceneUV.y);
+        float4 green = lerp(gColourTransformTop[i * 3 + 1], gColourTransformBottom[i * 3 + 1], input.sceneUV.y);
+        float4 blue  = lerp(gColourTransformTop[i * 3 + 2], gColourTransformBottom[i * 3 + 2], input.sceneUV.y);
+        colour = float3(dot(red.rgb, colour) + red.a, dot(green.rgb, colour) + green.a, dot(blue.rgb, colour) + blue.a);
+    }
+
+	// Got the RGB from the scene texture, set alpha to 1 for final output
+    return float4(colour, 1.0f);
+}
@@ -7,6 +7,7 @@
 #include "CVector2.h"
 #include "CVector3.h"
 #include "CMatrix4x4.h"
+#include "PostProcess.h"
 
 #include <d3d11.h>
 #include <string>
@@ -106,64 +107,7 @@ extern ID3D11Buffer*     gPerModelConstantBuffer; // This variable controls the
 
 //**************************
 
-// Settings used by post-processes - must match the similar structure in the Common.hlsli shader file
-struct PostProcessingConstants
-{
-	CVector2 area2DTopLeft; // Top-left of post-process area on screen, provided as coordinate from 0.0->1.0 not as a pixel coordinate
-	CVector2 area2DSize;    // Size of post-process area on screen, provided as sizes from 0.0->1.0 (1 = full screen) not as a size in pixels
-	float    area2DDepth;   // Depth buffer value for area (0.0 nearest to 1.0 furthest). Full screen post-processing uses 0.0f
-	CVector3 paddingA;      // Pad things to collections of 4 floats (see notes in earlier labs to read about padding)
-
-	CVector4 polygon2DPoints[4]; // Four points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
-
-	// Tint post-process settings
-	int kawaseIter;
-	CVector3 paddingB;
-
-	// Grey noise post-process settings
-    CVector2 noiseScale;
-	CVector2 noiseOffset;
-
-	// Burn post-process settings
-	float    burnHeight;
-	CVector3 paddingC;
-
-	// DOF post-process settings
-	float distanceToFocusedObject;
-	CVector3 paddingD;
-
-	// Gaussian Blur post-process settings
-	float    blurAmount;
-	CVector3 paddingE;
-
-	// Spiral post-process settings
-	float    spiralLevel;
-	CVector3 paddingF;
-
-	// Heat haze post-process settings
-	float    heatHazeTimer;
-	CVector3 paddingG;
-
-	// UnderWater post-process settings
-	float    underWaterTimer;
-	CVector3 paddingH;
-
-	// Hue Vertical Colour Gradient post-process settings
-	float elapsedTime;
-	CVector3 paddingI;
-	float period;
-	CVector3 paddingJ;
-
-	// Vertical Colour Gradient post-process settings
-	CVector3 topColour;
-	CVector3 bottomColour;
-	float paddingK;
-
-	// Dualfiltering post-process settings
-	float dualFilterIteration;
-	CVector3 paddingL;
-
-};
+// Settings used by post-processes are in PostProcess.h (shared with the CPU post-processing pipeline)
 extern PostProcessingConstants gPostProcessingConstants;      // This variable holds the CPU-side constant buffer described above
 extern ID3D11Buffer*           gPostProcessingConstantBuffer; // This variable controls the GPU-side constant buffer related to the above structure
 
@@ -99,6 +99,8 @@ cbuffer PerFrameConstants : register(b0) // The b0 gives this constant buffer th
 
 
 static const int MAX_BONES = 64;
+static const int MAX_POLYGON_POINTS = 16; // Must match PostProcess.h
+static const int MAX_COLOUR_TRANSFORMS = 4; // Must match PostProcess.h
 
 // If we have multiple models then we need to update the world matrix from C++ to GPU multiple times per frame because we
 // only have one world matrix here. Because this data is updated more frequently it is kept in a different buffer for better performance.
@@ -127,7 +129,10 @@ cbuffer PostProcessingConstants : register(b1)
 	float  gArea2DDepth;   // Depth buffer value for area (0.0 nearest to 1.0 furthest). Full screen post-processing uses 0.0f
 	float3 paddingA;       // Pad things to collections of 4 floats (see notes in earlier labs to read about padding)
 
-  	float4 gPolygon2DPoints[4]; // Four points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
+  	float4 gPolygon2DPoints[MAX_POLYGON_POINTS]; // Points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
+  	float4 gPolygonAreaUVs[MAX_POLYGON_POINTS];  // Area UV of each point of the polygon in x and y (z and w unused)
+	int    gNumPolygonPoints;
+	float3 paddingM;
 
     
 	// Tint post-process settings
@@ -176,7 +181,12 @@ cbuffer PostProcessingConstants : register(b1)
     // Dualfiltering post-process settings
     float gDualFilterIteration;
     float3 paddingL;
-    
+
+    // Colour matrix post-process settings - three rows for each transform, at the top and bottom of the screen
+    float4 gColourTransformTop[MAX_COLOUR_TRANSFORMS * 3];
+    float4 gColourTransformBottom[MAX_COLOUR_TRANSFORMS * 3];
+    int    gNumColourTransforms;
+    float3 paddingO;
 }
 
 //**************************
@@ -261,6 +261,53 @@ CMatrix4x4 InverseAffine(const CMatrix4x4& m)
 }
 
 
+// Return the inverse of any invertible matrix, e.g. a view-projection matrix. Slower than InverseAffine
+// Uses the cofactors of the matrix, two rows at a time (2x2 determinants of the top and bottom halves)
+CMatrix4x4 Inverse(const CMatrix4x4& m)
+{
+    // 2x2 determinants from the top two rows and the bottom two rows
+    float s0 = m.e00*m.e11 - m.e10*m.e01;
+    float s1 = m.e00*m.e12 - m.e10*m.e02;
+    float s2 = m.e00*m.e13 - m.e10*m.e03;
+    float s3 = m.e01*m.e12 - m.e11*m.e02;
+    float s4 = m.e01*m.e13 - m.e11*m.e03;
+    float s5 = m.e02*m.e13 - m.e12*m.e03;
+
+    float c5 = m.e22*m.e33 - m.e32*m.e23;
+    float c4 = m.e21*m.e33 - m.e31*m.e23;
+    float c3 = m.e21*m.e32 - m.e31*m.e22;
+    float c2 = m.e20*m.e33 - m.e30*m.e23;
+    float c1 = m.e20*m.e32 - m.e30*m.e22;
+    float c0 = m.e20*m.e31 - m.e30*m.e21;
+
+    float det = s0*c5 - s1*c4 + s2*c3 + s3*c2 - s4*c1 + s5*c0;
+    float invDet = 1.0f / det;
+
+    CMatrix4x4 mOut;
+    mOut.e00 = ( m.e11*c5 - m.e12*c4 + m.e13*c3) * invDet;
+    mOut.e01 = (-m.e01*c5 + m.e02*c4 - m.e03*c3) * invDet;
+    mOut.e02 = ( m.e31*s5 - m.e32*s4 + m.e33*s3) * invDet;
+    mOut.e03 = (-m.e21*s5 + m.e22*s4 - m.e23*s3) * invDet;
+
+    mOut.e10 = (-m.e10*c5 + m.e12*c2 - m.e13*c1) * invDet;
+    mOut.e11 = ( m.e00*c5 - m.e02*c2 + m.e03*c1) * invDet;
+    mOut.e12 = (-m.e30*s5 + m.e32*s2 - m.e33*s1) * invDet;
+    mOut.e13 = ( m.e20*s5 - m.e22*s2 + m.e23*s1) * invDet;
+
+    mOut.e20 = ( m.e10*c4 - m.e11*c2 + m.e13*c0) * invDet;
+    mOut.e21 = (-m.e00*c4 + m.e01*c2 - m.e03*c0) * invDet;
+    mOut.e22 = ( m.e30*s4 - m.e31*s2 + m.e33*s0) * invDet;
+    mOut.e23 = (-m.e20*s4 + m.e21*s2 - m.e23*s0) * invDet;
+
+    mOut.e30 = (-m.e10*c3 + m.e11*c1 - m.e12*c0) * invDet;
+    mOut.e31 = ( m.e00*c3 - m.e01*c1 + m.e02*c0) * invDet;
+    mOut.e32 = (-m.e30*s3 + m.e31*s1 - m.e32*s0) * invDet;
+    mOut.e33 = ( m.e20*s3 - m.e21*s1 + m.e22*s0) * invDet;
+
+    return mOut;
+}
+
+
 // Make this matrix an affine 3D transformation matrix to face from current position to given target (in the Z direction)
 // Will retain the matrix's current scaling
 void CMatrix4x4::FaceTarget(const CVector3& target)
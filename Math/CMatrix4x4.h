@@ -117,5 +117,8 @@ CMatrix4x4 MatrixScaling(const float s);
 // Advanced calulation needed to get the view matrix from the camera's positioning matrix
 CMatrix4x4 InverseAffine(const CMatrix4x4& m);
 
+// Return the inverse of any invertible matrix, e.g. a view-projection matrix. Slower than InverseAffine
+CMatrix4x4 Inverse(const CMatrix4x4& m);
+
 
 #endif // _CMATRIX4X4_H_DEFINED_
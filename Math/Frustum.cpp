@@ -0,0 +1,222 @@
+//--------------------------------------------------------------------------------------
+// Bounding volumes and view frustum tests, for culling models that are off-screen
+//--------------------------------------------------------------------------------------
+
+#include "Frustum.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define FRUSTUM_SSE
+#endif
+
+static_assert(sizeof(BoundingSphere) == 4 * sizeof(float), "CullSpheres loads a sphere as four floats");
+
+
+namespace
+{
+	// a + b * scale for the four components, CVector4 has no arithmetic operators
+	CVector4 AddScaled(const CVector4& a, const CVector4& b, float scale)
+	{
+		return { a.x + b.x * scale, a.y + b.y * scale, a.z + b.z * scale, a.w + b.w * scale };
+	}
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Bounding volumes
+-----------------------------------------------------------------------------------------*/
+
+// Empty bounding volumes, to be grown with Union
+BoundingBox EmptyBoundingBox()
+{
+	const float big = std::numeric_limits<float>::max();
+	return { { big, big, big }, { -big, -big, -big } };
+}
+
+BoundingSphere EmptyBoundingSphere()
+{
+	return { { 0, 0, 0 }, -1.0f };
+}
+
+
+// Bounding box of a list of points, empty if there are none
+BoundingBox BoundingBoxOfPoints(const CVector3* points, size_t numPoints)
+{
+	BoundingBox box = EmptyBoundingBox();
+	for (size_t i = 0; i < numPoints; ++i)
+	{
+		box.minimum = { std::min(box.minimum.x, points[i].x), std::min(box.minimum.y, points[i].y), std::min(box.minimum.z, points[i].z) };
+		box.maximum = { std::max(box.maximum.x, points[i].x), std::max(box.maximum.y, points[i].y), std::max(box.maximum.z, points[i].z) };
+	}
+	return box;
+}
+
+
+// Bounding sphere of a list of points, centred on their bounding box. Empty if there are none
+BoundingSphere BoundingSphereOfPoints(const CVector3* points, size_t numPoints)
+{
+	if (numPoints == 0)  return EmptyBoundingSphere();
+
+	BoundingBox box = BoundingBoxOfPoints(points, numPoints);
+	CVector3 centre = (box.minimum + box.maximum) * 0.5f;
+
+	// Furthest point from the centre, usually well inside the box's corners
+	float radiusSquared = 0;
+	for (size_t i = 0; i < numPoints; ++i)
+	{
+		CVector3 offset = points[i] - centre;
+		radiusSquared = std::max(radiusSquared, Dot(offset, offset));
+	}
+	return { centre, std::sqrt(radiusSquared) };
+}
+
+
+// Smallest box / sphere containing both volumes. Either can be empty
+BoundingBox Union(const BoundingBox& a, const BoundingBox& b)
+{
+	return { { std::min(a.minimum.x, b.minimum.x), std::min(a.minimum.y, b.minimum.y), std::min(a.minimum.z, b.minimum.z) },
+	         { std::max(a.maximum.x, b.maximum.x), std::max(a.maximum.y, b.maximum.y), std::max(a.maximum.z, b.maximum.z) } };
+}
+
+BoundingSphere Union(const BoundingSphere& a, const BoundingSphere& b)
+{
+	if (a.IsEmpty())  return b;
+	if (b.IsEmpty())  return a;
+
+	CVector3 offset = b.centre - a.centre;
+	float distance = Length(offset);
+	if (distance + b.radius <= a.radius)  return a; // One sphere inside the other
+	if (distance + a.radius <= b.radius)  return b;
+
+	// New sphere touches the far side of each
+	float radius = (distance + a.radius + b.radius) * 0.5f;
+	return { a.centre + offset * ((radius - a.radius) / distance), radius };
+}
+
+
+// Bounds of a volume after transformation by an affine matrix. Each axis of the new box gets the largest and smallest
+// contribution from each row of the matrix
+BoundingBox TransformBoundingBox(const BoundingBox& box, const CMatrix4x4& matrix)
+{
+	if (box.IsEmpty())  return box;
+
+	CVector3 minimum = matrix.GetRow(3);
+	CVector3 maximum = minimum;
+	const float boxMinimum[3] = { box.minimum.x, box.minimum.y, box.minimum.z };
+	const float boxMaximum[3] = { box.maximum.x, box.maximum.y, box.maximum.z };
+	for (int row = 0; row < 3; ++row)
+	{
+		CVector3 axis = matrix.GetRow(row);
+		CVector3 a = axis * boxMinimum[row];
+		CVector3 b = axis * boxMaximum[row];
+		minimum = minimum + CVector3{ std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z) };
+		maximum = maximum + CVector3{ std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z) };
+	}
+	return { minimum, maximum };
+}
+
+BoundingSphere TransformBoundingSphere(const BoundingSphere& sphere, const CMatrix4x4& matrix)
+{
+	if (sphere.IsEmpty())  return sphere;
+
+	CVector4 centre = CVector4(sphere.centre, 1) * matrix;
+	float scale = std::max({ Length(matrix.GetRow(0)), Length(matrix.GetRow(1)), Length(matrix.GetRow(2)) });
+	return { { centre.x, centre.y, centre.z }, sphere.radius * scale };
+}
+
+
+/*-----------------------------------------------------------------------------------------
+	Frustum tests
+-----------------------------------------------------------------------------------------*/
+
+// Frustum of a view-projection matrix. A point p is visible when clip space x = p . column 0 is between -w and w (w = p . column 3),
+// similarly y, and z = p . column 2 is between 0 and w. Each limit is a plane made from sums / differences of matrix columns
+Frustum FrustumFromMatrix(const CMatrix4x4& m)
+{
+	CVector4 column0 = { m.e00, m.e10, m.e20, m.e30 };
+	CVector4 column1 = { m.e01, m.e11, m.e21, m.e31 };
+	CVector4 column2 = { m.e02, m.e12, m.e22, m.e32 };
+	CVector4 column3 = { m.e03, m.e13, m.e23, m.e33 };
+
+	Frustum frustum;
+	frustum.planes[0] = AddScaled(column3, column0,  1); // Left
+	frustum.planes[1] = AddScaled(column3, column0, -1); // Right
+	frustum.planes[2] = AddScaled(column3, column1,  1); // Bottom
+	frustum.planes[3] = AddScaled(column3, column1, -1); // Top
+	frustum.planes[4] = column2;                         // Near
+	frustum.planes[5] = AddScaled(column3, column2, -1); // Far
+
+	// Normalise so distances from the planes are in world units, for comparison with sphere radii
+	for (auto& plane : frustum.planes)
+	{
+		float length = Length(CVector3(plane.x, plane.y, plane.z));
+		plane = { plane.x / length, plane.y / length, plane.z / length, plane.w / length };
+	}
+	return frustum;
+}
+
+
+// Whether a sphere might be visible - it is not entirely outside one of the planes
+bool IsVisible(const Frustum& frustum, const BoundingSphere& sphere)
+{
+	if (sphere.IsEmpty())  return false;
+	for (auto& plane : frustum.planes)
+	{
+		float distance = plane.x * sphere.centre.x + plane.y * sphere.centre.y + plane.z * sphere.centre.z + plane.w;
+		if (distance < -sphere.radius)  return false;
+	}
+	return true;
+}
+
+// Whether a box might be visible. For each plane only the corner furthest along the plane's normal needs testing
+bool IsVisible(const Frustum& frustum, const BoundingBox& box)
+{
+	if (box.IsEmpty())  return false;
+	for (auto& plane : frustum.planes)
+	{
+		float x = plane.x >= 0 ? box.maximum.x : box.minimum.x;
+		float y = plane.y >= 0 ? box.maximum.y : box.minimum.y;
+		float z = plane.z >= 0 ? box.maximum.z : box.minimum.z;
+		if (plane.x * x + plane.y * y + plane.z * z + plane.w < 0)  return false;
+	}
+	return true;
+}
+
+
+// Test a list of spheres at once. Four spheres are loaded and transposed so each register holds one of centre x, y, z or
+// radius for all four, then each plane is tested against all four spheres together
+void CullSpheres(const Frustum& frustum, const BoundingSphere* spheres, int numSpheres, bool* visible)
+{
+	int sphere = 0;
+
+#if defined(FRUSTUM_SSE)
+	const float* sphereFloats = reinterpret_cast<const float*>(spheres);
+	for (; sphere + 4 <= numSpheres; sphere += 4)
+	{
+		__m128 x      = _mm_loadu_ps(sphereFloats + sphere * 4);
+		__m128 y      = _mm_loadu_ps(sphereFloats + sphere * 4 + 4);
+		__m128 z      = _mm_loadu_ps(sphereFloats + sphere * 4 + 8);
+		__m128 radius = _mm_loadu_ps(sphereFloats + sphere * 4 + 12);
+		_MM_TRANSPOSE4_PS(x, y, z, radius);
+
+		// Visible while every plane distance is at least -radius. Empty spheres have a negative radius so are rejected below
+		__m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+		__m128 inside = _mm_cmpge_ps(radius, _mm_setzero_ps());
+		for (auto& plane : frustum.planes)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)), _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+			                             _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)), _mm_set1_ps(plane.w)));
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, negativeRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (int i = 0; i < 4; ++i)  visible[sphere + i] = (mask & (1 << i)) != 0;
+	}
+#endif
+
+	// Remaining spheres (or all of them without SSE)
+	for (; sphere < numSpheres; ++sphere)  visible[sphere] = IsVisible(frustum, spheres[sphere]);
+}
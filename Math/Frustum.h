@@ -0,0 +1,84 @@
+//--------------------------------------------------------------------------------------
+// Bounding volumes and view frustum tests, for culling models that are off-screen
+//--------------------------------------------------------------------------------------
+// A frustum is six planes taken from a view-projection matrix (D3D clip space, depth 0->1), each
+// facing inwards and normalised so plane distances are in world units. Boxes are axis-aligned.
+// Tests are conservative: something reported outside is certainly off-screen, but a volume near
+// a corner of the frustum can be reported inside when it is not. CullSpheres tests four spheres
+// per SSE instruction against each plane. Code in .cpp file
+
+#ifndef _FRUSTUM_H_DEFINED_
+#define _FRUSTUM_H_DEFINED_
+
+#include "CVector3.h"
+#include "CVector4.h"
+#include "CMatrix4x4.h"
+#include <cstddef>
+
+
+// Axis-aligned bounding box. An empty box has minimum greater than maximum
+struct BoundingBox
+{
+	CVector3 minimum;
+	CVector3 maximum;
+
+	bool IsEmpty() const  { return minimum.x > maximum.x; }
+};
+
+// Bounding sphere. An empty sphere has a negative radius. Four floats so CullSpheres can load one per SSE register
+struct BoundingSphere
+{
+	CVector3 centre;
+	float    radius;
+
+	bool IsEmpty() const  { return radius < 0; }
+};
+
+// Frustum planes (x, y, z) . p + w >= 0 inside, in the order left, right, bottom, top, near, far
+struct Frustum
+{
+	CVector4 planes[6];
+};
+
+
+/*-----------------------------------------------------------------------------------------
+	Bounding volumes
+-----------------------------------------------------------------------------------------*/
+
+// Empty bounding volumes, to be grown with Union
+BoundingBox    EmptyBoundingBox();
+BoundingSphere EmptyBoundingSphere();
+
+// Bounding box of a list of points, empty if there are none
+BoundingBox BoundingBoxOfPoints(const CVector3* points, size_t numPoints);
+
+// Bounding sphere of a list of points, centred on their bounding box. Empty if there are none
+BoundingSphere BoundingSphereOfPoints(const CVector3* points, size_t numPoints);
+
+// Smallest box / sphere containing both volumes. Either can be empty
+BoundingBox    Union(const BoundingBox& a, const BoundingBox& b);
+BoundingSphere Union(const BoundingSphere& a, const BoundingSphere& b);
+
+// Bounds of a volume after transformation by an affine matrix (row vectors, as world matrices). The box is the bounding box of
+// the transformed box, the sphere radius is scaled by the matrix's largest scale
+BoundingBox    TransformBoundingBox(const BoundingBox& box, const CMatrix4x4& matrix);
+BoundingSphere TransformBoundingSphere(const BoundingSphere& sphere, const CMatrix4x4& matrix);
+
+
+/*-----------------------------------------------------------------------------------------
+	Frustum tests
+-----------------------------------------------------------------------------------------*/
+
+// Frustum of a view-projection matrix, e.g. Camera::ViewProjectionMatrix(). Also works with a world-view-projection matrix to
+// get the frustum in model space
+Frustum FrustumFromMatrix(const CMatrix4x4& viewProjectionMatrix);
+
+// Whether a volume might be visible, i.e. is not entirely outside one of the planes. Empty volumes are never visible
+bool IsVisible(const Frustum& frustum, const BoundingSphere& sphere);
+bool IsVisible(const Frustum& frustum, const BoundingBox& box);
+
+// Test a list of spheres at once, setting visible[i] as IsVisible does for spheres[i]
+void CullSpheres(const Frustum& frustum, const BoundingSphere* spheres, int numSpheres, bool* visible);
+
+
+#endif // _FRUSTUM_H_DEFINED_
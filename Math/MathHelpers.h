@@ -7,10 +7,11 @@
 
 #include <cmath>
 #include <stdint.h>
+#include <stdlib.h>
 
 
 // Surprisingly, pi is not *officially* defined anywhere in C++
-const float PI = 3.14159265359f;
+constexpr float PI = 3.14159265359f;
 
 
 
@@ -44,6 +45,27 @@ constexpr float ToDegrees(float r)
 
 
 
+// Clamp a value to the range 0->1 (same as HLSL saturate)
+inline float Saturate(const float x)
+{
+    return x < 0.0f ? 0.0f : (x > 1.0f ? 1.0f : x);
+}
+
+// Linear interpolation from a to b by t (same as HLSL lerp)
+inline float Lerp(const float a, const float b, const float t)
+{
+    return a + (b - a) * t;
+}
+
+// Smooth hermite interpolation from 0 to 1 as x moves from edge0 to edge1 (same as HLSL smoothstep)
+inline float SmoothStep(const float edge0, const float edge1, const float x)
+{
+    float t = Saturate((x - edge0) / (edge1 - edge0));
+    return t * t * (3.0f - 2.0f * t);
+}
+
+
+
 // Return random integer from a to b (inclusive)
 // Can only return up to RAND_MAX different values, spread evenly across the given range
 // RAND_MAX is defined in stdlib.h and is compiler-specific (32767 on VS-2005, higher elsewhere)
@@ -10,13 +10,228 @@
 #include "GraphicsHelpers.h" // Helper functions to unclutter the code here
 #include "CVector2.h" 
 #include "CVector3.h" 
+#include "BinaryFile.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 #include <assimp/DefaultLogger.hpp>
 
+#include <cstring>
 #include <memory>
+#include <mutex>
+
+
+namespace
+{
+	// Assimp's logger is global, so meshes loaded on several threads at once (see InitGeometry in Scene.cpp) take turns to import.
+	// Meshes read from the cache don't use assimp so still load in parallel
+	std::mutex gImportMutex;
+
+
+	//--------------------------------------------------------------------------------------
+	// Vertex layout
+	//--------------------------------------------------------------------------------------
+
+	// Optional parts of a vertex. Every vertex starts with a position and normal, the parts present follow in this order
+	const unsigned int VertexTangent = 1;
+	const unsigned int VertexUV      = 2;
+	const unsigned int VertexBones   = 4; // Four bone indexes in bytes followed by four weights
+
+	// Size of a vertex and where each part is within it
+	struct VertexLayout
+	{
+		unsigned int size;
+		unsigned int positionOffset;
+		unsigned int normalOffset;
+		unsigned int tangentOffset;
+		unsigned int uvOffset;
+		unsigned int bonesOffset;
+	};
+
+	VertexLayout MakeVertexLayout(unsigned int parts)
+	{
+		VertexLayout layout;
+		unsigned int offset = 0;
+		layout.positionOffset = offset;  offset += 12;
+		layout.normalOffset   = offset;  offset += 12;
+		layout.tangentOffset  = offset;  if (parts & VertexTangent)  offset += 12;
+		layout.uvOffset       = offset;  if (parts & VertexUV)       offset += 8;
+		layout.bonesOffset    = offset;  if (parts & VertexBones)    offset += 20;
+		layout.size = offset;
+		return layout;
+	}
+
+	// DirectX specification of a vertex with the given parts
+	std::vector<D3D11_INPUT_ELEMENT_DESC> MakeVertexElements(unsigned int parts)
+	{
+		VertexLayout layout = MakeVertexLayout(parts);
+		std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
+		vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, layout.positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		vertexElements.push_back({ "normal",   0, DXGI_FORMAT_R32G32B32_FLOAT, 0, layout.normalOffset,   D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		if (parts & VertexTangent)
+		{
+			vertexElements.push_back({ "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, layout.tangentOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		}
+		if (parts & VertexUV)
+		{
+			vertexElements.push_back({ "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, layout.uvOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		}
+		if (parts & VertexBones)
+		{
+			vertexElements.push_back({ "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, layout.bonesOffset,     D3D11_INPUT_PER_VERTEX_DATA, 0 });
+			vertexElements.push_back({ "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, layout.bonesOffset + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
+		}
+		return vertexElements;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Mesh cache
+	//--------------------------------------------------------------------------------------
+	// A cache file is a header, then each node, then each sub-mesh. Every record is followed by its arrays and everything is
+	// padded to 4 bytes, so the vertices and indices can be given to CreateBuffer straight from the mapped file
+
+	// Increase when the file layout or the import (the flags and settings in the Mesh constructor) changes, old cache files
+	// are then imported again
+	const uint32_t MeshCacheVersion = 1;
+	const char     MeshCacheMagic[4] = { 'M', 'E', 'S', 'H' };
+
+	struct MeshCacheHeader
+	{
+		char     magic[4];
+		uint32_t version;
+		uint64_t key;      // Hash of the mesh file, the import flags and the version
+		uint64_t fileSize; // Size of the whole cache file, to detect truncation
+		uint32_t numNodes;
+		uint32_t numSubMeshes;
+		uint32_t hasBones;
+		uint32_t padding;
+	};
+
+	// Followed by the node's name, its child node indexes and its sub-mesh indexes
+	struct MeshCacheNode
+	{
+		float    defaultMatrix[16];
+		float    offsetMatrix[16];
+		uint32_t parentIndex;
+		uint32_t nameLength;
+		uint32_t numChildNodes;
+		uint32_t numSubMeshes;
+	};
+
+	// Followed by the vertices and the (32-bit) indices
+	struct MeshCacheSubMesh
+	{
+		uint32_t vertexParts;
+		uint32_t vertexSize;
+		uint32_t numVertices;
+		uint32_t numIndices;
+	};
+
+	static_assert(sizeof(CMatrix4x4) == sizeof(MeshCacheNode::defaultMatrix), "Matrices are copied directly to and from the cache");
+
+
+	// Append an array to cache data, padded to 4 bytes
+	template <typename T>
+	void Append(std::vector<unsigned char>& data, const T* items, size_t count)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(items);
+		data.insert(data.end(), bytes, bytes + count * sizeof(T));
+		data.resize((data.size() + 3) & ~size_t(3), 0);
+	}
+
+	// Reads arrays from cache data as written by Append. Returns nullptr rather than reading past the end
+	class CacheReader
+	{
+	public:
+		CacheReader(const unsigned char* data, size_t size) : mPosition(data), mEnd(data + size) {}
+
+		template <typename T>
+		const T* Read(size_t count = 1)
+		{
+			size_t size = (count * sizeof(T) + 3) & ~size_t(3);
+			if (size > static_cast<size_t>(mEnd - mPosition))  return nullptr;
+			const T* items = reinterpret_cast<const T*>(mPosition);
+			mPosition += size;
+			return items;
+		}
+
+		bool AtEnd() const  { return mPosition == mEnd; }
+
+	private:
+		const unsigned char* mPosition;
+		const unsigned char* mEnd;
+	};
+
+
+	// The parts of a cache file's contents, pointing into the data
+	struct CachedNode
+	{
+		const MeshCacheNode* record;
+		const char*          name;
+		const uint32_t*      childNodes;
+		const uint32_t*      subMeshes;
+	};
+	struct CachedSubMesh
+	{
+		const MeshCacheSubMesh* record;
+		const unsigned char*    vertices;
+		const uint32_t*         indices;
+	};
+	struct CachedMesh
+	{
+		const MeshCacheHeader*     header;
+		std::vector<CachedNode>    nodes;
+		std::vector<CachedSubMesh> subMeshes;
+	};
+
+	// Find and check every part of a cache file's contents. Returns false if the data is incomplete, inconsistent or doesn't have
+	// the given key
+	bool ReadCache(const unsigned char* data, size_t size, uint64_t key, CachedMesh& cached)
+	{
+		CacheReader reader(data, size);
+		auto header = reader.Read<MeshCacheHeader>();
+		if (header == nullptr || std::memcmp(header->magic, MeshCacheMagic, 4) != 0 || header->version != MeshCacheVersion ||
+			header->key != key || header->fileSize != size || header->numSubMeshes == 0 ||
+			header->numNodes > size / sizeof(MeshCacheNode) || header->numSubMeshes > size / sizeof(MeshCacheSubMesh))
+		{
+			return false;
+		}
+		cached.header = header;
+
+		// Find and check each node's data
+		cached.nodes.resize(header->numNodes);
+		for (auto& node : cached.nodes)
+		{
+			node.record = reader.Read<MeshCacheNode>();
+			if (node.record == nullptr)  return false;
+			node.name       = reader.Read<char>(node.record->nameLength);
+			node.childNodes = reader.Read<uint32_t>(node.record->numChildNodes);
+			node.subMeshes  = reader.Read<uint32_t>(node.record->numSubMeshes);
+			if (node.name == nullptr || node.childNodes == nullptr || node.subMeshes == nullptr)  return false;
+			if (node.record->parentIndex >= header->numNodes)  return false;
+			for (uint32_t i = 0; i < node.record->numChildNodes; ++i)  if (node.childNodes[i] >= header->numNodes)  return false;
+			for (uint32_t i = 0; i < node.record->numSubMeshes;  ++i)  if (node.subMeshes[i] >= header->numSubMeshes)  return false;
+		}
+
+		// Find and check each sub-mesh's data. Indices are checked too as the software rasterizer reads vertices with them
+		cached.subMeshes.resize(header->numSubMeshes);
+		for (auto& subMesh : cached.subMeshes)
+		{
+			subMesh.record = reader.Read<MeshCacheSubMesh>();
+			if (subMesh.record == nullptr || subMesh.record->vertexParts > (VertexTangent | VertexUV | VertexBones))  return false;
+			if (subMesh.record->vertexSize != MakeVertexLayout(subMesh.record->vertexParts).size)  return false;
+			if (((subMesh.record->vertexParts & VertexBones) != 0) != (header->hasBones != 0))  return false;
+
+			subMesh.vertices = reader.Read<unsigned char>(static_cast<size_t>(subMesh.record->numVertices) * subMesh.record->vertexSize);
+			subMesh.indices  = reader.Read<uint32_t>(subMesh.record->numIndices);
+			if (subMesh.vertices == nullptr || subMesh.indices == nullptr)  return false;
+			for (uint32_t i = 0; i < subMesh.record->numIndices; ++i)  if (subMesh.indices[i] >= subMesh.record->numVertices)  return false;
+		}
+		return reader.AtEnd();
+	}
+}
 
 
 // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
@@ -63,6 +278,30 @@ Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
 		removeComponents |= aiComponent_TANGENTS_AND_BITANGENTS;
 	}
 
+
+	//-----------------------------------
+
+	// Meshes imported before are loaded from a cache file beside the mesh file, holding the final vertices, indices and nodes.
+	// The cache is keyed by a hash of the mesh file and the import settings so changing either imports the mesh again
+	std::string cacheFileName = fileName + ".cache";
+	uint64_t    cacheKey = 0;
+	MappedFile  meshFile;
+	bool        useCache = meshFile.Open(fileName); // If the file can't be opened leave the import to report the error
+	if (useCache)
+	{
+		cacheKey = HashData(meshFile.Data(), meshFile.Size());
+		cacheKey = HashData(&MeshCacheVersion, sizeof(MeshCacheVersion), cacheKey);
+		cacheKey = HashData(&assimpFlags,      sizeof(assimpFlags),      cacheKey);
+		cacheKey = HashData(&removeComponents, sizeof(removeComponents), cacheKey);
+		meshFile.Close();
+		mCacheKey = cacheKey;
+
+		if (LoadCache(cacheFileName, cacheKey, fileName))  return;
+	}
+
+
+	//-----------------------------------
+
 	// Other miscellaneous settings
 	importer.SetPropertyFloat(AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80.0f); // Smoothing angle for normals
 	importer.SetPropertyInteger(AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);  // Remove points and lines (keep triangles only)
@@ -78,9 +317,13 @@ Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
 	importer.SetPropertyInteger(AI_CONFIG_PP_RVC_FLAGS, removeComponents);
 
 	// Import mesh with assimp given above requirements - log output
-	Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE);
-	const aiScene* scene = importer.ReadFile(fileName, assimpFlags);
-	Assimp::DefaultLogger::kill();
+	const aiScene* scene;
+	{
+		std::lock_guard<std::mutex> importLock(gImportMutex);
+		Assimp::DefaultLogger::create("", Assimp::DefaultLogger::VERBOSE);
+		scene = importer.ReadFile(fileName, assimpFlags);
+		Assimp::DefaultLogger::kill();
+	}
 	if (scene == nullptr)  throw std::runtime_error("Error loading mesh (" + fileName + "). " + importer.GetErrorString());
 	if (scene->mNumMeshes == 0)  throw std::runtime_error("No usable geometry in mesh: " + fileName);
 
@@ -106,6 +349,8 @@ Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
 
 	// A mesh is made of sub-meshes, each one can have a different material (texture)
 	// Import each sub-mesh in the file to seperate index / vertex buffer (could share buffers between sub-meshes but that would make things more complex)
+	// The final data for each sub-mesh is also collected for the cache
+	std::vector<unsigned char> cacheSubMeshes;
 	mSubMeshes.resize(scene->mNumMeshes);
 	for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
 	{
@@ -117,54 +362,30 @@ Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
 		//-----------------------------------
 
 		// Check for presence of position and normal data. Tangents and UVs are optional.
-		std::vector<D3D11_INPUT_ELEMENT_DESC> vertexElements;
-		unsigned int offset = 0;
-
 		if (!assimpMesh->HasPositions())  throw std::runtime_error("No position data for sub-mesh " + subMeshName + " in " + fileName);
-		unsigned int positionOffset = offset;
-		vertexElements.push_back({ "position", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, positionOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-		offset += 12;
-
 		if (!assimpMesh->HasNormals())  throw std::runtime_error("No normal data for sub-mesh " + subMeshName + " in " + fileName);
-		unsigned int normalOffset = offset;
-		vertexElements.push_back({ "normal", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, normalOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-		offset += 12;
 
-		unsigned int tangentOffset = offset;
+		unsigned int vertexParts = 0;
 		if (requireTangents)
 		{
 			if (!assimpMesh->HasTangentsAndBitangents())  throw std::runtime_error("No tangent data for sub-mesh " + subMeshName + " in " + fileName);
-			vertexElements.push_back({ "tangent", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, tangentOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 12;
+			vertexParts |= VertexTangent;
 		}
-
-		unsigned int uvOffset = offset;
 		if (assimpMesh->GetNumUVChannels() > 0 && assimpMesh->HasTextureCoords(0))
 		{
 			if (assimpMesh->mNumUVComponents[0] != 2)  throw std::runtime_error("Unsupported texture coordinates in " + subMeshName + " in " + fileName);
-			vertexElements.push_back({ "uv", 0, DXGI_FORMAT_R32G32_FLOAT, 0, uvOffset, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 8;
+			vertexParts |= VertexUV;
 		}
+		if (mHasBones)  vertexParts |= VertexBones;
 
-		unsigned int bonesOffset = offset;
-		if (mHasBones)
-		{
-			vertexElements.push_back({ "bones"  , 0, DXGI_FORMAT_R8G8B8A8_UINT,      0, bonesOffset,     D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 4;
-			vertexElements.push_back({ "weights", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, bonesOffset + 4, D3D11_INPUT_PER_VERTEX_DATA, 0 });
-			offset += 16;
-		}
-
-		subMesh.vertexSize = offset;
-
-
-		// Create a "vertex layout" to describe to DirectX what is data in each vertex of this mesh
-		auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
-		HRESULT hr = gD3DDevice->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
-			shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),
-			&subMesh.vertexLayout);
-		if (shaderSignature)  shaderSignature->Release();
-		if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + fileName);
+		// Where each part goes in a vertex. The DirectX vertex layout is created from the same parts by CreateSubMesh
+		VertexLayout layout = MakeVertexLayout(vertexParts);
+		unsigned int positionOffset = layout.positionOffset;
+		unsigned int normalOffset   = layout.normalOffset;
+		unsigned int tangentOffset  = layout.tangentOffset;
+		unsigned int uvOffset       = layout.uvOffset;
+		unsigned int bonesOffset    = layout.bonesOffset;
+		subMesh.vertexSize = layout.size;
 
 
 
@@ -331,31 +552,181 @@ Mesh::Mesh(const std::string& fileName, bool requireTangents /*= false*/)
 
 		//-----------------------------------
 
-		D3D11_BUFFER_DESC bufferDesc;
-		D3D11_SUBRESOURCE_DATA initData;
+		// Create the GPU buffers and the CPU-side copy, and add the final vertices and indices to the cache data
+		CreateSubMesh(subMesh, vertexParts, vertices.get(), reinterpret_cast<uint32_t*>(indices.get()), fileName);
+
+		MeshCacheSubMesh cacheSubMesh = { vertexParts, subMesh.vertexSize, subMesh.numVertices, subMesh.numIndices };
+		Append(cacheSubMeshes, &cacheSubMesh, 1);
+		Append(cacheSubMeshes, vertices.get(), subMesh.numVertices * subMesh.vertexSize);
+		Append(cacheSubMeshes, reinterpret_cast<uint32_t*>(indices.get()), subMesh.numIndices);
+	}
+
+	CalculateNodeBounds();
 
-		// Create GPU-side vertex buffer and copy the vertices imported by assimp into it
-		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Indicate it is a vertex buffer
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;          // Default usage for this buffer - we'll see other usages later
-		bufferDesc.ByteWidth = subMesh.numVertices * subMesh.vertexSize; // Size of the buffer in bytes
-		bufferDesc.CPUAccessFlags = 0;
-		bufferDesc.MiscFlags = 0;
-		initData.pSysMem = vertices.get(); // Fill the new vertex buffer with data loaded by assimp
+	// Failure to save only means the next load imports again. The software rasterizer's copy of the geometry is made from the
+	// cache data when it is first needed, so the saved file is kept mapped for that (see LoadCache), or the data kept if unsaved
+	std::vector<unsigned char> cacheData = MakeCacheData(cacheKey, cacheSubMeshes);
+	if (!useCache || !WriteFileReplacing(cacheFileName, cacheData) || !mCacheFile.Open(cacheFileName))
+	{
+		mUnsavedCacheData = std::move(cacheData);
+	}
+}
+
+
+// Set up the mesh from a cache file written by the constructor, if it exists and has the given key. The whole file is checked before
+// anything is created. Returns false if the cache can't be used, the mesh is unchanged in that case. The file stays mapped until the
+// software rasterizer's geometry is made from it, so deleting or rewriting the cache file meanwhile doesn't affect this mesh
+bool Mesh::LoadCache(const std::string& cacheFileName, uint64_t key, const std::string& fileName)
+{
+	if (!mCacheFile.Open(cacheFileName))  return false;
+
+	CachedMesh cache;
+	if (!ReadCache(mCacheFile.Data(), mCacheFile.Size(), key, cache))
+	{
+		mCacheFile.Close();
+		return false;
+	}
+	const auto& nodes     = cache.nodes;
+	const auto& subMeshes = cache.subMeshes;
 
-		hr = gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.vertexBuffer);
-		if (FAILED(hr))  throw std::runtime_error("Failure creating vertex buffer for " + fileName);
 
+	// Cache is good, set up the mesh from it
+	mHasBones = cache.header->hasBones != 0;
 
-		// Create GPU-side index buffer and copy the vertices imported by assimp into it
-		bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER; // Indicate it is an index buffer
-		bufferDesc.Usage = D3D11_USAGE_DEFAULT;         // Default usage for this buffer - we'll see other usages later
-		bufferDesc.ByteWidth = subMesh.numIndices * sizeof(DWORD); // Size of the buffer in bytes
-		bufferDesc.CPUAccessFlags = 0;
-		bufferDesc.MiscFlags = 0;
-		initData.pSysMem = indices.get(); // Fill the new index buffer with data loaded by assimp
+	mNodes.resize(nodes.size());
+	for (size_t n = 0; n < nodes.size(); ++n)
+	{
+		auto& node = mNodes[n];
+		const CachedNode& cached = nodes[n];
+		node.name.assign(cached.name, cached.record->nameLength);
+		std::memcpy(&node.defaultMatrix, cached.record->defaultMatrix, sizeof(node.defaultMatrix));
+		std::memcpy(&node.offsetMatrix,  cached.record->offsetMatrix,  sizeof(node.offsetMatrix));
+		node.parentIndex = cached.record->parentIndex;
+		node.childNodes.assign(cached.childNodes, cached.childNodes + cached.record->numChildNodes);
+		node.subMeshes.assign(cached.subMeshes, cached.subMeshes + cached.record->numSubMeshes);
+	}
 
-		hr = gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.indexBuffer);
-		if (FAILED(hr))  throw std::runtime_error("Failure creating index buffer for " + fileName);
+	// The vertices and indices go to CreateBuffer straight from the mapped file
+	mSubMeshes.resize(subMeshes.size());
+	for (size_t m = 0; m < subMeshes.size(); ++m)
+	{
+		auto& subMesh = mSubMeshes[m];
+		subMesh.vertexSize  = subMeshes[m].record->vertexSize;
+		subMesh.numVertices = subMeshes[m].record->numVertices;
+		subMesh.numIndices  = subMeshes[m].record->numIndices;
+		CreateSubMesh(subMesh, subMeshes[m].record->vertexParts, subMeshes[m].vertices, subMeshes[m].indices, fileName);
+	}
+
+	CalculateNodeBounds();
+	return true;
+}
+
+
+// Make the contents of a cache file for LoadCache from the mesh's nodes and the given sub-mesh data (as collected by the constructor)
+std::vector<unsigned char> Mesh::MakeCacheData(uint64_t key, const std::vector<unsigned char>& subMeshData)
+{
+	std::vector<unsigned char> data;
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, MeshCacheMagic, 4);
+	header.version      = MeshCacheVersion;
+	header.key          = key;
+	header.numNodes     = static_cast<uint32_t>(mNodes.size());
+	header.numSubMeshes = static_cast<uint32_t>(mSubMeshes.size());
+	header.hasBones     = mHasBones ? 1 : 0;
+	Append(data, &header, 1);
+
+	for (auto& node : mNodes)
+	{
+		MeshCacheNode record;
+		std::memcpy(record.defaultMatrix, &node.defaultMatrix, sizeof(record.defaultMatrix));
+		std::memcpy(record.offsetMatrix,  &node.offsetMatrix,  sizeof(record.offsetMatrix));
+		record.parentIndex   = node.parentIndex;
+		record.nameLength    = static_cast<uint32_t>(node.name.size());
+		record.numChildNodes = static_cast<uint32_t>(node.childNodes.size());
+		record.numSubMeshes  = static_cast<uint32_t>(node.subMeshes.size());
+		Append(data, &record, 1);
+		Append(data, node.name.data(), node.name.size());
+		Append(data, node.childNodes.data(), node.childNodes.size());
+		Append(data, node.subMeshes.data(), node.subMeshes.size());
+	}
+
+	data.insert(data.end(), subMeshData.begin(), subMeshData.end());
+
+	// Size is only known now, the header is at the start of the data
+	reinterpret_cast<MeshCacheHeader*>(data.data())->fileSize = data.size();
+	return data;
+}
+
+
+// Create a sub-mesh's vertex layout, GPU buffers and bounds from its final vertex and index data. The vertex size and counts must
+// already be set
+void Mesh::CreateSubMesh(SubMesh& subMesh, unsigned int vertexParts, const unsigned char* vertices, const uint32_t* indices,
+                         const std::string& fileName)
+{
+	// Create a "vertex layout" to describe to DirectX what is data in each vertex of this mesh
+	auto vertexElements = MakeVertexElements(vertexParts);
+	auto shaderSignature = CreateSignatureForVertexLayout(vertexElements.data(), static_cast<int>(vertexElements.size()));
+	HRESULT hr = gD3DDevice->CreateInputLayout(vertexElements.data(), static_cast<UINT>(vertexElements.size()),
+		shaderSignature->GetBufferPointer(), shaderSignature->GetBufferSize(),
+		&subMesh.vertexLayout);
+	if (shaderSignature)  shaderSignature->Release();
+	if (FAILED(hr))  throw std::runtime_error("Failure creating input layout for " + fileName);
+
+
+	//-----------------------------------
+
+	// Bounds for view frustum culling
+	std::vector<CVector3> positions(subMesh.numVertices);
+	for (unsigned int v = 0; v < subMesh.numVertices; ++v)
+	{
+		std::memcpy(&positions[v], vertices + v * subMesh.vertexSize, sizeof(CVector3)); // Position is first in every vertex
+	}
+	subMesh.boundingBox    = BoundingBoxOfPoints(positions.data(), positions.size());
+	subMesh.boundingSphere = BoundingSphereOfPoints(positions.data(), positions.size());
+
+
+	//-----------------------------------
+
+	D3D11_BUFFER_DESC bufferDesc;
+	D3D11_SUBRESOURCE_DATA initData;
+
+	// Create GPU-side vertex buffer and copy the vertices imported by assimp into it
+	bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Indicate it is a vertex buffer
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;          // Default usage for this buffer - we'll see other usages later
+	bufferDesc.ByteWidth = subMesh.numVertices * subMesh.vertexSize; // Size of the buffer in bytes
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags = 0;
+	initData.pSysMem = vertices; // Fill the new vertex buffer with data loaded by assimp
+
+	hr = gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.vertexBuffer);
+	if (FAILED(hr))  throw std::runtime_error("Failure creating vertex buffer for " + fileName);
+
+
+	// Create GPU-side index buffer and copy the vertices imported by assimp into it
+	bufferDesc.BindFlags = D3D11_BIND_INDEX_BUFFER; // Indicate it is an index buffer
+	bufferDesc.Usage = D3D11_USAGE_DEFAULT;         // Default usage for this buffer - we'll see other usages later
+	bufferDesc.ByteWidth = subMesh.numIndices * sizeof(DWORD); // Size of the buffer in bytes
+	bufferDesc.CPUAccessFlags = 0;
+	bufferDesc.MiscFlags = 0;
+	initData.pSysMem = indices; // Fill the new index buffer with data loaded by assimp
+
+	hr = gD3DDevice->CreateBuffer(&bufferDesc, &initData, &subMesh.indexBuffer);
+	if (FAILED(hr))  throw std::runtime_error("Failure creating index buffer for " + fileName);
+
+
+}
+
+
+// Calculate the bounds of each node from the sub-meshes attached to it
+void Mesh::CalculateNodeBounds()
+{
+	for (auto& node : mNodes)
+	{
+		node.boundingSphere = EmptyBoundingSphere();
+		for (auto& subMeshIndex : node.subMeshes)
+		{
+			node.boundingSphere = Union(node.boundingSphere, mSubMeshes[subMeshIndex].boundingSphere);
+		}
 	}
 }
 
@@ -396,21 +767,40 @@ void Mesh::RenderSubMesh(const SubMesh& subMesh)
 
 
 
+// Bounding sphere in world space of the mesh drawn with the given matrices, for culling whole models before rendering
+// LIMITATION: Skinned meshes are bounded in their bind pose with the root matrix
+BoundingSphere Mesh::WorldBoundingSphere(std::vector<CMatrix4x4>& modelMatrices)
+{
+	std::vector<CMatrix4x4> absoluteMatrices = CalculateAbsoluteMatrices(modelMatrices);
+
+	BoundingSphere sphere = EmptyBoundingSphere();
+	if (mHasBones)
+	{
+		for (auto& subMesh : mSubMeshes)
+		{
+			sphere = Union(sphere, TransformBoundingSphere(subMesh.boundingSphere, absoluteMatrices[0]));
+		}
+	}
+	else
+	{
+		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		{
+			sphere = Union(sphere, TransformBoundingSphere(mNodes[nodeIndex].boundingSphere, absoluteMatrices[nodeIndex]));
+		}
+	}
+	return sphere;
+}
+
+
 // Render the mesh with the given matrices
 // Handles rigid body meshes (including single part meshes) as well as skinned meshes
+// If a frustum is given, sub-meshes of rigid body meshes with bounding boxes outside it are skipped
 // LIMITATION: The mesh must use a single texture throughout
-void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices)
+void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices, const Frustum* frustum /*= nullptr*/)
 {
 	// Skinning needs all matrices available in the shader at the same time, so first calculate all the absolute
 	// matrices before rendering anything
-	std::vector<CMatrix4x4> absoluteMatrices(modelMatrices.size());
-	absoluteMatrices[0] = modelMatrices[0]; // First matrix for a model is the root matrix, already in world space
-	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
-	{
-		// Multiply each model matrix by its parent's absolute world matrix (already calculated earlier in this loop)
-		// Same process as for rigid bodies, simply done prior to rendering now
-		absoluteMatrices[nodeIndex] = modelMatrices[nodeIndex] * absoluteMatrices[mNodes[nodeIndex].parentIndex];
-	}
+	std::vector<CMatrix4x4> absoluteMatrices = CalculateAbsoluteMatrices(modelMatrices);
 
 	if (mHasBones) // Render a mesh that uses skinning
 	{
@@ -452,6 +842,14 @@ void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices)
 		// Iterate through each node
 		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
 		{
+			// Skip nodes with nothing to draw, or whose sub-meshes are all outside the view
+			bool visible = false;
+			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
+			{
+				visible = visible || IsSubMeshVisible(mSubMeshes[subMeshIndex], absoluteMatrices[nodeIndex], frustum);
+			}
+			if (!visible)  continue;
+
 			// Send this node's matrix to the GPU via a constant buffer
 			gPerModelConstants.worldMatrix = absoluteMatrices[nodeIndex];
 			UpdateConstantBuffer(gPerModelConstantBuffer, gPerModelConstants); // Send to GPU
@@ -464,17 +862,136 @@ void Mesh::Render(std::vector<CMatrix4x4>& modelMatrices)
 			// Render the sub-meshes attached to this node (no bones - rigid movement)
 			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
 			{
-				RenderSubMesh(mSubMeshes[subMeshIndex]);
+				const SubMesh& subMesh = mSubMeshes[subMeshIndex];
+				if (IsSubMeshVisible(subMesh, absoluteMatrices[nodeIndex], frustum))  RenderSubMesh(subMesh);
 			}
 		}
 	}
 }
 
 
+
+// Make the CPU-side copy of the geometry the software rasterizer draws, if not done already. It is read back from the cache data
+// the mesh was loaded from, as only the GPU keeps the geometry after loading. The cache file has been kept mapped since then
+// (or the data kept in memory), so this doesn't depend on the file still being there. Returns false if the data can't be read
+bool Mesh::PrepareSoftwareRendering()
+{
+	if (mHasSoftwareGeometry)  return true;
+
+	const unsigned char* data = mUnsavedCacheData.empty() ? mCacheFile.Data() : mUnsavedCacheData.data();
+	size_t               size = mUnsavedCacheData.empty() ? mCacheFile.Size() : mUnsavedCacheData.size();
+	CachedMesh cache;
+	if (!ReadCache(data, size, mCacheKey, cache) || cache.subMeshes.size() != mSubMeshes.size())  return false;
+
+	// Keep a copy of the positions, normals, uvs and faces
+	for (size_t m = 0; m < mSubMeshes.size(); ++m)
+	{
+		auto& subMesh = mSubMeshes[m];
+		const CachedSubMesh& cached = cache.subMeshes[m];
+		VertexLayout layout = MakeVertexLayout(cached.record->vertexParts);
+		subMesh.rasterVertices.resize(cached.record->numVertices);
+		subMesh.rasterPositions.resize(cached.record->numVertices);
+		for (unsigned int v = 0; v < cached.record->numVertices; ++v)
+		{
+			const unsigned char* vertex = cached.vertices + v * layout.size;
+			auto& rasterVertex = subMesh.rasterVertices[v];
+			std::memcpy(&rasterVertex.position, vertex + layout.positionOffset, sizeof(CVector3));
+			std::memcpy(&rasterVertex.normal,   vertex + layout.normalOffset,   sizeof(CVector3));
+			rasterVertex.uv = CVector2(0, 0);
+			if (cached.record->vertexParts & VertexUV)  std::memcpy(&rasterVertex.uv, vertex + layout.uvOffset, sizeof(CVector2));
+			subMesh.rasterPositions[v] = rasterVertex.position;
+		}
+		subMesh.rasterIndices.assign(cached.indices, cached.indices + cached.record->numIndices);
+	}
+
+	// Not needed again
+	mCacheFile.Close();
+	mUnsavedCacheData = std::vector<unsigned char>();
+	mHasSoftwareGeometry = true;
+	return true;
+}
+
+
+// Render the mesh with the given matrices using the software rasterizer, which must be between BeginFrame and EndFrame.
+// The state replaces the shaders, textures and states set before Render. Sub-meshes outside the frustum (if given) are skipped
+// LIMITATION: Skinned meshes are drawn with the root matrix, as the scene's vertex shaders do no skinning
+void Mesh::RenderSoftware(SoftwareRasterizer& rasterizer, std::vector<CMatrix4x4>& modelMatrices, const RasterState& state,
+                          const Frustum* frustum /*= nullptr*/)
+{
+	std::vector<CMatrix4x4> absoluteMatrices = CalculateAbsoluteMatrices(modelMatrices);
+
+	if (mHasBones)
+	{
+		for (auto& subMesh : mSubMeshes)
+		{
+			if (!IsSubMeshVisible(subMesh, absoluteMatrices[0], frustum))  continue;
+			rasterizer.Draw(subMesh.rasterVertices, subMesh.rasterIndices, absoluteMatrices[0], state);
+		}
+	}
+	else
+	{
+		// Draw the sub-meshes attached to each node with the node's matrix (no bones - rigid movement)
+		for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+		{
+			for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
+			{
+				const SubMesh& subMesh = mSubMeshes[subMeshIndex];
+				if (!IsSubMeshVisible(subMesh, absoluteMatrices[nodeIndex], frustum))  continue;
+				rasterizer.Draw(subMesh.rasterVertices, subMesh.rasterIndices, absoluteMatrices[nodeIndex], state);
+			}
+		}
+	}
+}
+
+
+// Render the mesh into the depth buffer of a depth-only software rasterizer frame. Only the vertex positions are read
+void Mesh::RenderDepthSoftware(SoftwareRasterizer& rasterizer, std::vector<CMatrix4x4>& modelMatrices, RasterCull cull,
+                               const Frustum* frustum /*= nullptr*/)
+{
+	std::vector<CMatrix4x4> absoluteMatrices = CalculateAbsoluteMatrices(modelMatrices);
+
+	for (unsigned int nodeIndex = 0; nodeIndex < mNodes.size(); ++nodeIndex)
+	{
+		for (auto& subMeshIndex : mNodes[nodeIndex].subMeshes)
+		{
+			const SubMesh&    subMesh = mSubMeshes[subMeshIndex];
+			const CMatrix4x4& matrix  = absoluteMatrices[mHasBones ? 0 : nodeIndex];
+			if (!IsSubMeshVisible(subMesh, matrix, frustum))  continue;
+			rasterizer.DrawDepth(subMesh.rasterPositions, subMesh.rasterIndices, matrix, cull);
+		}
+	}
+}
+
+
 //--------------------------------------------------------------------------------------
 // Helper functions
 //--------------------------------------------------------------------------------------
 
+// Helper function for Render functions - calculates the absolute world matrix of each node from the model's matrices
+std::vector<CMatrix4x4> Mesh::CalculateAbsoluteMatrices(std::vector<CMatrix4x4>& modelMatrices)
+{
+	std::vector<CMatrix4x4> absoluteMatrices(modelMatrices.size());
+	absoluteMatrices[0] = modelMatrices[0]; // First matrix for a model is the root matrix, already in world space
+	for (unsigned int nodeIndex = 1; nodeIndex < mNodes.size(); ++nodeIndex)
+	{
+		// Multiply each model matrix by its parent's absolute world matrix (already calculated earlier in this loop)
+		// Same process as for rigid bodies, simply done prior to rendering now
+		absoluteMatrices[nodeIndex] = modelMatrices[nodeIndex] * absoluteMatrices[mNodes[nodeIndex].parentIndex];
+	}
+	return absoluteMatrices;
+}
+
+
+// Helper function for Render functions - whether a sub-mesh drawn with the given matrix might be inside the frustum (if any).
+// The sphere test is cheaper so is done first, the box fits long thin sub-meshes better
+bool Mesh::IsSubMeshVisible(const SubMesh& subMesh, const CMatrix4x4& matrix, const Frustum* frustum)
+{
+	if (frustum == nullptr)  return true;
+	return IsVisible(*frustum, TransformBoundingSphere(subMesh.boundingSphere, matrix)) &&
+	       IsVisible(*frustum, TransformBoundingBox(subMesh.boundingBox, matrix));
+}
+
+
 // Count the number of nodes with given assimp node as root - recursive
 unsigned int Mesh::CountNodes(aiNode* assimpNode)
 {
@@ -497,6 +1014,7 @@ unsigned int Mesh::ReadNodes(aiNode* assimpNode, unsigned int nodeIndex, unsigne
 
 	node.defaultMatrix.SetValues(&assimpNode->mTransformation.a1);
 	node.defaultMatrix.Transpose(); // Assimp stores matrices differently to this app
+	node.offsetMatrix = MatrixIdentity(); // Set for bones when the sub-meshes are read
 
 	node.subMeshes.resize(assimpNode->mNumMeshes);
 	for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
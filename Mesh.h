@@ -5,7 +5,10 @@
 // The class also doesn't load textures, filters or shaders as the outer code is
 // expected to select these things
 
+#include "BinaryFile.h"
 #include "CMatrix4x4.h"
+#include "Frustum.h"
+#include "Rasterizer.h"
 #define NOMINMAX // Use this to stop Windows headers defining "min" and "max", which breaks some libraries (e.g. assimp)
 #include <d3d11.h>
 #include <assimp/scene.h>
@@ -25,6 +28,8 @@ public:
     // Pass the name of the mesh file to load. Uses assimp (http://www.assimp.org/) to support many file types
     // Optionally request tangents to be calculated (for normal and parallax mapping - see later lab)
     // Will throw a std::runtime_error exception on failure (since constructors can't return errors).
+    // The imported mesh is cached in a file named after the mesh file with ".cache" added, later loads of the same file with the
+    // same settings read the cache instead of importing
     Mesh(const std::string& fileName, bool requireTangents = false);
     ~Mesh();
 
@@ -37,11 +42,32 @@ public:
     CMatrix4x4 GetNodeDefaultMatrix(unsigned int node) { return mNodes[node].defaultMatrix; }
 
 
+	// Bounding sphere in world space of the mesh drawn with the given matrices, for culling whole models before rendering
+	// LIMITATION: Skinned meshes are bounded in their bind pose with the root matrix
+	BoundingSphere WorldBoundingSphere(std::vector<CMatrix4x4>& modelMatrices);
+
+
 	// Render the mesh with the given matrices
 	// Handles rigid body meshes (including single part meshes) as well as skinned meshes
+	// If a frustum is given, sub-meshes of rigid body meshes with bounding boxes outside it are skipped
 	// LIMITATION: The mesh must use a single texture throughout
-	void Render(std::vector<CMatrix4x4>& modelMatrices);
+	void Render(std::vector<CMatrix4x4>& modelMatrices, const Frustum* frustum = nullptr);
+
+	// Make the CPU-side copy of the geometry needed by the software render functions below. Only meshes that will be drawn by
+	// the software rasterizer need it, so it isn't made when the mesh is loaded. Returns false on failure
+	bool PrepareSoftwareRendering();
+
+	// Render the mesh with the given matrices using the software rasterizer, which must be between BeginFrame and EndFrame.
+	// PrepareSoftwareRendering must have been called, nothing is drawn before that.
+	// The state replaces the shaders, textures and states set before Render. Frustum as above
+	// LIMITATION: Skinned meshes are drawn with the root matrix, as the scene's vertex shaders do no skinning
+	void RenderSoftware(SoftwareRasterizer& rasterizer, std::vector<CMatrix4x4>& modelMatrices, const RasterState& state,
+	                    const Frustum* frustum = nullptr);
 
+	// Render the mesh into the depth buffer of a depth-only software rasterizer frame (see SoftwareRasterizer::BeginDepthFrame).
+	// Only the vertex positions are read. Preparation, frustum and limitation as above
+	void RenderDepthSoftware(SoftwareRasterizer& rasterizer, std::vector<CMatrix4x4>& modelMatrices, RasterCull cull,
+	                         const Frustum* frustum = nullptr);
 
 
 //--------------------------------------------------------------------------------------
@@ -62,6 +88,15 @@ private:
 
 		unsigned int       numIndices = 0;
 		ID3D11Buffer*      indexBuffer  = nullptr;
+
+		// CPU-side copy of the geometry for the software rasterizer, empty until PrepareSoftwareRendering
+		std::vector<RasterVertex> rasterVertices;
+		std::vector<CVector3>     rasterPositions; // Positions alone for depth-only rendering, a quarter of the memory to read
+		std::vector<uint32_t>     rasterIndices;
+
+		// Bounds of the vertices, in the space of the node the sub-mesh is attached to
+		BoundingBox    boundingBox;
+		BoundingSphere boundingSphere;
 	};
 
 
@@ -81,6 +116,8 @@ private:
 
 		std::vector<unsigned int> childNodes; // Child nodes that are controlled by this node (indexes into the mNodes vector below)
 		std::vector<unsigned int> subMeshes;  // The geometry representing this node (indexes into the mSubMeshes vector below)
+
+		BoundingSphere boundingSphere; // Bounds of the node's sub-meshes in the node's space. Empty for nodes without geometry
 	};
 
 
@@ -95,9 +132,29 @@ private:
 	// Help build the arrays of submeshes and nodes from the assimp data - recursive
 	unsigned int ReadNodes(aiNode* assimpNode, unsigned int nodeIndex, unsigned int parentIndex);
 
+	// Set up the mesh from a cache file written by the constructor, if it exists and has the given key. Returns false if the cache
+	// can't be used, leaving the mesh unchanged
+	bool LoadCache(const std::string& cacheFileName, uint64_t key, const std::string& fileName);
+
+	// Make the contents of a cache file from the mesh's nodes and the given sub-mesh data (as collected by the constructor)
+	std::vector<unsigned char> MakeCacheData(uint64_t key, const std::vector<unsigned char>& subMeshData);
+
+	// Create a sub-mesh's vertex layout, GPU buffers and bounds from its final vertex and index data
+	void CreateSubMesh(SubMesh& subMesh, unsigned int vertexParts, const unsigned char* vertices, const uint32_t* indices,
+	                   const std::string& fileName);
+
+	// Calculate the bounds of each node from the sub-meshes attached to it
+	void CalculateNodeBounds();
+
 	// Helper function for Render function - renders a given sub-mesh. World matrices / textures / states etc. must already be set
 	void RenderSubMesh(const SubMesh& subMesh);
 
+	// Helper function for Render functions - calculates the absolute world matrix of each node from the model's matrices
+	std::vector<CMatrix4x4> CalculateAbsoluteMatrices(std::vector<CMatrix4x4>& modelMatrices);
+
+	// Helper function for Render functions - whether a sub-mesh drawn with the given matrix might be inside the frustum (if any)
+	bool IsSubMeshVisible(const SubMesh& subMesh, const CMatrix4x4& matrix, const Frustum* frustum);
+
 
 
 //--------------------------------------------------------------------------------------
@@ -109,6 +166,13 @@ private:
     std::vector<Node>    mNodes;     // The mesh hierarchy. First entry is root. remainder aree stored in depth-first order
 
 	bool mHasBones; // If any submesh has bones, then all submeshes are given bones - makes rendering easier (one shader for the whole mesh)
+
+	// Where PrepareSoftwareRendering reads the geometry from: the cache file, kept mapped from loading until then so deleting or
+	// rewriting the file in between doesn't matter, or the cache data itself if it couldn't be saved. Released once used
+	MappedFile                 mCacheFile;
+	uint64_t                   mCacheKey = 0;
+	std::vector<unsigned char> mUnsavedCacheData;
+	bool                       mHasSoftwareGeometry = false;
 };
 
 
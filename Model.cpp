@@ -23,9 +23,28 @@ Model::Model(Mesh* mesh, CVector3 position /*= { 0,0,0 }*/, CVector3 rotation /*
 
 // The render function simply passes this model's matrices over to Mesh:Render.
 // All other per-frame constants must have been set already along with shaders, textures, samplers, states etc.
-void Model::Render()
+// Parts of the model outside the frustum (if given) are not drawn
+void Model::Render(const Frustum* frustum /*= nullptr*/)
 {
-    mMesh->Render(mWorldMatrices);
+    mMesh->Render(mWorldMatrices, frustum);
+}
+
+// Render this model with the software rasterizer instead, using the given shader, texture and states
+void Model::RenderSoftware(SoftwareRasterizer& rasterizer, const RasterState& state, const Frustum* frustum /*= nullptr*/)
+{
+    mMesh->RenderSoftware(rasterizer, mWorldMatrices, state, frustum);
+}
+
+// Render this model into the depth buffer of a depth-only software rasterizer frame
+void Model::RenderDepthSoftware(SoftwareRasterizer& rasterizer, RasterCull cull, const Frustum* frustum /*= nullptr*/)
+{
+    mMesh->RenderDepthSoftware(rasterizer, mWorldMatrices, cull, frustum);
+}
+
+// Bounding sphere of the model in world space, for view frustum culling
+BoundingSphere Model::WorldBoundingSphere()
+{
+    return mMesh->WorldBoundingSphere(mWorldMatrices);
 }
 
 
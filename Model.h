@@ -14,6 +14,11 @@
 #define _MODEL_H_INCLUDED_
 
 class Mesh;
+class SoftwareRasterizer;
+struct RasterState;
+enum class RasterCull;
+struct Frustum;
+struct BoundingSphere;
 
 class Model
 {
@@ -27,7 +32,17 @@ public:
 
     // The render function simply passes this model's matrices over to Mesh:Render.
     // All other per-frame constants must have been set already along with shaders, textures, samplers, states etc.
-    void Render();
+    // Parts of the model outside the frustum (if given) are not drawn
+    void Render(const Frustum* frustum = nullptr);
+
+    // Render this model with the software rasterizer instead, using the given shader, texture and states
+    void RenderSoftware(SoftwareRasterizer& rasterizer, const RasterState& state, const Frustum* frustum = nullptr);
+
+    // Render this model into the depth buffer of a depth-only software rasterizer frame
+    void RenderDepthSoftware(SoftwareRasterizer& rasterizer, RasterCull cull, const Frustum* frustum = nullptr);
+
+    // Bounding sphere of the model in world space, for view frustum culling
+    BoundingSphere WorldBoundingSphere();
 
 
 	// Control a given node in the model using keys provided. Amount of motion performed depends on frame time
@@ -0,0 +1,364 @@
+//--------------------------------------------------------------------------------------
+// Post-process definitions shared by the GPU (Scene.cpp) and CPU (CPU folder) pipelines
+//--------------------------------------------------------------------------------------
+
+#include "PostProcess.h"
+#include "MathHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// Update the settings a post-process needs before it is run (timers, animation, iteration counters etc.)
+// Called once per pass by both the GPU and CPU pipelines so they animate identically
+void UpdatePostProcessConstants(PostProcess postProcess, PostProcessingConstants& constants, float frameTime,
+                                int viewportWidth, int viewportHeight)
+{
+	if (postProcess == PostProcess::DualFiltering)
+	{
+		constants.dualFilterIteration = constants.dualFilterIteration + 1;
+	}
+	else if (postProcess == PostProcess::Dilation)
+	{
+		constants.elapsedTime += frameTime;
+	}
+	else if (postProcess == PostProcess::KawaseLightStreak)
+	{
+		constants.kawaseIter = constants.kawaseIter + 1;
+	}
+	else if (postProcess == PostProcess::Bloom)
+	{
+		constants.dualFilterIteration = 0;
+		constants.kawaseIter = -1;
+	}
+	else if (postProcess == PostProcess::HueVerticalColourGradient)
+	{
+		constants.elapsedTime += frameTime;
+		constants.period = 4;
+
+		// Set the top and bottom colours of the gradient
+		constants.topColour = { 0.0f, 0.0f, 1.0f };
+		constants.bottomColour = { 0.0f, 1.0f, 1.0f };
+	}
+	else if (postProcess == PostProcess::UnderWater)
+	{
+		// Update the underwater timer
+		constants.underWaterTimer += frameTime;
+	}
+	else if (postProcess == PostProcess::GaussianBlurHorizontal || postProcess == PostProcess::GaussianBlurVertical)
+	{
+		constants.blurAmount = 1.0f;
+	}
+	else if (postProcess == PostProcess::VerticalColourGradient)
+	{
+		// Set the top and bottom colours of the gradient
+		constants.topColour = { 0.0f, 0.0f, 1.0f };
+		constants.bottomColour = { 0.0f, 1.0f, 1.0f };
+	}
+	else if (postProcess == PostProcess::GreyNoise)
+	{
+		// Noise scaling adjusts how fine the grey noise is.
+		const float grainSize = 140; // Fineness of the noise grain
+		constants.noiseScale = { viewportWidth / grainSize, viewportHeight / grainSize };
+
+		// The noise offset is randomised to give a constantly changing noise effect (like tv static)
+		constants.noiseOffset = { Random(0.0f, 1.0f), Random(0.0f, 1.0f) };
+	}
+	else if (postProcess == PostProcess::Burn)
+	{
+		// Set and increase the burn level (cycling back to 0 when it reaches 1.0f)
+		const float burnSpeed = 0.2f;
+		constants.burnHeight = std::fmod(constants.burnHeight + burnSpeed * frameTime, 1.0f);
+	}
+	else if (postProcess == PostProcess::Spiral)
+	{
+		// Set and increase the amount of spiral - use a tweaked cos wave to animate
+		static float wiggle = 0.0f;
+		const float wiggleSpeed = 1.0f;
+		constants.spiralLevel = ((1.0f - std::cos(wiggle)) * 4.0f);
+		wiggle += wiggleSpeed * frameTime;
+	}
+	else if (postProcess == PostProcess::HeatHaze)
+	{
+		// Update heat haze timer
+		constants.heatHazeTimer += frameTime;
+	}
+}
+
+
+// The history slot a post-process reads, HistorySlot::None if it only reads the output of the previous pass
+HistorySlot PostProcessHistoryRead(PostProcess postProcess)
+{
+	switch (postProcess)
+	{
+		case PostProcess::MotionBlur:        return HistorySlot::PreviousFrame;
+		case PostProcess::DepthOfField:      return HistorySlot::PreEffect;
+		case PostProcess::MergeTextures:     return HistorySlot::PreEffect;
+		case PostProcess::KawaseLightStreak: return HistorySlot::PreEffect;
+		case PostProcess::LightStreaks:      return HistorySlot::PreEffect;
+		default:                             return HistorySlot::None;
+	}
+}
+
+
+// True if the input to a post-process must be kept as the PreEffect history, for itself or for later passes
+bool PostProcessSavesPreEffect(PostProcess postProcess)
+{
+	return postProcess == PostProcess::Bloom || postProcess == PostProcess::DepthOfField;
+}
+
+
+// True if a post-process only changes the colour of each pixel with an affine colour transform
+bool IsColourTransform(PostProcess postProcess)
+{
+	return postProcess == PostProcess::Sepia || postProcess == PostProcess::Inverted || postProcess == PostProcess::Tint ||
+	       IsRowVaryingColourTransform(postProcess);
+}
+
+
+// True for colour transforms that change down the screen
+bool IsRowVaryingColourTransform(PostProcess postProcess)
+{
+	return postProcess == PostProcess::VerticalColourGradient || postProcess == PostProcess::HueVerticalColourGradient;
+}
+
+
+// True for post-processes that only the CPU pipeline can run
+bool IsCpuOnlyPostProcess(PostProcess postProcess)
+{
+	return postProcess == PostProcess::DualFilterPyramid || postProcess == PostProcess::LightStreaks ||
+	       postProcess == PostProcess::BloomMerge;
+}
+
+
+// Bytes per pixel of a scene buffer format
+int SceneBufferFormatBytes(SceneBufferFormat format)
+{
+	switch (format)
+	{
+		case SceneBufferFormat::RGBA8:      return 4;
+		case SceneBufferFormat::R11G11B10F: return 4;
+		case SceneBufferFormat::RGBA16F:    return 8;
+		default:                            return 16;
+	}
+}
+
+
+// The least precise format that can hold the output of a pass given the format of its input
+SceneBufferFormat PostProcessOutputFormat(PostProcess postProcess, PostProcessMode mode, SceneBufferFormat inputFormat)
+{
+	SceneBufferFormat format;
+	switch (postProcess)
+	{
+		// Passes that copy their input, and the CPU-only post-processes, which keep the precision of their input
+		case PostProcess::None:
+		case PostProcess::Copy:
+		case PostProcess::DualFilterPyramid:
+		case PostProcess::LightStreaks:
+		case PostProcess::BloomMerge:
+			format = inputFormat;
+			break;
+
+		// Output is one of four colours, all in 0->1
+		case PostProcess::GameBoy:
+			format = SceneBufferFormat::RGBA8;
+			break;
+
+		// 1 - colour is negative for HDR colours. A colour matrix may include Inverted
+		case PostProcess::Inverted:
+		case PostProcess::ColourMatrix:
+			format = SceneBufferFormat::RGBA16F;
+			break;
+
+		// Alpha is read by a later KawaseLightStreak (its diagonal streak), so these need a format with alpha. Bloom stores the
+		// threshold in alpha and the streaks for each direction are kept in a different channel, including alpha, between
+		// iterations. GreyNoise, HeatHaze and Spiral output their soft circle in alpha
+		case PostProcess::Bloom:
+		case PostProcess::KawaseLightStreak:
+		case PostProcess::GreyNoise:
+		case PostProcess::HeatHaze:
+		case PostProcess::Spiral:
+			format = SceneBufferFormat::RGBA16F;
+			break;
+
+		// Average their input including alpha, which only needs keeping if the input has it
+		case PostProcess::DualFiltering:
+		case PostProcess::MotionBlur:
+			format = (inputFormat == SceneBufferFormat::R11G11B10F) ? SceneBufferFormat::R11G11B10F : SceneBufferFormat::RGBA16F;
+			break;
+
+		// Everything else only makes positive colours from positive colours, with alpha 1 (tints, blurs, edges, distortions,
+		// blends). Small floats are precise enough for a single pass, the error is about the same as 8-bit sRGB
+		default:
+			format = SceneBufferFormat::R11G11B10F;
+			break;
+	}
+
+	if (mode != PostProcessMode::Fullscreen)  format = std::max(format, inputFormat);
+	return format;
+}
+
+
+// Remove passes from a stack that make no difference to the result, then merge runs of colour-only passes
+PostProcessExecutionPlan OptimisePostProcessStack(const PostProcessStack& stack)
+{
+	PostProcessExecutionPlan plan;
+	for (int i = 0; i < static_cast<int>(stack.size()); ++i)
+	{
+		PostProcess     postProcess = stack[i].first;
+		PostProcessMode mode        = stack[i].second;
+
+		// Copies leave the image as it was, whatever their mode
+		if (postProcess == PostProcess::None || postProcess == PostProcess::Copy)
+		{
+			++plan.identityPasses;
+			continue;
+		}
+
+		// Compare full-screen passes with the pass before them, which may itself be the result of earlier changes
+		// (e.g. Inverted, Copy, Inverted). Inverted and Tint only read their own pixel so two in a row can be worked out together
+		if (mode == PostProcessMode::Fullscreen && !plan.passes.empty() && plan.passes.back().second == PostProcessMode::Fullscreen &&
+		    plan.passes.back().first == postProcess)
+		{
+			// 1 - (1 - c) = c
+			if (postProcess == PostProcess::Inverted)
+			{
+				plan.passes.pop_back();
+				plan.stackIndex.pop_back();
+				plan.cancelledPasses += 2;
+				continue;
+			}
+
+			// Tint keeps only the red channel, doing it again changes nothing
+			if (postProcess == PostProcess::Tint)
+			{
+				++plan.foldedPasses;
+				continue;
+			}
+		}
+
+		plan.passes.push_back(stack[i]);
+		plan.stackIndex.push_back(i);
+	}
+
+	// Merge each run of full-screen colour transforms into one ColourMatrix pass. A transform that changes down the screen
+	// can't be multiplied with another that does (the product would not change linearly), so each gradient in a run takes
+	// one of the pass's MAX_COLOUR_TRANSFORMS transforms and a run with more gradients than that is split
+	std::vector<std::pair<PostProcess, PostProcessMode>> passes;
+	std::vector<int> stackIndex;
+	passes.swap(plan.passes);
+	stackIndex.swap(plan.stackIndex);
+	int numPasses = static_cast<int>(passes.size());
+	for (int i = 0; i < numPasses; )
+	{
+		std::vector<PostProcess> run;
+		int numRowVarying = 0;
+		int last = i;
+		while (last < numPasses && passes[last].second == PostProcessMode::Fullscreen && IsColourTransform(passes[last].first))
+		{
+			bool rowVarying = IsRowVaryingColourTransform(passes[last].first);
+			if (rowVarying && numRowVarying == MAX_COLOUR_TRANSFORMS)  break;
+			if (rowVarying)  ++numRowVarying;
+			run.push_back(passes[last].first);
+			++last;
+		}
+
+		if (run.size() < 2)
+		{
+			plan.passes.push_back(passes[i]);
+			plan.colourMatrixPasses.emplace_back();
+			last = i + 1;
+		}
+		else
+		{
+			plan.passes.push_back({ PostProcess::ColourMatrix, PostProcessMode::Fullscreen });
+			plan.colourMatrixPasses.push_back(run);
+			plan.mergedPasses += static_cast<int>(run.size()) - 1;
+		}
+		plan.stackIndex.push_back(stackIndex[i]);
+		i = last;
+	}
+	return plan;
+}
+
+
+// Work out the scene buffers needed for a stack and which image goes in each
+PostProcessBufferPlan PlanPostProcessBuffers(const PostProcessStack& stack, bool keepPreviousFrame, SceneBufferFormat minFormat)
+{
+	PostProcessBufferPlan plan;
+	int numPasses = static_cast<int>(stack.size());
+	if (numPasses == 0)  return plan;
+
+	// Last pass to read each image. Passes are numbered from 0, the copy to the back buffer after the stack counts as pass
+	// numPasses. Image i is written by pass i - 1 (the scene is rendered "before" pass 0) and read by pass i
+	int numImages = numPasses + 1;
+	std::vector<int> lastRead(numImages);
+	for (int image = 0; image < numImages; ++image)  lastRead[image] = image;
+
+	// Extend the lives of images held as history
+	plan.preEffect.resize(numPasses, -1);
+	int preEffect = -1;
+	bool readsPreviousFrame = false;
+	for (int pass = 0; pass < numPasses; ++pass)
+	{
+		PostProcess postProcess = stack[pass].first;
+		if (stack[pass].second == PostProcessMode::Fullscreen && PostProcessSavesPreEffect(postProcess))  preEffect = pass;
+		plan.preEffect[pass] = preEffect;
+
+		HistorySlot historySlot = PostProcessHistoryRead(postProcess);
+		if (historySlot == HistorySlot::PreEffect && preEffect >= 0)  lastRead[preEffect] = pass;
+		if (historySlot == HistorySlot::PreviousFrame)                readsPreviousFrame = true;
+	}
+
+	// Format of each image
+	plan.imageFormat.resize(numImages);
+	plan.imageFormat[0] = std::max(SCENE_RENDER_FORMAT, minFormat);
+	for (int pass = 0; pass < numPasses; ++pass)
+	{
+		SceneBufferFormat format = PostProcessOutputFormat(stack[pass].first, stack[pass].second, plan.imageFormat[pass]);
+		plan.imageFormat[pass + 1] = std::max(format, minFormat);
+	}
+
+	// Give each image the first buffer of its format that was last read before the image is written. Images are visited in
+	// the order they are written so this is the usual greedy interval allocation, which uses the fewest buffers possible for
+	// each format
+	std::vector<int> bufferFreeAfter; // Last pass to read the image currently in each buffer
+	plan.imageBuffer.resize(numImages);
+	for (int image = 0; image < numImages; ++image)
+	{
+		int writtenBy = image - 1;
+		int buffer = 0;
+		while (buffer < static_cast<int>(bufferFreeAfter.size()) &&
+		       (bufferFreeAfter[buffer] >= writtenBy || plan.bufferFormat[buffer] != plan.imageFormat[image]))
+		{
+			++buffer;
+		}
+		if (buffer == static_cast<int>(bufferFreeAfter.size()))
+		{
+			bufferFreeAfter.push_back(0);
+			plan.bufferFormat.push_back(plan.imageFormat[image]);
+		}
+		bufferFreeAfter[buffer] = lastRead[image];
+		plan.imageBuffer[image] = buffer;
+	}
+
+	// The previous frame is needed for the whole frame, and is replaced by this frame's final image at the end
+	if (keepPreviousFrame && readsPreviousFrame)
+	{
+		plan.previousFrameBuffer = static_cast<int>(bufferFreeAfter.size());
+		bufferFreeAfter.push_back(numPasses);
+		plan.bufferFormat.push_back(plan.imageFormat[numPasses]);
+	}
+
+	plan.numBuffers = static_cast<int>(bufferFreeAfter.size());
+	return plan;
+}
+
+
+// Memory used by the buffers of a plan for images of the given size
+size_t PostProcessBufferBytes(const PostProcessBufferPlan& plan, int width, int height)
+{
+	size_t bytesPerPixel = 0;
+	for (SceneBufferFormat format : plan.bufferFormat)  bytesPerPixel += SceneBufferFormatBytes(format);
+	return bytesPerPixel * width * height;
+}
@@ -0,0 +1,266 @@
+//--------------------------------------------------------------------------------------
+// Post-process definitions shared by the GPU (Scene.cpp) and CPU (CPU folder) pipelines
+//--------------------------------------------------------------------------------------
+// Nothing in here depends on DirectX so the CPU post-processing code can be built on
+// machines without a GPU (or without Windows)
+
+#ifndef _POST_PROCESS_H_INCLUDED_
+#define _POST_PROCESS_H_INCLUDED_
+
+#include "CVector2.h"
+#include "CVector3.h"
+#include "CVector4.h"
+
+#include <utility>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------------
+// Post-process types
+//--------------------------------------------------------------------------------------
+
+// Available post-processes
+enum class PostProcess
+{
+	None,
+	NightVision,
+	VerticalColourGradient,
+	GaussianBlurHorizontal,
+	GaussianBlurVertical,
+	UnderWater,
+	HueVerticalColourGradient,
+	Sepia,
+	Inverted,
+	Contour,
+	GameBoy,
+	Bloom,
+	MergeTextures,
+	Dilation,
+	DualFiltering,
+	DepthOfField,
+	KawaseLightStreak,
+	MotionBlur,
+
+	Copy,
+	Tint,
+	GreyNoise,
+	Burn,
+	Distort,
+	Spiral,
+	HeatHaze,
+
+	// Made by OptimisePostProcessStack from a run of full-screen colour-only passes, not selected directly. Applies the colour
+	// transforms in the constants (see SetColourMatrixConstants in CPU/PostProcessShaders.h) in one pass
+	ColourMatrix,
+
+	// Only available in the CPU post-processing pipeline (CPU folder), they can't be added to the GPU's stack
+	DualFilterPyramid,
+	LightStreaks,
+	BloomMerge,
+};
+
+enum class PostProcessMode
+{
+	Fullscreen,
+	Area,
+	Polygon,
+};
+
+// The list of post-processes applied each frame, in order. Each entry is run as one pass, reading the
+// output of the previous pass and writing to another scene buffer
+using PostProcessStack = std::vector<std::pair<PostProcess, PostProcessMode>>;
+
+// Earlier images a post-process can read as well as the output of the previous pass (bound to t1 on the GPU). The
+// pipelines keep each one by holding on to the scene buffer it is in, rather than copying it to another texture
+enum class HistorySlot
+{
+	None,
+	PreviousFrame, // Final image of an earlier frame (updated every other frame), read by MotionBlur
+	PreEffect,     // Input to the last Bloom or DepthOfField pass - the sharp scene before it was blurred
+};
+const int NUM_HISTORY_SLOTS = 3;
+
+
+// Storage formats for scene buffers, from least to most precise. Each image in a frame is stored in the least precise format
+// that the pass writing it needs (see PostProcessOutputFormat), which saves memory and memory traffic in every later pass
+enum class SceneBufferFormat
+{
+	RGBA8,      // 8 bits per channel, colour stored with sRGB encoding (decoded when read). 4 bytes per pixel, 0->1 only
+	R11G11B10F, // Small floats, 6 bit mantissa for red and green, 5 for blue, no alpha. 4 bytes per pixel, positive HDR
+	RGBA16F,    // Half floats. 8 bytes per pixel, HDR, negatives and alpha
+	RGBA32F,    // Full floats. 16 bytes per pixel
+};
+
+// Format of the buffer the scene is rendered to, before any post-processing. The lighting is HDR
+const SceneBufferFormat SCENE_RENDER_FORMAT = SceneBufferFormat::RGBA16F;
+
+
+// The passes actually run for a post-process stack. Passes that have no effect are left out, see OptimisePostProcessStack
+struct PostProcessExecutionPlan
+{
+	PostProcessStack passes;     // Passes to run, in order
+	std::vector<int> stackIndex; // Position of each pass in the original stack (e.g. to find the window of a polygon pass)
+
+	// Passes saved, by reason
+	int identityPasses  = 0; // Copy passes (and None)
+	int cancelledPasses = 0; // Pairs of passes that undo each other (Inverted followed by Inverted)
+	int foldedPasses    = 0; // Passes that repeat the one before to no further effect (Tint followed by Tint)
+	int mergedPasses    = 0; // Colour-only passes run as part of a ColourMatrix pass, not counting one for each ColourMatrix pass
+
+	// For each pass, the colour-only post-processes a ColourMatrix pass stands for in the order they are applied. Empty for
+	// other passes
+	std::vector<std::vector<PostProcess>> colourMatrixPasses;
+
+	int SavedPasses() const  { return identityPasses + cancelledPasses + foldedPasses + mergedPasses; }
+};
+
+
+// Scene buffers needed to run a post-process stack. Each image in a frame (the rendered scene, then the output of each
+// pass) is given a buffer, and images that are never needed at the same time share one. An image is needed from the pass
+// that writes it to the last pass that reads it, as the next pass's input or as history
+struct PostProcessBufferPlan
+{
+	std::vector<int> imageBuffer; // Buffer for each image, [0] is the rendered scene (always buffer 0), [i + 1] the output of pass i
+	std::vector<int> preEffect;   // Image held as the PreEffect history while each pass runs, -1 if none
+	int previousFrameBuffer = -1; // Buffer holding the final image of an earlier frame, -1 if no pass reads it
+	int numBuffers = 0;           // Total buffers used, the peak number of full-size images in memory during the frame
+
+	// Format of each image and each buffer. Only images of the same format share a buffer, the previous frame buffer has the
+	// format of the final image
+	std::vector<SceneBufferFormat> imageFormat;
+	std::vector<SceneBufferFormat> bufferFormat;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Post-process settings
+//--------------------------------------------------------------------------------------
+
+// Most points a polygon post-process can have after clipping (see PostProcessPolygon.h) - must match Common.hlsli
+static const int MAX_POLYGON_POINTS = 16;
+
+// Most colour transforms a ColourMatrix pass can apply - must match Common.hlsli. A transform is needed for each vertical
+// gradient in the run of passes it stands for (at least one), see SetColourMatrixConstants
+static const int MAX_COLOUR_TRANSFORMS = 4;
+
+// Settings used by post-processes - must match the similar structure in the Common.hlsli shader file
+struct PostProcessingConstants
+{
+	CVector2 area2DTopLeft; // Top-left of post-process area on screen, provided as coordinate from 0.0->1.0 not as a pixel coordinate
+	CVector2 area2DSize;    // Size of post-process area on screen, provided as sizes from 0.0->1.0 (1 = full screen) not as a size in pixels
+	float    area2DDepth;   // Depth buffer value for area (0.0 nearest to 1.0 furthest). Full screen post-processing uses 0.0f
+	CVector3 paddingA;      // Pad things to collections of 4 floats (see notes in earlier labs to read about padding)
+
+	CVector4 polygon2DPoints[MAX_POLYGON_POINTS]; // Points of a polygon in 2D viewport space for polygon post-processing. Matrix transformations already done on C++ side
+	CVector4 polygonAreaUVs[MAX_POLYGON_POINTS];  // Area UV of each point of the polygon in x and y (z and w unused)
+	int      numPolygonPoints;
+	CVector3 paddingM;
+
+	// Tint post-process settings
+	int kawaseIter;
+	CVector3 paddingB;
+
+	// Grey noise post-process settings
+    CVector2 noiseScale;
+	CVector2 noiseOffset;
+
+	// Burn post-process settings
+	float    burnHeight;
+	CVector3 paddingC;
+
+	// DOF post-process settings
+	float distanceToFocusedObject;
+	CVector3 paddingD;
+
+	// Gaussian Blur post-process settings
+	float    blurAmount;
+	CVector3 paddingE;
+
+	// Spiral post-process settings
+	float    spiralLevel;
+	CVector3 paddingF;
+
+	// Heat haze post-process settings
+	float    heatHazeTimer;
+	CVector3 paddingG;
+
+	// UnderWater post-process settings
+	float    underWaterTimer;
+	CVector3 paddingH;
+
+	// Hue Vertical Colour Gradient post-process settings
+	float elapsedTime;
+	CVector3 paddingI;
+	float period;
+	CVector3 paddingJ;
+
+	// Vertical Colour Gradient post-process settings. A float3 can't cross a 16-byte boundary in a constant buffer, so the
+	// shader's bottom colour starts after a gap
+	CVector3 topColour;
+	float paddingN;
+	CVector3 bottomColour;
+	float paddingK;
+
+	// Dualfiltering post-process settings
+	float dualFilterIteration;
+	CVector3 paddingL;
+
+	// Colour matrix post-process settings. Each transform is three rows (red, green and blue weights then a constant, as in
+	// ColourTransform) at the top and at the bottom of the screen, interpolated between them down the screen
+	CVector4 colourTransformTop[MAX_COLOUR_TRANSFORMS * 3];
+	CVector4 colourTransformBottom[MAX_COLOUR_TRANSFORMS * 3];
+	int      numColourTransforms;
+	CVector3 paddingO;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Helper functions
+//--------------------------------------------------------------------------------------
+
+// Update the settings a post-process needs before it is run (timers, animation, iteration counters etc.)
+// Called once per pass by both the GPU and CPU pipelines so they animate identically
+void UpdatePostProcessConstants(PostProcess postProcess, PostProcessingConstants& constants, float frameTime,
+                                int viewportWidth, int viewportHeight);
+
+// The history slot a post-process reads, HistorySlot::None if it only reads the output of the previous pass
+HistorySlot PostProcessHistoryRead(PostProcess postProcess);
+
+// True if the input to a post-process must be kept as the PreEffect history, for itself or for later passes
+// (e.g. the scene before Bloom, merged back in by MergeTextures). Full-screen passes only
+bool PostProcessSavesPreEffect(PostProcess postProcess);
+
+// True if a post-process only changes the colour of each pixel with an affine colour transform (Sepia, Inverted, Tint and the
+// vertical colour gradients, see GetColourTransform in CPU/PostProcessShaders.h)
+bool IsColourTransform(PostProcess postProcess);
+
+// True for colour transforms that change down the screen (the vertical colour gradients)
+bool IsRowVaryingColourTransform(PostProcess postProcess);
+
+// True for post-processes that only the CPU pipeline can run (DualFilterPyramid, LightStreaks and BloomMerge)
+bool IsCpuOnlyPostProcess(PostProcess postProcess);
+
+// Bytes per pixel of a scene buffer format
+int SceneBufferFormatBytes(SceneBufferFormat format);
+
+// The least precise format that can hold the output of a pass given the format of its input, as declared by each post-process.
+// Area and polygon passes keep the rest of their input so need at least its format, as do passes that copy their input
+SceneBufferFormat PostProcessOutputFormat(PostProcess postProcess, PostProcessMode mode, SceneBufferFormat inputFormat);
+
+// Remove passes from a stack that make no difference to the result: copies, full-screen passes that are undone by the next
+// pass and full-screen passes that are repeated. Runs of full-screen colour-only passes are then merged into one ColourMatrix
+// pass each
+PostProcessExecutionPlan OptimisePostProcessStack(const PostProcessStack& stack);
+
+// Work out the scene buffers needed for a stack and which image goes in each. The previous frame is only kept if
+// keepPreviousFrame is true (the CPU pipeline uses velocities instead). Empty stacks need no buffers. Each image is given the
+// format from PostProcessOutputFormat (the rendered scene SCENE_RENDER_FORMAT), raised to minFormat if less precise. The
+// default stores every image in full floats
+PostProcessBufferPlan PlanPostProcessBuffers(const PostProcessStack& stack, bool keepPreviousFrame,
+                                             SceneBufferFormat minFormat = SceneBufferFormat::RGBA32F);
+
+// Memory used by the buffers of a plan for images of the given size
+size_t PostProcessBufferBytes(const PostProcessBufferPlan& plan, int width, int height);
+
+
+#endif //_POST_PROCESS_H_INCLUDED_
@@ -0,0 +1,297 @@
+//--------------------------------------------------------------------------------------
+// Polygons for polygon post-processing, shared by the GPU (Scene.cpp) and CPU (CPU folder) pipelines
+//--------------------------------------------------------------------------------------
+
+#include "PostProcessPolygon.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+namespace
+{
+	inline float Cross(const CVector2& origin, const CVector2& a, const CVector2& b)
+	{
+		return (a.x - origin.x) * (b.y - origin.y) - (a.y - origin.y) * (b.x - origin.x);
+	}
+
+	inline float Axis(const CVector3& v, int axis)
+	{
+		return (axis == 0) ? v.x : (axis == 1) ? v.y : v.z;
+	}
+
+	inline CVector4 Lerp(const CVector4& a, const CVector4& b, float t)
+	{
+		return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t };
+	}
+
+
+	// Clip a polygon in clip space against the near plane (z >= 0 in DirectX), one point at a time around the edge
+	// (Sutherland-Hodgman). Area UVs are clipped along with the points
+	void ClipToNearPlane(std::vector<CVector4>& points, std::vector<CVector2>& areaUVs)
+	{
+		std::vector<CVector4> clippedPoints;
+		std::vector<CVector2> clippedUVs;
+		int numPoints = static_cast<int>(points.size());
+		for (int i = 0; i < numPoints; ++i)
+		{
+			int next = (i + 1) % numPoints;
+			const CVector4& a = points[i];
+			const CVector4& b = points[next];
+			bool aInside = a.z >= 0;
+			bool bInside = b.z >= 0;
+
+			if (aInside)
+			{
+				clippedPoints.push_back(a);
+				clippedUVs.push_back(areaUVs[i]);
+			}
+			if (aInside != bInside)
+			{
+				float t = a.z / (a.z - b.z);
+				clippedPoints.push_back(Lerp(a, b, t));
+				clippedUVs.push_back(areaUVs[i] + (areaUVs[next] - areaUVs[i]) * t);
+			}
+		}
+		points.swap(clippedPoints);
+		areaUVs.swap(clippedUVs);
+	}
+
+
+	// Whether point p is inside or on the edge of triangle abc, which has the given winding (1 or -1)
+	bool InTriangle(const CVector2& p, const CVector2& a, const CVector2& b, const CVector2& c, float winding)
+	{
+		return Cross(a, b, p) * winding >= 0 && Cross(b, c, p) * winding >= 0 && Cross(c, a, p) * winding >= 0;
+	}
+}
+
+
+// Give each point of a flat polygon an area UV
+std::vector<CVector2> PolygonAreaUVs(const std::vector<CVector3>& points)
+{
+	std::vector<CVector2> areaUVs(points.size(), { 0, 0 });
+	if (points.empty())  return areaUVs;
+
+	float minPoint[3], maxPoint[3];
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		minPoint[axis] = maxPoint[axis] = Axis(points[0], axis);
+		for (const CVector3& point : points)
+		{
+			minPoint[axis] = std::min(minPoint[axis], Axis(point, axis));
+			maxPoint[axis] = std::max(maxPoint[axis], Axis(point, axis));
+		}
+	}
+
+	// Axes in order of size, the smallest is across the polygon
+	int axes[3] = { 0, 1, 2 };
+	std::sort(axes, axes + 3, [&](int a, int b) { return maxPoint[a] - minPoint[a] > maxPoint[b] - minPoint[b]; });
+	int uAxis = axes[0];
+	int vAxis = axes[1];
+	if (uAxis == 1)  std::swap(uAxis, vAxis);
+
+	float uSize = maxPoint[uAxis] - minPoint[uAxis];
+	float vSize = maxPoint[vAxis] - minPoint[vAxis];
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		areaUVs[i].x = (uSize > 0) ? (Axis(points[i], uAxis) - minPoint[uAxis]) / uSize : 0;
+		areaUVs[i].y = (vSize > 0) ? (Axis(points[i], vAxis) - minPoint[vAxis]) / vSize : 0;
+		if (vAxis == 1)  areaUVs[i].y = 1 - areaUVs[i].y; // y is up, v is down
+	}
+	return areaUVs;
+}
+
+
+// Transform the points of a polygon, clip it against the near plane and store the result in the constants
+bool SetPolygonConstants(const std::vector<CVector3>& points, const CMatrix4x4& worldViewProjectionMatrix,
+                         PostProcessingConstants& constants)
+{
+	std::vector<CVector2> areaUVs = PolygonAreaUVs(points);
+	std::vector<CVector4> clipPoints;
+	for (const CVector3& point : points)
+	{
+		clipPoints.push_back(CVector4(point, 1) * worldViewProjectionMatrix);
+	}
+
+	ClipToNearPlane(clipPoints, areaUVs);
+	int numPoints = static_cast<int>(clipPoints.size());
+	if (numPoints < 3 || numPoints > MAX_POLYGON_POINTS)  return false;
+
+	for (int i = 0; i < numPoints; ++i)
+	{
+		constants.polygon2DPoints[i] = clipPoints[i];
+		constants.polygonAreaUVs[i] = { areaUVs[i].x, areaUVs[i].y, 0, 0 };
+	}
+	constants.numPolygonPoints = numPoints;
+	return true;
+}
+
+
+// Convert the clip space polygon in the constants to pixel coordinates
+std::vector<CVector2> PolygonPixelPoints(const PostProcessingConstants& constants, float viewportWidth, float viewportHeight)
+{
+	std::vector<CVector2> pixelPoints;
+	for (int i = 0; i < constants.numPolygonPoints; ++i)
+	{
+		const CVector4& point = constants.polygon2DPoints[i];
+		pixelPoints.push_back({ (point.x / point.w + 1.0f) * 0.5f * viewportWidth, (1.0f - point.y / point.w) * 0.5f * viewportHeight });
+	}
+	return pixelPoints;
+}
+
+
+// Split a polygon in pixel coordinates into triangles. Ear clipping: repeatedly cut off a corner that bends the same way as the
+// polygon and has no other point inside it
+std::vector<uint16_t> TriangulatePolygon(const std::vector<CVector2>& pixelPoints)
+{
+	std::vector<uint16_t> indices;
+	int numPoints = static_cast<int>(pixelPoints.size());
+	if (numPoints < 3)  return indices;
+
+	// Winding from the signed area
+	float area = 0;
+	for (int i = 0; i < numPoints; ++i)
+	{
+		const CVector2& a = pixelPoints[i];
+		const CVector2& b = pixelPoints[(i + 1) % numPoints];
+		area += a.x * b.y - b.x * a.y;
+	}
+	float winding = (area >= 0) ? 1.0f : -1.0f;
+
+	std::vector<uint16_t> remaining;
+	for (int i = 0; i < numPoints; ++i)  remaining.push_back(static_cast<uint16_t>(i));
+
+	while (remaining.size() > 3)
+	{
+		int numRemaining = static_cast<int>(remaining.size());
+		bool foundEar = false;
+		for (int i = 0; i < numRemaining && !foundEar; ++i)
+		{
+			uint16_t prev = remaining[(i + numRemaining - 1) % numRemaining];
+			uint16_t curr = remaining[i];
+			uint16_t next = remaining[(i + 1) % numRemaining];
+			const CVector2& a = pixelPoints[prev];
+			const CVector2& b = pixelPoints[curr];
+			const CVector2& c = pixelPoints[next];
+			if (Cross(a, b, c) * winding <= 0)  continue; // Reflex or flat corner
+
+			bool empty = true;
+			for (uint16_t other : remaining)
+			{
+				if (other != prev && other != curr && other != next && InTriangle(pixelPoints[other], a, b, c, winding))
+				{
+					empty = false;
+					break;
+				}
+			}
+			if (!empty)  continue;
+
+			indices.insert(indices.end(), { prev, curr, next });
+			remaining.erase(remaining.begin() + i);
+			foundEar = true;
+		}
+
+		// Only happens for polygons with crossing edges or all their points in a line, draw what is left as a fan
+		if (!foundEar)  break;
+	}
+
+	for (size_t i = 1; i + 1 < remaining.size(); ++i)
+	{
+		indices.insert(indices.end(), { remaining[0], remaining[i], remaining[i + 1] });
+	}
+	return indices;
+}
+
+
+// Get the spans of pixels covered by a polygon in pixel coordinates
+void PolygonSpans(const std::vector<CVector2>& pixelPoints, int viewportWidth, int viewportHeight, std::vector<PolygonSpan>& spans)
+{
+	spans.clear();
+	int numPoints = static_cast<int>(pixelPoints.size());
+	if (numPoints < 3)  return;
+
+	float minY = pixelPoints[0].y;
+	float maxY = pixelPoints[0].y;
+	for (const CVector2& point : pixelPoints)
+	{
+		minY = std::min(minY, point.y);
+		maxY = std::max(maxY, point.y);
+	}
+	int top    = std::max(static_cast<int>(std::ceil(minY - 0.5f)), 0);
+	int bottom = std::min(static_cast<int>(std::ceil(maxY - 0.5f)), viewportHeight);
+
+	std::vector<float> crossings;
+	for (int y = top; y < bottom; ++y)
+	{
+		// Where the edges cross the row's centre line. Each edge includes its top end and not its bottom, so a point exactly on
+		// the line is counted once
+		float centreY = y + 0.5f;
+		crossings.clear();
+		for (int i = 0; i < numPoints; ++i)
+		{
+			const CVector2& a = pixelPoints[i];
+			const CVector2& b = pixelPoints[(i + 1) % numPoints];
+			if ((a.y <= centreY) != (b.y <= centreY))
+			{
+				crossings.push_back(a.x + (centreY - a.y) * (b.x - a.x) / (b.y - a.y));
+			}
+		}
+		std::sort(crossings.begin(), crossings.end());
+
+		// Pixels with centres between each pair of crossings are inside
+		for (size_t i = 0; i + 1 < crossings.size(); i += 2)
+		{
+			int left  = std::max(static_cast<int>(std::ceil(crossings[i]     - 0.5f)), 0);
+			int right = std::min(static_cast<int>(std::ceil(crossings[i + 1] - 0.5f)), viewportWidth);
+			if (right > left)  spans.push_back({ y, left, right });
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// PolygonUVMapping
+//--------------------------------------------------------------------------------------
+
+// Set up for the polygon in the constants, given its points from PolygonPixelPoints
+bool PolygonUVMapping::Set(const PostProcessingConstants& constants, const std::vector<CVector2>& pixelPoints)
+{
+	// Find the planes from the largest of the polygon's triangles, which is the least affected by rounding
+	std::vector<uint16_t> triangles = TriangulatePolygon(pixelPoints);
+	int corners[3] = { 0, 1, 2 };
+	float area = 0;
+	for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+	{
+		float triangleArea = Cross(pixelPoints[triangles[i]], pixelPoints[triangles[i + 1]], pixelPoints[triangles[i + 2]]);
+		if (std::abs(triangleArea) > std::abs(area))
+		{
+			area = triangleArea;
+			for (int corner = 0; corner < 3; ++corner)  corners[corner] = triangles[i + corner];
+		}
+	}
+	if (area == 0)  return false;
+
+	const CVector2& p0 = pixelPoints[corners[0]];
+	const CVector2& p1 = pixelPoints[corners[1]];
+	const CVector2& p2 = pixelPoints[corners[2]];
+	auto screenPlane = [&](float v0, float v1, float v2)
+	{
+		ScreenPlane plane;
+		plane.dx = ((v1 - v0) * (p2.y - p0.y) - (v2 - v0) * (p1.y - p0.y)) / area;
+		plane.dy = ((v2 - v0) * (p1.x - p0.x) - (v1 - v0) * (p2.x - p0.x)) / area;
+		plane.c  = v0 - plane.dx * p0.x - plane.dy * p0.y;
+		return plane;
+	};
+
+	float invW[3], uOverW[3], vOverW[3];
+	for (int corner = 0; corner < 3; ++corner)
+	{
+		invW[corner]   = 1.0f / constants.polygon2DPoints[corners[corner]].w;
+		uOverW[corner] = constants.polygonAreaUVs[corners[corner]].x * invW[corner];
+		vOverW[corner] = constants.polygonAreaUVs[corners[corner]].y * invW[corner];
+	}
+	mInvW   = screenPlane(invW[0],   invW[1],   invW[2]);
+	mUOverW = screenPlane(uOverW[0], uOverW[1], uOverW[2]);
+	mVOverW = screenPlane(vOverW[0], vOverW[1], vOverW[2]);
+	return true;
+}
@@ -0,0 +1,85 @@
+//--------------------------------------------------------------------------------------
+// Polygons for polygon post-processing, shared by the GPU (Scene.cpp) and CPU (CPU folder) pipelines
+//--------------------------------------------------------------------------------------
+// A polygon is given as any number of points in order around its edge, convex or concave, and
+// should be flat (e.g. a window on a building). Each point is transformed to clip space, the
+// polygon is clipped against the near plane and the result is stored in the post-processing
+// constants. The GPU draws the polygon as triangles from TriangulatePolygon, the CPU pipeline
+// shades the horizontal spans of pixels from PolygonSpans. Either way only the pixels covered
+// are processed. Nothing in here depends on DirectX. Code in .cpp file
+
+#ifndef _POST_PROCESS_POLYGON_H_INCLUDED_
+#define _POST_PROCESS_POLYGON_H_INCLUDED_
+
+#include "PostProcess.h"
+#include "CMatrix4x4.h"
+
+#include <cstdint>
+#include <vector>
+
+
+// A run of pixels in one row covered by a polygon, from left to right-1
+struct PolygonSpan
+{
+	int y;
+	int left;
+	int right;
+};
+
+
+// Give each point of a flat polygon an area UV, used by post-processes for effects that cover the polygon (e.g. the soft edge
+// of a frosted window). The UVs map the polygon's bounding box (in model space) to 0->1, along the two axes it is largest in.
+// If one of them is the y axis it is used for v, with v = 0 at the top. This gives a window in the xy plane listed from its
+// top-left corner the UVs (0,0) at the top-left and (1,1) at the bottom-right
+std::vector<CVector2> PolygonAreaUVs(const std::vector<CVector3>& points);
+
+// Transform the points of a polygon (in order around its edge) by the given world-view-projection matrix, clip it against the
+// near plane and store the result and the area UVs from PolygonAreaUVs in polygon2DPoints, polygonAreaUVs and numPolygonPoints.
+// Returns false if nothing is left after clipping, or if there are more than MAX_POLYGON_POINTS points after clipping
+bool SetPolygonConstants(const std::vector<CVector3>& points, const CMatrix4x4& worldViewProjectionMatrix,
+                         PostProcessingConstants& constants);
+
+// Convert the clip space polygon in the constants to pixel coordinates for a viewport of the given size. The points must be
+// in front of the camera, which SetPolygonConstants ensures
+std::vector<CVector2> PolygonPixelPoints(const PostProcessingConstants& constants, float viewportWidth, float viewportHeight);
+
+// Split a polygon in pixel coordinates into triangles, as indexes into its points, three per triangle. Works for convex and
+// concave polygons wound either way, as long as the edges do not cross
+std::vector<uint16_t> TriangulatePolygon(const std::vector<CVector2>& pixelPoints);
+
+// Get the spans of pixels covered by a polygon in pixel coordinates, row by row from the top, clipped to the viewport. A pixel
+// is covered if its centre is inside the polygon (even-odd rule, so concave polygons work). Any previous spans are cleared
+void PolygonSpans(const std::vector<CVector2>& pixelPoints, int viewportWidth, int viewportHeight, std::vector<PolygonSpan>& spans);
+
+
+// Area UVs across the polygon in the constants at any pixel position, interpolated with perspective correction as the GPU
+// does. For pipelines that shade the pixels of the polygon themselves
+class PolygonUVMapping
+{
+public:
+	// Set up for the polygon in the constants, given its points from PolygonPixelPoints. Returns false if it has no area
+	bool Set(const PostProcessingConstants& constants, const std::vector<CVector2>& pixelPoints);
+
+	// Area UV at a position in pixels (use x + 0.5, y + 0.5 for the centre of pixel x,y)
+	CVector2 At(float x, float y) const
+	{
+		float w = 1.0f / mInvW.At(x, y);
+		return { mUOverW.At(x, y) * w, mVOverW.At(x, y) * w };
+	}
+
+private:
+	// A value that changes linearly over the screen, dx * x + dy * y + c at pixel position x,y
+	struct ScreenPlane
+	{
+		float dx, dy, c;
+		float At(float x, float y) const  { return dx * x + dy * y + c; }
+	};
+
+	// The polygon is flat, so 1/w, u/w and v/w change linearly over the screen
+	ScreenPlane mInvW;
+	ScreenPlane mUOverW;
+	ScreenPlane mVOverW;
+};
+
+
+#endif //_POST_PROCESS_POLYGON_H_INCLUDED_
@@ -11,21 +11,30 @@
 #include "Shader.h"
 #include "Input.h"
 #include "Common.h"
+#include "PostProcess.h"
+#include "PostProcessPolygon.h"
+#include "PostProcessShaders.h"
+#include "Rasterizer.h"
 
 #include "CVector2.h" 
 #include "CVector3.h" 
 #include "CMatrix4x4.h"
+#include "Frustum.h"
 #include "MathHelpers.h"     // Helper functions for maths
 #include "GraphicsHelpers.h" // Helper functions to unclutter the code here
+#include "TaskGraph.h"
+#include "TextureCache.h"
 #include "ColourRGBA.h" 
 
-#include <array>
+#include <algorithm>
+#include <cmath>
 #include <sstream>
 #include <memory>
 
 #include <map>
 #include <vector>
 #include <stack>
+#include <stdexcept>
 
 
 //--------------------------------------------------------------------------------------
@@ -33,50 +42,15 @@
 //--------------------------------------------------------------------------------------
 
 //********************
-// Available post-processes
-enum class PostProcess
-{
-	None,
-	NightVision,
-	VerticalColourGradient,
-	GaussianBlurHorizontal,
-	GaussianBlurVertical,
-	UnderWater,
-	HueVerticalColourGradient,
-	Sepia,
-	Inverted,
-	Contour,
-	GameBoy,
-	Bloom,
-	MergeTextures,
-	Dilation,
-	DualFiltering,
-	DepthOfField,
-	KawaseLightStreak,
-	MotionBlur,
-
-	Copy,
-	Tint,
-	GreyNoise,
-	Burn,
-	Distort,
-	Spiral,
-	HeatHaze,
-};
-
-enum class PostProcessMode
-{
-	Fullscreen,
-	Area,
-	Polygon,
-};
-
+// Available post-processes and modes are in PostProcess.h
 auto gCurrentPostProcess     = PostProcess::None;
 auto gCurrentPostProcessMode = PostProcessMode::Fullscreen;
-std::vector<std::pair<PostProcess, PostProcessMode>> gPostProcessAndModeStack;
+PostProcessStack gPostProcessAndModeStack;
+PostProcessExecutionPlan gPostProcessExecutionPlan; // The passes actually run for the stack above, updated whenever the stack changes
 std::vector<PostProcess> windowPostProcesses;
 const int NUM_OF_WINDOWS = 4;
 bool isOtherFrame = false;
+bool gScissorAreaPostProcess = true; // Area post-processes only copy and process the pixels around the area, see AreaPostProcess
 //********************
 
 
@@ -136,6 +110,18 @@ struct Light
 Light gLights[NUM_LIGHTS];
 
 
+// The models above in a fixed order for view frustum culling, the lights follow on from FirstLightModel
+enum SceneModel
+{
+	GroundModel, CrateModel, CubeModel, WallModel, SecondWallModel, StarsModel, FirstLightModel,
+	NUM_SCENE_MODELS = FirstLightModel + NUM_LIGHTS
+};
+
+// Results of the last CullSceneModels: the camera's view frustum and which models might be inside it
+Frustum gSceneFrustum;
+bool    gSceneModelVisible[NUM_SCENE_MODELS];
+
+
 // Additional light information
 CVector3 gAmbientColour = { 0.3f, 0.3f, 0.4f }; // Background level of light (slightly bluish to match the far background, which is dark blue)
 float    gSpecularPower = 256; // Specular power controls shininess - same for all models in this app
@@ -165,6 +151,7 @@ ID3D11Buffer*     gPerModelConstantBuffer; // --"--
 //**************************
 PostProcessingConstants gPostProcessingConstants;       // As above, but constants (settings) for each post-process
 ID3D11Buffer*           gPostProcessingConstantBuffer; // --"--
+ID3D11Buffer*           gPolygonIndexBuffer;           // Triangles of the polygon for polygon post-processing, see PolygonPostProcess
 //**************************
 
 
@@ -189,6 +176,15 @@ ID3D11ShaderResourceView* gSecondWallDifuseSpecularMapSRV = nullptr;
 ID3D11Resource*           gLightDiffuseMap = nullptr;
 ID3D11ShaderResourceView* gLightDiffuseMapSRV = nullptr;
 
+// CPU copies of the textures above for the software rasterizer, decoded from the same files (see InitSoftwareRendering)
+Image gStarsImage;
+Image gGroundImage;
+Image gCrateImage;
+Image gCubeImage;
+Image gWallImage;
+Image gSecondWallImage;
+Image gLightImage;
+
 /* NOTE TO SELF
 
 The relation between a render target view (RTV) and a shader resource view (SRV) is that they both reference the same underlying texture resource in GPU memory, but with different access and usage semantics.
@@ -226,26 +222,40 @@ ID3D11Texture2D*		  gShadowMap1Texture = nullptr; // This object represents the
 ID3D11DepthStencilView*   gShadowMap1DepthStencil = nullptr; // This object is used when we want to render to the texture above **as a depth buffer**
 ID3D11ShaderResourceView* gShadowMap1SRV = nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
 
-// This texture will have the scene renderered on it. Then the texture is then used for post-processing
-ID3D11Texture2D*          gSceneTexture      = nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gSceneRenderTarget = nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gSceneTextureSRV   = nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
-
-// This texture will have the scene renderered on it. Then the texture is then used for post-processing
-ID3D11Texture2D*          gSceneTextureTwo = nullptr; // This object represents the memory used by the texture on the GPU
-ID3D11RenderTargetView*   gSceneRenderTargetTwo = nullptr; // This object is used when we want to render to the texture above
-ID3D11ShaderResourceView* gSceneTextureSRVTwo = nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+// Software rendering, toggled with C. The depth buffer and the scene are rendered on the CPU by the software rasterizer, then
+// uploaded to the textures below and used in place of the shadow map and the GPU's scene render. Post-processing is still done
+// on the GPU. Everything here is created the first time software rendering is switched on (see InitSoftwareRendering)
+bool                      gSoftwareRendering    = false;
+std::string               gSoftwareRenderingError; // Why software rendering couldn't be switched on, shown in the window title
+ThreadPool*               gSoftwareThreadPool   = nullptr;
+SoftwareRasterizer*       gSoftwareRasterizer   = nullptr;
+Image                     gSoftwareSceneImage;
+ID3D11Texture2D*          gSoftwareSceneTexture = nullptr; // Full floats, the rasterizer's image is copied up as it is
+ID3D11ShaderResourceView* gSoftwareSceneSRV     = nullptr;
+ID3D11Texture2D*          gSoftwareDepthTexture = nullptr; // The red channel of the rasterizer's DepthImage, same size as the shadow map
+ID3D11ShaderResourceView* gSoftwareDepthSRV     = nullptr;
+
+// Scene buffers - the scene is rendered to one of these textures, then each post-process reads one buffer and writes another.
+// Post-processes that need an earlier image (the sharp scene before Bloom, the previous frame for MotionBlur) read a history
+// slot, which is simply a buffer that is left alone while it is needed. No copies are made. Buffers are created and released
+// as the post-process stack changes, the plan (PostProcess.cpp) gives the fewest buffers the stack can run in
+struct SceneBuffer
+{
+	ID3D11Texture2D*          texture      = nullptr; // This object represents the memory used by the texture on the GPU
+	ID3D11RenderTargetView*   renderTarget = nullptr; // This object is used when we want to render to the texture above
+	ID3D11ShaderResourceView* textureSRV   = nullptr; // This object is used to give shaders access to the texture above (SRV = shader resource view)
+	SceneBufferFormat         format       = SceneBufferFormat::RGBA32F;
+};
+std::vector<SceneBuffer> gSceneBuffers;
+PostProcessBufferPlan    gSceneBufferPlan;     // Buffer for each image in the current post-process stack, see UpdateSceneBuffers
+size_t                   gSceneBufferBytes = 0; // Memory used by the scene buffers, shown in the window title
 
-// This texture will have the scene renderered on it. Then the texture is then used for post-processing
-// Used for bloom and other post processes that need the sharp scene to be saved
-ID3D11Texture2D*          gSceneTextureCopy = nullptr; 
-ID3D11RenderTargetView*   gSceneRenderTargetCopy = nullptr; 
-ID3D11ShaderResourceView* gSceneTextureSRVCopy = nullptr; 
+// Least precise format for the scene buffers. Each buffer uses the format its images need (see PostProcessOutputFormat) or this
+// format, whichever is more precise. Set to SceneBufferFormat::RGBA32F to store every image in full floats
+SceneBufferFormat gMinSceneBufferFormat = SceneBufferFormat::RGBA8;
 
-// Used for motion blur only, every other frame scene is getting saved (PF stands for previous frame)
-ID3D11Texture2D*		  gSceneTexturePF = nullptr;
-ID3D11RenderTargetView*   gSceneRenderTargetPF = nullptr;
-ID3D11ShaderResourceView* gSceneTextureSRVPF = nullptr;
+int gCurrentSceneBuffer = 0; // Buffer holding the latest image, the input to the next pass
+int gHistoryBuffers[NUM_HISTORY_SLOTS] = { -1, -1, -1 }; // Buffer held by each history slot (indexed by HistorySlot), -1 if empty
 
 // Additional textures used for specific post-processes
 ID3D11Resource*			  gStarLensMap = nullptr;
@@ -263,10 +273,11 @@ ID3D11ShaderResourceView* nullSRV = nullptr;
 //****************************
 
 // Helper method signatures
-void SaveCurrentSceneToTexture(int index, bool motionBlur);
+bool UpdateSceneBuffers();
 void AddProcessAndMode(PostProcess process, PostProcessMode mode);
 void RemoveProcessAndMode();
-std::array<CVector3, 4> GetWindowPoint(int windowIndex);
+void UpdatePostProcessExecutionPlan();
+std::vector<CVector3> GetWindowPoint(int windowIndex);
 void CreateWindowPostProcesses(std::vector<PostProcess> windowPostProcesses);
 
 //--------------------------------------------------------------------------------------
@@ -293,63 +304,105 @@ CMatrix4x4 CalculateLightProjectionMatrix(int lightIndex)
 // Returns true on success
 bool InitGeometry()
 {
+	// Meshes, textures, states and shaders don't depend on each other, so each one is a task in a graph that runs them all at once
+	// across a thread pool. Startup then takes about as long as the slowest asset rather than the total of them all. The tasks only
+	// use the D3D device, which is thread-safe, so can run on any thread (see TaskGraph.h)
+	ThreadPool   threadPool;
+	TaskGraph    startup;
+	TextureCache textureCache;
+
+
 	////--------------- Load meshes ---------------////
 
 	// Load mesh geometry data, just like TL-Engine this doesn't create anything in the scene. Create a Model for that.
-	try
+	// Constructors cannot return error messages so the Mesh class throws exceptions on error (fairly standard approach this),
+	// the task graph catches them and picks up the error message put in the exception (see Mesh.cpp)
+	struct MeshFile
 	{
-		gStarsMesh  = new Mesh("Stars.x");
-		gGroundMesh = new Mesh("Floor.x");
-		gCubeMesh   = new Mesh("Cube.x");
-		gCrateMesh  = new Mesh("CargoContainer.x");
-		gLightMesh = new Mesh("Light.x");
-		gWallMesh = new Mesh("Wall2.x");
-		gSecondWallMesh  = new Mesh("Wall1.x");
-	}
-	catch (std::runtime_error e)  // Constructors cannot return error messages so use exceptions to catch mesh errors (fairly standard approach this)
+		const char* fileName;
+		Mesh**      mesh;
+	};
+	const MeshFile meshFiles[] =
 	{
-		gLastError = e.what(); // This picks up the error message put in the exception (see Mesh.cpp)
-		return false;
+		{ "Stars.x",          &gStarsMesh      },
+		{ "Floor.x",          &gGroundMesh     },
+		{ "Cube.x",           &gCubeMesh       },
+		{ "CargoContainer.x", &gCrateMesh      },
+		{ "Light.x",          &gLightMesh      },
+		{ "Wall2.x",          &gWallMesh       },
+		{ "Wall1.x",          &gSecondWallMesh },
+	};
+	for (auto& meshFile : meshFiles)
+	{
+		startup.Add(meshFile.fileName, [meshFile]() { *meshFile.mesh = new Mesh(meshFile.fileName); });
 	}
 
 
 	////--------------- Load / prepare textures & GPU states ---------------////
 
 	// Load textures and create DirectX objects for them
-	// The LoadTexture function requires you to pass a ID3D11Resource* (e.g. &gCubeDiffuseMap), which manages the GPU memory for the
-	// texture and also a ID3D11ShaderResourceView* (e.g. &gCubeDiffuseMapSRV), which allows us to use the texture in shaders
+	// The texture cache's Load function requires you to pass a ID3D11Resource* (e.g. &gCubeDiffuseMap), which manages the GPU memory
+	// for the texture and also a ID3D11ShaderResourceView* (e.g. &gCubeDiffuseMapSRV), which allows us to use the texture in shaders
 	// The function will fill in these pointers with usable data. The variables used here are globals found near the top of the file.
-	if (!LoadTexture("Stars.jpg",                &gStarsDiffuseSpecularMap,  &gStarsDiffuseSpecularMapSRV) ||
-		!LoadTexture("GrassDiffuseSpecular.dds", &gGroundDiffuseSpecularMap, &gGroundDiffuseSpecularMapSRV) ||
-		!LoadTexture("StoneDiffuseSpecular.dds", &gCubeDiffuseSpecularMap, &gCubeDiffuseSpecularMapSRV) ||
-		!LoadTexture("brick_35.jpg", &gWallDifuseSpecularMap, &gWallDifuseSpecularMapSRV) ||
-		!LoadTexture("brick_35.jpg", &gSecondWallDifuseSpecularMap,   &gSecondWallDifuseSpecularMapSRV) ||
-		!LoadTexture("CargoA.dds",               &gCrateDiffuseSpecularMap,  &gCrateDiffuseSpecularMapSRV) ||
-		!LoadTexture("Flare.jpg",                &gLightDiffuseMap,          &gLightDiffuseMapSRV) ||
-		!LoadTexture("Noise.png",                &gNoiseMap,   &gNoiseMapSRV) ||
-		!LoadTexture("Flare.jpg",				 &gStarLensMap, &gStarLensMapSRV) ||
-		!LoadTexture("Burn.png",                 &gBurnMap,    &gBurnMapSRV) ||
-		!LoadTexture("Distort.png",              &gDistortMap, &gDistortMapSRV))
-	{
-		gLastError = "Error loading textures";
-		return false;
+	// Images used more than once (e.g. brick_35.jpg) are only loaded once, each user shares the same texture (see TextureCache.h)
+	struct TextureFile
+	{
+		const char*                fileName;
+		ID3D11Resource**           texture;
+		ID3D11ShaderResourceView** textureSRV;
+	};
+	const TextureFile textureFiles[] =
+	{
+		{ "Stars.jpg",                &gStarsDiffuseSpecularMap,     &gStarsDiffuseSpecularMapSRV     },
+		{ "GrassDiffuseSpecular.dds", &gGroundDiffuseSpecularMap,    &gGroundDiffuseSpecularMapSRV    },
+		{ "StoneDiffuseSpecular.dds", &gCubeDiffuseSpecularMap,      &gCubeDiffuseSpecularMapSRV      },
+		{ "brick_35.jpg",             &gWallDifuseSpecularMap,       &gWallDifuseSpecularMapSRV       },
+		{ "brick_35.jpg",             &gSecondWallDifuseSpecularMap, &gSecondWallDifuseSpecularMapSRV },
+		{ "CargoA.dds",               &gCrateDiffuseSpecularMap,     &gCrateDiffuseSpecularMapSRV     },
+		{ "Flare.jpg",                &gLightDiffuseMap,             &gLightDiffuseMapSRV             },
+		{ "Noise.png",                &gNoiseMap,                    &gNoiseMapSRV                    },
+		{ "Flare.jpg",                &gStarLensMap,                 &gStarLensMapSRV                 },
+		{ "Burn.png",                 &gBurnMap,                     &gBurnMapSRV                     },
+		{ "Distort.png",              &gDistortMap,                  &gDistortMapSRV                  },
+	};
+	for (auto& textureFile : textureFiles)
+	{
+		startup.Add(textureFile.fileName, [textureFile, &textureCache]()
+		{
+			if (!textureCache.Load(textureFile.fileName, textureFile.texture, textureFile.textureSRV))
+			{
+				throw std::runtime_error(std::string("Error loading texture ") + textureFile.fileName);
+			}
+		});
 	}
 
 
-	// Create all filtering modes, blending modes etc. used by the app (see State.cpp/.h)
-	if (!CreateStates())
+	// Create all filtering modes, blending modes etc. used by the app (see State.cpp/.h). This is the only task that sets gLastError
+	startup.Add("States", []()
 	{
-		gLastError = "Error creating states";
-		return false;
-	}
+		if (!CreateStates())  throw std::runtime_error(gLastError);
+	});
 
 
 	////--------------- Prepare shaders and constant buffers to communicate with them ---------------////
 
 	// Load the shaders required for the geometry we will use (see Shader.cpp / .h)
-	if (!LoadShaders())
+	for (int shader = 0; shader < NumShaders(); ++shader)
 	{
-		gLastError = "Error loading shaders";
+		startup.Add(ShaderName(shader), [shader]()
+		{
+			if (!LoadShader(shader))  throw std::runtime_error(std::string("Error loading shader ") + ShaderName(shader));
+		});
+	}
+
+
+	// Run everything above and show when each task ran in Visual Studio's output window
+	bool loaded = startup.Run(threadPool);
+	OutputDebugStringA(startup.TimelineReport().c_str());
+	OutputDebugStringA(("Textures shared: " + std::to_string(textureCache.NumShared()) + "\n").c_str());
+	if (!loaded)
+	{
+		gLastError = startup.Error();
 		return false;
 	}
 
@@ -365,115 +418,23 @@ bool InitGeometry()
 		return false;
 	}
 
-	//********************************************
-	//**** Create Scene Texture
-
-	// We will render the scene to this texture instead of the back-buffer (screen), then we post-process the texture onto the screen
-	// This is exactly the same code we used in the graphics module when we were rendering the scene onto a cube using a texture
-
-	// Using a helper function to load textures from files above. Here we create the scene texture manually
-	// as we are creating a special kind of texture (one that we can render to). Many settings to prepare:
-	D3D11_TEXTURE2D_DESC sceneTextureDesc = {};
-	sceneTextureDesc.Width = gViewportWidth;  // Full-screen post-processing - use full screen size for texture
-	sceneTextureDesc.Height = gViewportHeight;
-	sceneTextureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
-	sceneTextureDesc.ArraySize = 1;
-	//sceneTextureDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM; // RGBA texture (8-bits each)
-	sceneTextureDesc.Format = DXGI_FORMAT_R32G32B32A32_FLOAT; // Enables HDR (Comment to disable and uncomment above line)
-	sceneTextureDesc.SampleDesc.Count = 1;
-	sceneTextureDesc.SampleDesc.Quality = 0;
-	sceneTextureDesc.Usage = D3D11_USAGE_DEFAULT;
-	sceneTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
-	sceneTextureDesc.CPUAccessFlags = 0;
-	sceneTextureDesc.MiscFlags = 0;
-	if (FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &gSceneTexture)))
-	{
-		gLastError = "Error creating scene texture";
-		return false;
-	}
-
-	// Second texture
-	if (FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &gSceneTextureTwo)))
-	{
-		gLastError = "Error creating scene texture two";
-		return false;
-	}
-
-	// Copy texture
-	if (FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &gSceneTextureCopy)))
+	// Index buffer for polygon post-processing, rewritten for each polygon. The points themselves go in the constant buffer
+	D3D11_BUFFER_DESC indexBufferDesc = {};
+	indexBufferDesc.BindFlags      = D3D11_BIND_INDEX_BUFFER;
+	indexBufferDesc.ByteWidth      = 3 * (MAX_POLYGON_POINTS - 2) * sizeof(uint16_t); // A polygon of n points is n - 2 triangles
+	indexBufferDesc.Usage          = D3D11_USAGE_DYNAMIC;
+	indexBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	if (FAILED(gD3DDevice->CreateBuffer(&indexBufferDesc, nullptr, &gPolygonIndexBuffer)))
 	{
-		gLastError = "Error creating scene texture two";
+		gLastError = "Error creating polygon index buffer";
 		return false;
 	}
 
-	// Previous Frame texture
-	if (FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &gSceneTexturePF)))
-	{
-		gLastError = "Error creating scene texture two";
-		return false;
-	}
-
-	// We created the scene texture above, now we get a "view" of it as a render target, i.e. get a special pointer to the texture that
-	// we use when rendering to it (see RenderScene function below)
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gSceneTexture, NULL, &gSceneRenderTarget)))
-	{
-		gLastError = "Error creating scene render target view";
-		return false;
-	}
-
-	// Second RT
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gSceneTextureTwo, NULL, &gSceneRenderTargetTwo)))
-	{
-		gLastError = "Error creating scene render target view";
-		return false;
-	}
-
-	// Copy RT
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gSceneTextureCopy, NULL, &gSceneRenderTargetCopy)))
-	{
-		gLastError = "Error creating scene render target view";
-		return false;
-	}
-
-	// Previous Frame RT
-	if (FAILED(gD3DDevice->CreateRenderTargetView(gSceneTexturePF, NULL, &gSceneRenderTargetPF)))
-	{
-		gLastError = "Error creating scene render target view";
-		return false;
-	}
-
-	// We also need to send this texture (resource) to the shaders. To do that we must create a shader-resource "view"
-	D3D11_SHADER_RESOURCE_VIEW_DESC srDesc = {};
-	srDesc.Format = sceneTextureDesc.Format;
-	srDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-	srDesc.Texture2D.MostDetailedMip = 0;
-	srDesc.Texture2D.MipLevels = 1;
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gSceneTexture, &srDesc, &gSceneTextureSRV)))
-	{
-		gLastError = "Error creating scene shader resource view";
-		return false;
-	}
-
-	// Second SRV
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gSceneTextureTwo, &srDesc, &gSceneTextureSRVTwo)))
-	{
-		gLastError = "Error creating scene shader resource view";
-		return false;
-	}
-
-	// Copy SRV
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gSceneTextureCopy, &srDesc, &gSceneTextureSRVCopy)))
-	{
-		gLastError = "Error creating scene shader resource view";
-		return false;
-	}
+	//********************************************
+	//**** Scene Textures
 
-	// Previous Frame SRV
-	if (FAILED(gD3DDevice->CreateShaderResourceView(gSceneTexturePF, &srDesc, &gSceneTextureSRVPF)))
-	{
-		gLastError = "Error creating scene shader resource view";
-		return false;
-	}
+	// The scene is rendered to a texture instead of the back-buffer (screen), then we post-process the texture onto the screen
+	// Scene textures are only created when the post-process stack needs them, see CreateSceneBuffer and UpdateSceneBuffers
 
 	//**** Create Shadow Map texture ****//
 
@@ -594,6 +555,154 @@ bool InitScene()
 }
 
 
+// DirectX format for a scene buffer format
+DXGI_FORMAT SceneBufferDXGIFormat(SceneBufferFormat format)
+{
+	switch (format)
+	{
+		case SceneBufferFormat::RGBA8:      return DXGI_FORMAT_R8G8B8A8_UNORM_SRGB; // Shaders read and write linear colours
+		case SceneBufferFormat::R11G11B10F: return DXGI_FORMAT_R11G11B10_FLOAT;
+		case SceneBufferFormat::RGBA16F:    return DXGI_FORMAT_R16G16B16A16_FLOAT;
+		default:                            return DXGI_FORMAT_R32G32B32A32_FLOAT;
+	}
+}
+
+
+// Create a full-screen texture of the given format to render the scene or a post-process to, with views to use it as a render
+// target and a shader resource. Returns false on failure, the error is in gLastError
+bool CreateSceneBuffer(SceneBuffer& sceneBuffer, SceneBufferFormat format)
+{
+	// This is exactly the same code we used in the graphics module when we were rendering the scene onto a cube using a texture
+
+	// Using a helper function to load textures from files above. Here we create the scene texture manually
+	// as we are creating a special kind of texture (one that we can render to). Many settings to prepare:
+	D3D11_TEXTURE2D_DESC sceneTextureDesc = {};
+	sceneTextureDesc.Width = gViewportWidth;  // Full-screen post-processing - use full screen size for texture
+	sceneTextureDesc.Height = gViewportHeight;
+	sceneTextureDesc.MipLevels = 1; // No mip-maps when rendering to textures (or we would have to render every level)
+	sceneTextureDesc.ArraySize = 1;
+	sceneTextureDesc.Format = SceneBufferDXGIFormat(format); // The float formats enable HDR
+	sceneTextureDesc.SampleDesc.Count = 1;
+	sceneTextureDesc.SampleDesc.Quality = 0;
+	sceneTextureDesc.Usage = D3D11_USAGE_DEFAULT;
+	sceneTextureDesc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE; // IMPORTANT: Indicate we will use texture as render target, and pass it to shaders
+	sceneTextureDesc.CPUAccessFlags = 0;
+	sceneTextureDesc.MiscFlags = 0;
+	if (FAILED(gD3DDevice->CreateTexture2D(&sceneTextureDesc, NULL, &sceneBuffer.texture)))
+	{
+		gLastError = "Error creating scene texture";
+		return false;
+	}
+
+	// We created the scene texture above, now we get a "view" of it as a render target, i.e. get a special pointer to the texture that
+	// we use when rendering to it (see RenderScene function below)
+	if (FAILED(gD3DDevice->CreateRenderTargetView(sceneBuffer.texture, NULL, &sceneBuffer.renderTarget)))
+	{
+		gLastError = "Error creating scene render target view";
+		return false;
+	}
+
+	// We also need to send these textures (resources) to the shaders. To do that we must create a shader-resource "view"
+	D3D11_SHADER_RESOURCE_VIEW_DESC srDesc = {};
+	srDesc.Format = sceneTextureDesc.Format;
+	srDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srDesc.Texture2D.MostDetailedMip = 0;
+	srDesc.Texture2D.MipLevels = 1;
+	if (FAILED(gD3DDevice->CreateShaderResourceView(sceneBuffer.texture, &srDesc, &sceneBuffer.textureSRV)))
+	{
+		gLastError = "Error creating scene shader resource view";
+		return false;
+	}
+
+	sceneBuffer.format = format;
+	return true;
+}
+
+
+// Release the texture and views of a scene buffer
+void ReleaseSceneBuffer(SceneBuffer& sceneBuffer)
+{
+	if (sceneBuffer.textureSRV)    sceneBuffer.textureSRV->Release();
+	if (sceneBuffer.renderTarget)  sceneBuffer.renderTarget->Release();
+	if (sceneBuffer.texture)       sceneBuffer.texture->Release();
+	sceneBuffer = SceneBuffer();
+}
+
+
+// Create a texture the CPU writes with UpdateSubresource and shaders read, for the results of the software rendering. Returns
+// false on failure
+bool CreateSoftwareTexture(int width, int height, DXGI_FORMAT format, ID3D11Texture2D** texture, ID3D11ShaderResourceView** textureSRV)
+{
+	D3D11_TEXTURE2D_DESC textureDesc = {};
+	textureDesc.Width            = width;
+	textureDesc.Height           = height;
+	textureDesc.MipLevels        = 1;
+	textureDesc.ArraySize        = 1;
+	textureDesc.Format           = format;
+	textureDesc.SampleDesc.Count = 1;
+	textureDesc.Usage            = D3D11_USAGE_DEFAULT;
+	textureDesc.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
+	return SUCCEEDED(gD3DDevice->CreateTexture2D(&textureDesc, nullptr, texture)) &&
+	       SUCCEEDED(gD3DDevice->CreateShaderResourceView(*texture, nullptr, textureSRV));
+}
+
+
+// Prepare for software rendering: make the CPU copies of the meshes, decode the scene textures into CPU images and create the
+// rasterizer and the textures its results are uploaded to. Does nothing if done before. Returns false on failure, the error is in gLastError
+bool InitSoftwareRendering()
+{
+	if (gSoftwareRasterizer != nullptr)  return true;
+
+	// Meshes only keep a CPU-side copy of their geometry when it is needed
+	Mesh* meshes[] = { gStarsMesh, gGroundMesh, gCubeMesh, gCrateMesh, gLightMesh, gWallMesh, gSecondWallMesh };
+	for (auto mesh : meshes)
+	{
+		if (!mesh->PrepareSoftwareRendering())
+		{
+			gLastError = "Error preparing meshes for software rendering";
+			return false;
+		}
+	}
+
+	// Same files as the GPU textures in InitGeometry
+	struct TextureImage
+	{
+		const char* fileName;
+		Image*      image;
+	};
+	const TextureImage textureImages[] =
+	{
+		{ "Stars.jpg",                &gStarsImage      },
+		{ "GrassDiffuseSpecular.dds", &gGroundImage     },
+		{ "StoneDiffuseSpecular.dds", &gCubeImage       },
+		{ "brick_35.jpg",             &gWallImage       },
+		{ "brick_35.jpg",             &gSecondWallImage },
+		{ "CargoA.dds",               &gCrateImage      },
+		{ "Flare.jpg",                &gLightImage      },
+	};
+	for (auto& textureImage : textureImages)
+	{
+		if (!LoadTextureImage(textureImage.fileName, *textureImage.image))
+		{
+			gLastError = std::string("Error loading texture image ") + textureImage.fileName;
+			return false;
+		}
+	}
+
+	if (!CreateSoftwareTexture(gViewportWidth, gViewportHeight, DXGI_FORMAT_R32G32B32A32_FLOAT, &gSoftwareSceneTexture, &gSoftwareSceneSRV) ||
+	    !CreateSoftwareTexture(gShadowMapSize, gShadowMapSize, DXGI_FORMAT_R32_FLOAT, &gSoftwareDepthTexture, &gSoftwareDepthSRV))
+	{
+		gLastError = "Error creating software rendering textures";
+		return false;
+	}
+
+	gSoftwareSceneImage.Resize(gViewportWidth, gViewportHeight);
+	gSoftwareThreadPool = new ThreadPool();
+	gSoftwareRasterizer = new SoftwareRasterizer(*gSoftwareThreadPool);
+	return true;
+}
+
+
 // Release the geometry and scene resources created above
 void ReleaseResources()
 {
@@ -604,20 +713,17 @@ void ReleaseResources()
 	if (gShadowMap1SRV)           gShadowMap1SRV->Release();
 	if (gShadowMap1Texture)       gShadowMap1Texture->Release();
 
-	// First 
-	if (gSceneTextureSRV)              gSceneTextureSRV->Release();
-	if (gSceneRenderTarget)            gSceneRenderTarget->Release();
-	if (gSceneTexture)                 gSceneTexture->Release();
-
-	// Second
-	if (gSceneTextureSRVTwo)              gSceneTextureSRVTwo->Release();
-	if (gSceneRenderTargetTwo)            gSceneRenderTargetTwo->Release();
-	if (gSceneTextureTwo)                 gSceneTextureTwo->Release();
+	// Scene buffers
+	for (auto& sceneBuffer : gSceneBuffers)  ReleaseSceneBuffer(sceneBuffer);
+	gSceneBuffers.clear();
 
-	// Previous Frame
-	if (gSceneTextureSRVPF)              gSceneTextureSRVPF->Release();
-	if (gSceneRenderTargetPF)            gSceneRenderTargetPF->Release();
-	if (gSceneTexturePF)                 gSceneTexturePF->Release();
+	// Software rendering
+	if (gSoftwareDepthSRV)      gSoftwareDepthSRV->Release();
+	if (gSoftwareDepthTexture)  gSoftwareDepthTexture->Release();
+	if (gSoftwareSceneSRV)      gSoftwareSceneSRV->Release();
+	if (gSoftwareSceneTexture)  gSoftwareSceneTexture->Release();
+	delete gSoftwareRasterizer;  gSoftwareRasterizer = nullptr;
+	delete gSoftwareThreadPool;  gSoftwareThreadPool = nullptr;
 
 	if (gDistortMapSRV)                gDistortMapSRV->Release();
 	if (gDistortMap)                   gDistortMap->Release();
@@ -644,6 +750,7 @@ void ReleaseResources()
 	if (gStarsDiffuseSpecularMapSRV)   gStarsDiffuseSpecularMapSRV->Release();
 	if (gStarsDiffuseSpecularMap)      gStarsDiffuseSpecularMap->Release();
 
+	if (gPolygonIndexBuffer)            gPolygonIndexBuffer->Release();
 	if (gPostProcessingConstantBuffer)  gPostProcessingConstantBuffer->Release();
 	if (gPerModelConstantBuffer)        gPerModelConstantBuffer->Release();
 	if (gPerFrameConstantBuffer)        gPerFrameConstantBuffer->Release();
@@ -677,14 +784,39 @@ void ReleaseResources()
 // Scene Rendering
 //--------------------------------------------------------------------------------------
 
-void RenderDepthBufferFromCamera(Camera* camera)
+// Test the bounds of every model in the scene against the view of the given camera, the results are used by the next pass
+// rendered from that camera. Models off-screen are then skipped without any draw calls, and models partly on-screen only draw
+// the sub-meshes that are on-screen
+void CullSceneModels(Camera* camera)
+{
+	Model* models[NUM_SCENE_MODELS] = { gGround, gCrate, gCube, gWall, gSecondWall, gStars };
+	for (int i = 0; i < NUM_LIGHTS; ++i)  models[FirstLightModel + i] = gLights[i].model;
+
+	BoundingSphere spheres[NUM_SCENE_MODELS];
+	for (int i = 0; i < NUM_SCENE_MODELS; ++i)  spheres[i] = models[i]->WorldBoundingSphere();
+
+	gSceneFrustum = FrustumFromMatrix(camera->ViewProjectionMatrix());
+	CullSpheres(gSceneFrustum, spheres, NUM_SCENE_MODELS, gSceneModelVisible);
+}
+
+
+// Set the camera matrices in the per-frame constants and send them to the GPU
+void UpdateCameraConstants(Camera* camera)
 {
-	// Set camera matrices in the constant buffer and send over to GPU
 	gPerFrameConstants.cameraMatrix = camera->WorldMatrix();
 	gPerFrameConstants.viewMatrix = camera->ViewMatrix();
 	gPerFrameConstants.projectionMatrix = camera->ProjectionMatrix();
 	gPerFrameConstants.viewProjectionMatrix = camera->ViewProjectionMatrix();
 	UpdateConstantBuffer(gPerFrameConstantBuffer, gPerFrameConstants);
+}
+
+
+void RenderDepthBufferFromCamera(Camera* camera)
+{
+	CullSceneModels(camera);
+
+	// Set camera matrices in the constant buffer and send over to GPU
+	UpdateCameraConstants(camera);
 
 	// Get camera-like matrices from the spotlight, seet in the constant buffer and send over to GPU
 	/*gPerFrameConstants.viewMatrix = CalculateLightViewMatrix(0);
@@ -706,28 +838,50 @@ void RenderDepthBufferFromCamera(Camera* camera)
 	gD3DContext->OMSetDepthStencilState(gUseDepthBufferState, 0);
 	gD3DContext->RSSetState(gCullBackState);	
 
-	gGround->Render();
-	gCrate->Render();
-	gCube->Render();
-	gWall->Render();
-	gSecondWall->Render();
-	gStars->Render();
+	if (gSceneModelVisible[GroundModel])      gGround->Render(&gSceneFrustum);
+	if (gSceneModelVisible[CrateModel])       gCrate->Render(&gSceneFrustum);
+	if (gSceneModelVisible[CubeModel])        gCube->Render(&gSceneFrustum);
+	if (gSceneModelVisible[WallModel])        gWall->Render(&gSceneFrustum);
+	if (gSceneModelVisible[SecondWallModel])  gSecondWall->Render(&gSceneFrustum);
+	if (gSceneModelVisible[StarsModel])       gStars->Render(&gSceneFrustum);
+
+	for (int i = 0; i < NUM_LIGHTS; ++i)
+	{
+		if (gSceneModelVisible[FirstLightModel + i])  gLights[i].model->Render(&gSceneFrustum);
+	}
+}
+
+// Render the depth of everything in the scene from the given camera with the software rasterizer, the CPU equivalent of
+// RenderDepthBufferFromCamera. The depth is in the rasterizer's DepthImage afterwards, ready for DepthOfField
+void RenderDepthBufferFromCameraSoftware(Camera* camera, SoftwareRasterizer& rasterizer, int width, int height)
+{
+	CullSceneModels(camera);
+	rasterizer.BeginDepthFrame(width, height, camera->ViewProjectionMatrix());
+
+	// Same models and back-face culling as the GPU depth pass
+	const Frustum* frustum = &gSceneFrustum;
+	if (gSceneModelVisible[GroundModel])      gGround->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
+	if (gSceneModelVisible[CrateModel])       gCrate->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
+	if (gSceneModelVisible[CubeModel])        gCube->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
+	if (gSceneModelVisible[WallModel])        gWall->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
+	if (gSceneModelVisible[SecondWallModel])  gSecondWall->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
+	if (gSceneModelVisible[StarsModel])       gStars->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
 
 	for (int i = 0; i < NUM_LIGHTS; ++i)
 	{
-		gLights[i].model->Render();
+		if (gSceneModelVisible[FirstLightModel + i])  gLights[i].model->RenderDepthSoftware(rasterizer, RasterCull::Back, frustum);
 	}
+
+	rasterizer.EndFrame();
 }
 
 // Render everything in the scene from the given camera
 void RenderSceneFromCamera(Camera* camera)
 {
+	CullSceneModels(camera);
+
 	// Set camera matrices in the constant buffer and send over to GPU
-	gPerFrameConstants.cameraMatrix = camera->WorldMatrix();
-	gPerFrameConstants.viewMatrix = camera->ViewMatrix();
-	gPerFrameConstants.projectionMatrix = camera->ProjectionMatrix();
-	gPerFrameConstants.viewProjectionMatrix = camera->ViewProjectionMatrix();
-	UpdateConstantBuffer(gPerFrameConstantBuffer, gPerFrameConstants);
+	UpdateCameraConstants(camera);
 
 	// Indicate that the constant buffer we just updated is for use in the vertex shader (VS), geometry shader (GS) and pixel shader (PS)
 	gD3DContext->VSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer); // First parameter must match constant buffer number in the shader 
@@ -752,20 +906,36 @@ void RenderSceneFromCamera(Camera* camera)
 	// Render lit models, only change textures for each onee
 	gD3DContext->PSSetSamplers(0, 1, &gAnisotropic4xSampler);
 
-	gD3DContext->PSSetShaderResources(0, 1, &gGroundDiffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
-	gGround->Render();
+	// Models outside the view are skipped, including their texture changes
+	if (gSceneModelVisible[GroundModel])
+	{
+		gD3DContext->PSSetShaderResources(0, 1, &gGroundDiffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
+		gGround->Render(&gSceneFrustum);
+	}
 
-	gD3DContext->PSSetShaderResources(0, 1, &gCrateDiffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
-	gCrate->Render();
+	if (gSceneModelVisible[CrateModel])
+	{
+		gD3DContext->PSSetShaderResources(0, 1, &gCrateDiffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
+		gCrate->Render(&gSceneFrustum);
+	}
 
-	gD3DContext->PSSetShaderResources(0, 1, &gCubeDiffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
-	gCube->Render();
+	if (gSceneModelVisible[CubeModel])
+	{
+		gD3DContext->PSSetShaderResources(0, 1, &gCubeDiffuseSpecularMapSRV); // First parameter must match texture slot number in the shader
+		gCube->Render(&gSceneFrustum);
+	}
 
-	gD3DContext->PSSetShaderResources(0, 1, &gWallDifuseSpecularMapSRV); // First parameter must match texture slot number in the shader
-	gWall->Render();
+	if (gSceneModelVisible[WallModel])
+	{
+		gD3DContext->PSSetShaderResources(0, 1, &gWallDifuseSpecularMapSRV); // First parameter must match texture slot number in the shader
+		gWall->Render(&gSceneFrustum);
+	}
 
-	gD3DContext->PSSetShaderResources(0, 1, &gSecondWallDifuseSpecularMapSRV); // First parameter must match texture slot number in the shader
-	gSecondWall->Render();
+	if (gSceneModelVisible[SecondWallModel])
+	{
+		gD3DContext->PSSetShaderResources(0, 1, &gSecondWallDifuseSpecularMapSRV); // First parameter must match texture slot number in the shader
+		gSecondWall->Render(&gSceneFrustum);
+	}
 
 
 	////--------------- Render sky ---------------////
@@ -781,8 +951,11 @@ void RenderSceneFromCamera(Camera* camera)
 	gD3DContext->RSSetState(gCullNoneState);
 
 	// Render sky
-	gD3DContext->PSSetShaderResources(0, 1, &gStarsDiffuseSpecularMapSRV);
-	gStars->Render();
+	if (gSceneModelVisible[StarsModel])
+	{
+		gD3DContext->PSSetShaderResources(0, 1, &gStarsDiffuseSpecularMapSRV);
+		gStars->Render(&gSceneFrustum);
+	}
 
 
 
@@ -803,13 +976,83 @@ void RenderSceneFromCamera(Camera* camera)
 	// Render all the lights in the array
 	for (int i = 0; i < NUM_LIGHTS; ++i)
 	{
+		if (!gSceneModelVisible[FirstLightModel + i])  continue;
 		gPerModelConstants.objectColour = gLights[i].colour; // Set any per-model constants apart from the world matrix just before calling render (light colour here)
-		gLights[i].model->Render();
+		gLights[i].model->Render(&gSceneFrustum);
 	}
 }
 
 
 
+// Render everything in the scene from the given camera with the software rasterizer, into a CPU image such as the scene image
+// of a CpuPostProcessor. Draws the same models with the same shaders and states as RenderSceneFromCamera. The texture images must
+// have been loaded (see InitSoftwareRendering)
+void RenderSceneFromCameraSoftware(Camera* camera, SoftwareRasterizer& rasterizer, Image& target)
+{
+	// Same settings as the per-frame constant buffer
+	RasterFrameConstants constants;
+	constants.viewProjectionMatrix = camera->ViewProjectionMatrix();
+	constants.light1Position = gPerFrameConstants.light1Position;
+	constants.light1Colour   = gPerFrameConstants.light1Colour;
+	constants.light2Position = gPerFrameConstants.light2Position;
+	constants.light2Colour   = gPerFrameConstants.light2Colour;
+	constants.ambientColour  = gPerFrameConstants.ambientColour;
+	constants.specularPower  = gPerFrameConstants.specularPower;
+	constants.cameraPosition = gPerFrameConstants.cameraPosition;
+
+	CullSceneModels(camera);
+	rasterizer.BeginFrame(target, gBackgroundColor, constants);
+	const Frustum* frustum = &gSceneFrustum;
+
+
+	////--------------- Render ordinary models ---------------///
+
+	// Per-pixel lighting, no blending, normal depth buffer and back-face culling
+	RasterState state;
+	state.shader = RasterShader::PixelLighting;
+
+	state.texture = &gGroundImage;
+	if (gSceneModelVisible[GroundModel])  gGround->RenderSoftware(rasterizer, state, frustum);
+
+	state.texture = &gCrateImage;
+	if (gSceneModelVisible[CrateModel])  gCrate->RenderSoftware(rasterizer, state, frustum);
+
+	state.texture = &gCubeImage;
+	if (gSceneModelVisible[CubeModel])  gCube->RenderSoftware(rasterizer, state, frustum);
+
+	state.texture = &gWallImage;
+	if (gSceneModelVisible[WallModel])  gWall->RenderSoftware(rasterizer, state, frustum);
+
+	state.texture = &gSecondWallImage;
+	if (gSceneModelVisible[SecondWallModel])  gSecondWall->RenderSoftware(rasterizer, state, frustum);
+
+
+	////--------------- Render sky ---------------////
+
+	// Tinted texture with a white tint, no culling as the stars point inwards
+	state.shader       = RasterShader::TintedTexture;
+	state.objectColour = { 1, 1, 1 };
+	state.cull         = RasterCull::None;
+	state.texture      = &gStarsImage;
+	if (gSceneModelVisible[StarsModel])  gStars->RenderSoftware(rasterizer, state, frustum);
+
+
+	////--------------- Render lights ---------------////
+
+	// Additive blending, read-only depth buffer and no culling
+	state.texture    = &gLightImage;
+	state.blend      = RasterBlend::Additive;
+	state.depthWrite = false;
+	for (int i = 0; i < NUM_LIGHTS; ++i)
+	{
+		state.objectColour = gLights[i].colour;
+		if (gSceneModelVisible[FirstLightModel + i])  gLights[i].model->RenderSoftware(rasterizer, state, frustum);
+	}
+
+	rasterizer.EndFrame();
+}
+
+
 //**************************
 
 //--------------------------------------------------------------------------------------
@@ -821,6 +1064,17 @@ void RenderSceneFromCamera(Camera* camera)
 // Helper function shared by full-screen, area and polygon post-processing functions below
 void SelectPostProcessShaderAndTextures(PostProcess postProcess, float frameTime)
 {
+	// Timers, animation and iteration counters are updated by a helper shared with the CPU post-processing (PostProcess.cpp)
+	UpdatePostProcessConstants(postProcess, gPostProcessingConstants, frameTime, gViewportWidth, gViewportHeight);
+
+	// Give the pixel shader access to the history it reads (e.g. the scene before Bloom), if any, as its second texture
+	HistorySlot historySlot = PostProcessHistoryRead(postProcess);
+	if (historySlot != HistorySlot::None)
+	{
+		int historyBuffer = gHistoryBuffers[static_cast<int>(historySlot)];
+		gD3DContext->PSSetShaderResources(1, 1, historyBuffer >= 0 ? &gSceneBuffers[historyBuffer].textureSRV : &nullSRV);
+	}
+
 	if (postProcess == PostProcess::Copy)
 	{
 		gD3DContext->PSSetShader(gCopyPostProcess, nullptr, 0);
@@ -828,41 +1082,32 @@ void SelectPostProcessShaderAndTextures(PostProcess postProcess, float frameTime
 	else if (postProcess == PostProcess::MotionBlur)
 	{
 		gD3DContext->PSSetShader(gMotionBlurProcess, nullptr, 0);
-		gD3DContext->PSSetShaderResources(1, 1, &gSceneTextureSRVPF);
 	}
 	else if (postProcess == PostProcess::DepthOfField)
 	{
 		gPostProcessingConstants.distanceToFocusedObject = Distance(gCamera->Position(), gCube->Position());
 		gD3DContext->PSSetShader(gDepthOfFieldProcess, nullptr, 0);
-		gD3DContext->PSSetShaderResources(1, 1, &gSceneTextureSRVCopy);
-		gD3DContext->PSSetShaderResources(2, 1, &gShadowMap1SRV);
+		gD3DContext->PSSetShaderResources(2, 1, gSoftwareRendering ? &gSoftwareDepthSRV : &gShadowMap1SRV);
 	}
 	else if (postProcess == PostProcess::DualFiltering)
 	{
-		gPostProcessingConstants.dualFilterIteration = gPostProcessingConstants.dualFilterIteration + 1;
 		gD3DContext->PSSetShader(gDualFilteringProcess, nullptr, 0);
 	}
 	else if (postProcess == PostProcess::Dilation)
 	{
 		gD3DContext->PSSetShader(gDilationProcess, nullptr, 0);
-		gPostProcessingConstants.elapsedTime += frameTime;
 	}
 	else if (postProcess == PostProcess::MergeTextures)
 	{
 		gD3DContext->PSSetShader(gMergeTexturesProcess, nullptr, 0);
-		gD3DContext->PSSetShaderResources(1, 1, &gSceneTextureSRVCopy);
 	}
 	else if (postProcess == PostProcess::KawaseLightStreak)
 	{
-		gPostProcessingConstants.kawaseIter = gPostProcessingConstants.kawaseIter + 1;
 		gD3DContext->PSSetShader(gKawaseLighStreakProcess, nullptr, 0);
-		gD3DContext->PSSetShaderResources(1, 1, &gSceneTextureSRVCopy);
 	}
 	else if (postProcess == PostProcess::Bloom)
 	{
 		gD3DContext->PSSetShader(gBloomProcess, nullptr, 0);
-		gPostProcessingConstants.dualFilterIteration = 0;
-		gPostProcessingConstants.kawaseIter = -1;
 	}
 	else if (postProcess == PostProcess::GameBoy)
 	{
@@ -887,50 +1132,27 @@ void SelectPostProcessShaderAndTextures(PostProcess postProcess, float frameTime
 	else if (postProcess == PostProcess::HueVerticalColourGradient)
 	{
 		gD3DContext->PSSetShader(gHueVerticalColourGradientProcess, nullptr, 0);
-
-		gPostProcessingConstants.elapsedTime += frameTime;
-		gPostProcessingConstants.period = 4;
-
-		// Set the top and bottom colours of the gradient
-		gPostProcessingConstants.topColour = { 0.0f, 0.0f, 1.0f };
-		gPostProcessingConstants.bottomColour = { 0.0f, 1.0f, 1.0f };
 	}
 	else if (postProcess == PostProcess::UnderWater)
 	{
 		gD3DContext->PSSetShader(gUnderWaterProcess, nullptr, 0);
-
-		// Update the underwater timer
-		gPostProcessingConstants.underWaterTimer += frameTime;
 	}
 	else if (postProcess == PostProcess::GaussianBlurHorizontal)
 	{
-		gPostProcessingConstants.blurAmount = 1.0f;
 		gD3DContext->PSSetShader(gGaussianBlurHorizontalProcess, nullptr, 0);
 	}
 	else if (postProcess == PostProcess::GaussianBlurVertical)
 	{
-		gPostProcessingConstants.blurAmount = 1.0f;
 		gD3DContext->PSSetShader(gGaussianBlurVerticalProcess, nullptr, 0);
 	}
 	else if (postProcess == PostProcess::VerticalColourGradient)
 	{
 		gD3DContext->PSSetShader(gVerticalColourGradientProcess, nullptr, 0);
-
-		// Set the top and bottom colours of the gradient
-		gPostProcessingConstants.topColour = { 0.0f, 0.0f, 1.0f };
-		gPostProcessingConstants.bottomColour = { 0.0f, 1.0f, 1.0f };
 	}
 	else if (postProcess == PostProcess::GreyNoise)
 	{
 		gD3DContext->PSSetShader(gGreyNoisePostProcess, nullptr, 0);
 
-		// Noise scaling adjusts how fine the grey noise is.
-		const float grainSize = 140; // Fineness of the noise grain
-		gPostProcessingConstants.noiseScale = { gViewportWidth / grainSize, gViewportHeight / grainSize };
-
-		// The noise offset is randomised to give a constantly changing noise effect (like tv static)
-		gPostProcessingConstants.noiseOffset = { Random(0.0f, 1.0f), Random(0.0f, 1.0f) };
-
 		// Give pixel shader access to the noise texture
 		gD3DContext->PSSetShaderResources(1, 1, &gNoiseMapSRV);
 		gD3DContext->PSSetSamplers(1, 1, &gTrilinearSampler);
@@ -939,10 +1161,6 @@ void SelectPostProcessShaderAndTextures(PostProcess postProcess, float frameTime
 	{
 		gD3DContext->PSSetShader(gBurnPostProcess, nullptr, 0);
 
-		// Set and increase the burn level (cycling back to 0 when it reaches 1.0f)
-		const float burnSpeed = 0.2f;
-		gPostProcessingConstants.burnHeight = fmod(gPostProcessingConstants.burnHeight + burnSpeed * frameTime, 1.0f);
-
 		// Give pixel shader access to the burn texture (basically a height map that the burn level ascends)
 		gD3DContext->PSSetShaderResources(1, 1, &gBurnMapSRV);
 		gD3DContext->PSSetSamplers(1, 1, &gTrilinearSampler);
@@ -959,32 +1177,28 @@ void SelectPostProcessShaderAndTextures(PostProcess postProcess, float frameTime
 	else if (postProcess == PostProcess::Spiral)
 	{
 		gD3DContext->PSSetShader(gSpiralPostProcess, nullptr, 0);
-
-		// Set and increase the amount of spiral - use a tweaked cos wave to animate
-		static float wiggle = 0.0f;
-		const float wiggleSpeed = 1.0f;
-		gPostProcessingConstants.spiralLevel = ((1.0f - cos(wiggle)) * 4.0f);
-		wiggle += wiggleSpeed * frameTime;
 	}
 	else if (postProcess == PostProcess::HeatHaze)
 	{
 		gD3DContext->PSSetShader(gHeatHazePostProcess, nullptr, 0);
-
-		// Update heat haze timer
-		gPostProcessingConstants.heatHazeTimer += frameTime;
 	}
 	else if (postProcess == PostProcess::Tint)
 	{
 		gD3DContext->PSSetShader(gTintPostProcess, nullptr, 0);
 	}
+	else if (postProcess == PostProcess::ColourMatrix)
+	{
+		gD3DContext->PSSetShader(gColourMatrixProcess, nullptr, 0);
+	}
 }
 
 
 //**********************
 // Post Process Modes
 
-// Perform a full-screen post process from "scene texture" to back buffer
-void FullScreenPostProcess(PostProcess postProcess, float frameTime, int processIndex)
+// Prepare the pipeline for a post-process pass reading the given scene texture and writing to the given render target. Sets the
+// quad vertex shader, states (no blending), render target, scene texture and sampler but not the post-process shader
+void PreparePostProcessPass(ID3D11ShaderResourceView* source, ID3D11RenderTargetView* target)
 {
 	// Using special vertex shader that creates its own data for a 2D screen quad
 	gD3DContext->VSSetShader(g2DQuadVertexShader, nullptr, 0);
@@ -1001,30 +1215,24 @@ void FullScreenPostProcess(PostProcess postProcess, float frameTime, int process
 	gD3DContext->IASetInputLayout(NULL); // No vertex data
 	gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
 
-	// These lines unbind the scene texture from the pixel shader to stop DirectX issuing a warning when we try to render to it again next frame
+	// These lines unbind the scene textures from the pixel shader to stop DirectX issuing a warning when we render to one of them
 	gD3DContext->PSSetShaderResources(0, 1, &nullSRV);
+	gD3DContext->PSSetShaderResources(1, 1, &nullSRV);
 
-	if (processIndex % 2 == 0)
-	{
-		// Render first post-process to second render target texture
-		
-		// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTargetTwo, gDepthStencil); // Where to render
+	// Select the render target to use for rendering. Not going to clear it because we're going to overwrite it all
+	gD3DContext->OMSetRenderTargets(1, &target, gDepthStencil);
 
-		// Give the pixel shader (post-processing shader) access to the scene texture 
-		// Use the 'first' texture's contents on the 'second' render pass
-		gD3DContext->PSSetShaderResources(0, 1, &gSceneTextureSRV); // Which input (previous in this case)
-	}
-	else
-	{
-		// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTarget, gDepthStencil);
-
-		// Give the pixel shader (post-processing shader) access to the scene texture 
-		gD3DContext->PSSetShaderResources(0, 1, &gSceneTextureSRVTwo);
-	}
+	// Give the pixel shader (post-processing shader) access to the scene texture 
+	gD3DContext->PSSetShaderResources(0, 1, &source);
 
 	gD3DContext->PSSetSamplers(0, 1, &gPointSampler); // Use point sampling (no bilinear, trilinear, mip-mapping etc. for most post-processes)
+}
+
+
+// Render a full-screen quad with a post-process, reading the given scene texture and writing to the given render target
+void RenderFullScreenQuad(PostProcess postProcess, float frameTime, ID3D11ShaderResourceView* source, ID3D11RenderTargetView* target)
+{
+	PreparePostProcessPass(source, target);
 
 	// Select shader and textures needed for the required post-processes (helper function above)
 	SelectPostProcessShaderAndTextures(postProcess, frameTime);
@@ -1042,45 +1250,66 @@ void FullScreenPostProcess(PostProcess postProcess, float frameTime, int process
 	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
 
 
-	// Draw a quad
-	gD3DContext->Draw(4, 0);
-
-	// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-	gD3DContext->OMSetRenderTargets(1, &gBackBufferRenderTarget, gDepthStencil);
-
 	// Draw a quad
 	gD3DContext->Draw(4, 0);
 }
 
 
-// Perform an area post process from "scene texture" to back buffer at a given point in the world, with a given size (world units)
-void AreaPostProcess(PostProcess postProcess, CVector3 worldPoint, CVector2 areaSize, float frameTime, int processIndex)
+// Perform a full-screen post process from the current scene buffer to the target one, which becomes the current scene buffer
+void FullScreenPostProcess(PostProcess postProcess, float frameTime, int target)
 {
-	// First perform a full-screen copy of the scene to back-buffer
-	FullScreenPostProcess(PostProcess::Copy, frameTime, processIndex);
-	
+	RenderFullScreenQuad(postProcess, frameTime, gSceneBuffers[gCurrentSceneBuffer].textureSRV, gSceneBuffers[target].renderTarget);
+	gCurrentSceneBuffer = target;
+}
 
-	// Now perform a post-process of a portion of the scene to the back-buffer (overwriting some of the copy above)
-	// Note: The following code relies on many of the settings that were prepared in the FullScreenPostProcess call above, it only
-	//       updates a few things that need to be changed for an area process. If you tinker with the code structure you need to be
-	//       aware of all the work that the above function did that was also preparation for this post-process area step
 
-	// Select shader/textures needed for required post-process
-	SelectPostProcessShaderAndTextures(postProcess, frameTime);
+// Distance in pixels outside an area that a post-process may read the scene texture from, for an area of the given size
+// (0->1 coordinates). Returns -1 for post-processes that can read from anywhere on the screen, whatever the size. Call after
+// SelectPostProcessShaderAndTextures, which updates the constants used here
+int AreaSampleMargin(PostProcess postProcess, CVector2 area2DSize)
+{
+	// Offsets in 0->1 coordinates, taken from the shaders
+	float offset = 0;
+	if (postProcess == PostProcess::NightVision)  offset = 0.003f;
+	else if (postProcess == PostProcess::UnderWater)  offset = 0.01f;
+	else if (postProcess == PostProcess::HeatHaze)  offset = 0.01f * std::max(area2DSize.x, area2DSize.y);
+	else if (postProcess == PostProcess::Distort)  offset = 0.03f * 0.5f;
+	else if (postProcess == PostProcess::Burn)  offset = 0.15f * 0.5f;
+	else if (postProcess == PostProcess::Spiral || postProcess == PostProcess::DepthOfField || postProcess == PostProcess::MotionBlur ||
+	         postProcess == PostProcess::KawaseLightStreak)
+	{
+		return -1;
+	}
 
-	// Enable alpha blending - area effects need to fade out at the edges or the hard edge of the area is visible
-	// A couple of the shaders have been updated to put the effect into a soft circle
-	// Alpha blending isn't enabled for fullscreen and polygon effects so it doesn't affect those (except heat-haze, which works a bit differently)
-	gD3DContext->OMSetBlendState(gAlphaBlendingState, nullptr, 0xffffff);
+	// Offsets in pixels, plus one pixel for rounding
+	int pixels = static_cast<int>(std::ceil(offset * std::max(gViewportWidth, gViewportHeight)));
+	if (postProcess == PostProcess::GaussianBlurHorizontal || postProcess == PostProcess::GaussianBlurVertical)
+	{
+		pixels = static_cast<int>(std::ceil(4 * gPostProcessingConstants.blurAmount));
+	}
+	else if (postProcess == PostProcess::Contour || postProcess == PostProcess::Dilation || postProcess == PostProcess::DualFiltering)
+	{
+		pixels = 1;
+	}
+	else if (postProcess == PostProcess::GameBoy)
+	{
+		pixels = 4; // Rounds to the nearest 7x4 block
+	}
+	return pixels + 1;
+}
 
 
+// Find the screen area covered by an area post-process at a given point in the world, with a given size (world units).
+// Gets the top-left and size in 0->1 coordinates and the depth buffer value. Returns false if the point is behind the camera
+bool GetPostProcessArea(CVector3 worldPoint, CVector2 areaSize, CVector2& area2DTopLeft, CVector2& area2DSize, float& area2DDepth)
+{
 	// Use picking methods to find the 2D position of the 3D point at the centre of the area effect
 	auto worldPointTo2D = gCamera->PixelFromWorldPt(worldPoint, gViewportWidth, gViewportHeight);
 	CVector2 area2DCentre = { worldPointTo2D.x, worldPointTo2D.y };
 	float areaDistance = worldPointTo2D.z;
 	
 	// Nothing to do if given 3D point is behind the camera
-	if (areaDistance < gCamera->NearClip())  return;
+	if (areaDistance < gCamera->NearClip())  return false;
 	
 	// Convert pixel coordinates to 0->1 coordinates as used by the shader
 	area2DCentre.x /= gViewportWidth;
@@ -1091,66 +1320,126 @@ void AreaPostProcess(PostProcess postProcess, CVector3 worldPoint, CVector2 area
 	// Using new helper function here - it calculates the world space units covered by a pixel at a certain distance from the camera.
 	// Use this to find the size of the 2D area we need to cover the world space size requested
 	CVector2 pixelSizeAtPoint = gCamera->PixelSizeInWorldSpace(areaDistance, gViewportWidth, gViewportHeight);
-	CVector2 area2DSize = { areaSize.x / pixelSizeAtPoint.x, areaSize.y / pixelSizeAtPoint.y };
+	area2DSize = { areaSize.x / pixelSizeAtPoint.x, areaSize.y / pixelSizeAtPoint.y };
 
 	// Again convert the result in pixels to a result to 0->1 coordinates
 	area2DSize.x /= gViewportWidth;
 	area2DSize.y /= gViewportHeight;
 
-	// Send the area top-left and size into the constant buffer - the 2DQuad vertex shader will use this to create a quad in the right place
-	gPostProcessingConstants.area2DTopLeft = area2DCentre - 0.5f * area2DSize; // Top-left of area is centre - half the size
-	gPostProcessingConstants.area2DSize = area2DSize;
+	area2DTopLeft = area2DCentre - 0.5f * area2DSize; // Top-left of area is centre - half the size
 
 	// Manually calculate depth buffer value from Z distance to the 3D point and camera near/far clip values. Result is 0->1 depth value
 	// We've never seen this full calculation before, it's occasionally useful. It is derived from the material in the Picking lecture
 	// Having the depth allows us to have area effects behind normal objects
-	gPostProcessingConstants.area2DDepth = gCamera->FarClip() * (areaDistance - gCamera->NearClip()) / (gCamera->FarClip() - gCamera->NearClip());
-	gPostProcessingConstants.area2DDepth /= areaDistance;
+	area2DDepth = gCamera->FarClip() * (areaDistance - gCamera->NearClip()) / (gCamera->FarClip() - gCamera->NearClip());
+	area2DDepth /= areaDistance;
+	return true;
+}
+
+
+// Send the area to the shaders (also sends the per-process settings prepared in UpdateScene function below) and draw the quad
+// covering it - the 2DQuad vertex shader uses the area to create a quad in the right place
+void DrawPostProcessArea(CVector2 area2DTopLeft, CVector2 area2DSize, float area2DDepth)
+{
+	gPostProcessingConstants.area2DTopLeft = area2DTopLeft;
+	gPostProcessingConstants.area2DSize    = area2DSize;
+	gPostProcessingConstants.area2DDepth   = area2DDepth;
 
-	// Pass over this post-processing area to shaders (also sends the per-process settings prepared in UpdateScene function below)
 	UpdateConstantBuffer(gPostProcessingConstantBuffer, gPostProcessingConstants);
 	gD3DContext->VSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
 	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
 
-
 	// Draw a quad
 	gD3DContext->Draw(4, 0);
 }
 
 
-// Perform an post process from "scene texture" to back buffer within the given four-point polygon and a world matrix to position/rotate/scale the polygon
-void PolygonPostProcess(PostProcess postProcess, const std::array<CVector3, 4>& points, const CMatrix4x4& worldMatrix, float frameTime, int processIndex)
+// Copy the pixels in a rectangle and a margin around it from one scene buffer to another, clipped to the screen
+void CopySceneBufferRect(int source, int target, const D3D11_RECT& rect, int margin)
 {
-	// First perform a full-screen copy of the scene to back-buffer
-	FullScreenPostProcess(PostProcess::Copy, frameTime, processIndex);
+	D3D11_BOX copyBox;
+	copyBox.left   = static_cast<UINT>(std::max(rect.left - margin, 0L));
+	copyBox.top    = static_cast<UINT>(std::max(rect.top  - margin, 0L));
+	copyBox.right  = static_cast<UINT>(std::min(rect.right  + margin, static_cast<LONG>(gViewportWidth)));
+	copyBox.bottom = static_cast<UINT>(std::min(rect.bottom + margin, static_cast<LONG>(gViewportHeight)));
+	copyBox.front  = 0;
+	copyBox.back   = 1;
+	gD3DContext->CopySubresourceRegion(gSceneBuffers[target].texture, 0, copyBox.left, copyBox.top, 0,
+	                                   gSceneBuffers[source].texture, 0, &copyBox);
+}
 
 
-	// These lines unbind the scene texture from the pixel shader to stop DirectX issuing a warning when we try to render to it again next frame
-	gD3DContext->PSSetShaderResources(0, 1, &nullSRV);
+// Whether a post-process can be drawn over the current scene buffer itself, limited to the pixels around its area or polygon,
+// with the target buffer taking its place. Not if the scene buffer before this process is read later as history, or this
+// process reads history (the history might be in the buffer being drawn to), or the two buffers have different formats
+bool CanPostProcessInPlace(PostProcess postProcess, int target)
+{
+	return gScissorAreaPostProcess && AreaSampleMargin(postProcess, { 0, 0 }) >= 0 &&
+	       !PostProcessSavesPreEffect(postProcess) && PostProcessHistoryRead(postProcess) == HistorySlot::None &&
+	       gSceneBuffers[gCurrentSceneBuffer].format == gSceneBuffers[target].format;
+}
 
-	if (processIndex % 2 == 0)
-	{
-		// Render first post-process to second render target texture
 
-		// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTargetTwo, gDepthStencil); // Where to render
+// Perform an area post process that only touches the pixels around the area. The post-process is drawn over the current scene
+// buffer itself, limited to the area by a scissor rectangle, reading a copy of the pixels around the area in the target buffer.
+// The two buffers are then swapped so the result is in the target buffer. Only used when nothing else reads the current scene
+// buffer afterwards, and for post-processes that read the scene near the area (see AreaSampleMargin)
+void ScissoredAreaPostProcess(PostProcess postProcess, CVector3 worldPoint, CVector2 areaSize, float frameTime, int target)
+{
+	int source = gCurrentSceneBuffer;
+	PreparePostProcessPass(gSceneBuffers[target].textureSRV, gSceneBuffers[source].renderTarget);
+	SelectPostProcessShaderAndTextures(postProcess, frameTime);
+
+	CVector2 area2DTopLeft = { 0, 0 };
+	CVector2 area2DSize    = { 0, 0 };
+	float    area2DDepth   = 0;
+	bool onScreen = GetPostProcessArea(worldPoint, areaSize, area2DTopLeft, area2DSize, area2DDepth);
 
-		// Give the pixel shader (post-processing shader) access to the scene texture 
-		// Use the 'first' texture's contents on the 'second' render pass
-		gD3DContext->PSSetShaderResources(0, 1, &gSceneTextureSRV); // Which input (previous in this case)
-	}
-	else
+	int margin = AreaSampleMargin(postProcess, area2DSize);
+
+	// Pixels covered by the area, clipped to the screen
+	D3D11_RECT areaRect;
+	areaRect.left   = std::max(static_cast<LONG>(std::floor(area2DTopLeft.x * gViewportWidth)), 0L);
+	areaRect.top    = std::max(static_cast<LONG>(std::floor(area2DTopLeft.y * gViewportHeight)), 0L);
+	areaRect.right  = std::min(static_cast<LONG>(std::ceil((area2DTopLeft.x + area2DSize.x) * gViewportWidth)), static_cast<LONG>(gViewportWidth));
+	areaRect.bottom = std::min(static_cast<LONG>(std::ceil((area2DTopLeft.y + area2DSize.y) * gViewportHeight)), static_cast<LONG>(gViewportHeight));
+
+	if (onScreen && areaRect.right > areaRect.left && areaRect.bottom > areaRect.top)
 	{
-		// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTarget, gDepthStencil);
+		// Copy the pixels the post-process reads to the target buffer
+		CopySceneBufferRect(source, target, areaRect, margin);
 
-		// Give the pixel shader (post-processing shader) access to the scene texture 
-		gD3DContext->PSSetShaderResources(0, 1, &gSceneTextureSRVTwo);
+		// Alpha blended as in AreaPostProcess, the scissor test keeps the quad inside the area's pixels
+		gD3DContext->OMSetBlendState(gAlphaBlendingState, nullptr, 0xffffff);
+		gD3DContext->RSSetState(gCullNoneScissorState);
+		gD3DContext->RSSetScissorRects(1, &areaRect);
+		DrawPostProcessArea(area2DTopLeft, area2DSize, area2DDepth);
+		gD3DContext->RSSetState(gCullNoneState);
 	}
 
-	gD3DContext->PSSetSamplers(0, 1, &gPointSampler); // Use point sampling (no bilinear, trilinear, mip-mapping etc. for most post-processes)
+	// The result is in the source buffer, swap it with the target rather than copying
+	std::swap(gSceneBuffers[source], gSceneBuffers[target]);
+	gCurrentSceneBuffer = target;
+}
 
-	// Now perform a post-process of a portion of the scene to the back-buffer (overwriting some of the copy above)
+
+// Perform an area post process from the current scene buffer at a given point in the world, with a given size (world units)
+void AreaPostProcess(PostProcess postProcess, CVector3 worldPoint, CVector2 areaSize, float frameTime, int target)
+{
+	// Process only the pixels around the area if possible
+	if (CanPostProcessInPlace(postProcess, target))
+	{
+		ScissoredAreaPostProcess(postProcess, worldPoint, areaSize, frameTime, target);
+		return;
+	}
+
+	// First perform a full-screen copy of the scene to the target scene buffer, the area is processed over the top of the copy
+	// while still reading the scene buffer from before it
+	int source = gCurrentSceneBuffer;
+	FullScreenPostProcess(PostProcess::Copy, frameTime, target);
+	gD3DContext->PSSetShaderResources(0, 1, &gSceneBuffers[source].textureSRV);
+
+	// Now perform a post-process of a portion of the scene (overwriting some of the copy above)
 	// Note: The following code relies on many of the settings that were prepared in the FullScreenPostProcess call above, it only
 	//       updates a few things that need to be changed for an area process. If you tinker with the code structure you need to be
 	//       aware of all the work that the above function did that was also preparation for this post-process area step
@@ -1158,32 +1447,111 @@ void PolygonPostProcess(PostProcess postProcess, const std::array<CVector3, 4>&
 	// Select shader/textures needed for required post-process
 	SelectPostProcessShaderAndTextures(postProcess, frameTime);
 
-	// Loop through the given points, transform each to 2D (this is what the vertex shader normally does in most labs)
-	for (unsigned int i = 0; i < points.size(); ++i)
-	{
-		CVector4 modelPosition = CVector4(points[i], 1);
-		CVector4 worldPosition = modelPosition * worldMatrix;
-		CVector4 viewportPosition = worldPosition * gCamera->ViewProjectionMatrix();
+	// Enable alpha blending - area effects need to fade out at the edges or the hard edge of the area is visible
+	// A couple of the shaders have been updated to put the effect into a soft circle
+	// Alpha blending isn't enabled for fullscreen and polygon effects so it doesn't affect those (except heat-haze, which works a bit differently)
+	gD3DContext->OMSetBlendState(gAlphaBlendingState, nullptr, 0xffffff);
 
-		gPostProcessingConstants.polygon2DPoints[i] = viewportPosition;
-	}
+	CVector2 area2DTopLeft, area2DSize;
+	float area2DDepth;
+	if (!GetPostProcessArea(worldPoint, areaSize, area2DTopLeft, area2DSize, area2DDepth))  return;
+
+	DrawPostProcessArea(area2DTopLeft, area2DSize, area2DDepth);
+}
 
-	// Pass over the polygon points to the shaders (also sends the per-process settings prepared in UpdateScene function below)
+
+// Send the polygon in the constants to the shaders (also sends the per-process settings prepared in UpdateScene function below)
+// and draw it as the given triangles. The 2DPolygon vertex shader reads the points from the constants
+void DrawPostProcessPolygon(const std::vector<uint16_t>& indices)
+{
 	UpdateConstantBuffer(gPostProcessingConstantBuffer, gPostProcessingConstants);
 	gD3DContext->VSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
 	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
 
-	// Select the special 2D polygon post-processing vertex shader and draw the polygon
+	D3D11_MAPPED_SUBRESOURCE mappedIndices;
+	if (FAILED(gD3DContext->Map(gPolygonIndexBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mappedIndices)))  return;
+	memcpy(mappedIndices.pData, indices.data(), indices.size() * sizeof(uint16_t));
+	gD3DContext->Unmap(gPolygonIndexBuffer, 0);
+
+	// Select the special 2D polygon post-processing vertex shader and draw the triangles
 	gD3DContext->VSSetShader(g2DPolygonVertexShader, nullptr, 0);
+	gD3DContext->IASetIndexBuffer(gPolygonIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
+	gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	gD3DContext->DrawIndexed(static_cast<UINT>(indices.size()), 0, 0);
+}
 
-	// Draw a quad
-	gD3DContext->Draw(4, 0);
 
-	// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-	gD3DContext->OMSetRenderTargets(1, &gBackBufferRenderTarget, gDepthStencil);
+// Perform a post process from the current scene buffer within the given polygon and a world matrix to position/rotate/scale the
+// polygon. The points are in order around the edge of the polygon, which can be convex or concave and have any number of points
+// (see PostProcessPolygon.h). The polygon is clipped against the near plane and drawn as triangles, so only the pixels it covers
+// are processed. Like area post-processes it is drawn over the current scene buffer itself when possible, then only the pixels
+// around the polygon are copied
+void PolygonPostProcess(PostProcess postProcess, const std::vector<CVector3>& points, const CMatrix4x4& worldMatrix, float frameTime, int target)
+{
+	int source = gCurrentSceneBuffer;
+	bool inPlace = CanPostProcessInPlace(postProcess, target);
+	if (inPlace)
+	{
+		// Draw over the source buffer, reading a copy of the pixels around the polygon in the target buffer
+		PreparePostProcessPass(gSceneBuffers[target].textureSRV, gSceneBuffers[source].renderTarget);
+	}
+	else
+	{
+		// First perform a full-screen copy of the scene to the target scene buffer, the polygon is processed over the top of the
+		// copy while still reading the scene buffer from before it
+		FullScreenPostProcess(PostProcess::Copy, frameTime, target);
+		gD3DContext->PSSetShaderResources(0, 1, &gSceneBuffers[source].textureSRV);
+	}
 
-	// Draw a quad
-	gD3DContext->Draw(4, 0);
+	// Select shader/textures needed for required post-process
+	SelectPostProcessShaderAndTextures(postProcess, frameTime);
+
+	// Transform the points to 2D and clip them (this is what the vertex shader normally does in most labs), then split the
+	// polygon into triangles. Nothing to draw if the polygon is entirely behind the camera
+	std::vector<uint16_t> indices;
+	D3D11_RECT polygonRect = { 0, 0, 0, 0 };
+	if (SetPolygonConstants(points, worldMatrix * gCamera->ViewProjectionMatrix(), gPostProcessingConstants))
+	{
+		std::vector<CVector2> pixelPoints = PolygonPixelPoints(gPostProcessingConstants, static_cast<float>(gViewportWidth),
+		                                                       static_cast<float>(gViewportHeight));
+		indices = TriangulatePolygon(pixelPoints);
+
+		// Pixels covered by the polygon, clipped to the screen
+		CVector2 minPoint = pixelPoints[0];
+		CVector2 maxPoint = pixelPoints[0];
+		for (const CVector2& point : pixelPoints)
+		{
+			minPoint = { std::min(minPoint.x, point.x), std::min(minPoint.y, point.y) };
+			maxPoint = { std::max(maxPoint.x, point.x), std::max(maxPoint.y, point.y) };
+		}
+		polygonRect.left   = std::max(static_cast<LONG>(std::floor(minPoint.x)), 0L);
+		polygonRect.top    = std::max(static_cast<LONG>(std::floor(minPoint.y)), 0L);
+		polygonRect.right  = std::min(static_cast<LONG>(std::ceil(maxPoint.x)), static_cast<LONG>(gViewportWidth));
+		polygonRect.bottom = std::min(static_cast<LONG>(std::ceil(maxPoint.y)), static_cast<LONG>(gViewportHeight));
+	}
+
+	if (!indices.empty() && polygonRect.right > polygonRect.left && polygonRect.bottom > polygonRect.top)
+	{
+		if (inPlace)
+		{
+			// Copy the pixels the post-process reads to the target buffer, the scissor test keeps the triangles inside them
+			CVector2 polygon2DSize = { static_cast<float>(polygonRect.right - polygonRect.left) / gViewportWidth,
+			                           static_cast<float>(polygonRect.bottom - polygonRect.top) / gViewportHeight };
+			CopySceneBufferRect(source, target, polygonRect, AreaSampleMargin(postProcess, polygon2DSize));
+			gD3DContext->RSSetState(gCullNoneScissorState);
+			gD3DContext->RSSetScissorRects(1, &polygonRect);
+		}
+
+		DrawPostProcessPolygon(indices);
+		gD3DContext->RSSetState(gCullNoneState);
+	}
+
+	if (inPlace)
+	{
+		// The result is in the source buffer, swap it with the target rather than copying
+		std::swap(gSceneBuffers[source], gSceneBuffers[target]);
+		gCurrentSceneBuffer = target;
+	}
 }
 
 //**********************
@@ -1225,25 +1593,47 @@ void RenderScene(float frameTime)
 	vp.TopLeftY = 0;
 	gD3DContext->RSSetViewports(1, &vp);
 
-	gD3DContext->OMSetRenderTargets(0, nullptr, gShadowMap1DepthStencil);
-	gD3DContext->ClearDepthStencilView(gShadowMap1DepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
+	if (gSoftwareRendering)
+	{
+		// Render the depth on the CPU and upload the depth values, DepthOfField reads them in place of the shadow map
+		RenderDepthBufferFromCameraSoftware(gCamera, *gSoftwareRasterizer, gShadowMapSize, gShadowMapSize);
+		const Image& depthImage = gSoftwareRasterizer->DepthImage();
+		std::vector<float> depths(static_cast<size_t>(gShadowMapSize) * gShadowMapSize);
+		for (int y = 0; y < gShadowMapSize; ++y)
+		{
+			const ColourRGBA* row = depthImage.Row(y);
+			for (int x = 0; x < gShadowMapSize; ++x)  depths[static_cast<size_t>(y) * gShadowMapSize + x] = row[x].r;
+		}
+		gD3DContext->UpdateSubresource(gSoftwareDepthTexture, 0, nullptr, depths.data(),
+		                               static_cast<UINT>(gShadowMapSize * sizeof(float)), 0);
+	}
+	else
+	{
+		gD3DContext->OMSetRenderTargets(0, nullptr, gShadowMap1DepthStencil);
+		gD3DContext->ClearDepthStencilView(gShadowMap1DepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
+
+		RenderDepthBufferFromCamera(gCamera);
+	}
 
-	RenderDepthBufferFromCamera(gCamera);
+	// Create or release scene buffers to suit the post-process stack. If they can't be created, post-processing is switched off
+	if (!UpdateSceneBuffers())
+	{
+		gPostProcessAndModeStack.clear();
+		UpdatePostProcessExecutionPlan();
+	}
 
 	// Set the target for rendering and select the main depth buffer.
 	// If using post-processing then render to the scene texture, otherwise to the usual back buffer
 	// Also clear the render target to a fixed colour and the depth buffer to the far distance
-	if (gPostProcessAndModeStack.size() != 0)
-	{
-		// Render scene to first render target texture
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTarget, gDepthStencil);
-		gD3DContext->ClearRenderTargetView(gSceneRenderTarget, &gBackgroundColor.r);
-	}
-	else
+	ID3D11RenderTargetView* sceneTarget = gBackBufferRenderTarget;
+	if (gPostProcessExecutionPlan.passes.size() != 0)
 	{
-		gD3DContext->OMSetRenderTargets(1, &gBackBufferRenderTarget, gDepthStencil);
-		gD3DContext->ClearRenderTargetView(gBackBufferRenderTarget, &gBackgroundColor.r);
+		// Render scene to the first scene buffer given by the plan
+		gCurrentSceneBuffer = gSceneBufferPlan.imageBuffer[0];
+		sceneTarget = gSceneBuffers[gCurrentSceneBuffer].renderTarget;
 	}
+	gD3DContext->OMSetRenderTargets(1, &sceneTarget, gDepthStencil);
+	gD3DContext->ClearRenderTargetView(sceneTarget, &gBackgroundColor.r);
 
 	gD3DContext->ClearDepthStencilView(gDepthStencil, D3D11_CLEAR_DEPTH, 1.0f, 0);
 	
@@ -1261,27 +1651,53 @@ void RenderScene(float frameTime)
 	gD3DContext->PSSetSamplers(1, 1, &gPointSampler);
 
 	// Render the scene from the main camera
-	RenderSceneFromCamera(gCamera);
+	if (gSoftwareRendering)
+	{
+		// Render on the CPU then copy the image to the target. The depth buffer is left clear, so area post-processes are not
+		// hidden by the scene in front of them
+		RenderSceneFromCameraSoftware(gCamera, *gSoftwareRasterizer, gSoftwareSceneImage);
+
+		// The polygon and area post-processes still read the camera from the per-frame constants
+		UpdateCameraConstants(gCamera);
+		gD3DContext->VSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer);
+		gD3DContext->PSSetConstantBuffers(0, 1, &gPerFrameConstantBuffer);
+
+		gD3DContext->UpdateSubresource(gSoftwareSceneTexture, 0, nullptr, gSoftwareSceneImage.Row(0),
+		                               static_cast<UINT>(gViewportWidth * sizeof(ColourRGBA)), 0);
+		RenderFullScreenQuad(PostProcess::Copy, frameTime, gSoftwareSceneSRV, sceneTarget);
+	}
+	else
+	{
+		RenderSceneFromCamera(gCamera);
+	}
 
 
 	////--------------- Scene completion ---------------////
 
-	if (gPostProcessAndModeStack.size() != 0)
+	if (gPostProcessExecutionPlan.passes.size() != 0)
 	{
 		int processIndex = 0;
-		for (std::pair<PostProcess, PostProcessMode> postProcessAndMode : gPostProcessAndModeStack)
+		for (std::pair<PostProcess, PostProcessMode> postProcessAndMode : gPostProcessExecutionPlan.passes)
 		{
 			gCurrentPostProcess = postProcessAndMode.first;
 			gCurrentPostProcessMode = postProcessAndMode.second;
 
-			if (gCurrentPostProcessMode == PostProcessMode::Fullscreen)
+			// The plan gives the buffer to write to and the buffer holding the scene from before the last Bloom or DepthOfField.
+			// No copy is needed to hold an image, its buffer is not reused until the last process that reads it
+			int target = gSceneBufferPlan.imageBuffer[processIndex + 1];
+			int preEffect = gSceneBufferPlan.preEffect[processIndex];
+			gHistoryBuffers[static_cast<int>(HistorySlot::PreEffect)] = preEffect >= 0 ? gSceneBufferPlan.imageBuffer[preEffect] : -1;
+
+			// A run of colour-only passes merged into one, its constants stand for all of them
+			if (gCurrentPostProcess == PostProcess::ColourMatrix)
 			{
-				if (gCurrentPostProcess == PostProcess::Bloom || gCurrentPostProcess == PostProcess::DepthOfField)
-				{
-					SaveCurrentSceneToTexture(processIndex, false);
-				}
+				SetColourMatrixConstants(gPostProcessExecutionPlan.colourMatrixPasses[processIndex], gPostProcessingConstants, frameTime,
+				                         gViewportWidth, gViewportHeight);
+			}
 
-				FullScreenPostProcess(gCurrentPostProcess, frameTime, processIndex++);
+			if (gCurrentPostProcessMode == PostProcessMode::Fullscreen)
+			{
+				FullScreenPostProcess(gCurrentPostProcess, frameTime, target);
 			}
 			else if (gCurrentPostProcessMode == PostProcessMode::Polygon)
 			{
@@ -1289,13 +1705,27 @@ void RenderScene(float frameTime)
 				// A rotating matrix placing the model above in the scene
 				static CMatrix4x4 polyMatrix = MatrixTranslation({ 0, 0, 0 });
 			
-				// Pass an array of 4 points and a matrix. Only supports 4 points.
-				PolygonPostProcess(gCurrentPostProcess, GetWindowPoint(processIndex), polyMatrix, frameTime, processIndex++);
+				// Pass the points of the window and a matrix. Windows are placed by their position in the original stack, not the
+				// optimised one
+				int windowIndex = gPostProcessExecutionPlan.stackIndex[processIndex];
+				PolygonPostProcess(gCurrentPostProcess, GetWindowPoint(windowIndex), polyMatrix, frameTime, target);
 			}
 			else if (gCurrentPostProcessMode == PostProcessMode::Area)
 			{
-				AreaPostProcess(gCurrentPostProcess, gCube->Position(), { 10, 10 }, frameTime, processIndex++);
+				AreaPostProcess(gCurrentPostProcess, gCube->Position(), { 10, 10 }, frameTime, target);
 			}
+			processIndex++;
+		}
+
+		// Copy the final result to the back buffer
+		RenderFullScreenQuad(PostProcess::Copy, frameTime, gSceneBuffers[gCurrentSceneBuffer].textureSRV, gBackBufferRenderTarget);
+
+		// Every other frame keep the final result as MotionBlur's previous frame. The buffers are swapped rather than copied,
+		// the old previous frame will be overwritten next frame
+		int previousFrame = gSceneBufferPlan.previousFrameBuffer;
+		if (isOtherFrame && previousFrame >= 0)
+		{
+			std::swap(gSceneBuffers[previousFrame], gSceneBuffers[gCurrentSceneBuffer]);
 		}
 	}
 
@@ -1322,10 +1752,6 @@ void UpdateScene(float frameTime)
 {
 
 	isOtherFrame = !isOtherFrame;
-	if (isOtherFrame)
-	{
-		SaveCurrentSceneToTexture(0, true);
-	}
 
 	if (KeyHit(Key_1)) { AddProcessAndMode(PostProcess::VerticalColourGradient, PostProcessMode::Fullscreen); }
 	
@@ -1385,10 +1811,19 @@ void UpdateScene(float frameTime)
 
 	if (KeyHit(Key_Z)) { AddProcessAndMode(PostProcess::MotionBlur, PostProcessMode::Fullscreen); }
 	
-	if (KeyHit(Key_0)) { gPostProcessAndModeStack.clear(); CreateWindowPostProcesses(windowPostProcesses); }
+	if (KeyHit(Key_0)) { gPostProcessAndModeStack.clear(); CreateWindowPostProcesses(windowPostProcesses); UpdatePostProcessExecutionPlan(); }
 
 	if (KeyHit(Key_Back)) { RemoveProcessAndMode(); }
 
+	// Switch between rendering the scene on the GPU and with the software rasterizer. Stays on the GPU if software rendering
+	// can't be set up
+	if (KeyHit(Key_C))
+	{
+		bool switchOn = !gSoftwareRendering;
+		gSoftwareRendering = switchOn && InitSoftwareRendering();
+		gSoftwareRenderingError = (switchOn && !gSoftwareRendering) ? gLastError : "";
+	}
+
 	// Orbit one light - a bit of a cheat with the static variable [ask the tutor if you want to know what this is]
 	static float lightRotate = 0.0f;
 	static bool go = true;
@@ -1417,83 +1852,55 @@ void UpdateScene(float frameTime)
 		frameTimeMs.precision(2);
 		frameTimeMs << std::fixed << avgFrameTime * 1000;
 		std::string windowTitle = "CO3303 Post Process Assingment - Nicolas Nouhi - Frame Time: " + frameTimeMs.str() +
-			"ms, FPS: " + std::to_string(static_cast<int>(1 / avgFrameTime + 0.5f));
+			"ms, FPS: " + std::to_string(static_cast<int>(1 / avgFrameTime + 0.5f)) +
+			", Post-process memory: " + std::to_string(gSceneBufferBytes / (1024 * 1024)) + "MB, Passes: " +
+			std::to_string(gPostProcessExecutionPlan.passes.size()) + " (" + std::to_string(gPostProcessExecutionPlan.SavedPasses()) + " saved)";
+		if (!gSoftwareRenderingError.empty())  windowTitle += " - Software rendering failed: " + gSoftwareRenderingError;
 		SetWindowTextA(gHWnd, windowTitle.c_str());
 		totalFrameTime = 0;
 		frameCount = 0;
 	}
 }
 
-void SaveCurrentSceneToTexture(int index, bool motionBlur)
+// Plan the scene buffers for the post-process stack and create or release buffers to match. Buffers are reused between
+// frames, so they are only created or released when the stack changes. Returns false if a buffer can't be created
+bool UpdateSceneBuffers()
 {
-	// Using special vertex shader that creates its own data for a 2D screen quad
-	gD3DContext->VSSetShader(g2DQuadVertexShader, nullptr, 0);
-	gD3DContext->GSSetShader(nullptr, nullptr, 0);  // Switch off geometry shader when not using it (pass nullptr for first parameter)
-
-
-	// States - no blending, don't write to depth buffer and ignore back-face culling
-	gD3DContext->OMSetBlendState(gNoBlendingState, nullptr, 0xffffff);
-	gD3DContext->OMSetDepthStencilState(gDepthReadOnlyState, 0);
-	gD3DContext->RSSetState(gCullNoneState);
-
-
-	// No need to set vertex/index buffer (see 2D quad vertex shader), just indicate that the quad will be created as a triangle strip
-	gD3DContext->IASetInputLayout(NULL); // No vertex data
-	gD3DContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+	PostProcessBufferPlan plan = PlanPostProcessBuffers(gPostProcessExecutionPlan.passes, true, gMinSceneBufferFormat);
 
-	// These lines unbind the scene texture from the pixel shader to stop DirectX issuing a warning when we try to render to it again next frame
-	gD3DContext->PSSetShaderResources(0, 1, &nullSRV);
+	if (static_cast<int>(gSceneBuffers.size()) < plan.numBuffers)  gSceneBuffers.resize(plan.numBuffers);
 
-	if (motionBlur)
+	// Keep the previous frame if the new plan holds it in a different buffer
+	int oldPreviousFrame = gSceneBufferPlan.previousFrameBuffer;
+	if (oldPreviousFrame >= 0 && plan.previousFrameBuffer >= 0 && oldPreviousFrame != plan.previousFrameBuffer)
 	{
-		// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTargetPF, gDepthStencil); // Where to render
-		
+		std::swap(gSceneBuffers[oldPreviousFrame], gSceneBuffers[plan.previousFrameBuffer]);
 	}
-	else
-	{
-		// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-		gD3DContext->OMSetRenderTargets(1, &gSceneRenderTargetCopy, gDepthStencil); // Where to render
-	}
-	
 
-	if (index % 2 == 0)
+	// Create buffers that are new or need a different format
+	for (int i = 0; i < plan.numBuffers; ++i)
 	{
-		// Give the pixel shader (post-processing shader) access to the scene texture 
-		// Use the 'first' texture's contents on the 'second' render pass
-		gD3DContext->PSSetShaderResources(0, 1, &gSceneTextureSRV); // Which input (previous in this case)
+		SceneBuffer& sceneBuffer = gSceneBuffers[i];
+		if (sceneBuffer.texture != nullptr && sceneBuffer.format == plan.bufferFormat[i])  continue;
+
+		ReleaseSceneBuffer(sceneBuffer);
+		if (!CreateSceneBuffer(sceneBuffer, plan.bufferFormat[i]))
+		{
+			ReleaseSceneBuffer(sceneBuffer);
+			return false;
+		}
 	}
-	else
+
+	while (static_cast<int>(gSceneBuffers.size()) > plan.numBuffers)
 	{
-		// Give the pixel shader (post-processing shader) access to the scene texture 
-		gD3DContext->PSSetShaderResources(0, 1, &gSceneTextureSRVTwo);
+		ReleaseSceneBuffer(gSceneBuffers.back());
+		gSceneBuffers.pop_back();
 	}
 
-	gD3DContext->PSSetSamplers(0, 1, &gPointSampler); // Use point sampling (no bilinear, trilinear, mip-mapping etc. for most post-processes)
-
-	// Use the copy ps
-	gD3DContext->PSSetShader(gCopyPostProcess, nullptr, 0);
-
-	// Set 2D area for full-screen post-processing (coordinates in 0->1 range)
-	gPostProcessingConstants.area2DTopLeft = { 0, 0 }; // Top-left of entire screen
-	gPostProcessingConstants.area2DSize = { 1, 1 }; // Full size of screen
-	gPostProcessingConstants.area2DDepth = 0;        // Depth buffer value for full screen is as close as possible
-
-
-	// Pass over the above post-processing settings (also the per-process settings prepared in UpdateScene function below)
-	UpdateConstantBuffer(gPostProcessingConstantBuffer, gPostProcessingConstants);
-	gD3DContext->VSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
-	gD3DContext->PSSetConstantBuffers(1, 1, &gPostProcessingConstantBuffer);
-
-
-	// Draw a quad
-	gD3DContext->Draw(4, 0);
-
-	// Select the back buffer to use for rendering. Not going to clear the back-buffer because we're going to overwrite it all
-	gD3DContext->OMSetRenderTargets(1, &gBackBufferRenderTarget, gDepthStencil);
-
-	// Draw a quad
-	gD3DContext->Draw(4, 0);
+	gSceneBufferPlan = plan;
+	gHistoryBuffers[static_cast<int>(HistorySlot::PreviousFrame)] = plan.previousFrameBuffer;
+	gSceneBufferBytes = PostProcessBufferBytes(plan, gViewportWidth, gViewportHeight);
+	return true;
 }
 
 void CreateWindowPostProcesses(std::vector<PostProcess> windowPostProcesses)
@@ -1506,7 +1913,11 @@ void CreateWindowPostProcesses(std::vector<PostProcess> windowPostProcesses)
 
 void AddProcessAndMode(PostProcess process, PostProcessMode mode)
 {
+	// The GPU has no shaders for the CPU-only post-processes
+	if (IsCpuOnlyPostProcess(process))  return;
+
 	gPostProcessAndModeStack.push_back(std::pair<PostProcess, PostProcessMode>(std::make_pair(process, mode)));
+	UpdatePostProcessExecutionPlan();
 }
 
 void RemoveProcessAndMode()
@@ -1514,12 +1925,13 @@ void RemoveProcessAndMode()
 	if (gPostProcessAndModeStack.size() > NUM_OF_WINDOWS)
 	{
 		// If we're removing a vertical Gaussian blur, we need to remove the horizontal one too since its a 2 pass process
-		if (gCurrentPostProcess == PostProcess::GaussianBlurVertical)
+		PostProcess lastPostProcess = gPostProcessAndModeStack.back().first;
+		if (lastPostProcess == PostProcess::GaussianBlurVertical)
 		{
 			gPostProcessAndModeStack.pop_back();
 			gPostProcessAndModeStack.pop_back();
 		}
-		else if (gCurrentPostProcess == PostProcess::MergeTextures)
+		else if (lastPostProcess == PostProcess::MergeTextures)
 		{
 			gPostProcessAndModeStack.pop_back();
 			gPostProcessAndModeStack.pop_back(); 
@@ -1531,24 +1943,33 @@ void RemoveProcessAndMode()
 			gPostProcessAndModeStack.pop_back();
 		}
 	}
+	UpdatePostProcessExecutionPlan();
+}
+
+// Work out the passes to run for the post-process stack, leaving out passes that make no difference to the result. Called
+// whenever the stack changes
+void UpdatePostProcessExecutionPlan()
+{
+	gPostProcessExecutionPlan = OptimisePostProcessStack(gPostProcessAndModeStack);
 }
 
-std::array<CVector3, 4> GetWindowPoint(int windowIndex)
+// Get the points of a window on the building, in order around its edge from the top-left
+std::vector<CVector3> GetWindowPoint(int windowIndex)
 {
 
 	switch (windowIndex)
 	{
 		case 0:
-			return{{ { 22, 25, -50 }, {22, 5, -50 }, {33, 25, -50 }, {33, 5, -50 } }};
+			return { { 22, 25, -50 }, { 22, 5, -50 }, { 33, 5, -50 }, { 33, 25, -50 } };
 		case 1:
-			return{{ { 36, 25, -50 }, { 36, 5, -50 }, { 49, 25, -50 }, { 49, 5, -50 } }};
+			return { { 36, 25, -50 }, { 36, 5, -50 }, { 49, 5, -50 }, { 49, 25, -50 } };
 		case 2:
-			return{{ { 50, 25, -50 }, { 50, 5,-50 }, { 63, 25, -50 }, { 63, 5, -50 } }};
+			return { { 50, 25, -50 }, { 50, 5, -50 }, { 63, 5, -50 }, { 63, 25, -50 } };
 		case 3:
-			return{{ { 64, 25, -50 }, { 64, 5, -50 }, { 78 ,25, -50 }, { 78, 5, -50 } }};
+			return { { 64, 25, -50 }, { 64, 5, -50 }, { 78, 5, -50 }, { 78, 25, -50 } };
 		case 4:
-			return{{ { 160, 25, -50 }, { 160, 5, -50 }, { 176 ,25, -50 }, { 176, 5, -50 } }};
+			return { { 160, 25, -50 }, { 160, 5, -50 }, { 176, 5, -50 }, { 176, 25, -50 } };
 	}
 
-	return std::array<CVector3, 4>();
+	return std::vector<CVector3>();
 }
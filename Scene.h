@@ -6,6 +6,10 @@
 #ifndef _SCENE_H_INCLUDED_
 #define _SCENE_H_INCLUDED_
 
+class Camera;
+class Image;
+class SoftwareRasterizer;
+
 //--------------------------------------------------------------------------------------
 // Scene Geometry and Layout
 //--------------------------------------------------------------------------------------
@@ -18,6 +22,10 @@ bool InitGeometry();
 // Returns true on success
 bool InitScene();
 
+// Prepare for rendering the scene on the CPU with the software rasterizer, done the first time it is switched on
+// Returns true on success
+bool InitSoftwareRendering();
+
 // Release the geometry resources created above
 void ReleaseResources();
 
@@ -28,6 +36,15 @@ void ReleaseResources();
 
 void RenderScene(float frameTime);
 
+// Render the scene from the given camera with the software rasterizer into a CPU image, e.g. CpuPostProcessor::SceneImage,
+// without drawing on the GPU. The rasterizer's DepthImage can then be given to the CPU post-processes as the depth texture.
+// The light settings must already be set up, as RenderScene does, and the CPU copies of the textures loaded by InitSoftwareRendering
+void RenderSceneFromCameraSoftware(Camera* camera, SoftwareRasterizer& rasterizer, Image& target);
+
+// Render only the depth of the scene from the given camera with the software rasterizer, at the given size. Much cheaper than
+// the above as nothing is shaded. The rasterizer's DepthImage holds the result, e.g. for DepthOfField
+void RenderDepthBufferFromCameraSoftware(Camera* camera, SoftwareRasterizer& rasterizer, int width, int height);
+
 // frameTime is the time passed since the last frame
 void UpdateScene(float frameTime);
 
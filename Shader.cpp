@@ -35,6 +35,7 @@ ID3D11PixelShader*  gBurnPostProcess       = nullptr;
 ID3D11PixelShader*  gDistortPostProcess    = nullptr;
 ID3D11PixelShader*  gSpiralPostProcess     = nullptr;
 ID3D11PixelShader*  gHeatHazePostProcess   = nullptr;
+ID3D11PixelShader*  gColourMatrixProcess   = nullptr;
 ID3D11PixelShader* gVerticalColourGradientProcess = nullptr;
 ID3D11PixelShader* gUnderWaterProcess = nullptr;
 ID3D11PixelShader* gHueVerticalColourGradientProcess = nullptr;
@@ -61,70 +62,88 @@ ID3D11PixelShader* gMotionBlurProcess = nullptr;
 // Shader creation / destruction
 //--------------------------------------------------------------------------------------
 
-// Load shaders required for this app, returns true on success
-bool LoadShaders()
+// Shaders required for this app. Shaders must be added to the Visual Studio project to be compiled, they use the extension ".hlsl".
+// To load them for use, add them here without the extension, with the global to receive either the vertex or the pixel shader.
+// InitGeometry (Scene.cpp) loads each one in its own task with LoadShader. Ensure you release the shaders in the ReleaseShaders
+// function below
+namespace
 {
-	// Shaders must be added to the Visual Studio project to be compiled, they use the extension ".hlsl".
-	// To load them for use, include them here without the extension. Use the correct function for each.
-	// Ensure you release the shaders in the ShutdownDirect3D function below
-	gBasicTransformVertexShader   = LoadVertexShader  ("BasicTransform_vs"  );
-	gPixelLightingVertexShader    = LoadVertexShader  ("PixelLighting_vs"   );
-	gTintedTexturePixelShader     = LoadPixelShader   ("TintedTexture_ps"   );
-	gPixelLightingPixelShader	  = LoadPixelShader("PixelLighting_ps");
-	gPixelDepthPixelShader     = LoadPixelShader   ("PixelDepth_ps");
-
-	//***************************************
-	//**** Post processing shaders
-
-	g2DPolygonVertexShader  = LoadVertexShader("2DPolygon_pp");
-	g2DQuadVertexShader     = LoadVertexShader("2DQuad_pp");
-	gCopyPostProcess        = LoadPixelShader ("Copy_pp");
-	gTintPostProcess        = LoadPixelShader ("Tint_pp");
-	gGreyNoisePostProcess   = LoadPixelShader ("GreyNoise_pp");
-	gBurnPostProcess        = LoadPixelShader ("Burn_pp");
-	gDistortPostProcess     = LoadPixelShader ("Distort_pp");
-	gSpiralPostProcess      = LoadPixelShader ("Spiral_pp");
-	gHeatHazePostProcess    = LoadPixelShader ("HeatHaze_pp");
-	gVerticalColourGradientProcess = LoadPixelShader("VerticalColourGradient_pp");
-	gUnderWaterProcess = LoadPixelShader("UnderWater_pp");
-	gHueVerticalColourGradientProcess = LoadPixelShader("HueVerticalColourGradient_pp");
-	gGaussianBlurVerticalProcess = LoadPixelShader("GaussianBlurVertical_pp");
-	gGaussianBlurHorizontalProcess = LoadPixelShader("GuassianBlurHorizontal_pp");
-	gNightVisionProcess = LoadPixelShader("NightVision_pp");
-	gSepiaProcess = LoadPixelShader("Sepia_pp");
-	gInvertedProcess = LoadPixelShader("Inverted_pp");
-	gContourProcess = LoadPixelShader("Contour_pp");
-	gGameBoyProcess = LoadPixelShader("GameBoy_pp");
-	gBloomProcess = LoadPixelShader("Bloom_pp");
-	gMergeTexturesProcess = LoadPixelShader("MergeTextures_pp");
-	gDilationProcess = LoadPixelShader("Dilation_pp");
-	gDualFilteringProcess = LoadPixelShader("DualFiltering_pp");
-	gDepthOfFieldProcess = LoadPixelShader("DepthOfField_pp");
-	gKawaseLighStreakProcess = LoadPixelShader("KawaseLightStreak_pp");
-	gMotionBlurProcess = LoadPixelShader("MotionBlur_pp");
-
-	if (gBasicTransformVertexShader == nullptr || gPixelLightingVertexShader     == nullptr   ||
-		gTintedTexturePixelShader   == nullptr || gPixelLightingPixelShader      == nullptr   ||
-		g2DQuadVertexShader         == nullptr || gCopyPostProcess               == nullptr   ||
-		gTintPostProcess            == nullptr || gHeatHazePostProcess           == nullptr   ||
-		gGreyNoisePostProcess       == nullptr || gBurnPostProcess               == nullptr   ||
-		gDistortPostProcess         == nullptr || gSpiralPostProcess             == nullptr   ||
-		g2DPolygonVertexShader      == nullptr || gVerticalColourGradientProcess == nullptr   ||
-		gGaussianBlurVerticalProcess == nullptr|| gGaussianBlurHorizontalProcess == nullptr   ||
-		gUnderWaterProcess == nullptr          || gHueVerticalColourGradientProcess == nullptr||
-		gNightVisionProcess == nullptr         || gSepiaProcess == nullptr					  ||
-		gInvertedProcess == nullptr			   || gContourProcess == nullptr				  ||
-		gGameBoyProcess == nullptr			   || gBloomProcess == nullptr					  ||
-		gMergeTexturesProcess == nullptr	   || gDilationProcess == nullptr				  ||
-		gDualFilteringProcess == nullptr       || gPixelDepthPixelShader == nullptr			  ||
-		gDepthOfFieldProcess == nullptr        || gKawaseLighStreakProcess == nullptr		  ||
-		gMotionBlurProcess == nullptr)
+	struct ShaderFile
 	{
-		gLastError = "Error loading shaders";
-		return false;
-	}
+		const char*          name;
+		ID3D11VertexShader** vertexShader;
+		ID3D11PixelShader**  pixelShader;
+	};
+
+	const ShaderFile gShaderFiles[] =
+	{
+		{ "BasicTransform_vs", &gBasicTransformVertexShader, nullptr                    },
+		{ "PixelLighting_vs",  &gPixelLightingVertexShader,  nullptr                    },
+		{ "TintedTexture_ps",  nullptr,                      &gTintedTexturePixelShader },
+		{ "PixelLighting_ps",  nullptr,                      &gPixelLightingPixelShader },
+		{ "PixelDepth_ps",     nullptr,                      &gPixelDepthPixelShader    },
+
+		//***************************************
+		//**** Post processing shaders
+
+		{ "2DPolygon_pp",                 &g2DPolygonVertexShader, nullptr                             },
+		{ "2DQuad_pp",                    &g2DQuadVertexShader,    nullptr                             },
+		{ "Copy_pp",                      nullptr,                 &gCopyPostProcess                   },
+		{ "Tint_pp",                      nullptr,                 &gTintPostProcess                   },
+		{ "GreyNoise_pp",                 nullptr,                 &gGreyNoisePostProcess              },
+		{ "Burn_pp",                      nullptr,                 &gBurnPostProcess                   },
+		{ "Distort_pp",                   nullptr,                 &gDistortPostProcess                },
+		{ "Spiral_pp",                    nullptr,                 &gSpiralPostProcess                 },
+		{ "HeatHaze_pp",                  nullptr,                 &gHeatHazePostProcess               },
+		{ "ColourMatrix_pp",              nullptr,                 &gColourMatrixProcess               },
+		{ "VerticalColourGradient_pp",    nullptr,                 &gVerticalColourGradientProcess     },
+		{ "UnderWater_pp",                nullptr,                 &gUnderWaterProcess                 },
+		{ "HueVerticalColourGradient_pp", nullptr,                 &gHueVerticalColourGradientProcess  },
+		{ "GaussianBlurVertical_pp",      nullptr,                 &gGaussianBlurVerticalProcess       },
+		{ "GuassianBlurHorizontal_pp",    nullptr,                 &gGaussianBlurHorizontalProcess     },
+		{ "NightVision_pp",               nullptr,                 &gNightVisionProcess                },
+		{ "Sepia_pp",                     nullptr,                 &gSepiaProcess                      },
+		{ "Inverted_pp",                  nullptr,                 &gInvertedProcess                   },
+		{ "Contour_pp",                   nullptr,                 &gContourProcess                    },
+		{ "GameBoy_pp",                   nullptr,                 &gGameBoyProcess                    },
+		{ "Bloom_pp",                     nullptr,                 &gBloomProcess                      },
+		{ "MergeTextures_pp",             nullptr,                 &gMergeTexturesProcess              },
+		{ "Dilation_pp",                  nullptr,                 &gDilationProcess                   },
+		{ "DualFiltering_pp",             nullptr,                 &gDualFilteringProcess              },
+		{ "DepthOfField_pp",              nullptr,                 &gDepthOfFieldProcess               },
+		{ "KawaseLightStreak_pp",         nullptr,                 &gKawaseLighStreakProcess           },
+		{ "MotionBlur_pp",                nullptr,                 &gMotionBlurProcess                 },
+	};
+}
+
+
+// Number of shaders required for this app. They are loaded one at a time with LoadShader, so several can load at once on different
+// threads (see InitGeometry in Scene.cpp). Only the D3D device is used, which is safe to use from any thread
+int NumShaders()
+{
+	return static_cast<int>(sizeof(gShaderFiles) / sizeof(gShaderFiles[0]));
+}
 
-	return true;
+// File name of a shader without the extension
+const char* ShaderName(int shader)
+{
+	return gShaderFiles[shader].name;
+}
+
+// Load one of the app's shaders, returns true on success
+bool LoadShader(int shader)
+{
+	const ShaderFile& file = gShaderFiles[shader];
+	if (file.vertexShader != nullptr)
+	{
+		*file.vertexShader = LoadVertexShader(file.name);
+		return *file.vertexShader != nullptr;
+	}
+	else
+	{
+		*file.pixelShader = LoadPixelShader(file.name);
+		return *file.pixelShader != nullptr;
+	}
 }
 
 
@@ -149,6 +168,7 @@ void ReleaseShaders()
 	if (gUnderWaterProcess)		       gUnderWaterProcess->Release();
 	if (gVerticalColourGradientProcess)gVerticalColourGradientProcess->Release();
 	if (gHeatHazePostProcess)          gHeatHazePostProcess       ->Release();
+	if (gColourMatrixProcess)          gColourMatrixProcess       ->Release();
 	if (gSpiralPostProcess)            gSpiralPostProcess         ->Release();
 	if (gDistortPostProcess)           gDistortPostProcess        ->Release();
 	if (gBurnPostProcess)              gBurnPostProcess           ->Release();
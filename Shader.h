@@ -33,6 +33,7 @@ extern ID3D11PixelShader*  gBurnPostProcess;
 extern ID3D11PixelShader*  gDistortPostProcess;
 extern ID3D11PixelShader*  gSpiralPostProcess;
 extern ID3D11PixelShader*  gHeatHazePostProcess;
+extern ID3D11PixelShader*  gColourMatrixProcess;
 extern ID3D11PixelShader*  gVerticalColourGradientProcess;
 extern ID3D11PixelShader*  gUnderWaterProcess;
 extern ID3D11PixelShader* gHueVerticalColourGradientProcess;
@@ -58,8 +59,11 @@ extern ID3D11PixelShader* gMotionBlurProcess;
 // Shader creation / destruction
 //--------------------------------------------------------------------------------------
 
-// Load shaders required for this app, returns true on success
-bool LoadShaders();
+// The shaders required for this app, loaded one at a time so several can load at once on different threads (see InitGeometry
+// in Scene.cpp). ShaderName is the file name of a shader without the extension. LoadShader returns true on success
+int         NumShaders();
+const char* ShaderName(int shader);
+bool        LoadShader(int shader);
 
 // Release shaders used by the app
 void ReleaseShaders();
@@ -33,6 +33,7 @@ ID3D11BlendState* gAlphaBlendingState    = nullptr;
 ID3D11RasterizerState* gCullBackState  = nullptr;
 ID3D11RasterizerState* gCullFrontState = nullptr;
 ID3D11RasterizerState* gCullNoneState  = nullptr;
+ID3D11RasterizerState* gCullNoneScissorState = nullptr;
 
 // Depth-stencil states allow us change how the depth buffer is used
 ID3D11DepthStencilState* gUseDepthBufferState = nullptr;
@@ -158,6 +159,17 @@ bool CreateStates()
     }
 	
 	
+    ////-------- No culling, scissor test --------////
+    // Used for area post-processing, only pixels inside the rectangle given by RSSetScissorRects are drawn
+    rasterizerDesc.ScissorEnable         = TRUE;
+
+    if (FAILED(gD3DDevice->CreateRasterizerState(&rasterizerDesc, &gCullNoneScissorState)))
+    {
+        gLastError = "Error creating cull-none scissor state";
+        return false;
+    }
+	
+	
     //--------------------------------------------------------------------------------------
 	// Blending States
 	//--------------------------------------------------------------------------------------
@@ -289,6 +301,7 @@ void ReleaseStates()
     if (gNoDepthBufferState)     gNoDepthBufferState->Release();
     if (gCullBackState)          gCullBackState->Release();
     if (gCullFrontState)         gCullFrontState->Release();
+    if (gCullNoneScissorState)   gCullNoneScissorState->Release();
     if (gCullNoneState)          gCullNoneState->Release();
     if (gNoBlendingState)        gNoBlendingState->Release();
     if (gAlphaBlendingState)     gAlphaBlendingState->Release();
@@ -29,6 +29,7 @@ extern ID3D11BlendState* gAlphaBlendingState;
 extern ID3D11RasterizerState*   gCullBackState;
 extern ID3D11RasterizerState*   gCullFrontState;
 extern ID3D11RasterizerState*   gCullNoneState;
+extern ID3D11RasterizerState*   gCullNoneScissorState;
 
 extern ID3D11DepthStencilState* gUseDepthBufferState;
 extern ID3D11DepthStencilState* gDepthReadOnlyState;
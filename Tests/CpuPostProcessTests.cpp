@@ -0,0 +1,489 @@
+//--------------------------------------------------------------------------------------
+// Tests for the CPU post-processing pipeline
+//--------------------------------------------------------------------------------------
+// Checks the claims the pipeline makes about its optimisations: that results do not depend on the
+// number of threads, that tile fusion gives identical results and that fused chains and the
+// fixed-point kernels stay within their stated error of running each pass separately in float.
+// Also checks the scene buffer plans shared with the GPU pipeline. Run with a test name to run
+// only that test. Returns 0 if every test passes
+
+#include "ColourLut.h"
+#include "CpuPostProcess.h"
+#include "GaussianBlur.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	// Test helpers
+	//--------------------------------------------------------------------------------------
+
+	int gFailures = 0;
+
+	void Check(bool passed, const char* condition, const char* file, int line)
+	{
+		if (passed)  return;
+		std::printf("%s(%d): check failed: %s\n", file, line, condition);
+		++gFailures;
+	}
+	#define CHECK(condition)  Check((condition), #condition, __FILE__, __LINE__)
+
+
+	// Test image size. Not a multiple of the tile size so the edge tiles are partial
+	const int TestWidth  = 200;
+	const int TestHeight = 150;
+
+	// A test scene: smooth gradients with a little noise so the colour-only passes see every kind of colour, and with hdr true
+	// some bright spots above 1 for Bloom to pick up. Colours are otherwise 0->1
+	void TestImage(Image& image, bool hdr)
+	{
+		image.Resize(TestWidth, TestHeight);
+		unsigned int random = 12345;
+		auto Noise = [&]() { random = random * 1664525u + 1013904223u; return ((random >> 8) & 0xffff) / 65535.0f * 0.1f; };
+		for (int y = 0; y < TestHeight; ++y)
+		{
+			for (int x = 0; x < TestWidth; ++x)
+			{
+				float u = (x + 0.5f) / TestWidth;
+				float v = (y + 0.5f) / TestHeight;
+				float spot = (hdr && x % 32 < 3 && y % 32 < 3) ? 3.0f : 0.0f;
+				image.Pixel(x, y) = { 0.9f * u + Noise() + spot, 0.9f * v + Noise() + spot, 0.9f * (1 - u) * v + Noise() + spot, 1.0f };
+			}
+		}
+	}
+
+	// Run a stack of full-screen passes over a test image and return the result
+	Image RunStack(const PostProcessStack& stack, const CpuPostProcessSettings& settings, unsigned int numWorkers = 0, bool hdr = true)
+	{
+		ThreadPool threadPool(numWorkers);
+		CpuPostProcessor postProcessor(threadPool, TestWidth, TestHeight);
+		postProcessor.Settings() = settings;
+		TestImage(postProcessor.SceneImage(), hdr);
+
+		PostProcessingConstants constants = {};
+		constants.distanceToFocusedObject = 50.0f;
+		return postProcessor.Execute(stack, constants, PostProcessTextures(), 1.0f / 60.0f);
+	}
+
+	// A stack of full-screen passes
+	PostProcessStack FullScreenStack(const std::vector<PostProcess>& postProcesses)
+	{
+		PostProcessStack stack;
+		for (PostProcess postProcess : postProcesses)  stack.push_back({ postProcess, PostProcessMode::Fullscreen });
+		return stack;
+	}
+
+	// Largest difference in any channel between two images of the same size. With saturate the colours are clamped to 0->1
+	// first, as they would be written to an LDR target
+	float MaxDifference(const Image& a, const Image& b, bool saturate = false)
+	{
+		float maxDifference = 0;
+		for (int y = 0; y < a.Height(); ++y)
+		{
+			for (int x = 0; x < a.Width(); ++x)
+			{
+				const float* pixelA = &a.Pixel(x, y).r;
+				const float* pixelB = &b.Pixel(x, y).r;
+				for (int channel = 0; channel < 4; ++channel)
+				{
+					float valueA = saturate ? std::min(std::max(pixelA[channel], 0.0f), 1.0f) : pixelA[channel];
+					float valueB = saturate ? std::min(std::max(pixelB[channel], 0.0f), 1.0f) : pixelB[channel];
+					maxDifference = std::max(maxDifference, std::abs(valueA - valueB));
+				}
+			}
+		}
+		return maxDifference;
+	}
+
+	// Settings with every optimisation that changes how passes are run turned off
+	CpuPostProcessSettings PassByPassSettings()
+	{
+		CpuPostProcessSettings settings;
+		settings.fusePointOps     = false;
+		settings.tileFusion       = false;
+		settings.compositeRegions = false;
+		return settings;
+	}
+
+	// Run the passes of an execution plan over a test image one at a time, setting the constants of ColourMatrix passes as the
+	// GPU pipeline does, and return the result
+	Image RunPlan(const PostProcessExecutionPlan& plan)
+	{
+		ThreadPool threadPool;
+		CpuPostProcessor postProcessor(threadPool, TestWidth, TestHeight);
+		postProcessor.Settings() = PassByPassSettings();
+		TestImage(postProcessor.SceneImage(), true);
+
+		PostProcessingConstants constants = {};
+		constants.distanceToFocusedObject = 50.0f;
+		const float frameTime = 1.0f / 60.0f;
+		for (size_t pass = 0; pass < plan.passes.size(); ++pass)
+		{
+			if (plan.passes[pass].first == PostProcess::ColourMatrix)
+			{
+				SetColourMatrixConstants(plan.colourMatrixPasses[pass], constants, frameTime, TestWidth, TestHeight);
+			}
+			Image result = postProcessor.Execute({ plan.passes[pass] }, constants, PostProcessTextures(), frameTime);
+			postProcessor.SceneImage() = result;
+		}
+		return postProcessor.SceneImage();
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Tests
+	//--------------------------------------------------------------------------------------
+
+	// The work is split the same way whatever the number of threads, so the results are identical
+	void TestThreadCountIndependent()
+	{
+		PostProcessStack stack = FullScreenStack({ PostProcess::Sepia, PostProcess::GaussianBlurHorizontal, PostProcess::GaussianBlurVertical,
+		                                           PostProcess::Bloom, PostProcess::GaussianBlurHorizontal, PostProcess::GaussianBlurVertical,
+		                                           PostProcess::MergeTextures, PostProcess::DepthOfField, PostProcess::Contour,
+		                                           PostProcess::DualFilterPyramid, PostProcess::BloomMerge, PostProcess::Spiral });
+		Image oneThread   = RunStack(stack, CpuPostProcessSettings(), 1);
+		Image manyThreads = RunStack(stack, CpuPostProcessSettings(), 7);
+		CHECK(MaxDifference(oneThread, manyThreads) == 0);
+	}
+
+
+	// Tile fusion runs the same shaders in a different order, so results are identical (CpuPostProcessSettings::tileFusion)
+	void TestTileFusionIdentical()
+	{
+		PostProcessStack stack = FullScreenStack({ PostProcess::Tint, PostProcess::Contour, PostProcess::Dilation, PostProcess::Spiral,
+		                                           PostProcess::GaussianBlurHorizontal, PostProcess::GaussianBlurVertical,
+		                                           PostProcess::HeatHaze, PostProcess::UnderWater });
+		CpuPostProcessSettings fused;
+		fused.fusePointOps = false;
+		fused.tileFusionCacheBytes = 64 * 1024; // Small tiles, so the image is split into several
+		CpuPostProcessSettings unfused = fused;
+		unfused.tileFusion = false;
+		CHECK(MaxDifference(RunStack(stack, fused), RunStack(stack, unfused)) == 0);
+	}
+
+
+	// Only tile-fused groups keep images between their steps, a group of polygon passes drawn in one sweep (see RegionComposite.h)
+	// needs no more memory than the two images it reads and writes
+	void TestCompositeGroupsNeedNoFusedImages()
+	{
+		PostProcessStack stack;
+		for (int i = 0; i < 4; ++i)  stack.push_back({ PostProcess::Tint, PostProcessMode::Polygon });
+
+		ThreadPool threadPool;
+		CpuPostProcessor postProcessor(threadPool, TestWidth, TestHeight);
+		TestImage(postProcessor.SceneImage(), true);
+		PostProcessingConstants constants = {};
+		postProcessor.Execute(stack, constants, PostProcessTextures(), 1.0f / 60.0f);
+		CHECK(postProcessor.SceneImageBytes() == 2 * TestWidth * TestHeight * sizeof(ColourRGBA));
+	}
+
+
+	// Depth of field on a flat colour leaves it unchanged, whichever way each tile is blurred. With the depth the same
+	// everywhere the tiles all have one radius and are blurred with the near-uniform kernel
+	void TestDepthOfFieldKeepsFlatColour()
+	{
+		ThreadPool threadPool;
+		Image sharp(TestWidth, TestHeight), depth(TestWidth, TestHeight), target(TestWidth, TestHeight);
+		std::vector<float> cocBuffer;
+		for (float depthValue : { 0.5f, 0.9f, 0.999f })
+		{
+			for (int y = 0; y < TestHeight; ++y)
+			{
+				for (int x = 0; x < TestWidth; ++x)
+				{
+					sharp.Pixel(x, y) = { 0.25f, 0.5f, 2.0f, 1.0f };
+					depth.Pixel(x, y) = { depthValue, 0, 0, 1 };
+				}
+			}
+			DepthOfFieldStats stats = DepthOfField(threadPool, sharp, &depth, target, cocBuffer, 1.0f, 1000.0f, 50.0f);
+			CHECK(stats.mixedTiles == 0);
+			CHECK(MaxDifference(sharp, target) < 1e-5f);
+		}
+	}
+
+
+	// The separable blur's kernel is a true Gaussian at any size: the weights sum to 1 and fall off smoothly from the centre
+	// with no zero gaps inside the radius, and blurring a single bright pixel spreads it symmetrically over exactly the radius
+	void TestGaussianBlurKernel()
+	{
+		CHECK(GaussianBlurWeights(0.0f) == std::vector<float>{ 1.0f });
+
+		ThreadPool threadPool;
+		Image source(TestWidth, TestHeight), blurred(TestWidth, TestHeight);
+		PixelRect rect = { 0, 0, TestWidth, TestHeight };
+		const int centreX = TestWidth / 2, centreY = TestHeight / 2;
+		for (float blurAmount : { 0.5f, 1.0f, 3.0f, 10.0f })
+		{
+			std::vector<float> weights = GaussianBlurWeights(blurAmount * GaussianSigmaPerBlurAmount);
+			int radius = static_cast<int>(weights.size()) - 1;
+			CHECK(radius >= static_cast<int>(3 * blurAmount * GaussianSigmaPerBlurAmount));
+			CHECK(radius < centreY);
+
+			float total = weights[0];
+			for (int i = 1; i <= radius; ++i)
+			{
+				CHECK(weights[i] > 0 && weights[i] < weights[i - 1]);
+				total += 2 * weights[i];
+			}
+			CHECK(std::abs(total - 1) < 1e-5f);
+
+			// A single bright pixel, blurred both ways
+			for (int y = 0; y < TestHeight; ++y)
+			{
+				for (int x = 0; x < TestWidth; ++x)  source.Pixel(x, y) = { 0, 0, 0, 1 };
+			}
+			source.Pixel(centreX, centreY) = { 1, 1, 1, 1 };
+			GaussianBlurHorizontal(threadPool, source, blurred, rect, weights);
+			for (int i = 0; i <= radius + 1; ++i)
+			{
+				float left = blurred.Pixel(centreX - i, centreY).r, right = blurred.Pixel(centreX + i, centreY).r;
+				CHECK(left == right);
+				CHECK(i <= radius ? std::abs(left - weights[i]) < 1e-6f : left == 0);
+			}
+			GaussianBlurVertical(threadPool, source, blurred, rect, weights);
+			for (int i = 0; i <= radius + 1; ++i)
+			{
+				float above = blurred.Pixel(centreX, centreY - i).r, below = blurred.Pixel(centreX, centreY + i).r;
+				CHECK(above == below);
+				CHECK(i <= radius ? std::abs(above - weights[i]) < 1e-6f : above == 0);
+			}
+		}
+	}
+
+
+	// Chains of colour-only passes run as one pass differ from separate passes only by float rounding
+	// (CpuPostProcessSettings::fusePointOps)
+	void TestPointOpFusionMatchesPasses()
+	{
+		const std::vector<std::vector<PostProcess>> chains =
+		{
+			{ PostProcess::Sepia, PostProcess::Inverted, PostProcess::Tint },
+			{ PostProcess::Inverted, PostProcess::VerticalColourGradient, PostProcess::Sepia },
+			{ PostProcess::HueVerticalColourGradient, PostProcess::Inverted },
+			{ PostProcess::NightVision, PostProcess::Sepia, PostProcess::Inverted },
+			{ PostProcess::GameBoy, PostProcess::Inverted },
+			{ PostProcess::GameBoy, PostProcess::Sepia },
+			{ PostProcess::GameBoy, PostProcess::Tint, PostProcess::VerticalColourGradient },
+		};
+		for (const auto& chain : chains)
+		{
+			PostProcessStack stack = FullScreenStack(chain);
+			CpuPostProcessSettings fused = PassByPassSettings();
+			fused.fusePointOps = true;
+			CHECK(MaxDifference(RunStack(stack, fused), RunStack(stack, PassByPassSettings())) < 1e-5f);
+		}
+	}
+
+
+	// With colourLutSize set the row-invariant part of each chain is looked up in a table. The chains here are affine, which
+	// tetrahedral interpolation reproduces, so the table matches the direct transform to float rounding. A curve that is
+	// not affine is only approximated, more closely by the larger table
+	void TestColourLutAccuracy()
+	{
+		PostProcessStack stack = FullScreenStack({ PostProcess::Sepia, PostProcess::Inverted, PostProcess::VerticalColourGradient });
+		Image direct = RunStack(stack, CpuPostProcessSettings());
+		for (int lutSize : { 0, 33, 65 })
+		{
+			ThreadPool threadPool;
+			CpuPostProcessor postProcessor(threadPool, TestWidth, TestHeight);
+			postProcessor.Settings().colourLutSize = lutSize;
+			TestImage(postProcessor.SceneImage(), true);
+			PostProcessingConstants constants = {};
+			const Image& result = postProcessor.Execute(stack, constants, PostProcessTextures(), 1.0f / 60.0f);
+
+			float lutError = postProcessor.ColourLutMaxError(4.0f);
+			CHECK(lutSize == 0 ? lutError == 0 : lutError < 1e-4f);
+			CHECK(MaxDifference(result, direct) < 1e-4f);
+		}
+
+		auto Square = [](const ColourRGBA& colour) { return ColourRGBA{ colour.r * colour.r, colour.g * colour.g, colour.b * colour.b, 1.0f }; };
+		ColourLut lut33, lut65;
+		lut33.Bake(33, Square);
+		lut65.Bake(65, Square);
+		float error33 = lut33.MaxError(Square, 1.0f);
+		float error65 = lut65.MaxError(Square, 1.0f);
+		CHECK(error33 < 1e-3f);
+		CHECK(error65 < error33 * 0.5f);
+	}
+
+
+	// Runs of colour-only passes are merged into one ColourMatrix pass each (see OptimisePostProcessStack), which differs from
+	// running the passes separately only by float rounding
+	void TestColourMatrixMatchesPasses()
+	{
+		const PostProcess gradient    = PostProcess::VerticalColourGradient;
+		const PostProcess hueGradient = PostProcess::HueVerticalColourGradient;
+		const std::vector<std::vector<PostProcess>> stacks =
+		{
+			{ PostProcess::Sepia, PostProcess::Tint, PostProcess::Inverted },
+			{ PostProcess::Inverted, gradient, PostProcess::Sepia, hueGradient, PostProcess::Inverted, gradient, PostProcess::Tint },
+			{ hueGradient, hueGradient, gradient, PostProcess::Sepia, gradient, gradient, PostProcess::Inverted },
+			{ PostProcess::Sepia, PostProcess::Inverted, PostProcess::Contour, PostProcess::Tint, PostProcess::Inverted, PostProcess::Sepia },
+		};
+		for (const auto& postProcesses : stacks)
+		{
+			PostProcessStack stack = FullScreenStack(postProcesses);
+			PostProcessExecutionPlan plan = OptimisePostProcessStack(stack);
+			CHECK(plan.passes.size() == plan.colourMatrixPasses.size());
+			CHECK(static_cast<int>(plan.passes.size()) + plan.SavedPasses() == static_cast<int>(stack.size()));
+			for (size_t pass = 0; pass < plan.passes.size(); ++pass)
+			{
+				CHECK(plan.passes[pass].first != PostProcess::ColourMatrix || plan.colourMatrixPasses[pass].size() > 1);
+				CHECK(plan.passes[pass].first == PostProcess::ColourMatrix || !IsColourTransform(plan.passes[pass].first) ||
+				      pass + 1 == plan.passes.size() || !IsColourTransform(plan.passes[pass + 1].first));
+			}
+			// The bright spots reach about 5 after Sepia, where float rounding is a few times larger than in 0->1
+			CHECK(MaxDifference(RunPlan(plan), RunStack(stack, PassByPassSettings())) < 1e-4f);
+		}
+
+		// A run with more gradients than a pass can hold is split
+		PostProcessExecutionPlan plan = OptimisePostProcessStack(FullScreenStack({ gradient, gradient, gradient, gradient, gradient }));
+		CHECK(plan.passes.size() == 2 && plan.passes[0].first == PostProcess::ColourMatrix &&
+		      plan.colourMatrixPasses[0].size() == MAX_COLOUR_TRANSFORMS);
+	}
+
+
+	// The fixed-point kernels stay within the bounds given in FixedPoint.h of the float passes with their output saturated
+	void TestFixedPointMatchesFloat()
+	{
+		PostProcessStack stack = FullScreenStack({ PostProcess::Tint, PostProcess::Inverted, PostProcess::Sepia });
+		CHECK(CanRunFixedPoint(stack));
+
+		CpuPostProcessSettings ldr;
+		ldr.ldrOutput = true;
+		Image fixedPoint = RunStack(stack, ldr, 0, false);
+		Image floats     = RunStack(stack, CpuPostProcessSettings(), 0, false);
+		CHECK(MaxDifference(fixedPoint, floats, true) <= 4.0f / FixedOne);
+	}
+
+
+	// Each pass writes a different buffer from the one it reads, from the earlier image it reads as history and from the previous
+	// frame, and buffers are only shared by images of the same format
+	void TestBufferPlans()
+	{
+		const std::vector<PostProcessStack> stacks =
+		{
+			FullScreenStack({ PostProcess::Bloom, PostProcess::GaussianBlurHorizontal, PostProcess::GaussianBlurVertical,
+			                  PostProcess::KawaseLightStreak, PostProcess::KawaseLightStreak, PostProcess::MergeTextures }),
+			FullScreenStack({ PostProcess::Sepia, PostProcess::DepthOfField, PostProcess::Tint, PostProcess::MotionBlur,
+			                  PostProcess::GameBoy, PostProcess::Inverted }),
+			{ { PostProcess::Bloom, PostProcessMode::Fullscreen }, { PostProcess::Spiral, PostProcessMode::Area },
+			  { PostProcess::Tint, PostProcessMode::Polygon }, { PostProcess::MergeTextures, PostProcessMode::Fullscreen } },
+		};
+		for (const auto& stack : stacks)
+		{
+			for (SceneBufferFormat minFormat : { SceneBufferFormat::RGBA8, SceneBufferFormat::RGBA32F })
+			{
+				PostProcessBufferPlan plan = PlanPostProcessBuffers(stack, true, minFormat);
+				CHECK(plan.imageBuffer.size() == stack.size() + 1);
+				for (size_t pass = 0; pass < stack.size(); ++pass)
+				{
+					int output = plan.imageBuffer[pass + 1];
+					CHECK(output != plan.imageBuffer[pass]);
+					CHECK(output != plan.previousFrameBuffer);
+					if (PostProcessHistoryRead(stack[pass].first) == HistorySlot::PreEffect && plan.preEffect[pass] >= 0)
+					{
+						CHECK(output != plan.imageBuffer[plan.preEffect[pass]]);
+					}
+				}
+				for (size_t image = 0; image < plan.imageBuffer.size(); ++image)
+				{
+					CHECK(plan.bufferFormat[plan.imageBuffer[image]] == plan.imageFormat[image]);
+				}
+			}
+		}
+	}
+
+
+	// Passes whose output alpha may be read by a later pass (KawaseLightStreak reads the alpha of its input) are never given a
+	// format without alpha, for any input format or least precise format
+	void TestAlphaOutputsKeepAlpha()
+	{
+		const PostProcess alphaOutputs[] = { PostProcess::Bloom, PostProcess::KawaseLightStreak, PostProcess::GreyNoise,
+		                                     PostProcess::HeatHaze, PostProcess::Spiral };
+		const SceneBufferFormat alphaFormats[] = { SceneBufferFormat::RGBA8, SceneBufferFormat::RGBA16F, SceneBufferFormat::RGBA32F };
+		for (PostProcess postProcess : alphaOutputs)
+		{
+			for (SceneBufferFormat inputFormat : alphaFormats)
+			{
+				for (PostProcessMode mode : { PostProcessMode::Fullscreen, PostProcessMode::Area, PostProcessMode::Polygon })
+				{
+					CHECK(PostProcessOutputFormat(postProcess, mode, inputFormat) != SceneBufferFormat::R11G11B10F);
+				}
+
+				// Passes that average their input keep its alpha
+				for (PostProcess passThrough : { PostProcess::DualFiltering, PostProcess::MotionBlur, PostProcess::Copy })
+				{
+					SceneBufferFormat format = PostProcessOutputFormat(postProcess, PostProcessMode::Fullscreen, inputFormat);
+					CHECK(PostProcessOutputFormat(passThrough, PostProcessMode::Fullscreen, format) != SceneBufferFormat::R11G11B10F);
+				}
+			}
+		}
+
+		// The light streak stack added in the app, with the least precise formats allowed (as the GPU uses)
+		PostProcessStack stack = FullScreenStack({ PostProcess::Bloom, PostProcess::KawaseLightStreak, PostProcess::KawaseLightStreak,
+		                                           PostProcess::KawaseLightStreak, PostProcess::KawaseLightStreak,
+		                                           PostProcess::KawaseLightStreak, PostProcess::KawaseLightStreak });
+		PostProcessBufferPlan plan = PlanPostProcessBuffers(stack, false, SceneBufferFormat::RGBA8);
+		for (size_t image = 1; image < plan.imageFormat.size() - 1; ++image)
+		{
+			CHECK(plan.imageFormat[image] != SceneBufferFormat::R11G11B10F);
+		}
+
+		// Rounding to those formats only adds small errors. Losing the Bloom threshold in alpha saturates the diagonal streaks
+		// and washes the image out to white
+		CpuPostProcessSettings leastPrecise;
+		leastPrecise.minBufferFormat = SceneBufferFormat::RGBA8;
+		CHECK(MaxDifference(RunStack(stack, leastPrecise), RunStack(stack, CpuPostProcessSettings()), true) < 0.02f);
+	}
+
+
+	struct Test
+	{
+		const char* name;
+		void (*function)();
+	};
+
+	const Test Tests[] =
+	{
+		{ "ThreadCountIndependent",    TestThreadCountIndependent },
+		{ "TileFusionIdentical",       TestTileFusionIdentical },
+		{ "CompositeGroupsNeedNoFusedImages", TestCompositeGroupsNeedNoFusedImages },
+		{ "PointOpFusionMatchesPasses", TestPointOpFusionMatchesPasses },
+		{ "ColourLutAccuracy",         TestColourLutAccuracy },
+		{ "ColourMatrixMatchesPasses", TestColourMatrixMatchesPasses },
+		{ "DepthOfFieldKeepsFlatColour", TestDepthOfFieldKeepsFlatColour },
+		{ "GaussianBlurKernel",        TestGaussianBlurKernel },
+		{ "FixedPointMatchesFloat",    TestFixedPointMatchesFloat },
+		{ "BufferPlans",               TestBufferPlans },
+		{ "AlphaOutputsKeepAlpha",     TestAlphaOutputsKeepAlpha },
+	};
+}
+
+
+int main(int argc, char* argv[])
+{
+	int numRun = 0;
+	for (const Test& test : Tests)
+	{
+		if (argc > 1 && std::strcmp(argv[1], test.name) != 0)  continue;
+
+		int failuresBefore = gFailures;
+		test.function();
+		std::printf("%-32s %s\n", test.name, gFailures == failuresBefore ? "passed" : "FAILED");
+		++numRun;
+	}
+	if (numRun == 0)
+	{
+		std::printf("No test named %s\n", argv[1]);
+		return 1;
+	}
+	return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,312 @@
+//--------------------------------------------------------------------------------------
+// Command-line driver for the CPU post-processing pipeline
+//--------------------------------------------------------------------------------------
+// Runs a stack of full-screen post-processes over an image file (or a generated gradient) with
+// CpuPostProcessor and writes the result, without DirectX or a window. Run with no arguments for
+// the usage text. Also used as a benchmark: each frame is timed and the average reported, along
+// with what the pipeline's optimisations did with the stack
+
+#include "CpuPostProcess.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	// Post-process names
+	//--------------------------------------------------------------------------------------
+
+	// Names used on the command line, in the order of the PostProcess enum
+	const char* const PostProcessNames[] =
+	{
+		"None", "NightVision", "VerticalColourGradient", "GaussianBlurHorizontal", "GaussianBlurVertical", "UnderWater",
+		"HueVerticalColourGradient", "Sepia", "Inverted", "Contour", "GameBoy", "Bloom", "MergeTextures", "Dilation",
+		"DualFiltering", "DepthOfField", "KawaseLightStreak", "MotionBlur", "Copy", "Tint", "GreyNoise", "Burn", "Distort",
+		"Spiral", "HeatHaze", "ColourMatrix", "DualFilterPyramid", "LightStreaks", "BloomMerge",
+	};
+	const int NumPostProcesses = static_cast<int>(sizeof(PostProcessNames) / sizeof(PostProcessNames[0]));
+
+	// Find a post-process by name, returns false if there is none
+	bool FindPostProcess(const char* name, PostProcess& postProcess)
+	{
+		for (int i = 0; i < NumPostProcesses; ++i)
+		{
+			if (std::strcmp(name, PostProcessNames[i]) == 0)
+			{
+				postProcess = static_cast<PostProcess>(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	const char* const SceneBufferFormatNames[] = { "RGBA8", "R11G11B10F", "RGBA16F", "RGBA32F" };
+
+
+	//--------------------------------------------------------------------------------------
+	// Image files
+	//--------------------------------------------------------------------------------------
+	// Binary PPM (8 bits per channel, values stored as they are, as in the app's UNORM back buffer) and PFM (floats, for HDR
+	// scenes). Alpha is not stored, images are loaded as opaque
+
+	// Read a PPM or PFM file, chosen by the header. Returns false on failure
+	bool LoadImage(const std::string& fileName, Image& image)
+	{
+		FILE* file = std::fopen(fileName.c_str(), "rb");
+		if (file == nullptr)  return false;
+
+		char type[3] = {};
+		int width = 0, height = 0;
+		bool loaded = false;
+		if (std::fscanf(file, "%2s %d %d", type, &width, &height) == 3 && width > 0 && height > 0)
+		{
+			image.Resize(width, height);
+			if (std::strcmp(type, "P6") == 0)
+			{
+				int maxValue = 0;
+				if (std::fscanf(file, "%d", &maxValue) == 1 && maxValue > 0 && maxValue < 256 && std::fgetc(file) != EOF)
+				{
+					std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+					loaded = true;
+					for (int y = 0; y < height && loaded; ++y)
+					{
+						loaded = std::fread(row.data(), 1, row.size(), file) == row.size();
+						for (int x = 0; x < width; ++x)
+						{
+							image.Pixel(x, y) = { row[x * 3] / static_cast<float>(maxValue), row[x * 3 + 1] / static_cast<float>(maxValue),
+							                      row[x * 3 + 2] / static_cast<float>(maxValue), 1.0f };
+						}
+					}
+				}
+			}
+			else if (std::strcmp(type, "PF") == 0)
+			{
+				// Rows are stored bottom to top. A negative scale means little-endian, the only byte order supported
+				float scale = 0;
+				if (std::fscanf(file, "%f", &scale) == 1 && scale < 0 && std::fgetc(file) != EOF)
+				{
+					std::vector<float> row(static_cast<size_t>(width) * 3);
+					loaded = true;
+					for (int y = height - 1; y >= 0 && loaded; --y)
+					{
+						loaded = std::fread(row.data(), sizeof(float), row.size(), file) == row.size();
+						for (int x = 0; x < width; ++x)
+						{
+							image.Pixel(x, y) = { row[x * 3], row[x * 3 + 1], row[x * 3 + 2], 1.0f };
+						}
+					}
+				}
+			}
+		}
+		std::fclose(file);
+		return loaded;
+	}
+
+	// Write a PFM file if the name ends in .pfm, otherwise a PPM file (colours clamped to 0->1). Returns false on failure
+	bool SaveImage(const std::string& fileName, const Image& image)
+	{
+		FILE* file = std::fopen(fileName.c_str(), "wb");
+		if (file == nullptr)  return false;
+
+		bool isPfm = fileName.size() >= 4 && fileName.compare(fileName.size() - 4, 4, ".pfm") == 0;
+		int width  = image.Width();
+		int height = image.Height();
+		bool saved = true;
+		if (isPfm)
+		{
+			std::fprintf(file, "PF\n%d %d\n-1.0\n", width, height);
+			std::vector<float> row(static_cast<size_t>(width) * 3);
+			for (int y = height - 1; y >= 0; --y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const ColourRGBA& pixel = image.Pixel(x, y);
+					row[x * 3] = pixel.r;  row[x * 3 + 1] = pixel.g;  row[x * 3 + 2] = pixel.b;
+				}
+				saved = saved && std::fwrite(row.data(), sizeof(float), row.size(), file) == row.size();
+			}
+		}
+		else
+		{
+			std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+			std::vector<unsigned char> row(static_cast<size_t>(width) * 3);
+			auto ToByte = [](float value) { return static_cast<unsigned char>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f + 0.5f); };
+			for (int y = 0; y < height; ++y)
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					const ColourRGBA& pixel = image.Pixel(x, y);
+					row[x * 3] = ToByte(pixel.r);  row[x * 3 + 1] = ToByte(pixel.g);  row[x * 3 + 2] = ToByte(pixel.b);
+				}
+				saved = saved && std::fwrite(row.data(), 1, row.size(), file) == row.size();
+			}
+		}
+		return std::fclose(file) == 0 && saved;
+	}
+
+	// A test scene: colour gradients across and down, with bright (HDR) spots for Bloom and the light streaks to pick up
+	void GradientImage(int width, int height, Image& image)
+	{
+		image.Resize(width, height);
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				float u = (x + 0.5f) / width;
+				float v = (y + 0.5f) / height;
+				float spot = ((x / 40 + y / 40) % 5 == 0 && x % 40 < 4 && y % 40 < 4) ? 4.0f : 0.0f;
+				image.Pixel(x, y) = { u + spot, v + spot, 0.5f * (1.0f - u) + spot, 1.0f };
+			}
+		}
+	}
+
+
+	void PrintUsage()
+	{
+		std::printf(
+			"Usage: CpuPostProcessDriver [options] input PostProcess...\n"
+			"Runs the full-screen post-processes in order over the input image with the CPU pipeline\n"
+			"\n"
+			"input                 .ppm (binary, 8-bit) or .pfm (float) file, or gradient:WIDTHxHEIGHT for a generated image\n"
+			"-o file               Write the result, as a .pfm file if the name ends in .pfm, otherwise .ppm\n"
+			"-frames n             Run the stack n times and report the average time (default 1)\n"
+			"-threads n            Worker threads, not counting the main thread (default one less than the hardware threads)\n"
+			"-ldr                  LDR output, stacks that allow it are run in fixed point\n"
+			"-format f             Least precise format images are rounded to after each pass: RGBA8, R11G11B10F, RGBA16F\n"
+			"                      or RGBA32F (default)\n"
+			"-nopointops           Don't fuse chains of colour-only passes\n"
+			"-lut n                Look up the row-invariant part of colour-only chains in an n^3 table (33 or 65 are usual)\n"
+			"                      and report its largest error against the direct transform\n"
+			"-notilefusion         Don't run groups of passes tile by tile\n"
+			"-focus distance       distanceToFocusedObject for DepthOfField (default 50)\n"
+			"\n"
+			"Post-processes:\n");
+		for (int i = 1; i < NumPostProcesses; ++i)  std::printf("  %s\n", PostProcessNames[i]);
+	}
+}
+
+
+int main(int argc, char* argv[])
+{
+	std::string inputName;
+	std::string outputName;
+	PostProcessStack stack;
+	int frames = 1;
+	unsigned int threads = 0;
+	float focusDistance = 50.0f;
+	CpuPostProcessSettings settings;
+
+	for (int arg = 1; arg < argc; ++arg)
+	{
+		std::string option = argv[arg];
+		bool hasValue = arg + 1 < argc;
+		if      (option == "-o"       && hasValue)  outputName = argv[++arg];
+		else if (option == "-frames"  && hasValue)  frames = std::max(std::atoi(argv[++arg]), 1);
+		else if (option == "-threads" && hasValue)  threads = static_cast<unsigned int>(std::max(std::atoi(argv[++arg]), 0));
+		else if (option == "-focus"   && hasValue)  focusDistance = static_cast<float>(std::atof(argv[++arg]));
+		else if (option == "-lut"     && hasValue)  settings.colourLutSize = std::max(std::atoi(argv[++arg]), 0);
+		else if (option == "-ldr")                  settings.ldrOutput = true;
+		else if (option == "-nopointops")           settings.fusePointOps = false;
+		else if (option == "-notilefusion")         settings.tileFusion = false;
+		else if (option == "-format" && hasValue)
+		{
+			std::string format = argv[++arg];
+			auto found = std::find(std::begin(SceneBufferFormatNames), std::end(SceneBufferFormatNames), format);
+			if (found == std::end(SceneBufferFormatNames))
+			{
+				std::fprintf(stderr, "Unknown format %s\n", format.c_str());
+				return 1;
+			}
+			settings.minBufferFormat = static_cast<SceneBufferFormat>(found - std::begin(SceneBufferFormatNames));
+		}
+		else if (option[0] == '-')
+		{
+			PrintUsage();
+			return 1;
+		}
+		else if (inputName.empty())
+		{
+			inputName = option;
+		}
+		else
+		{
+			PostProcess postProcess;
+			if (!FindPostProcess(option.c_str(), postProcess))
+			{
+				std::fprintf(stderr, "Unknown post-process %s\n", option.c_str());
+				return 1;
+			}
+			stack.push_back({ postProcess, PostProcessMode::Fullscreen });
+		}
+	}
+	if (inputName.empty())
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Image input;
+	int gradientWidth = 0, gradientHeight = 0;
+	if (std::sscanf(inputName.c_str(), "gradient:%dx%d", &gradientWidth, &gradientHeight) == 2 && gradientWidth > 0 && gradientHeight > 0)
+	{
+		GradientImage(gradientWidth, gradientHeight, input);
+	}
+	else if (!LoadImage(inputName, input))
+	{
+		std::fprintf(stderr, "Error loading %s\n", inputName.c_str());
+		return 1;
+	}
+
+	ThreadPool threadPool(threads);
+	CpuPostProcessor postProcessor(threadPool, input.Width(), input.Height());
+	postProcessor.Settings() = settings;
+
+	PostProcessingConstants constants = {};
+	constants.distanceToFocusedObject = focusDistance;
+
+	// The scene is copied in each frame as the app renders it each frame, the time of the copy is included
+	const Image* result = nullptr;
+	double totalTime = 0;
+	const float frameTime = 1.0f / 60.0f;
+	for (int frame = 0; frame < frames; ++frame)
+	{
+		auto start = std::chrono::steady_clock::now();
+		postProcessor.SceneImage().CopyRect(input, input.Rect());
+		result = &postProcessor.Execute(stack, constants, PostProcessTextures(), frameTime);
+		totalTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	std::printf("%dx%d, %d passes on %u threads: %.2fms per frame over %d frames\n", input.Width(), input.Height(),
+	            static_cast<int>(stack.size()), threadPool.NumThreads(), totalTime / frames, frames);
+	if (postProcessor.LastUsedFixedPoint())
+	{
+		std::printf("Run in fixed point\n");
+	}
+	else
+	{
+		const TileFusionStats& tileFusion = postProcessor.LastTileFusionStats();
+		std::printf("Colour-only passes fused: %d, tile-fused groups: %d (%d passes), scene images: %.1fMB\n",
+		            postProcessor.LastFusedPasses(), tileFusion.fusedGroups, tileFusion.fusedPasses,
+		            postProcessor.SceneImageBytes() / (1024.0 * 1024.0));
+		if (settings.colourLutSize != 0)
+		{
+			// Over 0->4 to include the HDR range
+			std::printf("Colour lookup table %d^3, max error against direct evaluation: %g\n", settings.colourLutSize,
+			            postProcessor.ColourLutMaxError(4.0f));
+		}
+	}
+
+	if (!outputName.empty() && !SaveImage(outputName, *result))
+	{
+		std::fprintf(stderr, "Error saving %s\n", outputName.c_str());
+		return 1;
+	}
+	return 0;
+}
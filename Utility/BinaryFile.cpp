@@ -0,0 +1,152 @@
+//--------------------------------------------------------------------------------------
+// Binary file helpers - memory-mapped reading, safe writing and hashing of file contents
+//--------------------------------------------------------------------------------------
+
+#include "BinaryFile.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+	#ifndef NOMINMAX
+		#define NOMINMAX
+	#endif
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+
+//--------------------------------------------------------------------------------------
+// Mapped file
+//--------------------------------------------------------------------------------------
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+
+// Map the given file, returns false if it cannot be opened. Empty files open successfully with no data
+bool MappedFile::Open(const std::string& fileName)
+{
+	Close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)  return false;
+	mFile = file;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size))
+	{
+		Close();
+		return false;
+	}
+	if (size.QuadPart == 0)  return true; // Empty files cannot be mapped
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+	mMapping = mapping;
+
+	mData = static_cast<const unsigned char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (mData == nullptr)
+	{
+		Close();
+		return false;
+	}
+	mSize = static_cast<size_t>(size.QuadPart);
+#else
+	mFile = open(fileName.c_str(), O_RDONLY);
+	if (mFile < 0)  return false;
+
+	struct stat status;
+	if (fstat(mFile, &status) != 0)
+	{
+		Close();
+		return false;
+	}
+	if (status.st_size == 0)  return true;
+
+	void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, mFile, 0);
+	if (data == MAP_FAILED)
+	{
+		Close();
+		return false;
+	}
+	mData = static_cast<const unsigned char*>(data);
+	mSize = static_cast<size_t>(status.st_size);
+#endif
+
+	return true;
+}
+
+
+// Unmap the current file, if any
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (mData    != nullptr)  UnmapViewOfFile(mData);
+	if (mMapping != nullptr)  CloseHandle(mMapping);
+	if (mFile    != nullptr)  CloseHandle(mFile);
+	mMapping = nullptr;
+	mFile    = nullptr;
+#else
+	if (mData != nullptr)  munmap(const_cast<unsigned char*>(mData), mSize);
+	if (mFile >= 0)        close(mFile);
+	mFile = -1;
+#endif
+	mData = nullptr;
+	mSize = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Writing and hashing
+//--------------------------------------------------------------------------------------
+
+// Write data to a file, replacing it if it exists. The data is written to a temporary file first and renamed once complete
+bool WriteFileReplacing(const std::string& fileName, const std::vector<unsigned char>& data)
+{
+	std::string tempFileName = fileName + ".tmp";
+	FILE* file = std::fopen(tempFileName.c_str(), "wb");
+	if (file == nullptr)  return false;
+
+	bool written = data.empty() || std::fwrite(data.data(), 1, data.size(), file) == data.size();
+	written = (std::fclose(file) == 0) && written;
+	if (!written)
+	{
+		std::remove(tempFileName.c_str());
+		return false;
+	}
+
+#ifdef _WIN32
+	bool renamed = MoveFileExA(tempFileName.c_str(), fileName.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool renamed = std::rename(tempFileName.c_str(), fileName.c_str()) == 0;
+#endif
+	if (!renamed)  std::remove(tempFileName.c_str());
+	return renamed;
+}
+
+
+// 64-bit FNV-1a hash of some data. Pass the result of a previous call as the seed to hash several pieces of data together
+uint64_t HashData(const void* data, size_t size, uint64_t seed /*= HashSeed*/)
+{
+	const uint64_t prime = 0x100000001b3ull;
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= prime;
+	}
+	return hash;
+}
@@ -0,0 +1,60 @@
+//--------------------------------------------------------------------------------------
+// Binary file helpers - memory-mapped reading, safe writing and hashing of file contents
+//--------------------------------------------------------------------------------------
+// Used for caches of processed assets (e.g. the mesh cache in Mesh.cpp). A cache file is read by
+// mapping it into memory so its data can be used in place, without copying or parsing. Cache files
+// are written to a temporary file that is then renamed, so a crash while writing never leaves a
+// partial file behind. Code in .cpp file
+
+#ifndef _BINARY_FILE_H_INCLUDED_
+#define _BINARY_FILE_H_INCLUDED_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// A read-only file mapped into memory. The data stays valid until the object is destroyed or another file is opened
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Map the given file, returns false if it cannot be opened. Empty files open successfully with no data
+	bool Open(const std::string& fileName);
+
+	// Unmap the current file, if any
+	void Close();
+
+	const unsigned char* Data() const  { return mData; }
+	size_t               Size() const  { return mSize; }
+
+private:
+	const unsigned char* mData = nullptr;
+	size_t               mSize = 0;
+
+#ifdef _WIN32
+	void* mFile    = nullptr; // Windows file and file mapping handles
+	void* mMapping = nullptr;
+#else
+	int   mFile    = -1;
+#endif
+};
+
+
+// Write data to a file, replacing it if it exists. The data is written to a temporary file first and renamed once complete.
+// Returns false on failure, leaving any existing file unchanged
+bool WriteFileReplacing(const std::string& fileName, const std::vector<unsigned char>& data);
+
+
+// 64-bit FNV-1a hash of some data. Pass the result of a previous call as the seed to hash several pieces of data together
+const uint64_t HashSeed = 0xcbf29ce484222325ull;
+uint64_t HashData(const void* data, size_t size, uint64_t seed = HashSeed);
+
+
+#endif //_BINARY_FILE_H_INCLUDED_
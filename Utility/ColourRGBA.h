@@ -38,5 +38,23 @@ public:
         a = pfElts[3];
     }
 };
+
+
+/*-----------------------------------------------------------------------------------------
+    Non-member operators
+-----------------------------------------------------------------------------------------*/
+// Inline as they are used per-pixel by the CPU post-processing code. All four channels are affected
+
+// Colour-colour addition, subtraction and component-wise multiplication
+inline ColourRGBA operator+ (const ColourRGBA& c1, const ColourRGBA& c2)  { return { c1.r + c2.r, c1.g + c2.g, c1.b + c2.b, c1.a + c2.a }; }
+inline ColourRGBA operator- (const ColourRGBA& c1, const ColourRGBA& c2)  { return { c1.r - c2.r, c1.g - c2.g, c1.b - c2.b, c1.a - c2.a }; }
+inline ColourRGBA operator* (const ColourRGBA& c1, const ColourRGBA& c2)  { return { c1.r * c2.r, c1.g * c2.g, c1.b * c2.b, c1.a * c2.a }; }
+
+// Colour-scalar multiplication & division
+inline ColourRGBA operator* (const ColourRGBA& c, float s)  { return { c.r * s, c.g * s, c.b * s, c.a * s }; }
+inline ColourRGBA operator* (float s, const ColourRGBA& c)  { return { c.r * s, c.g * s, c.b * s, c.a * s }; }
+inline ColourRGBA operator/ (const ColourRGBA& c, float s)  { return c * (1.0f / s); }
+
+inline ColourRGBA& operator+= (ColourRGBA& c1, const ColourRGBA& c2)  { c1 = c1 + c2; return c1; }
 	
 #endif // _COLOURRGBA_H_DEFINED_
@@ -0,0 +1,44 @@
+//--------------------------------------------------------------------------------------
+// Helpers that split the rows of an image over a thread pool
+//--------------------------------------------------------------------------------------
+// Rows are split into bands of RowsPerJob rows, one job per band. The bands are the same whatever
+// the number of threads, so results don't depend on it
+
+#ifndef _PARALLEL_ROWS_H_INCLUDED_
+#define _PARALLEL_ROWS_H_INCLUDED_
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+
+// Rows per job when splitting an image over the thread pool
+const int RowsPerJob = 16;
+
+
+// Call bandFunction(top, bottom) for bands of rows covering rows 0 to height-1 (bottom is one past the last row of the band),
+// spread over the thread pool. Use when each job needs some setup of its own, such as a buffer
+template <typename BandFunction>
+void ForEachRowBand(ThreadPool& threadPool, int height, BandFunction bandFunction)
+{
+	int numJobs = (height + RowsPerJob - 1) / RowsPerJob;
+	threadPool.ParallelFor(numJobs, [&](int job)
+	{
+		int top    = job * RowsPerJob;
+		int bottom = std::min(top + RowsPerJob, height);
+		bandFunction(top, bottom);
+	});
+}
+
+// Call rowFunction(y) for every row from 0 to height-1, spread over the thread pool
+template <typename RowFunction>
+void ForEachRow(ThreadPool& threadPool, int height, RowFunction rowFunction)
+{
+	ForEachRowBand(threadPool, height, [&](int top, int bottom)
+	{
+		for (int y = top; y < bottom; ++y)  rowFunction(y);
+	});
+}
+
+
+#endif //_PARALLEL_ROWS_H_INCLUDED_
@@ -0,0 +1,293 @@
+//--------------------------------------------------------------------------------------
+// Task graph - named tasks with dependencies, run in parallel on a thread pool
+//--------------------------------------------------------------------------------------
+
+#include "TaskGraph.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <exception>
+
+
+namespace
+{
+	// Milliseconds between two times
+	double Milliseconds(std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end)
+	{
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+}
+
+
+// Add a task that will run after the given tasks, returns an ID for other tasks to depend on
+int TaskGraph::Add(const std::string& name, std::function<void()> task, const std::vector<int>& dependencies /*= {}*/,
+                   TaskThread thread /*= TaskThread::AnyThread*/)
+{
+	int id = static_cast<int>(mTasks.size());
+	for (int dependency : dependencies)
+	{
+		assert(dependency >= 0 && dependency < id && "Tasks can only depend on tasks added before them");
+		mTasks[dependency].dependents.push_back(id);
+	}
+
+	Task newTask;
+	newTask.name         = name;
+	newTask.function     = std::move(task);
+	newTask.dependencies = dependencies;
+	newTask.thread       = thread;
+	newTask.state        = TaskState::Waiting;
+	newTask.remainingDependencies = 0;
+	mTasks.push_back(std::move(newTask));
+	return id;
+}
+
+
+// Run all the tasks, using the pool's workers and the calling thread. Returns when every task has finished. If a task
+// throws, the tasks that depend on it are skipped and false is returned, the other tasks still run
+bool TaskGraph::Run(ThreadPool& threadPool)
+{
+	mThreadPool = &threadPool;
+	mError.clear();
+	mCallingThreadTasks.clear();
+	mNumCompleted = 0;
+	mCallingThreadId = std::this_thread::get_id();
+	for (auto& task : mTasks)
+	{
+		task.state = TaskState::Waiting;
+		task.remainingDependencies = static_cast<int>(task.dependencies.size());
+	}
+
+	// Find all the tasks with no dependencies before starting any, after that the task states belong to the running tasks
+	std::vector<int> ready;
+	for (int task = 0; task < static_cast<int>(mTasks.size()); ++task)
+	{
+		if (mTasks[task].remainingDependencies == 0)  ready.push_back(task);
+	}
+	mRunStart = Clock::now();
+	for (int task : ready)  Schedule(task);
+
+	// The calling thread runs its own tasks as they become ready, otherwise it waits for the workers
+	std::unique_lock<std::mutex> lock(mMutex);
+	while (mNumCompleted < static_cast<int>(mTasks.size()))
+	{
+		if (!mCallingThreadTasks.empty())
+		{
+			int task = mCallingThreadTasks.front();
+			mCallingThreadTasks.pop_front();
+			lock.unlock();
+			Execute(task);
+			lock.lock();
+		}
+		else
+		{
+			mProgress.wait(lock);
+		}
+	}
+	mRunEnd = Clock::now();
+	mThreadPool = nullptr;
+
+	return mError.empty();
+}
+
+
+// Pass a task that is ready to the pool, or the calling thread's queue
+void TaskGraph::Schedule(int task)
+{
+	if (mTasks[task].thread == TaskThread::CallingThread)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mCallingThreadTasks.push_back(task);
+		}
+		mProgress.notify_all();
+	}
+	else
+	{
+		mThreadPool->Submit([this, task]() { Execute(task); });
+	}
+}
+
+
+// Run a task then start any dependents that are now ready
+void TaskGraph::Execute(int task)
+{
+	Task& current = mTasks[task];
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		current.state    = TaskState::Running;
+		current.threadId = std::this_thread::get_id();
+	}
+
+	std::string error;
+	current.start = Clock::now();
+	try
+	{
+		current.function();
+	}
+	catch (const std::exception& e)
+	{
+		error = e.what();
+		if (error.empty())  error = "Error in " + current.name;
+	}
+	catch (...)
+	{
+		error = "Error in " + current.name;
+	}
+	current.end = Clock::now();
+
+	std::vector<int> ready;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mNumCompleted;
+		if (!error.empty())
+		{
+			current.state = TaskState::Failed;
+			if (mError.empty())  mError = error;
+			SkipDependents(task);
+		}
+		else
+		{
+			current.state = TaskState::Finished;
+			for (int dependent : current.dependents)
+			{
+				if (--mTasks[dependent].remainingDependencies == 0 && mTasks[dependent].state == TaskState::Waiting)
+				{
+					ready.push_back(dependent);
+				}
+			}
+		}
+
+		// Notify while locked - once the last task completes Run can return and the graph be destroyed as soon as the lock is released
+		mProgress.notify_all();
+	}
+
+	for (int dependent : ready)  Schedule(dependent);
+}
+
+
+// Mark the dependents of a failed task as skipped, and their dependents etc. Call with mMutex locked
+void TaskGraph::SkipDependents(int task)
+{
+	for (int dependent : mTasks[task].dependents)
+	{
+		if (mTasks[dependent].state == TaskState::Waiting)
+		{
+			mTasks[dependent].state = TaskState::Skipped;
+			++mNumCompleted;
+			SkipDependents(dependent);
+		}
+	}
+}
+
+
+// Text report of the last run: when each task started, its time and thread as a table and a bar chart, the total time
+// compared with running the tasks in sequence, and the critical path
+std::string TaskGraph::TimelineReport() const
+{
+	// Tasks that ran, in the order they started
+	std::vector<int> ran;
+	for (int task = 0; task < static_cast<int>(mTasks.size()); ++task)
+	{
+		if (mTasks[task].state == TaskState::Finished || mTasks[task].state == TaskState::Failed)  ran.push_back(task);
+	}
+	std::sort(ran.begin(), ran.end(), [&](int a, int b) { return mTasks[a].start < mTasks[b].start; });
+
+	// Number the threads in the order they were first used, the calling thread is always 0
+	std::vector<std::thread::id> threads = { mCallingThreadId };
+	auto ThreadNumber = [&](std::thread::id id)
+	{
+		auto found = std::find(threads.begin(), threads.end(), id);
+		if (found != threads.end())  return static_cast<int>(found - threads.begin());
+		threads.push_back(id);
+		return static_cast<int>(threads.size()) - 1;
+	};
+
+	double totalTime = Milliseconds(mRunStart, mRunEnd);
+	double sequenceTime = 0;
+	int    longestTask = -1;
+	for (int task : ran)
+	{
+		double time = Milliseconds(mTasks[task].start, mTasks[task].end);
+		sequenceTime += time;
+		if (longestTask < 0 || time > Milliseconds(mTasks[longestTask].start, mTasks[longestTask].end))  longestTask = task;
+	}
+
+	size_t nameWidth = 4;
+	for (int task : ran)  nameWidth = std::max(nameWidth, mTasks[task].name.size());
+
+	std::string report;
+	char line[256];
+
+	// Table and bar chart, one line per task
+	const int barWidth = 40;
+	std::snprintf(line, sizeof(line), "    Start      Time  Thread  %-*s  0ms%*s%.0fms\n", static_cast<int>(nameWidth), "Task", barWidth - 4, "", totalTime);
+	std::string table = line;
+	for (int task : ran)
+	{
+		const Task& t = mTasks[task];
+		double start = Milliseconds(mRunStart, t.start);
+		double end   = Milliseconds(mRunStart, t.end);
+
+		std::string bar(barWidth, ' ');
+		int barStart = totalTime > 0 ? static_cast<int>(start / totalTime * barWidth) : 0;
+		int barEnd   = totalTime > 0 ? static_cast<int>(end   / totalTime * barWidth) : 0;
+		barStart = std::min(barStart, barWidth - 1);
+		barEnd   = std::min(std::max(barEnd, barStart + 1), barWidth);
+		std::fill(bar.begin() + barStart, bar.begin() + barEnd, '#');
+
+		std::snprintf(line, sizeof(line), "%7.1fms %7.1fms  %6d  %-*s  |%s|%s\n", start, end - start, ThreadNumber(t.threadId),
+		              static_cast<int>(nameWidth), t.name.c_str(), bar.c_str(), t.state == TaskState::Failed ? " FAILED" : "");
+		table += line;
+	}
+
+	std::snprintf(line, sizeof(line), "Task timeline: %d tasks on %d threads\n", static_cast<int>(ran.size()), static_cast<int>(threads.size()));
+	report += line;
+	std::snprintf(line, sizeof(line), "Total %.1fms, %.1fms if run in sequence", totalTime, sequenceTime);
+	report += line;
+	if (longestTask >= 0)
+	{
+		std::snprintf(line, sizeof(line), ", longest task %.1fms (%s)", Milliseconds(mTasks[longestTask].start, mTasks[longestTask].end),
+		              mTasks[longestTask].name.c_str());
+		report += line;
+	}
+	report += "\n\n" + table;
+
+	// Skipped tasks are listed but have no times
+	for (auto& task : mTasks)
+	{
+		if (task.state == TaskState::Skipped)  report += "Skipped: " + task.name + "\n";
+	}
+
+	// Critical path - start from the task that finished last, then repeatedly step back to the dependency that finished last.
+	// Any time on the path not spent in its tasks was spent waiting for a free thread
+	if (!ran.empty())
+	{
+		int task = *std::max_element(ran.begin(), ran.end(), [&](int a, int b) { return mTasks[a].end < mTasks[b].end; });
+		double pathEnd = Milliseconds(mRunStart, mTasks[task].end);
+		std::vector<int> path;
+		for (;;)
+		{
+			path.push_back(task);
+			const auto& dependencies = mTasks[task].dependencies;
+			if (dependencies.empty())  break;
+			task = *std::max_element(dependencies.begin(), dependencies.end(), [&](int a, int b) { return mTasks[a].end < mTasks[b].end; });
+		}
+		std::reverse(path.begin(), path.end());
+
+		double pathTaskTime = 0;
+		for (int pathTask : path)  pathTaskTime += Milliseconds(mTasks[pathTask].start, mTasks[pathTask].end);
+
+		std::snprintf(line, sizeof(line), "\nCritical path %.1fms (%.1fms in tasks, %.1fms waiting):\n", pathEnd, pathTaskTime, pathEnd - pathTaskTime);
+		report += line;
+		for (size_t i = 0; i < path.size(); ++i)
+		{
+			std::snprintf(line, sizeof(line), "%s%s %.1fms", i == 0 ? "    " : " -> ", mTasks[path[i]].name.c_str(),
+			              Milliseconds(mTasks[path[i]].start, mTasks[path[i]].end));
+			report += line;
+		}
+		report += "\n";
+	}
+
+	return report;
+}
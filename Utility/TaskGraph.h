@@ -0,0 +1,104 @@
+//--------------------------------------------------------------------------------------
+// Task graph - named tasks with dependencies, run in parallel on a thread pool
+//--------------------------------------------------------------------------------------
+// Used to run the independent parts of app startup (loading meshes, textures, shaders etc.) at the
+// same time. A task starts as soon as all the tasks it depends on have finished. Tasks can only
+// depend on tasks added before them, so the graph never has cycles. Tasks report errors by throwing
+// a std::runtime_error, the same as the Mesh constructor. Each task is timed so a timeline of the
+// run can be reported, along with the critical path - the chain of tasks that decided the total
+// time. Code in .cpp file
+
+#ifndef _TASK_GRAPH_H_INCLUDED_
+#define _TASK_GRAPH_H_INCLUDED_
+
+#include "ThreadPool.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class TaskGraph
+{
+public:
+	// Which thread may run a task. Use CallingThread for work that is tied to the thread that calls Run, e.g. anything
+	// that uses the D3D immediate context or COM objects created on that thread
+	enum class TaskThread
+	{
+		AnyThread,
+		CallingThread,
+	};
+
+
+	// Add a task that will run after the given tasks, returns an ID for other tasks to depend on
+	int Add(const std::string& name, std::function<void()> task, const std::vector<int>& dependencies = {},
+	        TaskThread thread = TaskThread::AnyThread);
+
+	// Run all the tasks, using the pool's workers and the calling thread. Returns when every task has finished. If a task
+	// throws, the tasks that depend on it are skipped and false is returned, the other tasks still run
+	bool Run(ThreadPool& threadPool);
+
+	// Message from the first task that failed in the last run, empty if none did
+	const std::string& Error() const  { return mError; }
+
+	// Text report of the last run: when each task started, its time and thread as a table and a bar chart, the total time
+	// compared with running the tasks in sequence, and the critical path
+	std::string TimelineReport() const;
+
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	enum class TaskState
+	{
+		Waiting,
+		Running,
+		Finished,
+		Failed,
+		Skipped,
+	};
+
+	struct Task
+	{
+		std::string           name;
+		std::function<void()> function;
+		std::vector<int>      dependencies;
+		std::vector<int>      dependents;
+		TaskThread            thread;
+
+		TaskState         state;
+		int               remainingDependencies;
+		Clock::time_point start;
+		Clock::time_point end;
+		std::thread::id   threadId;
+	};
+
+	// Pass a task that is ready to the pool, or the calling thread's queue
+	void Schedule(int task);
+
+	// Run a task then start any dependents that are now ready
+	void Execute(int task);
+
+	// Mark the dependents of a failed task as skipped, and their dependents etc. Call with mMutex locked
+	void SkipDependents(int task);
+
+	std::vector<Task> mTasks;
+	std::string       mError;
+
+	// State of the current run
+	ThreadPool*             mThreadPool = nullptr;
+	std::deque<int>         mCallingThreadTasks; // Ready tasks that must run on the calling thread
+	int                     mNumCompleted = 0;   // Finished, failed or skipped tasks
+	Clock::time_point       mRunStart;
+	Clock::time_point       mRunEnd;
+	std::thread::id         mCallingThreadId;
+	std::mutex              mMutex;              // Protects the state above and the task states
+	std::condition_variable mProgress;           // Signalled when a task completes or a calling thread task is ready
+};
+
+
+#endif //_TASK_GRAPH_H_INCLUDED_
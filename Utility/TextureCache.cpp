@@ -0,0 +1,620 @@
+//--------------------------------------------------------------------------------------
+// Texture cache - loads textures once per distinct content and keeps decoded textures on disk
+//--------------------------------------------------------------------------------------
+
+#include "TextureCache.h"
+#include "BinaryFile.h"
+#include "PixelFormat.h"
+#include "../Common.h"
+
+#include <DDSTextureLoader.h>
+#include <wincodec.h>
+#include <atlbase.h> // CComPtr
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define TEXTURE_SSE
+#endif
+
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	// Cache file
+	//--------------------------------------------------------------------------------------
+
+	// Increase when the decoding or mip-map generation changes, so old cache files are replaced
+	const uint32_t TextureCacheVersion = 1;
+
+	// Start of a texture cache file, followed by each mip-map in turn, largest first, as rows of 8-bit RGBA pixels
+	struct TextureCacheHeader
+	{
+		char     magic[4];  // "TEXC"
+		uint32_t version;
+		uint64_t key;       // Hash of the image file contents and the version
+		uint32_t width;
+		uint32_t height;
+		uint32_t format;    // DXGI_FORMAT_R8G8B8A8_UNORM or DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+		uint32_t mipLevels; // Always the full chain down to 1x1
+	};
+
+
+	// Number of mip-maps in a full chain for a texture of the given size
+	uint32_t FullMipLevels(uint32_t width, uint32_t height)
+	{
+		uint32_t levels = 1;
+		while (width > 1 || height > 1)
+		{
+			width  = std::max(width  / 2, 1u);
+			height = std::max(height / 2, 1u);
+			++levels;
+		}
+		return levels;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Pixel conversion
+	//--------------------------------------------------------------------------------------
+
+#if defined(TEXTURE_SSE)
+	// Swap the red and blue bytes of four pixels and OR in the given alpha
+	inline __m128i SwapRedBlue4(__m128i pixels, __m128i alpha)
+	{
+		const __m128i greenAlpha = _mm_set1_epi32(static_cast<int>(0xff00ff00));
+		const __m128i lowByte    = _mm_set1_epi32(0xff);
+		__m128i red  = _mm_and_si128(_mm_srli_epi32(pixels, 16), lowByte);
+		__m128i blue = _mm_slli_epi32(_mm_and_si128(pixels, lowByte), 16);
+		return _mm_or_si128(_mm_or_si128(_mm_and_si128(pixels, greenAlpha), alpha), _mm_or_si128(red, blue));
+	}
+#endif
+
+	// Convert BGRA pixels to RGBA, four at a time with SSE2. Pass opaque to set alpha to 255, for BGRX pixels. The source and
+	// target can be the same
+	void ConvertBGRAToRGBA(const uint32_t* source, uint32_t* target, int count, bool opaque)
+	{
+		int i = 0;
+#if defined(TEXTURE_SSE)
+		const __m128i alpha = _mm_set1_epi32(opaque ? static_cast<int>(0xff000000) : 0);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), SwapRedBlue4(pixels, alpha));
+		}
+#endif
+		const uint32_t alpha32 = opaque ? 0xff000000 : 0;
+		for (; i < count; ++i)
+		{
+			uint32_t pixel = source[i];
+			target[i] = (pixel & 0xff00ff00) | ((pixel >> 16) & 0xff) | ((pixel & 0xff) << 16) | alpha32;
+		}
+	}
+
+	// Convert 24-bit BGR pixels to opaque RGBA. With SSE2, four pixels (12 bytes) are loaded at once and pixel n is moved up
+	// n bytes into its own 32-bit lane, then converted as BGRX. Each load reads 16 bytes so the last few pixels are done singly
+	void ConvertBGRToRGBA(const unsigned char* source, uint32_t* target, int count)
+	{
+		int i = 0;
+#if defined(TEXTURE_SSE)
+		const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+		const __m128i lane0 = _mm_setr_epi32(0xffffff, 0, 0, 0);
+		const __m128i lane1 = _mm_setr_epi32(0, 0xffffff, 0, 0);
+		const __m128i lane2 = _mm_setr_epi32(0, 0, 0xffffff, 0);
+		const __m128i lane3 = _mm_setr_epi32(0, 0, 0, 0xffffff);
+		for (; i + 6 <= count; i += 4)
+		{
+			__m128i bgr = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 3));
+			__m128i pixels = _mm_or_si128(_mm_or_si128(_mm_and_si128(bgr, lane0), _mm_and_si128(_mm_slli_si128(bgr, 1), lane1)),
+			                              _mm_or_si128(_mm_and_si128(_mm_slli_si128(bgr, 2), lane2), _mm_and_si128(_mm_slli_si128(bgr, 3), lane3)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(target + i), SwapRedBlue4(pixels, alpha));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			const unsigned char* pixel = source + i * 3;
+			target[i] = pixel[2] | (pixel[1] << 8) | (pixel[0] << 16) | 0xff000000;
+		}
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Mip-maps
+	//--------------------------------------------------------------------------------------
+
+	// Average of four 8-bit RGBA pixels, rounded to nearest
+	inline uint32_t Average4(uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+	{
+		uint32_t result = 0;
+		for (int shift = 0; shift < 32; shift += 8)
+		{
+			uint32_t sum = ((a >> shift) & 0xff) + ((b >> shift) & 0xff) + ((c >> shift) & 0xff) + ((d >> shift) & 0xff);
+			result |= ((sum + 2) >> 2) << shift;
+		}
+		return result;
+	}
+
+	// Make the next mip-map of an image, each pixel the average of a 2x2 block. When a side is odd the last row / column is
+	// averaged with itself. With SSE2, two target pixels are made at once from a pair of 4-pixel source rows
+	void DownsampleRGBA8(const uint32_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint32_t* target)
+	{
+		uint32_t targetWidth  = std::max(sourceWidth  / 2, 1u);
+		uint32_t targetHeight = std::max(sourceHeight / 2, 1u);
+		for (uint32_t y = 0; y < targetHeight; ++y)
+		{
+			const uint32_t* row0 = source + std::min(y * 2,     sourceHeight - 1) * sourceWidth;
+			const uint32_t* row1 = source + std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth;
+			uint32_t* targetRow = target + y * targetWidth;
+
+			uint32_t x = 0;
+#if defined(TEXTURE_SSE)
+			const __m128i zero  = _mm_setzero_si128();
+			const __m128i round = _mm_set1_epi16(2);
+			for (; x + 2 <= targetWidth && x * 2 + 4 <= sourceWidth; x += 2)
+			{
+				__m128i top    = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 2));
+				__m128i bottom = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 2));
+
+				// Sum each column pair in 16 bits, then add the two columns of each block (the halves of each register)
+				__m128i left  = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i right = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+				left  = _mm_add_epi16(left,  _mm_srli_si128(left,  8));
+				right = _mm_add_epi16(right, _mm_srli_si128(right, 8));
+				__m128i sum = _mm_unpacklo_epi64(left, right);
+
+				__m128i average = _mm_srli_epi16(_mm_add_epi16(sum, round), 2);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(targetRow + x), _mm_packus_epi16(average, average));
+			}
+#endif
+			for (; x < targetWidth; ++x)
+			{
+				uint32_t x0 = std::min(x * 2,     sourceWidth - 1);
+				uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				targetRow[x] = Average4(row0[x0], row0[x1], row1[x0], row1[x1]);
+			}
+		}
+	}
+
+	// Make the next mip-map of an sRGB image. The colours are averaged in linear space, as the GPU does for sRGB textures,
+	// using the sRGB tables of the CPU post-processing (RGBA8 scene buffers are stored the same way)
+	void DownsampleSrgb(const uint32_t* source, uint32_t sourceWidth, uint32_t sourceHeight, uint32_t* target)
+	{
+		uint32_t targetWidth  = std::max(sourceWidth  / 2, 1u);
+		uint32_t targetHeight = std::max(sourceHeight / 2, 1u);
+		std::vector<ColourRGBA> row0(sourceWidth), row1(sourceWidth), targetRow(targetWidth);
+		for (uint32_t y = 0; y < targetHeight; ++y)
+		{
+			UnpackPixels(SceneBufferFormat::RGBA8, source + std::min(y * 2,     sourceHeight - 1) * sourceWidth, static_cast<int>(sourceWidth), row0.data());
+			UnpackPixels(SceneBufferFormat::RGBA8, source + std::min(y * 2 + 1, sourceHeight - 1) * sourceWidth, static_cast<int>(sourceWidth), row1.data());
+			for (uint32_t x = 0; x < targetWidth; ++x)
+			{
+				uint32_t x0 = std::min(x * 2,     sourceWidth - 1);
+				uint32_t x1 = std::min(x * 2 + 1, sourceWidth - 1);
+				targetRow[x] = { (row0[x0].r + row0[x1].r + row1[x0].r + row1[x1].r) * 0.25f,
+				                 (row0[x0].g + row0[x1].g + row1[x0].g + row1[x1].g) * 0.25f,
+				                 (row0[x0].b + row0[x1].b + row1[x0].b + row1[x1].b) * 0.25f,
+				                 (row0[x0].a + row0[x1].a + row1[x0].a + row1[x1].a) * 0.25f };
+			}
+			PackPixels(SceneBufferFormat::RGBA8, targetRow.data(), static_cast<int>(targetWidth), target + y * targetWidth);
+		}
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// Decoding
+	//--------------------------------------------------------------------------------------
+
+	// Image decoded by WIC, 8-bit RGBA
+	struct DecodedImage
+	{
+		uint32_t              width  = 0;
+		uint32_t              height = 0;
+		bool                  srgb   = false;
+		std::vector<uint32_t> pixels;
+	};
+
+	// Initialises COM on the current thread for the lifetime of the object. WIC needs COM, and worker threads don't have
+	// it initialised. A thread that already uses COM in a different mode (e.g. the main thread) is left as it is
+	class ComInitialiser
+	{
+	public:
+		ComInitialiser()  : mResult(CoInitializeEx(nullptr, COINIT_MULTITHREADED)) {}
+		~ComInitialiser() { if (SUCCEEDED(mResult))  CoUninitialize(); }
+
+	private:
+		HRESULT mResult;
+	};
+
+
+	// Whether an image is marked as sRGB, checked in the same way as DirectXTK's WIC loader so textures look the same as
+	// they did when loaded with it
+	bool IsSrgbImage(IWICBitmapFrameDecode* frame)
+	{
+		CComPtr<IWICMetadataQueryReader> metadata;
+		GUID container;
+		if (FAILED(frame->GetMetadataQueryReader(&metadata)) || FAILED(metadata->GetContainerFormat(&container)))  return false;
+
+		bool srgb = false;
+		PROPVARIANT value;
+		PropVariantInit(&value);
+		if (container == GUID_ContainerFormatPng)
+		{
+			srgb = SUCCEEDED(metadata->GetMetadataByName(L"/sRGB/RenderingIntent", &value)) && value.vt == VT_UI1;
+		}
+		else
+		{
+			srgb = SUCCEEDED(metadata->GetMetadataByName(L"System.Image.ColorSpace", &value)) && value.vt == VT_UI2 && value.uiVal == 1;
+		}
+		PropVariantClear(&value);
+		return srgb;
+	}
+
+
+	// Decode an image file in memory with WIC. The common formats WIC decodes to (24-bit BGR from JPEGs, 32-bit BGRA from
+	// PNGs) are converted by the functions above, WIC converts anything else. Returns false on failure
+	bool DecodeImage(const unsigned char* data, size_t size, DecodedImage& image)
+	{
+		ComInitialiser com; // Must be destroyed after the WIC objects below
+
+		CComPtr<IWICImagingFactory>    factory;
+		CComPtr<IWICStream>            stream;
+		CComPtr<IWICBitmapDecoder>     decoder;
+		CComPtr<IWICBitmapFrameDecode> frame;
+		if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))) ||
+		    FAILED(factory->CreateStream(&stream)) ||
+		    FAILED(stream->InitializeFromMemory(const_cast<BYTE*>(data), static_cast<DWORD>(size))) ||
+		    FAILED(factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder)) ||
+		    FAILED(decoder->GetFrame(0, &frame)))
+		{
+			return false;
+		}
+
+		UINT width, height;
+		WICPixelFormatGUID format;
+		if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0 ||
+		    width > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION || height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+		    FAILED(frame->GetPixelFormat(&format)))
+		{
+			return false;
+		}
+		image.width  = width;
+		image.height = height;
+		image.srgb   = IsSrgbImage(frame);
+		image.pixels.resize(static_cast<size_t>(width) * height);
+
+		UINT rowSize   = width * 4;
+		UINT imageSize = rowSize * height;
+		BYTE* pixels = reinterpret_cast<BYTE*>(image.pixels.data());
+		if (format == GUID_WICPixelFormat32bppRGBA)
+		{
+			return SUCCEEDED(frame->CopyPixels(nullptr, rowSize, imageSize, pixels));
+		}
+		else if (format == GUID_WICPixelFormat32bppBGRA || format == GUID_WICPixelFormat32bppBGR)
+		{
+			if (FAILED(frame->CopyPixels(nullptr, rowSize, imageSize, pixels)))  return false;
+			ConvertBGRAToRGBA(image.pixels.data(), image.pixels.data(), static_cast<int>(image.pixels.size()), format == GUID_WICPixelFormat32bppBGR);
+			return true;
+		}
+		else if (format == GUID_WICPixelFormat24bppBGR)
+		{
+			UINT bgrRowSize = width * 3;
+			std::vector<unsigned char> bgr(static_cast<size_t>(bgrRowSize) * height);
+			if (FAILED(frame->CopyPixels(nullptr, bgrRowSize, static_cast<UINT>(bgr.size()), bgr.data())))  return false;
+			ConvertBGRToRGBA(bgr.data(), image.pixels.data(), static_cast<int>(image.pixels.size()));
+			return true;
+		}
+		else
+		{
+			CComPtr<IWICFormatConverter> converter;
+			return SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+			       SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, nullptr, 0, WICBitmapPaletteTypeMedianCut)) &&
+			       SUCCEEDED(converter->CopyPixels(nullptr, rowSize, imageSize, pixels));
+		}
+	}
+
+
+	// Make the contents of a cache file from a decoded image: the header then the image and all its mip-maps
+	std::vector<unsigned char> MakeTextureData(uint64_t key, const DecodedImage& image)
+	{
+		TextureCacheHeader header = {};
+		std::memcpy(header.magic, "TEXC", 4);
+		header.version   = TextureCacheVersion;
+		header.key       = key;
+		header.width     = image.width;
+		header.height    = image.height;
+		header.format    = image.srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+		header.mipLevels = FullMipLevels(image.width, image.height);
+
+		size_t numPixels = 0;
+		for (uint32_t level = 0; level < header.mipLevels; ++level)
+		{
+			numPixels += static_cast<size_t>(std::max(image.width >> level, 1u)) * std::max(image.height >> level, 1u);
+		}
+
+		std::vector<unsigned char> data(sizeof(header) + numPixels * 4);
+		std::memcpy(data.data(), &header, sizeof(header));
+		uint32_t* mip = reinterpret_cast<uint32_t*>(data.data() + sizeof(header));
+		std::memcpy(mip, image.pixels.data(), image.pixels.size() * 4);
+
+		uint32_t width = image.width, height = image.height;
+		for (uint32_t level = 1; level < header.mipLevels; ++level)
+		{
+			uint32_t* nextMip = mip + static_cast<size_t>(width) * height;
+			if (image.srgb)  DownsampleSrgb (mip, width, height, nextMip);
+			else             DownsampleRGBA8(mip, width, height, nextMip);
+			mip    = nextMip;
+			width  = std::max(width  / 2, 1u);
+			height = std::max(height / 2, 1u);
+		}
+		return data;
+	}
+
+
+	// Read the header of a cache file's contents. Returns false if the file is incomplete or doesn't have the given key
+	bool ReadCacheHeader(const unsigned char* data, size_t size, uint64_t key, TextureCacheHeader& header)
+	{
+		if (size < sizeof(TextureCacheHeader))  return false;
+		std::memcpy(&header, data, sizeof(header));
+		if (std::memcmp(header.magic, "TEXC", 4) != 0 || header.version != TextureCacheVersion || header.key != key ||
+		    header.width  == 0 || header.width  > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+		    header.height == 0 || header.height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+		    (header.format != DXGI_FORMAT_R8G8B8A8_UNORM && header.format != DXGI_FORMAT_R8G8B8A8_UNORM_SRGB) ||
+		    header.mipLevels != FullMipLevels(header.width, header.height))
+		{
+			return false;
+		}
+
+		size_t numPixels = 0;
+		for (uint32_t level = 0; level < header.mipLevels; ++level)
+		{
+			numPixels += static_cast<size_t>(std::max(header.width >> level, 1u)) * std::max(header.height >> level, 1u);
+		}
+		return size == sizeof(header) + numPixels * 4;
+	}
+
+
+	// Create a texture and view from the contents of a cache file, if it is complete and has the given key. Only uses the
+	// device so can be called from any thread. Returns false on failure
+	bool CreateTexture(const unsigned char* data, size_t size, uint64_t key, ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV)
+	{
+		TextureCacheHeader header;
+		if (!ReadCacheHeader(data, size, key, header))  return false;
+
+		// Point each mip-map's initial data into the file
+		std::vector<D3D11_SUBRESOURCE_DATA> mips(header.mipLevels);
+		size_t offset = sizeof(header);
+		for (uint32_t level = 0; level < header.mipLevels; ++level)
+		{
+			uint32_t width  = std::max(header.width  >> level, 1u);
+			uint32_t height = std::max(header.height >> level, 1u);
+			mips[level].pSysMem          = data + offset;
+			mips[level].SysMemPitch      = width * 4;
+			mips[level].SysMemSlicePitch = 0;
+			offset += static_cast<size_t>(width) * height * 4;
+		}
+
+		D3D11_TEXTURE2D_DESC textureDesc = {};
+		textureDesc.Width            = header.width;
+		textureDesc.Height           = header.height;
+		textureDesc.MipLevels        = header.mipLevels;
+		textureDesc.ArraySize        = 1;
+		textureDesc.Format           = static_cast<DXGI_FORMAT>(header.format);
+		textureDesc.SampleDesc.Count = 1;
+		textureDesc.Usage            = D3D11_USAGE_IMMUTABLE;
+		textureDesc.BindFlags        = D3D11_BIND_SHADER_RESOURCE;
+
+		ID3D11Texture2D* texture2D = nullptr;
+		if (FAILED(gD3DDevice->CreateTexture2D(&textureDesc, mips.data(), &texture2D)))  return false;
+		if (FAILED(gD3DDevice->CreateShaderResourceView(texture2D, nullptr, textureSRV)))
+		{
+			texture2D->Release();
+			return false;
+		}
+		*texture = texture2D;
+		return true;
+	}
+
+
+	//--------------------------------------------------------------------------------------
+	// CPU images
+	//--------------------------------------------------------------------------------------
+
+	// Copy the top mip-map from the contents of a cache file, if it is complete and has the given key. Returns false on failure
+	bool ReadCachedImage(const unsigned char* data, size_t size, uint64_t key, DecodedImage& image)
+	{
+		TextureCacheHeader header;
+		if (!ReadCacheHeader(data, size, key, header))  return false;
+
+		image.width  = header.width;
+		image.height = header.height;
+		image.srgb   = header.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+		image.pixels.resize(static_cast<size_t>(header.width) * header.height);
+		std::memcpy(image.pixels.data(), data + sizeof(header), image.pixels.size() * 4);
+		return true;
+	}
+
+
+	// Copy the top mip-map of an uncompressed 32-bit RGBA or BGRA DDS file, the formats the scene's DDS textures use. These
+	// have no sRGB flag so the GPU reads them as plain UNORM. Returns false for anything else, e.g. block compressed files
+	bool ReadDDSImage(const unsigned char* data, size_t size, DecodedImage& image)
+	{
+		// Offsets into the file of the parts of the DDS header used (the header follows the 4-byte "DDS " magic)
+		const size_t   HeaderSize = 128;
+		const size_t   HeightOffset = 12, WidthOffset = 16, PixelFlagsOffset = 80, BitCountOffset = 88, MasksOffset = 92;
+		const uint32_t PixelAlpha = 0x1, PixelFourCC = 0x4, PixelRGB = 0x40;
+
+		if (size < HeaderSize)  return false;
+		uint32_t height, width, pixelFlags, bitCount, masks[4];
+		std::memcpy(&height,     data + HeightOffset,     4);
+		std::memcpy(&width,      data + WidthOffset,      4);
+		std::memcpy(&pixelFlags, data + PixelFlagsOffset, 4);
+		std::memcpy(&bitCount,   data + BitCountOffset,   4);
+		std::memcpy(masks,       data + MasksOffset,      sizeof(masks));
+		if ((pixelFlags & PixelFourCC) || !(pixelFlags & PixelRGB) || bitCount != 32 ||
+		    width  == 0 || width  > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+		    height == 0 || height > D3D11_REQ_TEXTURE2D_U_OR_V_DIMENSION ||
+		    size < HeaderSize + static_cast<size_t>(width) * height * 4)
+		{
+			return false;
+		}
+
+		bool rgba = masks[0] == 0x000000ff && masks[1] == 0x0000ff00 && masks[2] == 0x00ff0000;
+		bool bgra = masks[0] == 0x00ff0000 && masks[1] == 0x0000ff00 && masks[2] == 0x000000ff;
+		if (!rgba && !bgra)  return false;
+		bool opaque = !(pixelFlags & PixelAlpha) || masks[3] == 0;
+
+		image.width  = width;
+		image.height = height;
+		image.srgb   = false;
+		image.pixels.resize(static_cast<size_t>(width) * height);
+		const uint32_t* pixels = reinterpret_cast<const uint32_t*>(data + HeaderSize);
+		if (bgra)
+		{
+			ConvertBGRAToRGBA(pixels, image.pixels.data(), static_cast<int>(image.pixels.size()), opaque);
+		}
+		else
+		{
+			std::memcpy(image.pixels.data(), pixels, image.pixels.size() * 4);
+			if (opaque)
+			{
+				for (auto& pixel : image.pixels)  pixel |= 0xff000000;
+			}
+		}
+		return true;
+	}
+
+
+	// Convert 8-bit RGBA pixels to a CPU image as the GPU reads them, decoding sRGB images to linear
+	void MakeImage(const DecodedImage& decoded, Image& image)
+	{
+		int width  = static_cast<int>(decoded.width);
+		int height = static_cast<int>(decoded.height);
+		image.Resize(width, height);
+		for (int y = 0; y < height; ++y)
+		{
+			const uint32_t* rgba = decoded.pixels.data() + static_cast<size_t>(y) * width;
+			ColourRGBA* row = image.Row(y);
+			if (decoded.srgb)
+			{
+				UnpackPixels(SceneBufferFormat::RGBA8, rgba, width, row); // RGBA8 scene buffers are sRGB encoded too
+			}
+			else
+			{
+				for (int x = 0; x < width; ++x)
+				{
+					row[x] = { ( rgba[x]        & 0xff) / 255.0f, ((rgba[x] >>  8) & 0xff) / 255.0f,
+					           ((rgba[x] >> 16) & 0xff) / 255.0f, ( rgba[x] >> 24        ) / 255.0f };
+				}
+			}
+		}
+	}
+}
+
+
+//--------------------------------------------------------------------------------------
+// Texture cache
+//--------------------------------------------------------------------------------------
+
+// Releases the cache's own references. Textures stay alive while the references given out by Load are held
+TextureCache::~TextureCache()
+{
+	for (auto& entry : mEntries)
+	{
+		if (entry.second->textureSRV)  entry.second->textureSRV->Release();
+		if (entry.second->texture)     entry.second->texture->Release();
+	}
+}
+
+
+// Load a texture and create a shader resource view for it, as LoadTexture does (see GraphicsHelpers.h). The pointers
+// returned must be released as usual. Textures with the same contents as one loaded before return the same objects.
+// Returns false on failure
+bool TextureCache::Load(const std::string& fileName, ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV)
+{
+	MappedFile file;
+	if (!file.Open(fileName) || file.Size() == 0)  return false;
+	uint64_t key = HashData(file.Data(), file.Size());
+
+	// Find the entry for these contents. Entries are never removed so the pointer stays valid
+	Entry* entry;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		auto& newEntry = mEntries[key];
+		if (!newEntry)  newEntry = std::make_unique<Entry>();
+		entry = newEntry.get();
+	}
+
+	std::lock_guard<std::mutex> entryLock(entry->mutex);
+	if (entry->texture != nullptr)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		++mNumShared;
+	}
+	else if (file.Size() >= 4 && std::memcmp(file.Data(), "DDS ", 4) == 0)
+	{
+		// DDS files are already in GPU formats with their mip-maps
+		if (FAILED(DirectX::CreateDDSTextureFromMemory(gD3DDevice, file.Data(), file.Size(), &entry->texture, &entry->textureSRV)))
+		{
+			entry->texture = nullptr;
+			entry->textureSRV = nullptr;
+			return false;
+		}
+	}
+	else
+	{
+		// Use the decoded texture saved beside the image if it was made from the same contents, otherwise decode the image
+		// and save the result for next time. Failing to save is not an error
+		std::string cacheFileName = fileName + ".cache";
+		uint64_t cacheKey = HashData(&TextureCacheVersion, sizeof(TextureCacheVersion), key);
+		MappedFile cacheFile;
+		if (!cacheFile.Open(cacheFileName) ||
+		    !CreateTexture(cacheFile.Data(), cacheFile.Size(), cacheKey, &entry->texture, &entry->textureSRV))
+		{
+			cacheFile.Close();
+			DecodedImage image;
+			if (!DecodeImage(file.Data(), file.Size(), image))  return false;
+			std::vector<unsigned char> data = MakeTextureData(cacheKey, image);
+			if (!CreateTexture(data.data(), data.size(), cacheKey, &entry->texture, &entry->textureSRV))  return false;
+			WriteFileReplacing(cacheFileName, data);
+		}
+	}
+
+	entry->texture->AddRef();
+	entry->textureSRV->AddRef();
+	*texture    = entry->texture;
+	*textureSRV = entry->textureSRV;
+	return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+// CPU images
+//--------------------------------------------------------------------------------------
+
+// Load the top mip-map of a texture file into a CPU image, with the values the GPU would sample from the texture Load creates
+// for the same file. Images other than DDS use the decoded file saved beside them by Load when it is up to date
+bool LoadTextureImage(const std::string& fileName, Image& image)
+{
+	MappedFile file;
+	if (!file.Open(fileName) || file.Size() == 0)  return false;
+
+	DecodedImage decoded;
+	if (file.Size() >= 4 && std::memcmp(file.Data(), "DDS ", 4) == 0)
+	{
+		if (!ReadDDSImage(file.Data(), file.Size(), decoded))  return false;
+	}
+	else
+	{
+		uint64_t cacheKey = HashData(&TextureCacheVersion, sizeof(TextureCacheVersion), HashData(file.Data(), file.Size()));
+		MappedFile cacheFile;
+		if (!cacheFile.Open(fileName + ".cache") || !ReadCachedImage(cacheFile.Data(), cacheFile.Size(), cacheKey, decoded))
+		{
+			if (!DecodeImage(file.Data(), file.Size(), decoded))  return false;
+		}
+	}
+
+	MakeImage(decoded, image);
+	return true;
+}
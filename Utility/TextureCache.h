@@ -0,0 +1,78 @@
+//--------------------------------------------------------------------------------------
+// Texture cache - loads textures once per distinct content and keeps decoded textures on disk
+//--------------------------------------------------------------------------------------
+// Textures are identified by a hash of their file contents, so requests for the same image, under
+// the same or a different file name, share one texture and shader resource view. Each caller gets
+// its own reference to release as usual. Load is thread-safe and uses only the D3D device, so
+// textures can be loaded from worker threads (see InitGeometry in Scene.cpp).
+//
+// DDS files are ready for the GPU and are created directly. Other files are decoded with WIC to
+// 8-bit RGBA, converting from WIC's own pixel formats with SSE2 where possible, and mip-maps are
+// made on the CPU (in linear space for sRGB images, as the GPU does). The decoded result with its
+// mip-maps is saved beside the image (the image file name plus ".cache") and reused while the
+// image's contents are unchanged.
+//
+// LoadTextureImage loads the same files into CPU images for the software rasterizer, without the
+// GPU. It reuses the decoded file saved by Load, and reads the uncompressed DDS files the scene uses
+// directly. Code in .cpp file
+
+#ifndef _TEXTURE_CACHE_H_INCLUDED_
+#define _TEXTURE_CACHE_H_INCLUDED_
+
+#include "Image.h"
+
+#include <d3d11.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class TextureCache
+{
+public:
+	// Construction / Destruction //
+
+	TextureCache() = default;
+
+	// Releases the cache's own references. Textures stay alive while the references given out by Load are held
+	~TextureCache();
+
+	TextureCache(const TextureCache&) = delete;
+	TextureCache& operator=(const TextureCache&) = delete;
+
+
+	// Usage //
+
+	// Load a texture and create a shader resource view for it, as LoadTexture does (see GraphicsHelpers.h). The pointers
+	// returned must be released as usual. Textures with the same contents as one loaded before return the same objects.
+	// Returns false on failure
+	bool Load(const std::string& fileName, ID3D11Resource** texture, ID3D11ShaderResourceView** textureSRV);
+
+	// Number of Load calls that were given a texture loaded before. Only call when no loads are in progress
+	int NumShared() const  { return mNumShared; }
+
+
+private:
+	// A texture with distinct contents. Locked while the texture is being loaded, so other requests for the same
+	// contents wait for it rather than loading it again
+	struct Entry
+	{
+		std::mutex                mutex;
+		ID3D11Resource*           texture    = nullptr;
+		ID3D11ShaderResourceView* textureSRV = nullptr;
+	};
+
+	std::mutex                                  mMutex;   // Protects the entries and count below
+	std::map<uint64_t, std::unique_ptr<Entry>> mEntries; // Keyed by hash of the file contents
+	int                                         mNumShared = 0;
+};
+
+
+// Load the top mip-map of a texture file into a CPU image, e.g. for the software rasterizer. The pixels have the values the GPU
+// samples from the texture Load creates for the same file, sRGB images are decoded to linear. DDS files must be uncompressed
+// 32-bit RGBA or BGRA. Returns false on failure
+bool LoadTextureImage(const std::string& fileName, Image& image);
+
+
+#endif //_TEXTURE_CACHE_H_INCLUDED_
@@ -0,0 +1,136 @@
+//--------------------------------------------------------------------------------------
+// Thread pool - a fixed set of worker threads that run queued tasks
+//--------------------------------------------------------------------------------------
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+
+// Construction / Destruction //
+
+// Create the worker threads. Pass 0 to create one worker per hardware thread, less one for the calling thread
+// (which also does work in ParallelFor)
+ThreadPool::ThreadPool(unsigned int numWorkers /*= 0*/)
+	: mStopping(false)
+{
+	if (numWorkers == 0)
+	{
+		unsigned int hardwareThreads = std::thread::hardware_concurrency();
+		numWorkers = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	mWorkers.reserve(numWorkers);
+	for (unsigned int i = 0; i < numWorkers; ++i)
+	{
+		mWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+	}
+}
+
+
+// Waits for running tasks to complete, tasks still queued are discarded
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mStopping = true;
+		mTasks.clear();
+	}
+	mTaskAvailable.notify_all();
+
+	for (auto& worker : mWorkers)
+	{
+		worker.join();
+	}
+}
+
+
+// Usage //
+
+// Queue a task to be run by one of the worker threads. Returns immediately
+void ThreadPool::Submit(std::function<void()> task)
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mTasks.push_back(std::move(task));
+	}
+	mTaskAvailable.notify_one();
+}
+
+
+// Call job(i) for every i from 0 to count-1, spread across the worker threads and the calling thread.
+// Returns when all the calls are complete. Safe to call from inside a job (the caller always makes progress)
+void ThreadPool::ParallelFor(int count, const std::function<void(int)>& job)
+{
+	if (count <= 0)  return;
+	if (count == 1 || mWorkers.empty())
+	{
+		for (int i = 0; i < count; ++i)  job(i);
+		return;
+	}
+
+	// Shared between the helpers and this thread. Helpers may start after this function has returned (if the workers were busy),
+	// so the state is reference counted. Late helpers find no indices left and never touch the job
+	struct ParallelForState
+	{
+		std::atomic<int>                  nextIndex;
+		std::atomic<int>                  completed;
+		int                               count;
+		const std::function<void(int)>*   job;
+		std::mutex                        mutex;
+		std::condition_variable           finished;
+	};
+	auto state = std::make_shared<ParallelForState>();
+	state->nextIndex = 0;
+	state->completed = 0;
+	state->count = count;
+	state->job = &job;
+
+	auto runJobs = [state]()
+	{
+		int numCompleted = 0;
+		int index;
+		while ((index = state->nextIndex++) < state->count)
+		{
+			(*state->job)(index);
+			++numCompleted;
+		}
+		if (numCompleted > 0 && (state->completed += numCompleted) == state->count)
+		{
+			std::lock_guard<std::mutex> lock(state->mutex);
+			state->finished.notify_all();
+		}
+	};
+
+	// One helper per worker (or per job if there are fewer jobs), then do work on this thread too
+	unsigned int numHelpers = std::min(static_cast<unsigned int>(count - 1), static_cast<unsigned int>(mWorkers.size()));
+	for (unsigned int i = 0; i < numHelpers; ++i)
+	{
+		Submit(runJobs);
+	}
+	runJobs();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state]() { return state->completed == state->count; });
+}
+
+
+// Function run by each worker thread - takes tasks from the queue until the pool is destroyed
+void ThreadPool::WorkerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mTaskAvailable.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+			if (mStopping)  return;
+
+			task = std::move(mTasks.front());
+			mTasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// Thread pool - a fixed set of worker threads that run queued tasks
+//--------------------------------------------------------------------------------------
+// Code in .cpp file
+
+#ifndef _THREAD_POOL_H_INCLUDED_
+#define _THREAD_POOL_H_INCLUDED_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	// Construction / Destruction //
+
+	// Create the worker threads. Pass 0 to create one worker per hardware thread, less one for the calling thread
+	// (which also does work in ParallelFor)
+	explicit ThreadPool(unsigned int numWorkers = 0);
+
+	// Waits for running tasks to complete, tasks still queued are discarded
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+
+	// Usage //
+
+	// Total number of threads that do work in ParallelFor (the workers plus the calling thread)
+	unsigned int NumThreads() const  { return static_cast<unsigned int>(mWorkers.size()) + 1; }
+
+	// Queue a task to be run by one of the worker threads. Returns immediately
+	void Submit(std::function<void()> task);
+
+	// Call job(i) for every i from 0 to count-1, spread across the worker threads and the calling thread.
+	// Returns when all the calls are complete. Safe to call from inside a job (the caller always makes progress)
+	void ParallelFor(int count, const std::function<void(int)>& job);
+
+
+private:
+	// Function run by each worker thread - takes tasks from the queue until the pool is destroyed
+	void WorkerLoop();
+
+	std::vector<std::thread>          mWorkers;
+	std::deque<std::function<void()>> mTasks;
+
+	std::mutex              mMutex;         // Protects the task queue and the stopping flag
+	std::condition_variable mTaskAvailable; // Signalled when a task is queued or the pool is stopping
+	bool                    mStopping;
+};
+
+
+#endif //_THREAD_POOL_H_INCLUDED_